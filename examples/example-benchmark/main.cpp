@@ -0,0 +1,469 @@
+/*
+	ofxNDI utility benchmark
+
+	Times the ofxNDIutils copy and conversion functions
+	and writes a JSON report of the results.
+
+	No Openframeworks or NDI SDK is needed. Build as a console program
+	with ofxNDIutils.cpp and ofxNDIthreadpool.cpp, for example :
+
+		g++ -std=c++11 -O2 -I../../src main.cpp
+			../../src/ofxNDIutils.cpp ../../src/ofxNDIthreadpool.cpp -lpthread
+
+	For Visual Studio, create an empty console project with the same files
+	and add "ofxNDI/src" to the include directories.
+
+	Options :
+
+		--quick           1920x1080 only and fewer repeats
+		--threads n       ofxNDIutils::SetThreads (default 1)
+		--max-threads n   last thread count of the scaling test
+		                  (default std::thread::hardware_concurrency)
+		--flush mb        size of the buffer read to empty the caches (default 64)
+		--out file        write the report to a file instead of the console
+
+	For each function, image size, stride and cache state the report gives :
+
+		ns_per_frame      median time for one frame
+		gb_per_sec        bytes read and written per second
+		cycles_per_pixel  time stamp counter cycles per pixel
+
+	"aligned" images have 16 byte aligned lines and buffers.
+	"unaligned" images are two pixels wider, so the line stride
+	is a multiple of 4 but not 16, and the buffers start 4 bytes
+	after a 64 byte boundary.
+
+	"hot" times repeat the function on the same buffers.
+	"cold" times read the flush buffer before each repeat
+	so that the image is not in the caches.
+
+	Time stamp counter cycles are at the nominal processor
+	frequency and not the actual core clock.
+
+	The "scaling" part of the report times the copy, swap, flip and
+	UYVY to RGBA kernels at 3840x2160 and 7680x4320 (3840x2160 only
+	with --quick) with SetThreads from 1 to the maximum, giving :
+
+		threads           ofxNDIutils::SetThreads
+		gb_per_sec        bytes read and written per second
+		speedup           time with one thread / time with this number
+
+	Copyright (C) 2016-2018 Lynn Jarvis.
+
+	http://www.spout.zeal.co
+
+	=========================================================================
+	This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+	=========================================================================
+
+	17.10.26 - Create file
+
+*/
+#include "ofxNDIutils.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <chrono>
+#include <thread>
+
+// Image buffer starting at an offset from a 64 byte boundary
+struct Image {
+	std::vector<unsigned char> memory;
+	unsigned char *data;
+	Image(size_t size, size_t offset)
+	{
+		memory.resize(size + 64 + offset);
+		uintptr_t start = ((uintptr_t)memory.data() + 63) & ~(uintptr_t)63;
+		data = (unsigned char *)start + offset;
+		// Touch every page and give conversions realistic values
+		for (size_t i = 0; i < size; i++)
+			data[i] = (unsigned char)(i * 7 + 3);
+	}
+};
+
+// A function to time for one image
+struct Kernel {
+	const char *name;
+	bool bSupported;
+	double srcBytesPerPixel;
+	double dstBytesPerPixel;
+	// source, dest, width, height
+	std::function<void(const unsigned char *, unsigned char *, unsigned int, unsigned int)> run;
+};
+
+struct Options {
+	bool bQuick;
+	unsigned int nThreads;
+	unsigned int maxThreads;
+	size_t flushSize;
+	std::string outFile;
+};
+
+static std::vector<unsigned char> flushBuffer;
+static volatile unsigned int flushSum = 0;
+
+// Read and write a buffer larger than the caches
+static void FlushCaches()
+{
+	unsigned int sum = 0;
+	for (size_t i = 0; i < flushBuffer.size(); i += 64) {
+		sum += flushBuffer[i];
+		flushBuffer[i] = (unsigned char)sum;
+	}
+	flushSum = sum;
+}
+
+static std::vector<Kernel> GetKernels()
+{
+	using namespace ofxNDIutils;
+	std::vector<Kernel> kernels;
+
+	// Plain copy for comparison
+	kernels.push_back({ "memcpy", true, 4, 4,
+		[](const unsigned char *s, unsigned char *d, unsigned int w, unsigned int h) {
+			memcpy(d, s, (size_t)w*h*4); } });
+	kernels.push_back({ "memcpy_sse2", HasSSE2(), 4, 4,
+		[](const unsigned char *s, unsigned char *d, unsigned int w, unsigned int h) {
+			memcpy_sse2(d, s, (size_t)w*h*4); } });
+
+	kernels.push_back({ "rgba_bgra", true, 4, 4,
+		[](const unsigned char *s, unsigned char *d, unsigned int w, unsigned int h) {
+			rgba_bgra(s, d, w, h); } });
+	kernels.push_back({ "rgba_bgra_c", true, 4, 4,
+		[](const unsigned char *s, unsigned char *d, unsigned int w, unsigned int h) {
+			rgba_bgra_c(s, d, w, h); } });
+	kernels.push_back({ "rgba_bgra_sse2", HasSSE2(), 4, 4,
+		[](const unsigned char *s, unsigned char *d, unsigned int w, unsigned int h) {
+			rgba_bgra_sse2(s, d, w, h); } });
+	kernels.push_back({ "rgba_bgra_avx2", HasAVX2(), 4, 4,
+		[](const unsigned char *s, unsigned char *d, unsigned int w, unsigned int h) {
+			rgba_bgra_avx2(s, d, w, h); } });
+	kernels.push_back({ "rgba_bgra_avx512", HasAVX512(), 4, 4,
+		[](const unsigned char *s, unsigned char *d, unsigned int w, unsigned int h) {
+			rgba_bgra_avx512(s, d, w, h); } });
+
+	kernels.push_back({ "FlipBuffer", true, 4, 4,
+		[](const unsigned char *s, unsigned char *d, unsigned int w, unsigned int h) {
+			FlipBuffer(s, d, w, h); } });
+	// In place, so only the destination is read and written
+	kernels.push_back({ "FlipImage_inplace", true, 4, 4,
+		[](const unsigned char *, unsigned char *d, unsigned int w, unsigned int h) {
+			FlipImage(d, w*4, w*4, h); } });
+	kernels.push_back({ "FlipImage_inplace_swap", true, 4, 4,
+		[](const unsigned char *, unsigned char *d, unsigned int w, unsigned int h) {
+			FlipImage(d, w*4, w*4, h, true); } });
+
+	// CopyImage options
+	// The copy used depends on the image size (see SetStreamThreshold)
+	kernels.push_back({ "CopyImage", true, 4, 4,
+		[](const unsigned char *s, unsigned char *d, unsigned int w, unsigned int h) {
+			CopyImage(s, d, w, h, w*4, false, false); } });
+	kernels.push_back({ "CopyImage_invert", true, 4, 4,
+		[](const unsigned char *s, unsigned char *d, unsigned int w, unsigned int h) {
+			CopyImage(s, d, w, h, w*4, false, true); } });
+	kernels.push_back({ "CopyImage_swap", true, 4, 4,
+		[](const unsigned char *s, unsigned char *d, unsigned int w, unsigned int h) {
+			CopyImage(s, d, w, h, w*4, true, false); } });
+	kernels.push_back({ "CopyImage_swap_invert", true, 4, 4,
+		[](const unsigned char *s, unsigned char *d, unsigned int w, unsigned int h) {
+			CopyImage(s, d, w, h, w*4, true, true); } });
+
+	// Received lines padded by 64 bytes copied to a packed image
+	kernels.push_back({ "CopyLines_padded", true, 4, 4,
+		[](const unsigned char *s, unsigned char *d, unsigned int w, unsigned int h) {
+			CopyLines(s, w*4, d, (w - 16)*4, (w - 16)*4, h); } });
+
+	// UYVY to RGBA
+	kernels.push_back({ "YUV422_to_RGBA", true, 2, 4,
+		[](const unsigned char *s, unsigned char *d, unsigned int w, unsigned int h) {
+			YUV422_to_RGBA(s, d, w, h, w*2, GetColorMatrix(w, h)); } });
+	kernels.push_back({ "YUV422_to_RGBA_c", true, 2, 4,
+		[](const unsigned char *s, unsigned char *d, unsigned int w, unsigned int h) {
+			YUV422_to_RGBA_c(s, d, w, h, w*2, GetColorMatrix(w, h)); } });
+	kernels.push_back({ "YUV422_to_RGBA_sse41", HasSSE41(), 2, 4,
+		[](const unsigned char *s, unsigned char *d, unsigned int w, unsigned int h) {
+			YUV422_to_RGBA_sse41(s, d, w, h, w*2, GetColorMatrix(w, h)); } });
+	kernels.push_back({ "YUV422_to_RGBA_avx2", HasAVX2(), 2, 4,
+		[](const unsigned char *s, unsigned char *d, unsigned int w, unsigned int h) {
+			YUV422_to_RGBA_avx2(s, d, w, h, w*2, GetColorMatrix(w, h)); } });
+
+	// Single pass conversions with flip, swap and alpha fill
+	kernels.push_back({ "ConvertImage_UYVY_BGRA_invert", true, 2, 4,
+		[](const unsigned char *s, unsigned char *d, unsigned int w, unsigned int h) {
+			ConvertImage(s, 0, FORMAT_UYVY, d, 0, FORMAT_BGRA, w, h, true, false, GetColorMatrix(w, h)); } });
+	kernels.push_back({ "ConvertImage_BGRX_RGBA_invert", true, 4, 4,
+		[](const unsigned char *s, unsigned char *d, unsigned int w, unsigned int h) {
+			ConvertImage(s, 0, FORMAT_BGRA, d, 0, FORMAT_RGBA, w, h, true, true); } });
+	kernels.push_back({ "ConvertImage_BGRA_UYVY_invert", true, 4, 2,
+		[](const unsigned char *s, unsigned char *d, unsigned int w, unsigned int h) {
+			ConvertImage(s, 0, FORMAT_BGRA, d, 0, FORMAT_UYVY, w, h, true); } });
+
+	// RGBA to UYVY
+	kernels.push_back({ "RGBA_to_YUV422", true, 4, 2,
+		[](const unsigned char *s, unsigned char *d, unsigned int w, unsigned int h) {
+			RGBA_to_YUV422(s, d, w, h, w*2); } });
+	kernels.push_back({ "RGBA_to_YUV422_c", true, 4, 2,
+		[](const unsigned char *s, unsigned char *d, unsigned int w, unsigned int h) {
+			RGBA_to_YUV422_c(s, d, w, h, w*2); } });
+	kernels.push_back({ "RGBA_to_YUV422_sse41", HasSSE41(), 4, 2,
+		[](const unsigned char *s, unsigned char *d, unsigned int w, unsigned int h) {
+			RGBA_to_YUV422_sse41(s, d, w, h, w*2); } });
+
+	// RGBA to UYVY and alpha planes
+	kernels.push_back({ "ConvertImage_RGBA_UYVA", true, 4, 3,
+		[](const unsigned char *s, unsigned char *d, unsigned int w, unsigned int h) {
+			ConvertImage(s, 0, FORMAT_RGBA, d, 0, FORMAT_UYVA, w, h); } });
+
+	// UYVY to 4:2:0 planes for video encoders
+	kernels.push_back({ "ConvertImage_UYVY_NV12", true, 2, 1.5,
+		[](const unsigned char *s, unsigned char *d, unsigned int w, unsigned int h) {
+			ConvertImage(s, 0, FORMAT_UYVY, d, 0, FORMAT_NV12, w, h); } });
+	kernels.push_back({ "ConvertImage_UYVY_I420", true, 2, 1.5,
+		[](const unsigned char *s, unsigned char *d, unsigned int w, unsigned int h) {
+			ConvertImage(s, 0, FORMAT_UYVY, d, 0, FORMAT_I420, w, h); } });
+
+	// High bit depth
+	kernels.push_back({ "ConvertImage_P216_RGBA16", true, 4, 8,
+		[](const unsigned char *s, unsigned char *d, unsigned int w, unsigned int h) {
+			ConvertImage(s, 0, FORMAT_P216, d, 0, FORMAT_RGBA16, w, h, false, false, GetColorMatrix(w, h)); } });
+	kernels.push_back({ "ConvertImage_P216_RGBA16F", true, 4, 8,
+		[](const unsigned char *s, unsigned char *d, unsigned int w, unsigned int h) {
+			ConvertImage(s, 0, FORMAT_P216, d, 0, FORMAT_RGBA16F, w, h, false, false, GetColorMatrix(w, h)); } });
+	kernels.push_back({ "ConvertImage_PA16_RGBA", true, 6, 4,
+		[](const unsigned char *s, unsigned char *d, unsigned int w, unsigned int h) {
+			ConvertImage(s, 0, FORMAT_PA16, d, 0, FORMAT_RGBA, w, h, false, false, GetColorMatrix(w, h)); } });
+	kernels.push_back({ "ConvertImage_RGBA16_P216", true, 8, 4,
+		[](const unsigned char *s, unsigned char *d, unsigned int w, unsigned int h) {
+			ConvertImage(s, 0, FORMAT_RGBA16, d, 0, FORMAT_P216, w, h, false, false, GetColorMatrix(w, h)); } });
+	kernels.push_back({ "ConvertImage_RGBA_P216", true, 4, 4,
+		[](const unsigned char *s, unsigned char *d, unsigned int w, unsigned int h) {
+			ConvertImage(s, 0, FORMAT_RGBA, d, 0, FORMAT_P216, w, h, false, false, GetColorMatrix(w, h)); } });
+	kernels.push_back({ "ConvertImage_P216_V210", true, 4, 16.0/6.0,
+		[](const unsigned char *s, unsigned char *d, unsigned int w, unsigned int h) {
+			ConvertImage(s, 0, FORMAT_P216, d, 0, FORMAT_V210, w, h); } });
+	kernels.push_back({ "ConvertImage_V210_P216", true, 16.0/6.0, 4,
+		[](const unsigned char *s, unsigned char *d, unsigned int w, unsigned int h) {
+			ConvertImage(s, 0, FORMAT_V210, d, 0, FORMAT_P216, w, h); } });
+
+	return kernels;
+}
+
+struct Result {
+	double ns;
+	double cycles;
+};
+
+// Time one kernel for one image and return the median of the repeats
+static Result TimeKernel(const Kernel &kernel, const unsigned char *src, unsigned char *dst,
+	unsigned int width, unsigned int height, bool bCold, const Options &options)
+{
+	// Warm up once, then repeat for at least the minimum time
+	kernel.run(src, dst, width, height);
+
+	unsigned int minRepeats = options.bQuick ? 3 : 5;
+	unsigned int maxRepeats = options.bQuick ? 20 : 200;
+	double minTime = options.bQuick ? 0.05e9 : 0.25e9; // nsec
+
+	std::vector<double> times;
+	std::vector<double> cycles;
+	double total = 0.0;
+	while (times.size() < maxRepeats && (times.size() < minRepeats || total < minTime)) {
+		if (bCold)
+			FlushCaches();
+		unsigned long long c0 = __rdtsc();
+		auto t0 = std::chrono::steady_clock::now();
+		kernel.run(src, dst, width, height);
+		auto t1 = std::chrono::steady_clock::now();
+		unsigned long long c1 = __rdtsc();
+		double ns = std::chrono::duration<double, std::nano>(t1 - t0).count();
+		times.push_back(ns);
+		cycles.push_back((double)(c1 - c0));
+		total += ns;
+	}
+
+	std::sort(times.begin(), times.end());
+	std::sort(cycles.begin(), cycles.end());
+	Result result;
+	result.ns = times[times.size() / 2];
+	result.cycles = cycles[cycles.size() / 2];
+	return result;
+}
+
+static bool ParseOptions(int argc, char *argv[], Options &options)
+{
+	options.bQuick = false;
+	options.nThreads = 1;
+	options.maxThreads = std::thread::hardware_concurrency();
+	options.flushSize = 64;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		bool bValue = i + 1 < argc;
+		if (arg == "--quick")
+			options.bQuick = true;
+		else if (arg == "--threads" && bValue)
+			options.nThreads = (unsigned int)atoi(argv[++i]);
+		else if (arg == "--max-threads" && bValue)
+			options.maxThreads = (unsigned int)atoi(argv[++i]);
+		else if (arg == "--flush" && bValue)
+			options.flushSize = (size_t)atoi(argv[++i]);
+		else if (arg == "--out" && bValue)
+			options.outFile = argv[++i];
+		else {
+			fprintf(stderr, "usage : %s [--quick] [--threads n] [--max-threads n] [--flush mb] [--out file]\n", argv[0]);
+			return false;
+		}
+	}
+	options.flushSize *= 1024 * 1024;
+	if (options.maxThreads == 0)
+		options.maxThreads = 1;
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	Options options;
+	if (!ParseOptions(argc, argv, options))
+		return 1;
+
+	FILE *out = stdout;
+	if (!options.outFile.empty()) {
+		out = fopen(options.outFile.c_str(), "w");
+		if (!out) {
+			fprintf(stderr, "Could not open %s\n", options.outFile.c_str());
+			return 1;
+		}
+	}
+
+	ofxNDIutils::SetThreads(options.nThreads);
+	flushBuffer.assign(options.flushSize, 1);
+
+	struct Size { unsigned int width, height; };
+	std::vector<Size> sizes;
+	if (options.bQuick) {
+		sizes.push_back({ 1920, 1080 });
+	}
+	else {
+		sizes.push_back({ 640, 480 });
+		sizes.push_back({ 1280, 720 });
+		sizes.push_back({ 1920, 1080 });
+		sizes.push_back({ 2560, 1440 });
+		sizes.push_back({ 3840, 2160 });
+		sizes.push_back({ 7680, 4320 });
+	}
+
+	std::vector<Kernel> kernels = GetKernels();
+
+	fprintf(out, "{\n");
+	fprintf(out, "  \"cpu\": { \"sse2\": %s, \"sse41\": %s, \"avx2\": %s, \"avx512\": %s, \"f16c\": %s },\n",
+		ofxNDIutils::HasSSE2() ? "true" : "false",
+		ofxNDIutils::HasSSE41() ? "true" : "false",
+		ofxNDIutils::HasAVX2() ? "true" : "false",
+		ofxNDIutils::HasAVX512() ? "true" : "false",
+		ofxNDIutils::HasF16C() ? "true" : "false");
+	fprintf(out, "  \"ermsb\": %s,\n", ofxNDIutils::HasERMSB() ? "true" : "false");
+	fprintf(out, "  \"cache_bytes\": %llu,\n", (unsigned long long)ofxNDIutils::GetCacheSize());
+	fprintf(out, "  \"stream_threshold\": %llu,\n", (unsigned long long)ofxNDIutils::GetStreamThreshold());
+	fprintf(out, "  \"threads\": %u,\n", ofxNDIutils::GetThreads());
+	fprintf(out, "  \"flush_bytes\": %llu,\n", (unsigned long long)options.flushSize);
+	fprintf(out, "  \"results\": [");
+
+	bool bFirst = true;
+	for (size_t s = 0; s < sizes.size(); s++) {
+		for (int a = 0; a < 2; a++) {
+			bool bAligned = (a == 0);
+			// Two pixels wider for a stride that is not a multiple of 16
+			unsigned int width  = sizes[s].width + (bAligned ? 0 : 2);
+			unsigned int height = sizes[s].height;
+			size_t offset = bAligned ? 0 : 4;
+			size_t pixels = (size_t)width*height;
+			// Room for 16 bit RGBA
+			Image src(pixels * 8, offset);
+			Image dst(pixels * 8, offset);
+
+			for (size_t k = 0; k < kernels.size(); k++) {
+				const Kernel &kernel = kernels[k];
+				if (!kernel.bSupported)
+					continue;
+				for (int c = 0; c < 2; c++) {
+					bool bCold = (c == 1);
+					Result result = TimeKernel(kernel, src.data, dst.data, width, height, bCold, options);
+					double bytes = (double)pixels*(kernel.srcBytesPerPixel + kernel.dstBytesPerPixel);
+					fprintf(out, "%s\n    { \"kernel\": \"%s\", \"width\": %u, \"height\": %u, "
+						"\"stride\": \"%s\", \"cache\": \"%s\", "
+						"\"ns_per_frame\": %.0f, \"gb_per_sec\": %.3f, \"cycles_per_pixel\": %.3f }",
+						bFirst ? "" : ",",
+						kernel.name, width, height,
+						bAligned ? "aligned" : "unaligned",
+						bCold ? "cold" : "hot",
+						result.ns, bytes / result.ns, result.cycles / (double)pixels);
+					fflush(out);
+					bFirst = false;
+				}
+			}
+		}
+	}
+
+	fprintf(out, "\n  ],\n");
+
+	// Thread scaling of the kernels split into bands
+	const char *scalingKernels[] = { "CopyImage", "rgba_bgra", "CopyImage_invert", "YUV422_to_RGBA" };
+	std::vector<Size> scalingSizes;
+	scalingSizes.push_back({ 3840, 2160 });
+	if (!options.bQuick)
+		scalingSizes.push_back({ 7680, 4320 });
+
+	fprintf(out, "  \"max_threads\": %u,\n", options.maxThreads);
+	fprintf(out, "  \"scaling\": [");
+	bFirst = true;
+	for (size_t s = 0; s < scalingSizes.size(); s++) {
+		unsigned int width = scalingSizes[s].width;
+		unsigned int height = scalingSizes[s].height;
+		size_t pixels = (size_t)width*height;
+		Image src(pixels * 4, 0);
+		Image dst(pixels * 4, 0);
+		for (size_t n = 0; n < sizeof(scalingKernels) / sizeof(scalingKernels[0]); n++) {
+			for (size_t k = 0; k < kernels.size(); k++) {
+				const Kernel &kernel = kernels[k];
+				if (strcmp(kernel.name, scalingKernels[n]) != 0)
+					continue;
+				double bytes = (double)pixels*(kernel.srcBytesPerPixel + kernel.dstBytesPerPixel);
+				double single = 0.0;
+				for (unsigned int t = 1; t <= options.maxThreads; t++) {
+					ofxNDIutils::SetThreads(t);
+					Result result = TimeKernel(kernel, src.data, dst.data, width, height, false, options);
+					if (t == 1)
+						single = result.ns;
+					fprintf(out, "%s\n    { \"kernel\": \"%s\", \"width\": %u, \"height\": %u, "
+						"\"threads\": %u, \"gb_per_sec\": %.3f, \"speedup\": %.2f }",
+						bFirst ? "" : ",",
+						kernel.name, width, height, t, bytes / result.ns, single / result.ns);
+					fflush(out);
+					bFirst = false;
+				}
+			}
+		}
+	}
+	ofxNDIutils::SetThreads(options.nThreads);
+
+	fprintf(out, "\n  ]\n}\n");
+
+	if (out != stdout)
+		fclose(out);
+
+	return 0;
+}
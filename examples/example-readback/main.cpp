@@ -0,0 +1,486 @@
+/*
+	ofxNDI readback check
+
+	Runs the PBO ring of ofxNDIsender (ofxNDIreadback) against a CPU
+	fake of the OpenGL buffer, fence and transfer calls and exits with 1
+	if a frame is lost, out of order or wrong, or if a buffer or fence
+	is misused or left behind.
+
+	No Openframeworks or OpenGL is needed. Build as a console program
+	with the NDI mock runtime (libs/NDImock) or the NDI SDK, for example :
+
+		g++ -std=c++11 -O2 -I../../src -I../../libs/NDImock/include main.cpp
+			../../src/ofxNDIreadback.cpp ../../src/ofxNDIsend.cpp
+			../../src/ofxNDIutils.cpp ../../src/ofxNDIthreadpool.cpp
+			../../src/ofxNDIbufferpool.cpp ../../src/ofxNDIruntime.cpp
+			../../libs/NDImock/src/Processing.NDI.Mock.cpp -lpthread
+
+	Each check sends a sequence of frames through the ring as
+	ofxNDIsender::SendImage does for an fbo, with fences that are
+	signalled a number of frames after the read :
+
+		full ring - the transfer is slower than the ring, so each
+		            frame waits for the oldest and none are skipped
+		skip      - SetSkip, frames are skipped instead of waiting
+		timeout   - the GPU stalls and the fence wait times out,
+		            nothing is mapped until the transfer completes
+		resize    - the sender size changes on the way, as by
+		            ofxNDIsender::UpdateSender
+		invert    - inverted frames with SetInPlace, a buffer
+		            mapped for reading is not written
+
+	Each is run with the buffers mapped to copy, persistently mapped
+	and with the ofxNDIsend pipeline.
+
+	Copyright (C) 2016-2018 Lynn Jarvis.
+
+	http://www.spout.zeal.co
+
+	=========================================================================
+	This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+	=========================================================================
+
+	17.10.26 - Create file
+
+*/
+#include "ofxNDIreadback.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <map>
+#include <vector>
+
+//
+// CPU fake of the OpenGL calls
+//
+// A transfer to a buffer completes, and its fence is signalled,
+// a number of frames after the read. A wait with a timeout lets
+// the GPU catch up, unless it has stalled. Any use that would
+// stall or be an error in OpenGL is counted.
+//
+class FakePbo : public ofxNDIpbo {
+
+public:
+
+	FakePbo()
+	{
+		latency = 1;
+		bStalled = false;
+		bPersistentSupported = true;
+		frame = 0;
+		width = height = 0;
+		nWaits = 0;
+		nTimeouts = 0;
+		nMaps = 0;
+		nErrors = 0;
+		nextBuffer = 1;
+		nextFence = 1;
+	}
+
+	// The framebuffer read, RGBA
+	std::vector<unsigned char> framebuffer;
+	unsigned int width, height;
+
+	unsigned int latency; // Frames from a read to its fence
+	bool bStalled; // Fences are not signalled and waits time out
+	bool bPersistentSupported;
+	unsigned long long frame; // Advanced once for each frame rendered
+
+	unsigned int nWaits; // Waits with a timeout
+	unsigned int nTimeouts;
+	unsigned int nMaps;
+	unsigned int nErrors;
+
+	size_t GetBuffers() { return buffers.size(); }
+	size_t GetFences() { return fences.size(); }
+
+	bool IsPersistentSupported()
+	{
+		return bPersistentSupported;
+	}
+
+	unsigned int CreateBuffer(size_t bytes, bool bPersistent, void **mapped)
+	{
+		Buffer &buffer = buffers[nextBuffer];
+		buffer.memory.assign(bytes, 0);
+		buffer.bPersistent = bPersistent;
+		buffer.bMapped = false;
+		buffer.complete = 0;
+		*mapped = bPersistent ? buffer.memory.data() : NULL;
+		return nextBuffer++;
+	}
+
+	void DeleteBuffer(unsigned int name, bool bMapped)
+	{
+		std::map<unsigned int, Buffer>::iterator it = buffers.find(name);
+		if (it == buffers.end())
+			return Error("delete of an unknown buffer");
+		if (bMapped != it->second.bPersistent)
+			Error("delete with the wrong mapping");
+		if (it->second.bMapped)
+			Error("delete of a mapped buffer");
+		buffers.erase(it);
+	}
+
+	void ReadPixels(unsigned int name, unsigned int w, unsigned int h)
+	{
+		Buffer *buffer = Find(name);
+		if (!buffer)
+			return Error("read into an unknown buffer");
+		if (buffer->bMapped)
+			return Error("read into a mapped buffer");
+		if (w != width || h != height || (size_t)w*h * 4 > buffer->memory.size())
+			return Error("read of the wrong size");
+		memcpy(buffer->memory.data(), framebuffer.data(), (size_t)w*h * 4);
+		buffer->complete = frame + latency;
+	}
+
+	void *FenceSync()
+	{
+		void *fence = (void *)nextFence++;
+		fences[fence] = frame + latency;
+		return fence;
+	}
+
+	bool ClientWaitSync(void *fence, unsigned long long timeout)
+	{
+		std::map<void *, unsigned long long>::iterator it = fences.find(fence);
+		if (it == fences.end()) {
+			Error("wait for an unknown fence");
+			return true;
+		}
+		if (!bStalled && frame >= it->second)
+			return true;
+		if (timeout == 0)
+			return false;
+		nWaits++;
+		if (bStalled) {
+			nTimeouts++;
+			return false;
+		}
+		// The GPU completes the commands up to the fence
+		frame = it->second;
+		return true;
+	}
+
+	void DeleteSync(void *fence)
+	{
+		if (fences.erase(fence) == 0)
+			Error("delete of an unknown fence");
+	}
+
+	void *MapBuffer(unsigned int name)
+	{
+		Buffer *buffer = Find(name);
+		if (!buffer) {
+			Error("map of an unknown buffer");
+			return NULL;
+		}
+		if (buffer->bMapped || buffer->bPersistent) {
+			Error("map of a mapped buffer");
+			return NULL;
+		}
+		if (frame < buffer->complete)
+			Error("map before the transfer is complete");
+		buffer->bMapped = true;
+		buffer->readOnly = buffer->memory;
+		nMaps++;
+		return buffer->memory.data();
+	}
+
+	void UnmapBuffer(unsigned int name)
+	{
+		Buffer *buffer = Find(name);
+		if (!buffer || !buffer->bMapped)
+			return Error("unmap of a buffer not mapped");
+		if (buffer->memory != buffer->readOnly)
+			Error("write to a buffer mapped for reading");
+		buffer->bMapped = false;
+	}
+
+private:
+
+	struct Buffer {
+		std::vector<unsigned char> memory;
+		bool bPersistent;
+		bool bMapped;
+		std::vector<unsigned char> readOnly; // Contents when mapped
+		unsigned long long complete; // Frame the transfer completes
+	};
+	std::map<unsigned int, Buffer> buffers;
+	std::map<void *, unsigned long long> fences; // Frame each is signalled
+	unsigned int nextBuffer;
+	uintptr_t nextFence;
+
+	Buffer *Find(unsigned int name)
+	{
+		std::map<unsigned int, Buffer>::iterator it = buffers.find(name);
+		return (it == buffers.end()) ? NULL : &it->second;
+	}
+
+	void Error(const char *error)
+	{
+		printf("  OpenGL error : %s\n", error);
+		nErrors++;
+	}
+
+};
+
+// Pixels of a frame, numbered so that the frame can be identified
+static void FillFrame(FakePbo &gl, unsigned int width, unsigned int height, unsigned int number)
+{
+	gl.width = width;
+	gl.height = height;
+	gl.framebuffer.resize((size_t)width*height * 4);
+	for (size_t i = 0; i < gl.framebuffer.size(); i++)
+		gl.framebuffer[i] = (unsigned char)(number * 7 + i);
+	memcpy(gl.framebuffer.data(), &number, sizeof(number));
+}
+
+// The frame number of pixels copied by Collect, 0 if they are wrong
+static unsigned int CheckFrame(const unsigned char *pixels, unsigned int width, unsigned int height)
+{
+	unsigned int number = 0;
+	memcpy(&number, pixels, sizeof(number));
+	for (size_t i = sizeof(number); i < (size_t)width*height * 4; i++) {
+		if (pixels[i] != (unsigned char)(number * 7 + i))
+			return 0;
+	}
+	return number;
+}
+
+enum Mode { MODE_COPY, MODE_PERSISTENT, MODE_PIPELINE };
+static const char *modeNames[] = { "copy", "persistent", "pipeline" };
+
+struct Result {
+	unsigned int nSent; // Frames collected and sent, or dropped by a full pipeline
+	unsigned int nWrong; // Wrong pixels or out of order
+	unsigned int last; // Last frame number collected
+};
+
+// Send one frame as ofxNDIsender::SendImage does for an fbo
+static bool SendFrame(ofxNDIsend &sender, ofxNDIreadback &ring, FakePbo &gl,
+	unsigned int width, unsigned int height, unsigned int number, Result &result,
+	bool bInvert = false)
+{
+	FillFrame(gl, width, height, number);
+
+	unsigned char *buffer = NULL;
+	if (!ring.IsMapped())
+		buffer = sender.LeaseBuffer((size_t)width*height * 4);
+
+	bool bFrame = ring.Collect(buffer);
+	if (ring.Next())
+		ring.Read(width, height);
+
+	if (bFrame && buffer) {
+		unsigned int collected = CheckFrame(buffer, sender.GetWidth(), sender.GetHeight());
+		if (collected == 0 || collected <= result.last)
+			result.nWrong++;
+		else
+			result.last = collected;
+	}
+	// A frame dropped by the pipeline has left the ring
+	unsigned int dropped = sender.GetPipelineDropped();
+	bool bSent = ring.Send(buffer, width, height, 0, bInvert);
+	if (bSent || sender.GetPipelineDropped() > dropped)
+		result.nSent++;
+
+	sender.ReturnBuffer(buffer);
+	gl.frame++;
+
+	return bSent;
+}
+
+// Report a check and return whether it passed
+static bool Check(const char *name, Mode mode, bool bPassed, const char *detail)
+{
+	printf("%-10s %-11s %s%s%s\n", name, modeNames[mode], bPassed ? "passed" : "FAILED",
+		bPassed ? "" : " - ", bPassed ? "" : detail);
+	return bPassed;
+}
+
+// Set up a sender and ring for a mode
+static void Start(ofxNDIsend &sender, ofxNDIreadback &ring, Mode mode, unsigned int width, unsigned int height)
+{
+	sender.SetClockVideo(false);
+	sender.SetPipeline(mode == MODE_PIPELINE, 2);
+	sender.CreateSender("ofxNDI readback check", width, height);
+	ring.SetPersistent(mode == MODE_PERSISTENT);
+	ring.Allocate(width, height);
+}
+
+// Delete the ring and check that nothing is left behind
+static bool Finish(ofxNDIsend &sender, ofxNDIreadback &ring, FakePbo &gl)
+{
+	ring.Delete();
+	sender.ReleaseSender();
+	return gl.GetBuffers() == 0 && gl.GetFences() == 0 && gl.nErrors == 0;
+}
+
+// The transfer takes longer than the ring covers. Each frame waits
+// for the oldest transfer and every frame is sent in order.
+static bool CheckFullRing(Mode mode)
+{
+	FakePbo gl;
+	gl.latency = 6;
+	ofxNDIsend sender;
+	ofxNDIreadback ring(sender, gl);
+	ring.SetBuffers(3);
+	Start(sender, ring, mode, 64, 48);
+
+	Result result = { 0, 0, 0 };
+	for (unsigned int i = 1; i <= 40; i++)
+		SendFrame(sender, ring, gl, 64, 48, i, result);
+
+	bool bPassed = result.nWrong == 0 && ring.GetSkipped() == 0
+		&& result.nSent == 40 - 3 && gl.nWaits > 0
+		&& (result.last == 40 - 3 || mode != MODE_COPY)
+		&& (gl.nMaps == 0 || mode != MODE_PERSISTENT);
+	bPassed = Finish(sender, ring, gl) && bPassed;
+
+	return Check("full ring", mode, bPassed, "frames lost, out of order or not waited for");
+}
+
+// With SetSkip, frames are not read while the ring is full
+// and the render thread does not wait
+static bool CheckSkip(Mode mode)
+{
+	FakePbo gl;
+	gl.latency = 6;
+	ofxNDIsend sender;
+	ofxNDIreadback ring(sender, gl);
+	ring.SetBuffers(3);
+	ring.SetSkip(true);
+	Start(sender, ring, mode, 64, 48);
+
+	Result result = { 0, 0, 0 };
+	for (unsigned int i = 1; i <= 40; i++)
+		SendFrame(sender, ring, gl, 64, 48, i, result);
+
+	bool bPassed = result.nWrong == 0 && gl.nWaits == 0
+		&& ring.GetSkipped() > 0 && result.nSent > 0
+		&& result.nSent + ring.GetSkipped() + ring.GetPending() == 40;
+	bPassed = Finish(sender, ring, gl) && bPassed;
+
+	return Check("skip", mode, bPassed, "waited or lost frames");
+}
+
+// The GPU stalls. The wait for the full ring times out, nothing
+// is sent or mapped, and frames resume once the GPU recovers.
+static bool CheckTimeout(Mode mode)
+{
+	FakePbo gl;
+	gl.latency = 1;
+	ofxNDIsend sender;
+	ofxNDIreadback ring(sender, gl);
+	ring.SetBuffers(3);
+	Start(sender, ring, mode, 64, 48);
+
+	Result result = { 0, 0, 0 };
+	for (unsigned int i = 1; i <= 10; i++)
+		SendFrame(sender, ring, gl, 64, 48, i, result);
+	unsigned int sentBefore = result.nSent;
+	unsigned int mapsBefore = gl.nMaps;
+
+	gl.bStalled = true;
+	for (unsigned int i = 11; i <= 20; i++)
+		SendFrame(sender, ring, gl, 64, 48, i, result);
+	bool bStalled = gl.nTimeouts > 0 && ring.GetPending() == 3
+		&& result.nSent <= sentBefore + 1 && gl.nMaps <= mapsBefore + 1;
+
+	gl.bStalled = false;
+	for (unsigned int i = 21; i <= 30; i++)
+		SendFrame(sender, ring, gl, 64, 48, i, result);
+
+	bool bPassed = bStalled && result.nWrong == 0 && result.nSent > sentBefore + 5;
+	bPassed = Finish(sender, ring, gl) && bPassed;
+
+	return Check("timeout", mode, bPassed, "sent or mapped during the stall, or did not resume");
+}
+
+// The sender size changes while frames are in the ring. The ring is
+// created again as by ofxNDIsender::UpdateSender, frames of the old
+// size are discarded and frames of the new size follow.
+static bool CheckResize(Mode mode)
+{
+	FakePbo gl;
+	gl.latency = 2;
+	ofxNDIsend sender;
+	ofxNDIreadback ring(sender, gl);
+	ring.SetBuffers(4);
+	Start(sender, ring, mode, 64, 48);
+
+	Result result = { 0, 0, 0 };
+	for (unsigned int i = 1; i <= 10; i++)
+		SendFrame(sender, ring, gl, 64, 48, i, result);
+	size_t nBuffers = gl.GetBuffers();
+
+	// ofxNDIsender::UpdateSender
+	ring.Allocate(96, 30);
+	sender.UpdateSender(96, 30);
+	bool bResized = ring.GetPending() == 0 && gl.GetBuffers() == nBuffers && gl.GetFences() == 0;
+
+	unsigned int sentBefore = result.nSent;
+	for (unsigned int i = 11; i <= 30; i++)
+		SendFrame(sender, ring, gl, 96, 30, i, result);
+
+	bool bPassed = bResized && result.nWrong == 0
+		&& result.nSent == sentBefore + 20 - 2 && sender.GetWidth() == 96
+		&& (result.last == 28 || mode != MODE_COPY);
+	bPassed = Finish(sender, ring, gl) && bPassed;
+
+	return Check("resize", mode, bPassed, "buffers left behind or frames of the wrong size");
+}
+
+// Inverted frames with SetInPlace. A PBO mapped for reading
+// is not written, so the pipeline inverts a copy of it.
+static bool CheckInvert(Mode mode)
+{
+	FakePbo gl;
+	gl.latency = 2;
+	ofxNDIsend sender;
+	ofxNDIreadback ring(sender, gl);
+	ring.SetBuffers(3);
+	sender.SetInPlace(true);
+	Start(sender, ring, mode, 64, 48);
+
+	Result result = { 0, 0, 0 };
+	for (unsigned int i = 1; i <= 20; i++)
+		SendFrame(sender, ring, gl, 64, 48, i, result, true);
+
+	bool bPassed = result.nWrong == 0 && result.nSent > 0
+		&& result.nSent + ring.GetPending() == 20;
+	bPassed = Finish(sender, ring, gl) && bPassed;
+
+	return Check("invert", mode, bPassed, "a buffer mapped for reading was written or frames lost");
+}
+
+int main()
+{
+	unsigned int nFailed = 0;
+
+	for (int m = MODE_COPY; m <= MODE_PIPELINE; m++) {
+		Mode mode = (Mode)m;
+		if (!CheckFullRing(mode)) nFailed++;
+		if (!CheckSkip(mode)) nFailed++;
+		if (!CheckTimeout(mode)) nFailed++;
+		if (!CheckResize(mode)) nFailed++;
+		if (!CheckInvert(mode)) nFailed++;
+	}
+
+	printf("%u checks failed\n", nFailed);
+
+	return nFailed ? 1 : 0;
+}
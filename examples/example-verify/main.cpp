@@ -0,0 +1,424 @@
+/*
+	ofxNDI conversion check
+
+	Compares every rgba_bgra path the processor supports
+	with the scalar version rgba_bgra_c, and every conversion
+	with SIMD paths at each instruction set the processor supports
+	with the same conversion limited to C (SetInstructionSet).
+	Exits with 1 if any output differs.
+
+	No Openframeworks or NDI SDK is needed. Build as a console program
+	with ofxNDIutils.cpp and ofxNDIthreadpool.cpp, for example :
+
+		g++ -std=c++11 -O2 -I../../src main.cpp
+			../../src/ofxNDIutils.cpp ../../src/ofxNDIthreadpool.cpp -lpthread
+
+	Widths from 1 to 130 pixels reach the scalar tail after every vector
+	width. Source and destination start at each 4 byte offset from a 64 byte
+	boundary so that the lines are unaligned, and odd widths give line
+	strides that are not a multiple of 16. Each size is checked with and
+	without invert. The dispatched rgba_bgra is checked as well, with more
+	than one thread.
+
+	The conversions are ConvertImage for each pair of formats that
+	it supports, FlipImage, CopyImage with padded lines, YUV422_to_RGBA,
+	RGBA_to_YUV422 and BGRA_to_YUV422. Each is checked for widths from
+	1 to 130 pixels, heights from 1 to 4 lines, packed and padded line
+	strides, with and without invert, and with and without swap or alpha
+	fill where the conversion has them. The colour matrix and range
+	change with the width. Each is checked again with more than one
+	thread at the fastest instruction set.
+
+	Copyright (C) 2016-2018 Lynn Jarvis.
+
+	http://www.spout.zeal.co
+
+	=========================================================================
+	This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+	=========================================================================
+
+	17.10.26 - Create file
+			 - Check every conversion with SIMD paths against C
+
+*/
+#include "ofxNDIutils.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <vector>
+
+typedef void (*rgba_bgra_func)(const void *source, void *dest, unsigned int width, unsigned int height, bool bInvert);
+
+struct Path {
+	const char *name;
+	bool bSupported;
+	rgba_bgra_func func;
+};
+
+// Pixels at an offset from a 64 byte boundary, guarded at both ends
+struct Buffer {
+	std::vector<unsigned char> memory;
+	unsigned char *data;
+	size_t size;
+	Buffer(size_t bytes, size_t offset)
+	{
+		size = bytes;
+		memory.assign(bytes + 192, 0xA5);
+		uintptr_t start = ((uintptr_t)memory.data() + 63) & ~(uintptr_t)63;
+		data = (unsigned char *)start + 64 + offset;
+	}
+	// Bytes before and after the image are unchanged
+	bool GuardsIntact() const
+	{
+		for (const unsigned char *p = memory.data(); p < data; p++)
+			if (*p != 0xA5) return false;
+		for (const unsigned char *p = data + size; p < memory.data() + memory.size(); p++)
+			if (*p != 0xA5) return false;
+		return true;
+	}
+};
+
+static void dispatched(const void *source, void *dest, unsigned int width, unsigned int height, bool bInvert)
+{
+	ofxNDIutils::rgba_bgra(source, dest, width, height, bInvert);
+}
+
+// Check one path for one size, offset and invert
+static bool CheckPath(const Path &path, unsigned int width, unsigned int height,
+	size_t srcOffset, size_t dstOffset, bool bInvert)
+{
+	size_t bytes = (size_t)width*height * 4;
+	Buffer src(bytes, srcOffset);
+	for (size_t i = 0; i < bytes; i++)
+		src.data[i] = (unsigned char)(i * 13 + (i >> 8) + 1);
+
+	Buffer expected(bytes, dstOffset);
+	Buffer result(bytes, dstOffset);
+	ofxNDIutils::rgba_bgra_c(src.data, expected.data, width, height, bInvert);
+	path.func(src.data, result.data, width, height, bInvert);
+
+	if (memcmp(expected.data, result.data, bytes) == 0 && result.GuardsIntact())
+		return true;
+
+	size_t i = 0;
+	while (i < bytes && expected.data[i] == result.data[i])
+		i++;
+	printf("FAIL %s width %u height %u src +%u dst +%u invert %d : ",
+		path.name, width, height, (unsigned int)srcOffset, (unsigned int)dstOffset, bInvert ? 1 : 0);
+	if (i < bytes)
+		printf("byte %u (pixel %u, line %u) is %u, expected %u\n", (unsigned int)i,
+			(unsigned int)(i / 4) % width, (unsigned int)(i / 4) / width, result.data[i], expected.data[i]);
+	else
+		printf("written outside the image\n");
+
+	return false;
+}
+
+//
+// Conversions with SIMD paths, compared with the C paths
+//
+using ofxNDIutils::PixelFormat;
+
+// Arguments of one conversion
+struct Job {
+	const unsigned char *source;
+	unsigned int sourceStride;
+	unsigned char *dest;
+	unsigned int destStride;
+	unsigned int width;
+	unsigned int height;
+	bool bInvert;
+	ofxNDIutils::ColorMatrix matrix;
+	bool bFullRange;
+};
+
+struct Conversion;
+typedef void (*run_func)(const Conversion &conversion, const Job &job);
+
+struct Conversion {
+	const char *name;
+	PixelFormat sourceFormat;
+	PixelFormat destFormat;
+	bool bOption; // Alpha fill, or swap for FlipImage
+	run_func run;
+};
+
+static void RunConvert(const Conversion &c, const Job &job)
+{
+	ofxNDIutils::ConvertImage(job.source, job.sourceStride, c.sourceFormat,
+		job.dest, job.destStride, c.destFormat, job.width, job.height,
+		job.bInvert, c.bOption, job.matrix, job.bFullRange);
+}
+
+// The image is copied to the destination and flipped there
+static void RunFlip(const Conversion &c, const Job &job)
+{
+	unsigned int lineBytes = job.width * 4;
+	ofxNDIutils::CopyLines(job.source, job.sourceStride, job.dest, job.destStride, lineBytes, job.height);
+	ofxNDIutils::FlipImage(job.dest, job.destStride, lineBytes, job.height, c.bOption);
+}
+
+static void RunCopy(const Conversion &, const Job &job)
+{
+	ofxNDIutils::CopyImage(job.source, job.dest, job.width, job.height, job.sourceStride,
+		true, job.bInvert, job.destStride);
+}
+
+static void RunYUV422toRGBA(const Conversion &, const Job &job)
+{
+	ofxNDIutils::YUV422_to_RGBA(job.source, job.dest, job.width, job.height, job.sourceStride,
+		job.matrix, job.bFullRange);
+}
+
+static void RunToYUV422(const Conversion &c, const Job &job)
+{
+	if (c.sourceFormat == ofxNDIutils::FORMAT_BGRA)
+		ofxNDIutils::BGRA_to_YUV422(job.source, job.dest, job.width, job.height, job.destStride, job.bInvert);
+	else
+		ofxNDIutils::RGBA_to_YUV422(job.source, job.dest, job.width, job.height, job.destStride, job.bInvert);
+}
+
+// Bytes of an image with a line stride, 0 - packed
+static size_t ImageBytes(PixelFormat format, unsigned int width, unsigned int height, unsigned int stride)
+{
+	using namespace ofxNDIutils;
+	if (stride == 0)
+		return GetImageBytes(format, width, height);
+	if (format == FORMAT_NV12 || format == FORMAT_I420)
+		return (size_t)stride*(height + (height + 1) / 2);
+	if (format == FORMAT_UYVA)
+		return (size_t)stride*height + (size_t)width*height;
+	return (size_t)stride*height*GetPlanes(format);
+}
+
+// Source pixels for a format
+// Half floats are from -0.125 to 1.125 so that clamping is checked.
+static void FillSource(unsigned char *data, size_t bytes, PixelFormat format, unsigned int seed)
+{
+	uint32_t state = seed * 2654435761u + 1;
+	if (format == ofxNDIutils::FORMAT_RGBA16F) {
+		unsigned short *half = (unsigned short *)data;
+		for (size_t i = 0; i < bytes / 2; i++) {
+			state = state * 1664525u + 1013904223u;
+			unsigned short h = (unsigned short)((state >> 8) % 0x3C80);
+			half[i] = ((state >> 28) == 0) ? (unsigned short)(0x8000 | (h & 0x3000)) : h;
+		}
+		return;
+	}
+	for (size_t i = 0; i < bytes; i++) {
+		state = state * 1664525u + 1013904223u;
+		data[i] = (unsigned char)(state >> 24);
+	}
+}
+
+// Check one conversion at one instruction set for one size, stride and invert
+static bool CheckConversion(const Conversion &c, ofxNDIutils::InstructionSet set, const char *setName,
+	unsigned int width, unsigned int height, bool bPadded, bool bInvert)
+{
+	using namespace ofxNDIutils;
+
+	// Padding keeps 16 bit lines and I420 chroma lines whole
+	unsigned int sourceStride = bPadded ? GetLineBytes(c.sourceFormat, width) + 36 : 0;
+	unsigned int destStride = bPadded ? GetLineBytes(c.destFormat, width) + 36 : 0;
+	size_t sourceBytes = ImageBytes(c.sourceFormat, width, height, sourceStride);
+	size_t destBytes = ImageBytes(c.destFormat, width, height, destStride);
+
+	Buffer src(sourceBytes, 4);
+	FillSource(src.data, sourceBytes, c.sourceFormat, width * 8 + height);
+
+	Buffer expected(destBytes, 20);
+	Buffer result(destBytes, 20);
+	Job job = { src.data, sourceStride, expected.data, destStride, width, height, bInvert,
+		(ColorMatrix)(width % 3), (width / 3) % 2 == 1 };
+
+	SetInstructionSet(INSTRUCTIONS_C);
+	c.run(c, job);
+	SetInstructionSet(set);
+	job.dest = result.data;
+	c.run(c, job);
+
+	if (memcmp(expected.data, result.data, destBytes) == 0 && result.GuardsIntact())
+		return true;
+
+	size_t i = 0;
+	while (i < destBytes && expected.data[i] == result.data[i])
+		i++;
+	printf("FAIL %s %s width %u height %u %s invert %d : ", c.name, setName,
+		width, height, bPadded ? "padded" : "packed", bInvert ? 1 : 0);
+	if (i < destBytes)
+		printf("byte %u is %u, expected %u\n", (unsigned int)i, result.data[i], expected.data[i]);
+	else
+		printf("written outside the image\n");
+
+	return false;
+}
+
+// Conversions that have SIMD paths
+static std::vector<Conversion> GetConversions()
+{
+	using namespace ofxNDIutils;
+
+	std::vector<Conversion> conversions;
+	conversions.push_back({ "RGBA to RGBA fill", FORMAT_RGBA, FORMAT_RGBA, true, RunConvert });
+	conversions.push_back({ "RGBA to BGRA", FORMAT_RGBA, FORMAT_BGRA, false, RunConvert });
+	conversions.push_back({ "RGBA to BGRA fill", FORMAT_RGBA, FORMAT_BGRA, true, RunConvert });
+	conversions.push_back({ "UYVY to RGBA", FORMAT_UYVY, FORMAT_RGBA, false, RunConvert });
+	conversions.push_back({ "UYVY to BGRA", FORMAT_UYVY, FORMAT_BGRA, false, RunConvert });
+	conversions.push_back({ "UYVA to RGBA", FORMAT_UYVA, FORMAT_RGBA, false, RunConvert });
+	conversions.push_back({ "UYVA to BGRA", FORMAT_UYVA, FORMAT_BGRA, false, RunConvert });
+	conversions.push_back({ "RGBA to UYVY", FORMAT_RGBA, FORMAT_UYVY, false, RunConvert });
+	conversions.push_back({ "BGRA to UYVY", FORMAT_BGRA, FORMAT_UYVY, false, RunConvert });
+	conversions.push_back({ "RGBA to UYVA", FORMAT_RGBA, FORMAT_UYVA, false, RunConvert });
+	conversions.push_back({ "BGRA to UYVA", FORMAT_BGRA, FORMAT_UYVA, false, RunConvert });
+
+	// 4:2:0
+	const PixelFormat to420[] = { FORMAT_UYVY, FORMAT_UYVA, FORMAT_RGBA, FORMAT_BGRA };
+	const char *to420names[][2] = {
+		{ "UYVY to NV12", "UYVY to I420" }, { "UYVA to NV12", "UYVA to I420" },
+		{ "RGBA to NV12", "RGBA to I420" }, { "BGRA to NV12", "BGRA to I420" } };
+	for (int i = 0; i < 4; i++) {
+		conversions.push_back({ to420names[i][0], to420[i], FORMAT_NV12, false, RunConvert });
+		conversions.push_back({ to420names[i][1], to420[i], FORMAT_I420, false, RunConvert });
+	}
+
+	// 16 bit, both ways
+	const PixelFormat deep[] = { FORMAT_RGBA, FORMAT_BGRA, FORMAT_RGBA16, FORMAT_RGBA16F, FORMAT_V210 };
+	const char *deepNames[][4] = {
+		{ "P216 to RGBA", "RGBA to P216", "PA16 to RGBA", "RGBA to PA16" },
+		{ "P216 to BGRA", "BGRA to P216", "PA16 to BGRA", "BGRA to PA16" },
+		{ "P216 to RGBA16", "RGBA16 to P216", "PA16 to RGBA16", "RGBA16 to PA16" },
+		{ "P216 to RGBA16F", "RGBA16F to P216", "PA16 to RGBA16F", "RGBA16F to PA16" },
+		{ "P216 to v210", "v210 to P216", "PA16 to v210", "v210 to PA16" } };
+	for (int i = 0; i < 5; i++) {
+		conversions.push_back({ deepNames[i][0], FORMAT_P216, deep[i], false, RunConvert });
+		conversions.push_back({ deepNames[i][1], deep[i], FORMAT_P216, false, RunConvert });
+		conversions.push_back({ deepNames[i][2], FORMAT_PA16, deep[i], false, RunConvert });
+		conversions.push_back({ deepNames[i][3], deep[i], FORMAT_PA16, false, RunConvert });
+	}
+
+	conversions.push_back({ "FlipImage", FORMAT_RGBA, FORMAT_RGBA, false, RunFlip });
+	conversions.push_back({ "FlipImage swap", FORMAT_RGBA, FORMAT_RGBA, true, RunFlip });
+	conversions.push_back({ "CopyImage swap", FORMAT_RGBA, FORMAT_RGBA, false, RunCopy });
+	conversions.push_back({ "YUV422_to_RGBA", FORMAT_UYVY, FORMAT_RGBA, false, RunYUV422toRGBA });
+	conversions.push_back({ "RGBA_to_YUV422", FORMAT_RGBA, FORMAT_UYVY, false, RunToYUV422 });
+	conversions.push_back({ "BGRA_to_YUV422", FORMAT_BGRA, FORMAT_UYVY, false, RunToYUV422 });
+
+	return conversions;
+}
+
+int main()
+{
+	using namespace ofxNDIutils;
+
+	std::vector<Path> paths;
+	paths.push_back({ "rgba_bgra_sse2", HasSSE2(), rgba_bgra_sse2 });
+	paths.push_back({ "rgba_bgra_avx2", HasAVX2(), rgba_bgra_avx2 });
+	paths.push_back({ "rgba_bgra_avx512", HasAVX512(), rgba_bgra_avx512 });
+	paths.push_back({ "rgba_bgra", true, dispatched });
+
+	unsigned int nFailed = 0;
+	unsigned int nChecked = 0;
+
+	for (size_t p = 0; p < paths.size(); p++) {
+		const Path &path = paths[p];
+		if (!path.bSupported) {
+			printf("%-18s not supported by this processor - skipped\n", path.name);
+			continue;
+		}
+		unsigned int nPathFailed = 0;
+		for (unsigned int width = 1; width <= 130; width++) {
+			for (unsigned int height = 1; height <= 3; height++) {
+				for (size_t srcOffset = 0; srcOffset < 64; srcOffset += 4) {
+					for (size_t dstOffset = 0; dstOffset < 64; dstOffset += 20) {
+						for (int inv = 0; inv < 2; inv++) {
+							nChecked++;
+							if (!CheckPath(path, width, height, srcOffset, dstOffset, inv == 1))
+								nPathFailed++;
+						}
+					}
+				}
+			}
+		}
+		printf("%-18s %s\n", path.name, nPathFailed ? "FAILED" : "bit exact");
+		nFailed += nPathFailed;
+	}
+
+	// Large images are split between threads by the dispatched path
+	SetThreads(4);
+	Path threaded = { "rgba_bgra threads", true, dispatched };
+	unsigned int nThreadFailed = 0;
+	for (int inv = 0; inv < 2; inv++) {
+		nChecked += 2;
+		if (!CheckPath(threaded, 1921, 1081, 4, 0, inv == 1)) nThreadFailed++;
+		if (!CheckPath(threaded, 3839, 517, 0, 12, inv == 1)) nThreadFailed++;
+	}
+	printf("%-18s %s\n", threaded.name, nThreadFailed ? "FAILED" : "bit exact");
+	nFailed += nThreadFailed;
+	SetThreads(1);
+
+	// Each conversion at each instruction set it could use, against C.
+	// AVX-512 is used by rgba_bgra only.
+	struct Set {
+		const char *name;
+		InstructionSet set;
+		bool bSupported;
+	};
+	const Set sets[] = {
+		{ "sse2", INSTRUCTIONS_SSE2, HasSSE2() },
+		{ "sse4.1", INSTRUCTIONS_SSE41, HasSSE41() },
+		{ "avx2", INSTRUCTIONS_AVX2, HasAVX2() } };
+	InstructionSet best = INSTRUCTIONS_C;
+	for (int s = 0; s < 3; s++) {
+		if (sets[s].bSupported)
+			best = sets[s].set;
+		else
+			printf("%-18s not supported by this processor - skipped\n", sets[s].name);
+	}
+
+	std::vector<Conversion> conversions = GetConversions();
+	for (size_t i = 0; i < conversions.size(); i++) {
+		const Conversion &c = conversions[i];
+		unsigned int nConversionFailed = 0;
+		for (int s = 0; s < 3; s++) {
+			if (!sets[s].bSupported)
+				continue;
+			for (unsigned int width = 1; width <= 130; width++) {
+				for (unsigned int height = 1; height <= 4; height++) {
+					for (int padded = 0; padded < 2; padded++) {
+						for (int inv = 0; inv < 2; inv++) {
+							nChecked++;
+							if (!CheckConversion(c, sets[s].set, sets[s].name, width, height, padded == 1, inv == 1))
+								nConversionFailed++;
+						}
+					}
+				}
+			}
+		}
+		// Large images are split between threads
+		SetThreads(4);
+		for (int inv = 0; inv < 2; inv++) {
+			nChecked++;
+			if (!CheckConversion(c, best, "threads", 1283, 723, inv == 1, inv == 1))
+				nConversionFailed++;
+		}
+		SetThreads(1);
+		printf("%-18s %s\n", c.name, nConversionFailed ? "FAILED" : "bit exact");
+		nFailed += nConversionFailed;
+	}
+	SetInstructionSet(INSTRUCTIONS_AVX512);
+
+	printf("%u checks, %u failed\n", nChecked, nFailed);
+
+	return nFailed ? 1 : 0;
+}
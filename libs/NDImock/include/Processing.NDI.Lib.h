@@ -0,0 +1,287 @@
+/*
+	NDI mock runtime
+
+	Stand-in for the NDI SDK 3.5 "Processing.NDI.Lib.h" for builds without the SDK.
+	Declares the subset of the NDIlib API used by ofxNDI with the same names,
+	values and structure layouts. Senders and receivers in the same process
+	are connected through shared memory by Processing.NDI.Mock.cpp.
+	Nothing is sent to the network.
+	The high bit depth formats of NDI 4 are declared as well.
+
+	Copyright (C) 2016-2018 Lynn Jarvis.
+
+	http://www.spout.zeal.co
+
+	=========================================================================
+	This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+	=========================================================================
+
+	17.10.26 - Create file
+			 - P216, PA16 and recv_color_format_best of NDI 4
+
+*/
+#pragma once
+#ifndef __Processing_NDI_Lib_mock__
+#define __Processing_NDI_Lib_mock__
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define NDI_LIB_MOCK 1
+
+#define NDI_LIB_FOURCC(ch0, ch1, ch2, ch3) \
+	((uint32_t)(uint8_t)(ch0) | ((uint32_t)(uint8_t)(ch1) << 8) | ((uint32_t)(uint8_t)(ch2) << 16) | ((uint32_t)(uint8_t)(ch3) << 24))
+
+//
+// Types
+//
+
+typedef enum NDIlib_frame_type_e {
+	NDIlib_frame_type_none = 0,
+	NDIlib_frame_type_video = 1,
+	NDIlib_frame_type_audio = 2,
+	NDIlib_frame_type_metadata = 3,
+	NDIlib_frame_type_error = 4,
+	NDIlib_frame_type_status_change = 100
+} NDIlib_frame_type_e;
+
+typedef enum NDIlib_FourCC_type_e {
+	NDIlib_FourCC_type_UYVY = NDI_LIB_FOURCC('U', 'Y', 'V', 'Y'),
+	NDIlib_FourCC_type_UYVA = NDI_LIB_FOURCC('U', 'Y', 'V', 'A'),
+	NDIlib_FourCC_type_BGRA = NDI_LIB_FOURCC('B', 'G', 'R', 'A'),
+	NDIlib_FourCC_type_BGRX = NDI_LIB_FOURCC('B', 'G', 'R', 'X'),
+	NDIlib_FourCC_type_RGBA = NDI_LIB_FOURCC('R', 'G', 'B', 'A'),
+	NDIlib_FourCC_type_RGBX = NDI_LIB_FOURCC('R', 'G', 'B', 'X'),
+	// NDI 4 - 16 bit Y plane, 16 bit CbCr plane and for PA16 a 16 bit alpha plane
+	NDIlib_FourCC_type_P216 = NDI_LIB_FOURCC('P', '2', '1', '6'),
+	NDIlib_FourCC_type_PA16 = NDI_LIB_FOURCC('P', 'A', '1', '6'),
+	NDIlib_FourCC_type_max = 0x7fffffff
+} NDIlib_FourCC_type_e;
+
+typedef enum NDIlib_frame_format_type_e {
+	NDIlib_frame_format_type_progressive = 1,
+	NDIlib_frame_format_type_interleaved = 0,
+	NDIlib_frame_format_type_field_0 = 2,
+	NDIlib_frame_format_type_field_1 = 3
+} NDIlib_frame_format_type_e;
+
+typedef enum NDIlib_recv_bandwidth_e {
+	NDIlib_recv_bandwidth_metadata_only = -10,
+	NDIlib_recv_bandwidth_audio_only = 10,
+	NDIlib_recv_bandwidth_lowest = 0,
+	NDIlib_recv_bandwidth_highest = 100
+} NDIlib_recv_bandwidth_e;
+
+typedef enum NDIlib_recv_color_format_e {
+	NDIlib_recv_color_format_BGRX_BGRA = 0,
+	NDIlib_recv_color_format_UYVY_BGRA = 1,
+	NDIlib_recv_color_format_RGBX_RGBA = 2,
+	NDIlib_recv_color_format_UYVY_RGBA = 3,
+	NDIlib_recv_color_format_fastest = 100,
+	NDIlib_recv_color_format_best = 101, // NDI 4
+	// Names used by earlier SDK versions
+	NDIlib_recv_color_format_e_BGRX_BGRA = NDIlib_recv_color_format_BGRX_BGRA,
+	NDIlib_recv_color_format_e_UYVY_BGRA = NDIlib_recv_color_format_UYVY_BGRA,
+	NDIlib_recv_color_format_e_RGBX_RGBA = NDIlib_recv_color_format_RGBX_RGBA,
+	NDIlib_recv_color_format_e_UYVY_RGBA = NDIlib_recv_color_format_UYVY_RGBA
+} NDIlib_recv_color_format_e;
+
+static const int64_t NDIlib_send_timecode_synthesize = INT64_MAX;
+static const int64_t NDIlib_recv_timestamp_undefined = INT64_MAX;
+
+typedef void* NDIlib_find_instance_t;
+typedef void* NDIlib_send_instance_t;
+typedef void* NDIlib_recv_instance_t;
+
+typedef struct NDIlib_source_t {
+	const char* p_ndi_name;
+	union {
+		const char* p_url_address;
+		const char* p_ip_address;
+	};
+	NDIlib_source_t(const char* p_ndi_name_ = NULL, const char* p_url_address_ = NULL)
+		: p_ndi_name(p_ndi_name_), p_url_address(p_url_address_) {}
+} NDIlib_source_t;
+
+typedef struct NDIlib_video_frame_v2_t {
+	int xres, yres;
+	NDIlib_FourCC_type_e FourCC;
+	int frame_rate_N, frame_rate_D;
+	float picture_aspect_ratio;
+	NDIlib_frame_format_type_e frame_format_type;
+	int64_t timecode;
+	uint8_t* p_data;
+	int line_stride_in_bytes;
+	const char* p_metadata;
+	int64_t timestamp;
+	NDIlib_video_frame_v2_t(int xres_ = 0, int yres_ = 0, NDIlib_FourCC_type_e FourCC_ = NDIlib_FourCC_type_UYVY,
+		int frame_rate_N_ = 30000, int frame_rate_D_ = 1001, float picture_aspect_ratio_ = 0.0f,
+		NDIlib_frame_format_type_e frame_format_type_ = NDIlib_frame_format_type_progressive,
+		int64_t timecode_ = NDIlib_send_timecode_synthesize, uint8_t* p_data_ = NULL,
+		int line_stride_in_bytes_ = 0, const char* p_metadata_ = NULL, int64_t timestamp_ = 0)
+		: xres(xres_), yres(yres_), FourCC(FourCC_), frame_rate_N(frame_rate_N_), frame_rate_D(frame_rate_D_),
+		picture_aspect_ratio(picture_aspect_ratio_), frame_format_type(frame_format_type_), timecode(timecode_),
+		p_data(p_data_), line_stride_in_bytes(line_stride_in_bytes_), p_metadata(p_metadata_), timestamp(timestamp_) {}
+} NDIlib_video_frame_v2_t;
+
+typedef struct NDIlib_audio_frame_v2_t {
+	int sample_rate, no_channels, no_samples;
+	int64_t timecode;
+	float* p_data; // Planar, one channel after another
+	int channel_stride_in_bytes;
+	const char* p_metadata;
+	int64_t timestamp;
+	NDIlib_audio_frame_v2_t(int sample_rate_ = 48000, int no_channels_ = 2, int no_samples_ = 0,
+		int64_t timecode_ = NDIlib_send_timecode_synthesize, float* p_data_ = NULL,
+		int channel_stride_in_bytes_ = 0, const char* p_metadata_ = NULL, int64_t timestamp_ = 0)
+		: sample_rate(sample_rate_), no_channels(no_channels_), no_samples(no_samples_), timecode(timecode_),
+		p_data(p_data_), channel_stride_in_bytes(channel_stride_in_bytes_), p_metadata(p_metadata_), timestamp(timestamp_) {}
+} NDIlib_audio_frame_v2_t;
+
+typedef struct NDIlib_audio_frame_interleaved_32f_t {
+	int sample_rate, no_channels, no_samples;
+	int64_t timecode;
+	float* p_data;
+	NDIlib_audio_frame_interleaved_32f_t(int sample_rate_ = 48000, int no_channels_ = 2, int no_samples_ = 0,
+		int64_t timecode_ = NDIlib_send_timecode_synthesize, float* p_data_ = NULL)
+		: sample_rate(sample_rate_), no_channels(no_channels_), no_samples(no_samples_), timecode(timecode_), p_data(p_data_) {}
+} NDIlib_audio_frame_interleaved_32f_t;
+
+typedef struct NDIlib_metadata_frame_t {
+	int length;
+	int64_t timecode;
+	char* p_data;
+	NDIlib_metadata_frame_t(int length_ = 0, int64_t timecode_ = NDIlib_send_timecode_synthesize, char* p_data_ = NULL)
+		: length(length_), timecode(timecode_), p_data(p_data_) {}
+} NDIlib_metadata_frame_t;
+
+typedef struct NDIlib_tally_t {
+	bool on_program;
+	bool on_preview;
+	NDIlib_tally_t(bool on_program_ = false, bool on_preview_ = false)
+		: on_program(on_program_), on_preview(on_preview_) {}
+} NDIlib_tally_t;
+
+typedef struct NDIlib_find_create_t {
+	bool show_local_sources;
+	const char* p_groups;
+	const char* p_extra_ips;
+	NDIlib_find_create_t(bool show_local_sources_ = true, const char* p_groups_ = NULL, const char* p_extra_ips_ = NULL)
+		: show_local_sources(show_local_sources_), p_groups(p_groups_), p_extra_ips(p_extra_ips_) {}
+} NDIlib_find_create_t;
+
+typedef struct NDIlib_send_create_t {
+	const char* p_ndi_name;
+	const char* p_groups;
+	bool clock_video, clock_audio;
+	NDIlib_send_create_t(const char* p_ndi_name_ = NULL, const char* p_groups_ = NULL,
+		bool clock_video_ = true, bool clock_audio_ = true)
+		: p_ndi_name(p_ndi_name_), p_groups(p_groups_), clock_video(clock_video_), clock_audio(clock_audio_) {}
+} NDIlib_send_create_t;
+
+typedef struct NDIlib_recv_create_v3_t {
+	NDIlib_source_t source_to_connect_to;
+	NDIlib_recv_color_format_e color_format;
+	NDIlib_recv_bandwidth_e bandwidth;
+	bool allow_video_fields;
+	const char* p_ndi_name;
+	NDIlib_recv_create_v3_t(const NDIlib_source_t source_to_connect_to_ = NDIlib_source_t(),
+		NDIlib_recv_color_format_e color_format_ = NDIlib_recv_color_format_UYVY_BGRA,
+		NDIlib_recv_bandwidth_e bandwidth_ = NDIlib_recv_bandwidth_highest,
+		bool allow_video_fields_ = true, const char* p_ndi_name_ = NULL)
+		: source_to_connect_to(source_to_connect_to_), color_format(color_format_), bandwidth(bandwidth_),
+		allow_video_fields(allow_video_fields_), p_ndi_name(p_ndi_name_) {}
+} NDIlib_recv_create_v3_t;
+
+typedef struct NDIlib_recv_performance_t {
+	int64_t video_frames;
+	int64_t audio_frames;
+	int64_t metadata_frames;
+	NDIlib_recv_performance_t() : video_frames(0), audio_frames(0), metadata_frames(0) {}
+} NDIlib_recv_performance_t;
+
+typedef struct NDIlib_recv_queue_t {
+	int video_frames;
+	int audio_frames;
+	int metadata_frames;
+	NDIlib_recv_queue_t() : video_frames(0), audio_frames(0), metadata_frames(0) {}
+} NDIlib_recv_queue_t;
+
+//
+// Functions
+//
+
+extern "C" {
+
+// Library
+bool NDIlib_initialize(void);
+void NDIlib_destroy(void);
+const char* NDIlib_version(void);
+bool NDIlib_is_supported_CPU(void);
+
+// Find
+NDIlib_find_instance_t NDIlib_find_create_v2(const NDIlib_find_create_t* p_create_settings);
+void NDIlib_find_destroy(NDIlib_find_instance_t p_instance);
+const NDIlib_source_t* NDIlib_find_get_current_sources(NDIlib_find_instance_t p_instance, uint32_t* p_no_sources);
+bool NDIlib_find_wait_for_sources(NDIlib_find_instance_t p_instance, uint32_t timeout_in_ms);
+
+// Send
+NDIlib_send_instance_t NDIlib_send_create(const NDIlib_send_create_t* p_create_settings);
+void NDIlib_send_destroy(NDIlib_send_instance_t p_instance);
+void NDIlib_send_send_video_v2(NDIlib_send_instance_t p_instance, const NDIlib_video_frame_v2_t* p_video_data);
+void NDIlib_send_send_video_async_v2(NDIlib_send_instance_t p_instance, const NDIlib_video_frame_v2_t* p_video_data);
+void NDIlib_send_send_audio_v2(NDIlib_send_instance_t p_instance, const NDIlib_audio_frame_v2_t* p_audio_data);
+void NDIlib_send_send_metadata(NDIlib_send_instance_t p_instance, const NDIlib_metadata_frame_t* p_metadata);
+void NDIlib_send_add_connection_metadata(NDIlib_send_instance_t p_instance, const NDIlib_metadata_frame_t* p_metadata);
+void NDIlib_send_clear_connection_metadata(NDIlib_send_instance_t p_instance);
+bool NDIlib_send_get_tally(NDIlib_send_instance_t p_instance, NDIlib_tally_t* p_tally, uint32_t timeout_in_ms);
+int NDIlib_send_get_no_connections(NDIlib_send_instance_t p_instance, uint32_t timeout_in_ms);
+
+// Receive
+NDIlib_recv_instance_t NDIlib_recv_create_v3(const NDIlib_recv_create_v3_t* p_create_settings);
+void NDIlib_recv_destroy(NDIlib_recv_instance_t p_instance);
+NDIlib_frame_type_e NDIlib_recv_capture_v2(NDIlib_recv_instance_t p_instance,
+	NDIlib_video_frame_v2_t* p_video_data, NDIlib_audio_frame_v2_t* p_audio_data,
+	NDIlib_metadata_frame_t* p_metadata, uint32_t timeout_in_ms);
+void NDIlib_recv_free_video_v2(NDIlib_recv_instance_t p_instance, const NDIlib_video_frame_v2_t* p_video_data);
+void NDIlib_recv_free_audio_v2(NDIlib_recv_instance_t p_instance, const NDIlib_audio_frame_v2_t* p_audio_data);
+void NDIlib_recv_free_metadata(NDIlib_recv_instance_t p_instance, const NDIlib_metadata_frame_t* p_metadata);
+bool NDIlib_recv_set_tally(NDIlib_recv_instance_t p_instance, const NDIlib_tally_t* p_tally);
+void NDIlib_recv_get_performance(NDIlib_recv_instance_t p_instance,
+	NDIlib_recv_performance_t* p_total, NDIlib_recv_performance_t* p_dropped);
+void NDIlib_recv_get_queue(NDIlib_recv_instance_t p_instance, NDIlib_recv_queue_t* p_total);
+
+// Utilities
+void NDIlib_util_audio_to_interleaved_32f_v2(const NDIlib_audio_frame_v2_t* p_src, NDIlib_audio_frame_interleaved_32f_t* p_dst);
+
+//
+// Mock only
+//
+
+// Delay from send to receive
+// - latency_ms | mean delay in milliseconds
+// - jitter_ms | each frame is delayed up to this much more or less
+// Frames are always received in the order sent.
+// Initialized from the NDI_MOCK_LATENCY and NDI_MOCK_JITTER environment variables,
+// otherwise 0.
+void NDIlib_mock_set_latency(float latency_ms, float jitter_ms);
+
+// Maximum video frames waiting for each receiver
+// The oldest frame is dropped when a new frame arrives at a full queue.
+// Initialized 4
+void NDIlib_mock_set_queue(int frames);
+
+} // extern "C"
+
+#endif
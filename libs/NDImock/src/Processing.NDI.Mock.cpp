@@ -0,0 +1,981 @@
+/*
+	NDI mock runtime
+
+	In-process implementation of the NDIlib functions declared in
+	libs/NDImock/include/Processing.NDI.Lib.h
+
+	Senders and receivers created in the same process are connected
+	by name. Each frame sent is copied into the queue of every receiver
+	connected to the sender and can be captured after a set latency
+	plus or minus a random jitter. Receivers get the colour format they
+	ask for, converted as NDI would.
+
+	Not simulated : network transport, compression, low bandwidth streams,
+	groups and extra IPs.
+
+	Copyright (C) 2016-2018 Lynn Jarvis.
+
+	http://www.spout.zeal.co
+
+	=========================================================================
+	This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+	=========================================================================
+
+	17.10.26 - Create file
+			 - Accept a negative line stride for bottom-up frames
+			 - P216 and PA16 frames. Received as sent for recv_color_format_best,
+			   otherwise as 8 bit UYVY or UYVA converted as usual.
+
+*/
+#include "Processing.NDI.Lib.h"
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+// A frame waiting in a receiver queue
+// Data pointers are malloc'd and handed to the receiver on capture
+struct MockFrame {
+	NDIlib_frame_type_e type;
+	Clock::time_point due; // Time the frame can be captured
+	NDIlib_video_frame_v2_t video;
+	NDIlib_audio_frame_v2_t audio;
+	NDIlib_metadata_frame_t metadata;
+};
+
+struct MockSender {
+	std::string name; // Source name "MOCK (sender name)"
+	bool bClockVideo;
+	Clock::time_point nextFrame; // Clocked video send time
+	bool bPending; // Async frame not yet copied
+	NDIlib_video_frame_v2_t pending;
+	Clock::time_point pendingTime; // Time the async frame was sent
+	std::vector<std::string> connectionMetadata;
+	NDIlib_tally_t tally;
+};
+
+struct MockReceiver {
+	std::string source; // Source name connected to
+	NDIlib_recv_color_format_e colorFormat;
+	NDIlib_recv_bandwidth_e bandwidth;
+	std::deque<MockFrame> queue;
+	std::condition_variable arrived;
+	Clock::time_point lastDue; // Keeps frames in order
+	NDIlib_tally_t tally;
+	NDIlib_recv_performance_t total;
+	NDIlib_recv_performance_t dropped;
+	bool bConnected; // Connection metadata delivered
+};
+
+struct MockFinder {
+	unsigned long long seen; // Source list generation last returned
+	std::vector<std::string> names;
+	std::vector<NDIlib_source_t> sources;
+};
+
+struct MockRuntime {
+	std::mutex mutex;
+	std::condition_variable sourcesChanged;
+	unsigned long long generation; // Incremented when a sender is created or destroyed
+	std::vector<MockSender *> senders;
+	std::vector<MockReceiver *> receivers;
+	double latency; // msec
+	double jitter; // msec
+	unsigned int queueFrames;
+	unsigned int senderCount;
+	std::mt19937 random;
+
+	MockRuntime()
+	{
+		generation = 0;
+		queueFrames = 4;
+		senderCount = 0;
+		const char *env = getenv("NDI_MOCK_LATENCY");
+		latency = env ? atof(env) : 0.0;
+		env = getenv("NDI_MOCK_JITTER");
+		jitter = env ? atof(env) : 0.0;
+	}
+};
+
+MockRuntime &Runtime()
+{
+	static MockRuntime runtime;
+	return runtime;
+}
+
+// Time in 100ns intervals for timecodes and timestamps
+int64_t Time100ns(Clock::time_point time)
+{
+	// Offset the steady clock to the system clock once
+	static const std::chrono::system_clock::duration offset =
+		std::chrono::system_clock::now().time_since_epoch() - std::chrono::duration_cast<std::chrono::system_clock::duration>(Clock::now().time_since_epoch());
+	return (int64_t)(std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch() + offset).count() / 100);
+}
+
+char *CopyString(const char *text)
+{
+	if (!text)
+		return NULL;
+	size_t n = strlen(text) + 1;
+	char *copy = (char *)malloc(n);
+	if (copy) memcpy(copy, text, n);
+	return copy;
+}
+
+void FreeFrame(MockFrame &frame)
+{
+	switch (frame.type) {
+		case NDIlib_frame_type_video:
+			free(frame.video.p_data);
+			free((void *)frame.video.p_metadata);
+			break;
+		case NDIlib_frame_type_audio:
+			free(frame.audio.p_data);
+			free((void *)frame.audio.p_metadata);
+			break;
+		case NDIlib_frame_type_metadata:
+			free(frame.metadata.p_data);
+			break;
+		default:
+			break;
+	}
+}
+
+// Delivery time for a frame sent at "sent" - called with the lock held
+Clock::time_point DueTime(MockRuntime &runtime, MockReceiver &receiver, Clock::time_point sent)
+{
+	double delay = runtime.latency;
+	if (runtime.jitter > 0.0) {
+		std::uniform_real_distribution<double> spread(-runtime.jitter, runtime.jitter);
+		delay += spread(runtime.random);
+	}
+	if (delay < 0.0) delay = 0.0;
+	Clock::time_point due = sent + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(delay));
+	if (due < receiver.lastDue)
+		due = receiver.lastDue;
+	receiver.lastDue = due;
+	return due;
+}
+
+// Add a frame to a receiver queue - called with the lock held
+void Deliver(MockRuntime &runtime, MockReceiver &receiver, MockFrame &frame, Clock::time_point sent)
+{
+	frame.due = DueTime(runtime, receiver, sent);
+	receiver.queue.push_back(frame);
+
+	// Drop the oldest video frame if too many are waiting
+	if (frame.type == NDIlib_frame_type_video) {
+		unsigned int nVideo = 0;
+		for (size_t i = 0; i < receiver.queue.size(); i++) {
+			if (receiver.queue[i].type == NDIlib_frame_type_video) nVideo++;
+		}
+		if (nVideo > runtime.queueFrames) {
+			for (std::deque<MockFrame>::iterator it = receiver.queue.begin(); it != receiver.queue.end(); ++it) {
+				if (it->type == NDIlib_frame_type_video) {
+					FreeFrame(*it);
+					receiver.queue.erase(it);
+					receiver.dropped.video_frames++;
+					break;
+				}
+			}
+		}
+	}
+	receiver.arrived.notify_all();
+}
+
+void DeliverMetadata(MockRuntime &runtime, MockReceiver &receiver, const std::string &text, int64_t timecode, Clock::time_point sent)
+{
+	MockFrame frame;
+	frame.type = NDIlib_frame_type_metadata;
+	frame.metadata.length = (int)text.size();
+	frame.metadata.timecode = timecode;
+	frame.metadata.p_data = CopyString(text.c_str());
+	Deliver(runtime, receiver, frame, sent);
+}
+
+// Connection metadata for a receiver that has found its sender - called with the lock held
+void Connect(MockRuntime &runtime, MockSender &sender, MockReceiver &receiver)
+{
+	if (receiver.bConnected)
+		return;
+	receiver.bConnected = true;
+	Clock::time_point now = Clock::now();
+	for (size_t i = 0; i < sender.connectionMetadata.size(); i++)
+		DeliverMetadata(runtime, receiver, sender.connectionMetadata[i], NDIlib_send_timecode_synthesize, now);
+}
+
+//
+// Video conversion to the receiver colour format
+//
+
+bool HasAlpha(NDIlib_FourCC_type_e fourcc)
+{
+	return fourcc == NDIlib_FourCC_type_RGBA || fourcc == NDIlib_FourCC_type_BGRA || fourcc == NDIlib_FourCC_type_UYVA
+		|| fourcc == NDIlib_FourCC_type_PA16;
+}
+
+bool IsHighBitDepth(NDIlib_FourCC_type_e fourcc)
+{
+	return fourcc == NDIlib_FourCC_type_P216 || fourcc == NDIlib_FourCC_type_PA16;
+}
+
+bool IsYUV(NDIlib_FourCC_type_e fourcc)
+{
+	return fourcc == NDIlib_FourCC_type_UYVY || fourcc == NDIlib_FourCC_type_UYVA;
+}
+
+bool IsBGR(NDIlib_FourCC_type_e fourcc)
+{
+	return fourcc == NDIlib_FourCC_type_BGRA || fourcc == NDIlib_FourCC_type_BGRX;
+}
+
+// Format received for a format sent
+NDIlib_FourCC_type_e ReceivedFourCC(NDIlib_FourCC_type_e sent, NDIlib_recv_color_format_e format)
+{
+	bool bAlpha = HasAlpha(sent);
+	if (IsHighBitDepth(sent)) {
+		if (format == NDIlib_recv_color_format_best)
+			return sent;
+		sent = bAlpha ? NDIlib_FourCC_type_UYVA : NDIlib_FourCC_type_UYVY;
+	}
+	switch (format) {
+		case NDIlib_recv_color_format_BGRX_BGRA:
+			return bAlpha ? NDIlib_FourCC_type_BGRA : NDIlib_FourCC_type_BGRX;
+		case NDIlib_recv_color_format_RGBX_RGBA:
+			return bAlpha ? NDIlib_FourCC_type_RGBA : NDIlib_FourCC_type_RGBX;
+		case NDIlib_recv_color_format_UYVY_BGRA:
+			return bAlpha ? NDIlib_FourCC_type_BGRA : NDIlib_FourCC_type_UYVY;
+		case NDIlib_recv_color_format_UYVY_RGBA:
+			return bAlpha ? NDIlib_FourCC_type_RGBA : NDIlib_FourCC_type_UYVY;
+		default: // fastest or best
+			return sent;
+	}
+}
+
+uint8_t Clamp255(int value)
+{
+	return (uint8_t)(value < 0 ? 0 : (value > 255 ? 255 : value));
+}
+
+// One line of UYVY (with optional alpha) to RGBA or BGRA - BT.601 limited range
+void UYVYtoRGBA(const uint8_t *src, const uint8_t *alpha, uint8_t *dst, int width, bool bBGR)
+{
+	for (int x = 0; x < width; x += 2) {
+		int u = src[0] - 128;
+		int v = src[2] - 128;
+		for (int i = 0; i < 2 && x + i < width; i++) {
+			int y = ((i == 0 ? src[1] : src[3]) - 16) * 298;
+			uint8_t r = Clamp255((y + 409 * v + 128) >> 8);
+			uint8_t g = Clamp255((y - 100 * u - 208 * v + 128) >> 8);
+			uint8_t b = Clamp255((y + 516 * u + 128) >> 8);
+			dst[0] = bBGR ? b : r;
+			dst[1] = g;
+			dst[2] = bBGR ? r : b;
+			dst[3] = alpha ? alpha[x + i] : 255;
+			dst += 4;
+		}
+		src += 4;
+	}
+}
+
+// One line of RGBA or BGRA to UYVY - BT.601 limited range
+void RGBAtoUYVY(const uint8_t *src, uint8_t *dst, int width, bool bBGR)
+{
+	for (int x = 0; x < width; x += 2) {
+		const uint8_t *p1 = src + (x + 1 < width ? 4 : 0);
+		int r = bBGR ? src[2] : src[0];
+		int g = src[1];
+		int b = bBGR ? src[0] : src[2];
+		int r1 = bBGR ? p1[2] : p1[0];
+		int g1 = p1[1];
+		int b1 = bBGR ? p1[0] : p1[2];
+		dst[0] = Clamp255(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+		dst[1] = Clamp255(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+		dst[2] = Clamp255(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+		dst[3] = Clamp255(((66 * r1 + 129 * g1 + 25 * b1 + 128) >> 8) + 16);
+		src += 8;
+		dst += 4;
+	}
+}
+
+bool CopyVideo(const NDIlib_video_frame_v2_t &sent, NDIlib_recv_color_format_e format, NDIlib_video_frame_v2_t &received);
+
+// Copy a P216 or PA16 frame as sent or as 8 bit UYVY or UYVA
+bool CopyHighBitDepth(const NDIlib_video_frame_v2_t &sent, NDIlib_recv_color_format_e format, NDIlib_video_frame_v2_t &received)
+{
+	int width = sent.xres;
+	int height = sent.yres;
+	int lineBytes = (width + 1) / 2 * 4;
+	int srcStride = sent.line_stride_in_bytes > 0 ? sent.line_stride_in_bytes : lineBytes;
+	bool bAlpha = sent.FourCC == NDIlib_FourCC_type_PA16;
+	int planes = bAlpha ? 3 : 2;
+	const uint8_t *srcY = sent.p_data;
+	const uint8_t *srcUV = srcY + (size_t)srcStride * height;
+	const uint8_t *srcA = srcUV + (size_t)srcStride * height;
+
+	if (format == NDIlib_recv_color_format_best) {
+		uint8_t *data = (uint8_t *)malloc((size_t)lineBytes * height * planes);
+		if (!data)
+			return false;
+		for (int p = 0; p < planes; p++) {
+			for (int y = 0; y < height; y++)
+				memcpy(data + ((size_t)p * height + y) * lineBytes, sent.p_data + ((size_t)p * height + y) * srcStride, lineBytes);
+		}
+		received = sent;
+		received.p_data = data;
+		received.line_stride_in_bytes = lineBytes;
+		received.p_metadata = CopyString(sent.p_metadata);
+		return true;
+	}
+
+	// The high byte of each component
+	size_t uyvySize = (size_t)lineBytes * height;
+	uint8_t *uyvy = (uint8_t *)malloc(uyvySize + (bAlpha ? (size_t)width * height : 0));
+	if (!uyvy)
+		return false;
+	for (int y = 0; y < height; y++) {
+		const uint16_t *Y = (const uint16_t *)(srcY + (size_t)srcStride * y);
+		const uint16_t *UV = (const uint16_t *)(srcUV + (size_t)srcStride * y);
+		uint8_t *dst = uyvy + (size_t)lineBytes * y;
+		for (int x = 0; x < width; x += 2) {
+			dst[0] = (uint8_t)(UV[x] >> 8);
+			dst[1] = (uint8_t)(Y[x] >> 8);
+			dst[2] = (uint8_t)(UV[x + 1] >> 8);
+			dst[3] = (uint8_t)((x + 1 < width ? Y[x + 1] : Y[x]) >> 8);
+			dst += 4;
+		}
+		if (bAlpha) {
+			const uint16_t *A = (const uint16_t *)(srcA + (size_t)srcStride * y);
+			uint8_t *alpha = uyvy + uyvySize + (size_t)width * y;
+			for (int x = 0; x < width; x++)
+				alpha[x] = (uint8_t)(A[x] >> 8);
+		}
+	}
+
+	NDIlib_video_frame_v2_t frame = sent;
+	frame.FourCC = bAlpha ? NDIlib_FourCC_type_UYVA : NDIlib_FourCC_type_UYVY;
+	frame.p_data = uyvy;
+	frame.line_stride_in_bytes = lineBytes;
+	bool bResult = CopyVideo(frame, format, received);
+	free(uyvy);
+	return bResult;
+}
+
+// Copy and convert a sent video frame for a receiver
+// The copy is packed with no line padding
+bool CopyVideo(const NDIlib_video_frame_v2_t &sent, NDIlib_recv_color_format_e format, NDIlib_video_frame_v2_t &received)
+{
+	if (IsHighBitDepth(sent.FourCC))
+		return CopyHighBitDepth(sent, format, received);
+
+	int width = sent.xres;
+	int height = sent.yres;
+	NDIlib_FourCC_type_e fourcc = ReceivedFourCC(sent.FourCC, format);
+	int srcStride = sent.line_stride_in_bytes;
+	int dstStride = IsYUV(fourcc) ? width * 2 : width * 4;
+	if (srcStride == 0)
+		srcStride = IsYUV(sent.FourCC) ? width * 2 : width * 4;
+
+	size_t size = (size_t)dstStride * height;
+	if (fourcc == NDIlib_FourCC_type_UYVA)
+		size += (size_t)width * height; // Alpha plane after the UYVY lines
+	uint8_t *data = (uint8_t *)malloc(size);
+	if (!data)
+		return false;
+
+	// A negative stride is a bottom-up frame from its last line
+	const uint8_t *srcAlpha = (sent.FourCC == NDIlib_FourCC_type_UYVA && srcStride > 0) ? sent.p_data + (size_t)srcStride * height : NULL;
+	for (int y = 0; y < height; y++) {
+		const uint8_t *src = sent.p_data + (ptrdiff_t)srcStride * y;
+		uint8_t *dst = data + (size_t)dstStride * y;
+		if (IsYUV(sent.FourCC) == IsYUV(fourcc)) {
+			if (IsYUV(fourcc) || IsBGR(sent.FourCC) == IsBGR(fourcc)) {
+				memcpy(dst, src, dstStride);
+			}
+			else {
+				for (int x = 0; x < width * 4; x += 4) {
+					dst[x + 0] = src[x + 2];
+					dst[x + 1] = src[x + 1];
+					dst[x + 2] = src[x + 0];
+					dst[x + 3] = src[x + 3];
+				}
+			}
+		}
+		else if (IsYUV(sent.FourCC)) {
+			UYVYtoRGBA(src, srcAlpha ? srcAlpha + (size_t)width * y : NULL, dst, width, IsBGR(fourcc));
+		}
+		else {
+			RGBAtoUYVY(src, dst, width, IsBGR(sent.FourCC));
+		}
+	}
+	if (fourcc == NDIlib_FourCC_type_UYVA && srcAlpha)
+		memcpy(data + (size_t)dstStride * height, srcAlpha, (size_t)width * height);
+
+	received = sent;
+	received.FourCC = fourcc;
+	received.p_data = data;
+	received.line_stride_in_bytes = dstStride;
+	received.p_metadata = CopyString(sent.p_metadata);
+	return true;
+}
+
+// Copy a video frame to every connected receiver - called with the lock held
+void SendVideo(MockRuntime &runtime, MockSender &sender, const NDIlib_video_frame_v2_t &video, Clock::time_point sent)
+{
+	for (size_t i = 0; i < runtime.receivers.size(); i++) {
+		MockReceiver &receiver = *runtime.receivers[i];
+		if (receiver.source != sender.name)
+			continue;
+		Connect(runtime, sender, receiver);
+		if (receiver.bandwidth == NDIlib_recv_bandwidth_metadata_only || receiver.bandwidth == NDIlib_recv_bandwidth_audio_only)
+			continue;
+		MockFrame frame;
+		frame.type = NDIlib_frame_type_video;
+		if (!CopyVideo(video, receiver.colorFormat, frame.video))
+			continue;
+		if (frame.video.timecode == NDIlib_send_timecode_synthesize)
+			frame.video.timecode = Time100ns(sent);
+		frame.video.timestamp = Time100ns(sent);
+		receiver.total.video_frames++;
+		Deliver(runtime, receiver, frame, sent);
+	}
+}
+
+// Copy an async frame once NDI would have finished with it - called with the lock held
+void FlushPending(MockRuntime &runtime, MockSender &sender)
+{
+	if (!sender.bPending)
+		return;
+	// The application must not have changed the data since it was sent
+	SendVideo(runtime, sender, sender.pending, sender.pendingTime);
+	sender.bPending = false;
+}
+
+// Wait for the frame time of a clocked sender
+void ClockVideo(MockSender &sender, const NDIlib_video_frame_v2_t &video)
+{
+	if (!sender.bClockVideo || video.frame_rate_N <= 0 || video.frame_rate_D <= 0)
+		return;
+	Clock::time_point now = Clock::now();
+	Clock::duration period = std::chrono::duration_cast<Clock::duration>(
+		std::chrono::duration<double>((double)video.frame_rate_D / (double)video.frame_rate_N));
+	// Start again if more than a frame late
+	if (sender.nextFrame + period < now)
+		sender.nextFrame = now;
+	std::this_thread::sleep_until(sender.nextFrame);
+	sender.nextFrame += period;
+}
+
+} // namespace
+
+//
+// Library
+//
+
+bool NDIlib_initialize(void)
+{
+	Runtime();
+	return true;
+}
+
+void NDIlib_destroy(void)
+{
+}
+
+const char* NDIlib_version(void)
+{
+	return "NDI mock runtime 3.5";
+}
+
+bool NDIlib_is_supported_CPU(void)
+{
+	return true;
+}
+
+//
+// Find
+//
+
+NDIlib_find_instance_t NDIlib_find_create_v2(const NDIlib_find_create_t* p_create_settings)
+{
+	(void)p_create_settings;
+	MockFinder *finder = new MockFinder;
+	finder->seen = ~0ULL; // The first wait returns the current sources
+	return finder;
+}
+
+void NDIlib_find_destroy(NDIlib_find_instance_t p_instance)
+{
+	delete (MockFinder *)p_instance;
+}
+
+const NDIlib_source_t* NDIlib_find_get_current_sources(NDIlib_find_instance_t p_instance, uint32_t* p_no_sources)
+{
+	MockFinder *finder = (MockFinder *)p_instance;
+	if (p_no_sources) *p_no_sources = 0;
+	if (!finder)
+		return NULL;
+
+	MockRuntime &runtime = Runtime();
+	std::lock_guard<std::mutex> lock(runtime.mutex);
+	finder->names.clear();
+	for (size_t i = 0; i < runtime.senders.size(); i++)
+		finder->names.push_back(runtime.senders[i]->name);
+	finder->sources.clear();
+	for (size_t i = 0; i < finder->names.size(); i++)
+		finder->sources.push_back(NDIlib_source_t(finder->names[i].c_str(), "127.0.0.1"));
+	finder->seen = runtime.generation;
+
+	if (p_no_sources) *p_no_sources = (uint32_t)finder->sources.size();
+	return finder->sources.empty() ? NULL : &finder->sources[0];
+}
+
+bool NDIlib_find_wait_for_sources(NDIlib_find_instance_t p_instance, uint32_t timeout_in_ms)
+{
+	MockFinder *finder = (MockFinder *)p_instance;
+	if (!finder)
+		return false;
+
+	MockRuntime &runtime = Runtime();
+	std::unique_lock<std::mutex> lock(runtime.mutex);
+	bool bChanged = runtime.sourcesChanged.wait_for(lock, std::chrono::milliseconds(timeout_in_ms),
+		[&] { return runtime.generation != finder->seen; });
+	finder->seen = runtime.generation;
+	return bChanged;
+}
+
+//
+// Send
+//
+
+NDIlib_send_instance_t NDIlib_send_create(const NDIlib_send_create_t* p_create_settings)
+{
+	MockRuntime &runtime = Runtime();
+	std::lock_guard<std::mutex> lock(runtime.mutex);
+
+	MockSender *sender = new MockSender;
+	std::string name;
+	if (p_create_settings && p_create_settings->p_ndi_name && p_create_settings->p_ndi_name[0])
+		name = p_create_settings->p_ndi_name;
+	else
+		name = "Mock sender " + std::to_string(++runtime.senderCount);
+	sender->name = "MOCK (" + name + ")";
+	sender->bClockVideo = p_create_settings ? p_create_settings->clock_video : true;
+	sender->nextFrame = Clock::now();
+	sender->bPending = false;
+
+	runtime.senders.push_back(sender);
+	runtime.generation++;
+	runtime.sourcesChanged.notify_all();
+	return sender;
+}
+
+void NDIlib_send_destroy(NDIlib_send_instance_t p_instance)
+{
+	MockSender *sender = (MockSender *)p_instance;
+	if (!sender)
+		return;
+
+	MockRuntime &runtime = Runtime();
+	std::lock_guard<std::mutex> lock(runtime.mutex);
+	FlushPending(runtime, *sender);
+	for (size_t i = 0; i < runtime.senders.size(); i++) {
+		if (runtime.senders[i] == sender) {
+			runtime.senders.erase(runtime.senders.begin() + i);
+			break;
+		}
+	}
+	for (size_t i = 0; i < runtime.receivers.size(); i++) {
+		if (runtime.receivers[i]->source == sender->name)
+			runtime.receivers[i]->bConnected = false;
+	}
+	runtime.generation++;
+	runtime.sourcesChanged.notify_all();
+	delete sender;
+}
+
+void NDIlib_send_send_video_v2(NDIlib_send_instance_t p_instance, const NDIlib_video_frame_v2_t* p_video_data)
+{
+	MockSender *sender = (MockSender *)p_instance;
+	if (!sender)
+		return;
+
+	if (p_video_data)
+		ClockVideo(*sender, *p_video_data);
+
+	MockRuntime &runtime = Runtime();
+	std::lock_guard<std::mutex> lock(runtime.mutex);
+	FlushPending(runtime, *sender);
+	if (p_video_data && p_video_data->p_data)
+		SendVideo(runtime, *sender, *p_video_data, Clock::now());
+}
+
+void NDIlib_send_send_video_async_v2(NDIlib_send_instance_t p_instance, const NDIlib_video_frame_v2_t* p_video_data)
+{
+	MockSender *sender = (MockSender *)p_instance;
+	if (!sender)
+		return;
+
+	if (p_video_data)
+		ClockVideo(*sender, *p_video_data);
+
+	// The previous frame is copied now that NDI would have finished with it.
+	// The new frame is held by pointer until the next synchronizing event,
+	// so an application that changes the data too early sends the wrong image.
+	MockRuntime &runtime = Runtime();
+	std::lock_guard<std::mutex> lock(runtime.mutex);
+	FlushPending(runtime, *sender);
+	if (p_video_data && p_video_data->p_data) {
+		sender->pending = *p_video_data;
+		sender->pendingTime = Clock::now();
+		sender->bPending = true;
+	}
+}
+
+void NDIlib_send_send_audio_v2(NDIlib_send_instance_t p_instance, const NDIlib_audio_frame_v2_t* p_audio_data)
+{
+	MockSender *sender = (MockSender *)p_instance;
+	if (!sender || !p_audio_data || !p_audio_data->p_data || p_audio_data->no_samples <= 0 || p_audio_data->no_channels <= 0)
+		return;
+
+	MockRuntime &runtime = Runtime();
+	std::lock_guard<std::mutex> lock(runtime.mutex);
+	Clock::time_point sent = Clock::now();
+
+	int nChannels = p_audio_data->no_channels;
+	int nSamples = p_audio_data->no_samples;
+	int srcStride = p_audio_data->channel_stride_in_bytes;
+	if (srcStride <= 0)
+		srcStride = nSamples * (int)sizeof(float);
+
+	for (size_t i = 0; i < runtime.receivers.size(); i++) {
+		MockReceiver &receiver = *runtime.receivers[i];
+		if (receiver.source != sender->name || receiver.bandwidth == NDIlib_recv_bandwidth_metadata_only)
+			continue;
+		Connect(runtime, *sender, receiver);
+		MockFrame frame;
+		frame.type = NDIlib_frame_type_audio;
+		frame.audio = *p_audio_data;
+		// Packed planar copy
+		frame.audio.p_data = (float *)malloc((size_t)nChannels * nSamples * sizeof(float));
+		if (!frame.audio.p_data)
+			continue;
+		for (int c = 0; c < nChannels; c++)
+			memcpy(frame.audio.p_data + (size_t)c * nSamples, (const uint8_t *)p_audio_data->p_data + (size_t)c * srcStride, nSamples * sizeof(float));
+		frame.audio.channel_stride_in_bytes = nSamples * (int)sizeof(float);
+		frame.audio.p_metadata = CopyString(p_audio_data->p_metadata);
+		if (frame.audio.timecode == NDIlib_send_timecode_synthesize)
+			frame.audio.timecode = Time100ns(sent);
+		frame.audio.timestamp = Time100ns(sent);
+		receiver.total.audio_frames++;
+		Deliver(runtime, receiver, frame, sent);
+	}
+}
+
+void NDIlib_send_send_metadata(NDIlib_send_instance_t p_instance, const NDIlib_metadata_frame_t* p_metadata)
+{
+	MockSender *sender = (MockSender *)p_instance;
+	if (!sender || !p_metadata || !p_metadata->p_data)
+		return;
+
+	MockRuntime &runtime = Runtime();
+	std::lock_guard<std::mutex> lock(runtime.mutex);
+	Clock::time_point sent = Clock::now();
+	for (size_t i = 0; i < runtime.receivers.size(); i++) {
+		MockReceiver &receiver = *runtime.receivers[i];
+		if (receiver.source != sender->name)
+			continue;
+		Connect(runtime, *sender, receiver);
+		receiver.total.metadata_frames++;
+		DeliverMetadata(runtime, receiver, p_metadata->p_data, p_metadata->timecode, sent);
+	}
+}
+
+void NDIlib_send_add_connection_metadata(NDIlib_send_instance_t p_instance, const NDIlib_metadata_frame_t* p_metadata)
+{
+	MockSender *sender = (MockSender *)p_instance;
+	if (!sender || !p_metadata || !p_metadata->p_data)
+		return;
+
+	MockRuntime &runtime = Runtime();
+	std::lock_guard<std::mutex> lock(runtime.mutex);
+	sender->connectionMetadata.push_back(p_metadata->p_data);
+
+	// Receivers already connected get it now
+	Clock::time_point now = Clock::now();
+	for (size_t i = 0; i < runtime.receivers.size(); i++) {
+		MockReceiver &receiver = *runtime.receivers[i];
+		if (receiver.source == sender->name && receiver.bConnected)
+			DeliverMetadata(runtime, receiver, p_metadata->p_data, p_metadata->timecode, now);
+	}
+}
+
+void NDIlib_send_clear_connection_metadata(NDIlib_send_instance_t p_instance)
+{
+	MockSender *sender = (MockSender *)p_instance;
+	if (!sender)
+		return;
+	MockRuntime &runtime = Runtime();
+	std::lock_guard<std::mutex> lock(runtime.mutex);
+	sender->connectionMetadata.clear();
+}
+
+bool NDIlib_send_get_tally(NDIlib_send_instance_t p_instance, NDIlib_tally_t* p_tally, uint32_t timeout_in_ms)
+{
+	(void)timeout_in_ms;
+	MockSender *sender = (MockSender *)p_instance;
+	if (!sender || !p_tally)
+		return false;
+
+	MockRuntime &runtime = Runtime();
+	std::lock_guard<std::mutex> lock(runtime.mutex);
+	NDIlib_tally_t tally;
+	for (size_t i = 0; i < runtime.receivers.size(); i++) {
+		if (runtime.receivers[i]->source == sender->name) {
+			tally.on_program |= runtime.receivers[i]->tally.on_program;
+			tally.on_preview |= runtime.receivers[i]->tally.on_preview;
+		}
+	}
+	bool bChanged = (tally.on_program != sender->tally.on_program || tally.on_preview != sender->tally.on_preview);
+	sender->tally = tally;
+	*p_tally = tally;
+	return bChanged;
+}
+
+int NDIlib_send_get_no_connections(NDIlib_send_instance_t p_instance, uint32_t timeout_in_ms)
+{
+	(void)timeout_in_ms;
+	MockSender *sender = (MockSender *)p_instance;
+	if (!sender)
+		return 0;
+
+	MockRuntime &runtime = Runtime();
+	std::lock_guard<std::mutex> lock(runtime.mutex);
+	int n = 0;
+	for (size_t i = 0; i < runtime.receivers.size(); i++) {
+		if (runtime.receivers[i]->source == sender->name) n++;
+	}
+	return n;
+}
+
+//
+// Receive
+//
+
+NDIlib_recv_instance_t NDIlib_recv_create_v3(const NDIlib_recv_create_v3_t* p_create_settings)
+{
+	if (!p_create_settings || !p_create_settings->source_to_connect_to.p_ndi_name)
+		return NULL;
+
+	MockRuntime &runtime = Runtime();
+	std::lock_guard<std::mutex> lock(runtime.mutex);
+
+	MockReceiver *receiver = new MockReceiver;
+	receiver->source = p_create_settings->source_to_connect_to.p_ndi_name;
+	receiver->colorFormat = p_create_settings->color_format;
+	receiver->bandwidth = p_create_settings->bandwidth;
+	receiver->lastDue = Clock::now();
+	receiver->bConnected = false;
+	runtime.receivers.push_back(receiver);
+
+	for (size_t i = 0; i < runtime.senders.size(); i++) {
+		if (runtime.senders[i]->name == receiver->source)
+			Connect(runtime, *runtime.senders[i], *receiver);
+	}
+
+	return receiver;
+}
+
+void NDIlib_recv_destroy(NDIlib_recv_instance_t p_instance)
+{
+	MockReceiver *receiver = (MockReceiver *)p_instance;
+	if (!receiver)
+		return;
+
+	MockRuntime &runtime = Runtime();
+	std::lock_guard<std::mutex> lock(runtime.mutex);
+	for (size_t i = 0; i < runtime.receivers.size(); i++) {
+		if (runtime.receivers[i] == receiver) {
+			runtime.receivers.erase(runtime.receivers.begin() + i);
+			break;
+		}
+	}
+	for (size_t i = 0; i < receiver->queue.size(); i++)
+		FreeFrame(receiver->queue[i]);
+	delete receiver;
+}
+
+NDIlib_frame_type_e NDIlib_recv_capture_v2(NDIlib_recv_instance_t p_instance,
+	NDIlib_video_frame_v2_t* p_video_data, NDIlib_audio_frame_v2_t* p_audio_data,
+	NDIlib_metadata_frame_t* p_metadata, uint32_t timeout_in_ms)
+{
+	MockReceiver *receiver = (MockReceiver *)p_instance;
+	if (!receiver)
+		return NDIlib_frame_type_error;
+
+	MockRuntime &runtime = Runtime();
+	std::unique_lock<std::mutex> lock(runtime.mutex);
+	Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(timeout_in_ms);
+
+	for (;;) {
+		// Frame types not asked for are discarded
+		while (!receiver->queue.empty()) {
+			MockFrame &head = receiver->queue.front();
+			if ((head.type == NDIlib_frame_type_video && p_video_data)
+				|| (head.type == NDIlib_frame_type_audio && p_audio_data)
+				|| (head.type == NDIlib_frame_type_metadata && p_metadata))
+				break;
+			FreeFrame(head);
+			receiver->queue.pop_front();
+		}
+
+		Clock::time_point now = Clock::now();
+		if (!receiver->queue.empty() && receiver->queue.front().due <= now) {
+			MockFrame frame = receiver->queue.front();
+			receiver->queue.pop_front();
+			// The caller frees the data
+			switch (frame.type) {
+				case NDIlib_frame_type_video: *p_video_data = frame.video; break;
+				case NDIlib_frame_type_audio: *p_audio_data = frame.audio; break;
+				default: *p_metadata = frame.metadata; break;
+			}
+			return frame.type;
+		}
+
+		if (now >= deadline)
+			return NDIlib_frame_type_none;
+
+		// Wait for the head frame to be due, a new frame or the timeout
+		Clock::time_point wake = deadline;
+		if (!receiver->queue.empty() && receiver->queue.front().due < wake)
+			wake = receiver->queue.front().due;
+		receiver->arrived.wait_until(lock, wake);
+	}
+}
+
+void NDIlib_recv_free_video_v2(NDIlib_recv_instance_t p_instance, const NDIlib_video_frame_v2_t* p_video_data)
+{
+	(void)p_instance;
+	if (!p_video_data)
+		return;
+	free(p_video_data->p_data);
+	free((void *)p_video_data->p_metadata);
+}
+
+void NDIlib_recv_free_audio_v2(NDIlib_recv_instance_t p_instance, const NDIlib_audio_frame_v2_t* p_audio_data)
+{
+	(void)p_instance;
+	if (!p_audio_data)
+		return;
+	free(p_audio_data->p_data);
+	free((void *)p_audio_data->p_metadata);
+}
+
+void NDIlib_recv_free_metadata(NDIlib_recv_instance_t p_instance, const NDIlib_metadata_frame_t* p_metadata)
+{
+	(void)p_instance;
+	if (p_metadata)
+		free(p_metadata->p_data);
+}
+
+bool NDIlib_recv_set_tally(NDIlib_recv_instance_t p_instance, const NDIlib_tally_t* p_tally)
+{
+	MockReceiver *receiver = (MockReceiver *)p_instance;
+	if (!receiver || !p_tally)
+		return false;
+	MockRuntime &runtime = Runtime();
+	std::lock_guard<std::mutex> lock(runtime.mutex);
+	receiver->tally = *p_tally;
+	return true;
+}
+
+void NDIlib_recv_get_performance(NDIlib_recv_instance_t p_instance,
+	NDIlib_recv_performance_t* p_total, NDIlib_recv_performance_t* p_dropped)
+{
+	MockReceiver *receiver = (MockReceiver *)p_instance;
+	if (!receiver)
+		return;
+	MockRuntime &runtime = Runtime();
+	std::lock_guard<std::mutex> lock(runtime.mutex);
+	if (p_total) *p_total = receiver->total;
+	if (p_dropped) *p_dropped = receiver->dropped;
+}
+
+void NDIlib_recv_get_queue(NDIlib_recv_instance_t p_instance, NDIlib_recv_queue_t* p_total)
+{
+	MockReceiver *receiver = (MockReceiver *)p_instance;
+	if (!receiver || !p_total)
+		return;
+	MockRuntime &runtime = Runtime();
+	std::lock_guard<std::mutex> lock(runtime.mutex);
+	*p_total = NDIlib_recv_queue_t();
+	for (size_t i = 0; i < receiver->queue.size(); i++) {
+		switch (receiver->queue[i].type) {
+			case NDIlib_frame_type_video: p_total->video_frames++; break;
+			case NDIlib_frame_type_audio: p_total->audio_frames++; break;
+			case NDIlib_frame_type_metadata: p_total->metadata_frames++; break;
+			default: break;
+		}
+	}
+}
+
+//
+// Utilities
+//
+
+void NDIlib_util_audio_to_interleaved_32f_v2(const NDIlib_audio_frame_v2_t* p_src, NDIlib_audio_frame_interleaved_32f_t* p_dst)
+{
+	if (!p_src || !p_dst || !p_src->p_data || !p_dst->p_data)
+		return;
+	p_dst->sample_rate = p_src->sample_rate;
+	p_dst->no_channels = p_src->no_channels;
+	p_dst->no_samples = p_src->no_samples;
+	p_dst->timecode = p_src->timecode;
+	for (int c = 0; c < p_src->no_channels; c++) {
+		const float *src = (const float *)((const uint8_t *)p_src->p_data + (size_t)c * p_src->channel_stride_in_bytes);
+		for (int i = 0; i < p_src->no_samples; i++)
+			p_dst->p_data[(size_t)i * p_src->no_channels + c] = src[i];
+	}
+}
+
+//
+// Mock only
+//
+
+void NDIlib_mock_set_latency(float latency_ms, float jitter_ms)
+{
+	MockRuntime &runtime = Runtime();
+	std::lock_guard<std::mutex> lock(runtime.mutex);
+	runtime.latency = latency_ms > 0.0f ? latency_ms : 0.0;
+	runtime.jitter = jitter_ms > 0.0f ? jitter_ms : 0.0;
+}
+
+void NDIlib_mock_set_queue(int frames)
+{
+	MockRuntime &runtime = Runtime();
+	std::lock_guard<std::mutex> lock(runtime.mutex);
+	runtime.queueFrames = frames > 0 ? (unsigned int)frames : 1;
+}
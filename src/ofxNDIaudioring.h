@@ -0,0 +1,224 @@
+/*
+	NDI audio ring
+
+	Lock-free single producer, single consumer ring of interleaved audio
+
+	http://NDI.NewTek.com
+
+	Copyright (C) 2016-2018 Lynn Jarvis.
+
+	http://www.spout.zeal.co
+
+	=========================================================================
+	This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+	=========================================================================
+
+	17.10.26 - Create file
+
+*/
+#pragma once
+#ifndef __ofxNDIaudioring__
+#define __ofxNDIaudioring__
+
+#include <atomic>
+#include <vector>
+#include <string.h> // for memcpy, memset
+
+//
+// Audio passed from a receive thread to an audio callback.
+// Planar samples are written as they are received and read interleaved
+// in a fixed number of channels. Mono is copied to every channel, other
+// channels not received are silent and extra channels are ignored.
+// One thread only may Write and one thread only may Read.
+// Read neither locks nor allocates, so it can be called from a realtime
+// audio thread. Allocate must be called while neither thread is using the ring.
+//
+class ofxNDIaudioring {
+
+public:
+
+	ofxNDIaudioring()
+	{
+		m_nChannels = 0;
+		m_nSamples = 0;
+		Reset();
+	}
+
+	// Set the size and number of channels read and empty the ring
+	// - nSamples | samples per channel held
+	// - nChannels | channels read
+	void Allocate(unsigned int nSamples, int nChannels)
+	{
+		m_nChannels = (nChannels < 1) ? 1 : nChannels;
+		m_nSamples = (nSamples < 1) ? 1 : nSamples;
+		m_data.assign((size_t)m_nSamples*m_nChannels, 0.0f);
+		Reset();
+	}
+
+	// Empty the ring and reset the statistics
+	// Neither thread may be using the ring
+	void Reset()
+	{
+		m_write = 0;
+		m_read = 0;
+		m_sampleRate = 0;
+		m_sourceChannels = 0;
+		m_nUnderruns = 0;
+		m_nOverruns = 0;
+	}
+
+	// Add planar samples - producer thread
+	// - data | first channel
+	// - channelStride | bytes from one channel to the next
+	// Samples that do not fit are dropped and counted as an overrun.
+	// Returns the number of samples written
+	unsigned int Write(const float *data, unsigned int nSamples, int nChannels, int channelStride, int sampleRate)
+	{
+		if (m_data.empty() || !data || nSamples == 0 || nChannels < 1)
+			return 0;
+
+		m_sampleRate.store(sampleRate, std::memory_order_relaxed);
+		m_sourceChannels.store(nChannels, std::memory_order_relaxed);
+
+		unsigned long long write = m_write.load(std::memory_order_relaxed);
+		unsigned long long read = m_read.load(std::memory_order_acquire);
+		unsigned int space = m_nSamples - (unsigned int)(write - read);
+		if (nSamples > space) {
+			m_nOverruns.fetch_add(1, std::memory_order_relaxed);
+			nSamples = space;
+		}
+
+		// Interleave, in at most two parts around the end of the ring
+		unsigned int done = 0;
+		while (done < nSamples) {
+			unsigned int pos = (unsigned int)((write + done) % m_nSamples);
+			unsigned int count = nSamples - done;
+			if (count > m_nSamples - pos)
+				count = m_nSamples - pos;
+			float *dst = &m_data[(size_t)pos*m_nChannels];
+			for (int c = 0; c < m_nChannels; c++) {
+				int sc = (c < nChannels) ? c : (nChannels == 1 ? 0 : -1);
+				if (sc < 0) {
+					for (unsigned int i = 0; i < count; i++)
+						dst[(size_t)i*m_nChannels + c] = 0.0f;
+				}
+				else {
+					const float *src = (const float *)((const unsigned char *)data + (size_t)sc*channelStride) + done;
+					for (unsigned int i = 0; i < count; i++)
+						dst[(size_t)i*m_nChannels + c] = src[i];
+				}
+			}
+			done += count;
+		}
+
+		m_write.store(write + nSamples, std::memory_order_release);
+
+		return nSamples;
+	}
+
+	// Read interleaved samples - consumer thread
+	// - data | nSamples * GetChannels() samples
+	// Silence is written in place of samples not received,
+	// counted as an underrun once audio has been received.
+	// Returns the number of received samples read
+	unsigned int Read(float *data, unsigned int nSamples)
+	{
+		if (!data || nSamples == 0 || m_data.empty())
+			return 0;
+
+		unsigned long long read = m_read.load(std::memory_order_relaxed);
+		unsigned long long write = m_write.load(std::memory_order_acquire);
+		unsigned int available = (unsigned int)(write - read);
+		unsigned int count = (nSamples < available) ? nSamples : available;
+
+		unsigned int done = 0;
+		while (done < count) {
+			unsigned int pos = (unsigned int)((read + done) % m_nSamples);
+			unsigned int part = count - done;
+			if (part > m_nSamples - pos)
+				part = m_nSamples - pos;
+			memcpy(data + (size_t)done*m_nChannels, &m_data[(size_t)pos*m_nChannels],
+				(size_t)part*m_nChannels*sizeof(float));
+			done += part;
+		}
+
+		m_read.store(read + count, std::memory_order_release);
+
+		if (count < nSamples) {
+			memset(data + (size_t)count*m_nChannels, 0, (size_t)(nSamples - count)*m_nChannels*sizeof(float));
+			if (write > 0)
+				m_nUnderruns.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		return count;
+	}
+
+	// Samples per channel waiting - either thread
+	unsigned int Available() const
+	{
+		return (unsigned int)(m_write.load(std::memory_order_acquire) - m_read.load(std::memory_order_acquire));
+	}
+
+	// Samples per channel held
+	unsigned int Capacity() const
+	{
+		return m_data.empty() ? 0 : m_nSamples;
+	}
+
+	// Channels read
+	int GetChannels() const
+	{
+		return m_nChannels;
+	}
+
+	// Sample rate of the last samples written, 0 if none
+	int GetSampleRate() const
+	{
+		return m_sampleRate.load(std::memory_order_relaxed);
+	}
+
+	// Channels of the last samples written, 0 if none
+	int GetSourceChannels() const
+	{
+		return m_sourceChannels.load(std::memory_order_relaxed);
+	}
+
+	// Reads short of samples
+	unsigned int GetUnderruns() const
+	{
+		return m_nUnderruns.load(std::memory_order_relaxed);
+	}
+
+	// Writes that did not fit
+	unsigned int GetOverruns() const
+	{
+		return m_nOverruns.load(std::memory_order_relaxed);
+	}
+
+private:
+
+	std::vector<float> m_data; // Interleaved
+	int m_nChannels;
+	unsigned int m_nSamples;
+	std::atomic<int> m_sampleRate;
+	std::atomic<int> m_sourceChannels;
+	std::atomic<unsigned int> m_nUnderruns;
+	std::atomic<unsigned int> m_nOverruns;
+	// Producer and consumer sample counts on separate cache lines
+	alignas(64) std::atomic<unsigned long long> m_write; // Samples written
+	alignas(64) std::atomic<unsigned long long> m_read; // Samples read
+
+};
+
+#endif
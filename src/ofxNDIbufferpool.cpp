@@ -0,0 +1,219 @@
+/*
+	NDI buffer pool
+
+	Aligned frame buffers re-used between frames
+
+	http://NDI.NewTek.com
+
+	Copyright (C) 2016-2018 Lynn Jarvis.
+
+	http://www.spout.zeal.co
+
+	=========================================================================
+	This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+	=========================================================================
+
+	17.10.26 - Create file
+			 - Owner tags for a pool shared by all senders and receivers.
+			   Clear and GetAllocations for one owner. Add RemoveOwner.
+
+*/
+#include "ofxNDIbufferpool.h"
+#include <stdlib.h>
+#include <iostream> // for cout
+
+#if defined(_WIN32)
+#include <malloc.h> // for _aligned_malloc
+#endif
+
+
+ofxNDIbufferpool::ofxNDIbufferpool()
+{
+	m_nAllocations = 0;
+}
+
+ofxNDIbufferpool::~ofxNDIbufferpool()
+{
+	// Any buffer still leased is freed as well
+	for (size_t i = 0; i < m_buffers.size(); i++)
+		AlignedFree(m_buffers[i].data);
+	m_buffers.clear();
+}
+
+// Lease a buffer of the size required
+unsigned char *ofxNDIbufferpool::Lease(size_t size, const void *owner)
+{
+	if (size == 0)
+		return NULL;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	// Re-use a free buffer of the same size
+	for (size_t i = 0; i < m_buffers.size(); i++) {
+		if (m_buffers[i].refs == 0 && m_buffers[i].size == size) {
+			m_buffers[i].refs = 1;
+			m_buffers[i].owner = owner;
+			return m_buffers[i].data;
+		}
+	}
+
+	// None free - grow the pool
+	Buffer buffer;
+	buffer.data = AlignedAlloc(size);
+	if (!buffer.data) {
+		std::cout << "ofxNDIbufferpool - out of memory" << std::endl;
+		return NULL;
+	}
+	buffer.size = size;
+	buffer.refs = 1;
+	buffer.bDiscard = false;
+	buffer.owner = owner;
+	m_buffers.push_back(buffer);
+	m_nAllocations++;
+	if (owner)
+		m_ownerAllocations[owner]++;
+
+	return buffer.data;
+}
+
+// Add a reference to a leased buffer
+bool ofxNDIbufferpool::AddRef(const unsigned char *buffer)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	Buffer *entry = Find(buffer);
+	if (!entry || entry->refs == 0)
+		return false;
+	entry->refs++;
+	return true;
+}
+
+// Release a reference and return the buffer to the pool if unused
+void ofxNDIbufferpool::Return(const unsigned char *buffer)
+{
+	if (!buffer)
+		return;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	Buffer *entry = Find(buffer);
+	if (!entry || entry->refs == 0)
+		return;
+
+	if (--entry->refs == 0 && entry->bDiscard) {
+		AlignedFree(entry->data);
+		m_buffers.erase(m_buffers.begin() + (entry - &m_buffers[0]));
+	}
+}
+
+// Is the buffer from this pool and leased
+bool ofxNDIbufferpool::Owns(const unsigned char *buffer, const void *owner)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	Buffer *entry = Find(buffer);
+	return (entry && entry->refs > 0 && (!owner || entry->owner == owner));
+}
+
+// Free buffers that are not leased
+void ofxNDIbufferpool::Clear(const void *owner)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	size_t n = 0;
+	for (size_t i = 0; i < m_buffers.size(); i++) {
+		if (owner && m_buffers[i].owner != owner) {
+			m_buffers[n++] = m_buffers[i];
+		}
+		else if (m_buffers[i].refs == 0) {
+			AlignedFree(m_buffers[i].data);
+		}
+		else {
+			m_buffers[i].bDiscard = true;
+			m_buffers[n++] = m_buffers[i];
+		}
+	}
+	m_buffers.resize(n);
+}
+
+// Clear the buffers of an owner no longer used
+void ofxNDIbufferpool::RemoveOwner(const void *owner)
+{
+	if (!owner)
+		return;
+	Clear(owner);
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_ownerAllocations.erase(owner);
+}
+
+// Number of buffers allocated since the pool was created
+unsigned int ofxNDIbufferpool::GetAllocations(const void *owner)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (!owner)
+		return m_nAllocations;
+	std::map<const void *, unsigned int>::const_iterator it = m_ownerAllocations.find(owner);
+	return it == m_ownerAllocations.end() ? 0 : it->second;
+}
+
+// Number of buffers held by the pool
+unsigned int ofxNDIbufferpool::GetBuffers()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return (unsigned int)m_buffers.size();
+}
+
+// Number of buffers leased
+unsigned int ofxNDIbufferpool::GetLeased()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	unsigned int n = 0;
+	for (size_t i = 0; i < m_buffers.size(); i++) {
+		if (m_buffers[i].refs > 0) n++;
+	}
+	return n;
+}
+
+//
+// Private functions
+//
+
+// Find the entry for a buffer - called with the lock held
+ofxNDIbufferpool::Buffer *ofxNDIbufferpool::Find(const unsigned char *buffer)
+{
+	if (!buffer)
+		return NULL;
+	for (size_t i = 0; i < m_buffers.size(); i++) {
+		if (m_buffers[i].data == buffer)
+			return &m_buffers[i];
+	}
+	return NULL;
+}
+
+unsigned char *ofxNDIbufferpool::AlignedAlloc(size_t size)
+{
+#if defined(_WIN32)
+	return (unsigned char *)_aligned_malloc(size, alignment);
+#else
+	void *data = NULL;
+	if (posix_memalign(&data, alignment, size) != 0)
+		return NULL;
+	return (unsigned char *)data;
+#endif
+}
+
+void ofxNDIbufferpool::AlignedFree(unsigned char *data)
+{
+#if defined(_WIN32)
+	_aligned_free(data);
+#else
+	free(data);
+#endif
+}
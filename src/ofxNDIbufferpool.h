@@ -0,0 +1,125 @@
+/*
+	NDI buffer pool
+
+	Aligned frame buffers re-used between frames
+
+	http://NDI.NewTek.com
+
+	Copyright (C) 2016-2018 Lynn Jarvis.
+
+	http://www.spout.zeal.co
+
+	=========================================================================
+	This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+	=========================================================================
+
+	17.10.26 - Create file
+			 - Buffers are tagged with the user that leased them so that
+			   one pool can be shared by all senders and receivers
+
+*/
+#pragma once
+#ifndef __ofxNDIbufferpool__
+#define __ofxNDIbufferpool__
+
+#include <stddef.h>
+#include <mutex>
+#include <vector>
+#include <map>
+
+//
+// Buffers are leased for a frame and returned when no longer used.
+// A returned buffer is kept for the next lease of the same size,
+// so the pool grows to the number of frames in use at once
+// and then allocates nothing more.
+// Each buffer has a reference count so that more than one user
+// (e.g. the application and an asynchronous send) can hold it.
+// A pool can be shared. Each buffer is tagged with the owner that
+// leased it last so that one owner can clear its own buffers
+// without freeing those of the others.
+// All functions can be called from any thread.
+//
+class ofxNDIbufferpool {
+
+public:
+
+	ofxNDIbufferpool();
+	~ofxNDIbufferpool();
+
+	// Alignment of every buffer in bytes
+	static const size_t alignment = 64;
+
+	// Lease a buffer with a reference count of one
+	// - size | bytes required
+	// - owner | tag of the user, any pointer unique to it
+	// Returns NULL if out of memory
+	unsigned char *Lease(size_t size, const void *owner = NULL);
+
+	// Add a reference to a leased buffer
+	// Returns false if the buffer is not from this pool
+	bool AddRef(const unsigned char *buffer);
+
+	// Release a reference
+	// The buffer is returned to the pool when no references remain.
+	// NULL or a buffer not from this pool is ignored.
+	void Return(const unsigned char *buffer);
+
+	// Is the buffer from this pool and leased
+	// - owner | and leased last by this owner
+	bool Owns(const unsigned char *buffer, const void *owner = NULL);
+
+	// Free buffers that are not leased.
+	// Leased buffers are freed when they are returned.
+	// Use when the frame size changes.
+	// - owner | free only the buffers leased last by this owner
+	//   NULL - every buffer
+	void Clear(const void *owner = NULL);
+
+	// Clear the buffers of an owner that is no longer used
+	// and remove its allocation count
+	void RemoveOwner(const void *owner);
+
+	// Number of buffers allocated since the pool was created
+	// - owner | allocated for leases by this owner
+	//   NULL - all owners
+	unsigned int GetAllocations(const void *owner = NULL);
+
+	// Number of buffers held by the pool
+	unsigned int GetBuffers();
+
+	// Number of buffers leased
+	unsigned int GetLeased();
+
+private:
+
+	struct Buffer {
+		unsigned char *data;
+		size_t size;
+		int refs; // 0 if free
+		bool bDiscard; // Free on return
+		const void *owner; // Leased last by
+	};
+
+	std::mutex m_mutex;
+	std::vector<Buffer> m_buffers;
+	unsigned int m_nAllocations;
+	std::map<const void *, unsigned int> m_ownerAllocations;
+
+	Buffer *Find(const unsigned char *buffer);
+	static unsigned char *AlignedAlloc(size_t size);
+	static void AlignedFree(unsigned char *data);
+
+};
+
+#endif
@@ -0,0 +1,63 @@
+/*
+	NDI formats
+
+	High bit depth video formats of NDI 4 for use with the 3.5 SDK headers
+
+	http://NDI.NewTek.com
+
+	Copyright (C) 2016-2018 Lynn Jarvis.
+
+	http://www.spout.zeal.co
+
+	=========================================================================
+	This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+	=========================================================================
+
+	17.10.26 - Create file
+
+*/
+#pragma once
+#ifndef __ofxNDIformats__
+#define __ofxNDIformats__
+
+#include "Processing.NDI.Lib.h" // NDI SDK
+#include "ofxNDIutils.h" // pixel formats
+
+//
+// The values are those of NDI 4. The 3.5 SDK does not name them and
+// a 3.5 runtime neither sends nor receives them.
+//
+
+// 16 bit Y plane followed by an interleaved 16 bit CbCr plane
+static const NDIlib_FourCC_type_e ofxNDI_FourCC_type_P216 = (NDIlib_FourCC_type_e)NDI_LIB_FOURCC('P', '2', '1', '6');
+
+// P216 followed by a 16 bit alpha plane
+static const NDIlib_FourCC_type_e ofxNDI_FourCC_type_PA16 = (NDIlib_FourCC_type_e)NDI_LIB_FOURCC('P', 'A', '1', '6');
+
+// Receive the format sent, including P216 and PA16
+static const NDIlib_recv_color_format_e ofxNDI_recv_color_format_best = (NDIlib_recv_color_format_e)101;
+
+// Is the format P216 or PA16
+inline bool ofxNDI_IsHighBitDepth(NDIlib_FourCC_type_e fourcc)
+{
+	return fourcc == ofxNDI_FourCC_type_P216 || fourcc == ofxNDI_FourCC_type_PA16;
+}
+
+// ConvertImage format of a high bit depth FourCC
+inline ofxNDIutils::PixelFormat ofxNDI_HighBitDepthFormat(NDIlib_FourCC_type_e fourcc)
+{
+	return fourcc == ofxNDI_FourCC_type_PA16 ? ofxNDIutils::FORMAT_PA16 : ofxNDIutils::FORMAT_P216;
+}
+
+#endif
@@ -0,0 +1,397 @@
+/*
+	NDI frame sync
+
+	Received video and audio presented at the render clock
+
+	http://NDI.NewTek.com
+
+	Copyright (C) 2016-2018 Lynn Jarvis.
+
+	http://www.spout.zeal.co
+
+	=========================================================================
+	This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+	=========================================================================
+
+	17.10.26 - Create file
+			 - Audio held in a ring allocated outside the lock
+
+*/
+#include "ofxNDIframesync.h"
+#include <cmath> // for fabs, floor
+#include <string.h> // for memset, memcpy
+#include <chrono>
+
+
+ofxNDIframesync::ofxNDIframesync()
+{
+	m_nFrames = 4;
+	m_requestedDelay = 0.0;
+	m_audioSize = 0;
+	m_audioChannels = 0;
+	Reset();
+}
+
+ofxNDIframesync::~ofxNDIframesync()
+{
+	Clear();
+}
+
+// Steady clock time in microseconds
+long long ofxNDIframesync::GetClock()
+{
+	return (long long)std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Set the buffer size and delay and empty the buffers
+void ofxNDIframesync::Setup(unsigned int nFrames, double delay)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_nFrames = (nFrames < 1) ? 1 : nFrames;
+	m_requestedDelay = (delay > 0.0) ? delay : 0.0;
+	Reset();
+}
+
+// Release all frames and audio
+void ofxNDIframesync::Clear()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	Reset();
+}
+
+// Add a received video frame in sender time order
+void ofxNDIframesync::AddVideo(const ofxNDIreceive::SharedFrame &frame, long long arrival)
+{
+	if (!frame || !frame->IsValid())
+		return;
+
+	const NDIlib_video_frame_v2_t &video = frame->GetVideoFrame();
+	long long source = SourceTime(video, arrival);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	// Sender to local clock offset averaged over frames.
+	// A jump of more than a second is a new sender clock.
+	double offset = (double)(arrival - source);
+	if (!m_bOffset || fabs(offset - m_offset) > 1000000.0) {
+		m_nDropped += (unsigned int)m_frames.size();
+		m_frames.clear();
+		m_currentTime = 0;
+		m_offset = offset;
+		m_bOffset = true;
+	}
+	else {
+		m_offset += (offset - m_offset) / 32.0;
+	}
+
+	// Automatic delay of one and a half frame periods
+	if (m_requestedDelay <= 0.0 && video.frame_rate_N > 0 && video.frame_rate_D > 0)
+		m_delay = (long long)(1500000.0 * video.frame_rate_D / video.frame_rate_N);
+
+	// Too late to be shown
+	if (m_current && source <= m_currentTime) {
+		m_nDropped++;
+		return;
+	}
+
+	Entry entry;
+	entry.frame = frame;
+	entry.sourceTime = source;
+	std::deque<Entry>::iterator it = m_frames.end();
+	while (it != m_frames.begin() && (it - 1)->sourceTime > source)
+		--it;
+	m_frames.insert(it, entry);
+
+	// The oldest are dropped beyond the buffer size
+	while (m_frames.size() > m_nFrames) {
+		m_frames.pop_front();
+		m_nDropped++;
+	}
+}
+
+// The frame nearest to the sender time for presentation
+bool ofxNDIframesync::GetVideo(ofxNDIreceive::SharedFrame &frame, long long presentTime)
+{
+	if (presentTime == 0)
+		presentTime = GetClock();
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (!m_frames.empty()) {
+
+		// Sender time to show
+		double target = (double)(presentTime - m_delay) - m_offset;
+
+		// Frames are in time order, so the difference falls to the nearest
+		size_t best = 0;
+		double bestDiff = fabs((double)m_frames[0].sourceTime - target);
+		for (size_t i = 1; i < m_frames.size(); i++) {
+			double diff = fabs((double)m_frames[i].sourceTime - target);
+			if (diff >= bestDiff)
+				break;
+			best = i;
+			bestDiff = diff;
+		}
+
+		// Move on unless the current frame is still nearer
+		if (!m_current || bestDiff < fabs((double)m_currentTime - target)) {
+			// Earlier frames are never shown
+			for (size_t i = 0; i < best; i++) {
+				m_frames.pop_front();
+				m_nDropped++;
+			}
+			m_current = m_frames.front().frame;
+			m_currentTime = m_frames.front().sourceTime;
+			m_frames.pop_front();
+			frame = m_current;
+			return true;
+		}
+	}
+
+	if (!m_current)
+		return false;
+
+	m_nRepeated++;
+	frame = m_current;
+
+	return true;
+}
+
+// Add received planar audio
+void ofxNDIframesync::AddAudio(const NDIlib_audio_frame_v2_t &audio)
+{
+	if (!audio.p_data || audio.no_samples <= 0 || audio.no_channels <= 0 || audio.sample_rate <= 0)
+		return;
+
+	size_t nSamples = (size_t)audio.no_samples;
+
+	// No more than a second beyond the delay is kept
+	size_t maxSamples = (size_t)((double)audio.sample_rate * (1.0 + (double)GetAudioDelay() / 1000000.0));
+	if (maxSamples < nSamples)
+		maxSamples = nSamples;
+
+	// A new format, or a delay longer than the ring holds, needs a new ring.
+	// It is allocated before the lock is taken, with a second to spare for
+	// a longer delay, and the old ring is freed after the lock is released.
+	std::vector<float> ring;
+	size_t ringSize = 0;
+	{
+		std::lock_guard<std::mutex> lock(m_audioMutex);
+		if (audio.sample_rate != m_audioRate || audio.no_channels != m_audioChannels || maxSamples > m_audioSize)
+			ringSize = maxSamples + (size_t)audio.sample_rate;
+	}
+	if (ringSize > 0)
+		ring.assign(ringSize*audio.no_channels, 0.0f);
+
+	std::lock_guard<std::mutex> lock(m_audioMutex);
+
+	if (ringSize > 0) {
+		m_audio.swap(ring);
+		m_audioSize = ringSize;
+		m_audioChannels = audio.no_channels;
+		m_audioRate = audio.sample_rate;
+		m_audioWrite = 0;
+		m_audioRead = 0;
+		m_audioPos = 0.0;
+		m_audioFill = 0.0;
+		m_bAudioStarted = false;
+	}
+	else if (audio.sample_rate != m_audioRate || audio.no_channels != m_audioChannels || maxSamples > m_audioSize) {
+		return; // Format changed by another thread
+	}
+
+	// Copy to the ring, wrapping at the end
+	size_t pos = (size_t)(m_audioWrite % m_audioSize);
+	size_t first = m_audioSize - pos;
+	if (first > nSamples)
+		first = nSamples;
+	for (int c = 0; c < audio.no_channels; c++) {
+		const float *src = (const float *)((const unsigned char *)audio.p_data + (size_t)c*audio.channel_stride_in_bytes);
+		float *dst = &m_audio[(size_t)c*m_audioSize];
+		memcpy(dst + pos, src, first*sizeof(float));
+		if (nSamples > first)
+			memcpy(dst, src + first, (nSamples - first)*sizeof(float));
+	}
+	m_audioWrite += nSamples;
+
+	// The oldest samples are dropped before they are overwritten
+	if (m_audioWrite - m_audioRead > maxSamples) {
+		m_audioRead = m_audioWrite - maxSamples;
+		m_audioPos = 0.0;
+	}
+}
+
+// Read audio resampled to the render clock
+// Linear interpolation, intended for the small ratio changes that
+// follow the sender clock and for conversion between common rates.
+int ofxNDIframesync::GetAudio(float *data, int nSamples, int nChannels, int sampleRate)
+{
+	if (!data || nSamples <= 0 || nChannels <= 0)
+		return 0;
+
+	int written = 0;
+
+	{
+		std::lock_guard<std::mutex> lock(m_audioMutex);
+
+		if (m_audioChannels > 0 && sampleRate > 0) {
+
+			int srcChannels = m_audioChannels;
+			size_t size = m_audioSize;
+			double waiting = (double)(m_audioWrite - m_audioRead) - m_audioPos;
+			double ratio = (double)m_audioRate / (double)sampleRate;
+
+			// Samples held back - the delay and this read
+			double target = (double)m_audioRate * (double)GetAudioDelay() / 1000000.0 + nSamples * ratio;
+
+			// Start when filled to the delay, and again after an underrun
+			if (!m_bAudioStarted && waiting >= target) {
+				m_bAudioStarted = true;
+				m_audioFill = waiting;
+			}
+
+			if (m_bAudioStarted) {
+
+				// Read faster when more than the delay is waiting and slower when less
+				m_audioFill += (waiting - m_audioFill) / 16.0;
+				double correction = (m_audioFill - target) / (double)m_audioRate * 0.05;
+				if (correction > 0.005) correction = 0.005;
+				if (correction < -0.005) correction = -0.005;
+				ratio *= 1.0 + correction;
+
+				for (; written < nSamples; written++) {
+					unsigned long long i = m_audioRead + (unsigned long long)m_audioPos;
+					if (i + 1 >= m_audioWrite)
+						break;
+					size_t i0 = (size_t)(i % size);
+					size_t i1 = (i0 + 1 < size) ? i0 + 1 : 0;
+					float frac = (float)(m_audioPos - floor(m_audioPos));
+					float *out = data + (size_t)written*nChannels;
+					for (int c = 0; c < nChannels; c++) {
+						int sc = (c < srcChannels) ? c : (srcChannels == 1 ? 0 : -1);
+						if (sc < 0) {
+							out[c] = 0.0f;
+						}
+						else {
+							const float *s = &m_audio[(size_t)sc*size];
+							out[c] = s[i0] + (s[i1] - s[i0])*frac;
+						}
+					}
+					m_audioPos += ratio;
+				}
+
+				unsigned long long whole = (unsigned long long)m_audioPos;
+				m_audioRead += whole;
+				m_audioPos -= (double)whole;
+				if (m_audioRead > m_audioWrite) {
+					m_audioRead = m_audioWrite;
+					m_audioPos = 0.0;
+				}
+
+				if (written < nSamples) {
+					m_nUnderruns++;
+					m_bAudioStarted = false;
+				}
+			}
+		}
+	}
+
+	// Silence for samples not received
+	if (written < nSamples)
+		memset(data + (size_t)written*nChannels, 0, (size_t)(nSamples - written)*nChannels*sizeof(float));
+
+	return written;
+}
+
+unsigned int ofxNDIframesync::GetDroppedFrames()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_nDropped;
+}
+
+unsigned int ofxNDIframesync::GetRepeatedFrames()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_nRepeated;
+}
+
+unsigned int ofxNDIframesync::GetAudioUnderruns()
+{
+	std::lock_guard<std::mutex> lock(m_audioMutex);
+	return m_nUnderruns;
+}
+
+double ofxNDIframesync::GetDelay()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return (double)m_delay / 1000.0;
+}
+
+unsigned int ofxNDIframesync::GetBufferedFrames()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return (unsigned int)m_frames.size();
+}
+
+//
+// Private functions
+//
+
+// Empty the buffers and reset the clock and statistics
+// The video lock is held by the caller. The audio ring
+// is freed after the audio lock is released.
+void ofxNDIframesync::Reset()
+{
+	std::vector<float> ring;
+
+	m_frames.clear();
+	m_current.reset();
+	m_currentTime = 0;
+	m_delay = (long long)(m_requestedDelay * 1000.0);
+	m_offset = 0.0;
+	m_bOffset = false;
+	m_nDropped = 0;
+	m_nRepeated = 0;
+
+	std::lock_guard<std::mutex> lock(m_audioMutex);
+	m_audio.swap(ring);
+	m_audioSize = 0;
+	m_audioChannels = 0;
+	m_audioWrite = 0;
+	m_audioRead = 0;
+	m_audioPos = 0.0;
+	m_audioFill = 0.0;
+	m_audioRate = 0;
+	m_bAudioStarted = false;
+	m_nUnderruns = 0;
+}
+
+// Sender time of a frame in microseconds
+// The timestamp, or the timecode if there is none, or the arrival time
+long long ofxNDIframesync::SourceTime(const NDIlib_video_frame_v2_t &frame, long long arrival)
+{
+	if (frame.timestamp != NDIlib_recv_timestamp_undefined && frame.timestamp != 0)
+		return frame.timestamp / 10;
+	if (frame.timecode != NDIlib_send_timecode_synthesize)
+		return frame.timecode / 10;
+	return arrival;
+}
+
+// Audio is held for the video delay, or 40 msec before video is received
+long long ofxNDIframesync::GetAudioDelay()
+{
+	long long delay = m_delay;
+	return (delay > 0) ? delay : 40000;
+}
@@ -0,0 +1,163 @@
+/*
+	NDI frame sync
+
+	Received video and audio presented at the render clock
+
+	http://NDI.NewTek.com
+
+	Copyright (C) 2016-2018 Lynn Jarvis.
+
+	http://www.spout.zeal.co
+
+	=========================================================================
+	This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+	=========================================================================
+
+	17.10.26 - Create file
+			 - Audio held in a ring allocated outside the lock
+
+*/
+#pragma once
+#ifndef __ofxNDIframesync__
+#define __ofxNDIframesync__
+
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include "ofxNDIreceive.h" // ReceivedFrame
+
+//
+// Video frames are added with their arrival time and taken for the
+// time they will be seen. The sender timestamp of each frame, or the
+// timecode if the sender gives no timestamp, is mapped to the local clock
+// by an offset averaged over the frames received, so that network jitter
+// does not move the presentation. The frame nearest to its sender time
+// plus a fixed delay is returned. A render rate above the sender rate
+// then repeats a frame, and a lower one skips a frame, at regular
+// intervals rather than whenever arrival happens to vary.
+//
+// Latency is bounded by the delay and by the buffer size,
+// beyond which the oldest frames are dropped.
+//
+// Audio is held in the sender sample rate and read at the render sample
+// rate. The read ratio is adjusted by up to 0.5% to keep the audio
+// buffered at the delay, so that it follows the sender clock without
+// gaps or repeats. Audio has a lock of its own and is held in a ring
+// for each channel, so that the audio callback is not held up by video
+// and neither side allocates or moves samples while holding the lock.
+//
+// All functions can be called from any thread.
+//
+class ofxNDIframesync {
+
+public:
+
+	ofxNDIframesync();
+	~ofxNDIframesync();
+
+	// Steady clock time in microseconds, the time base of presentation
+	static long long GetClock();
+
+	// Set the buffer size and delay, and empty the buffers
+	// - nFrames | most video frames held
+	// - delay | milliseconds from sender time to presentation
+	//   0 - one and a half frame periods
+	void Setup(unsigned int nFrames, double delay);
+
+	// Release all frames and audio, and reset the clock and statistics
+	void Clear();
+
+	// Add a received video frame
+	// - frame | shared with each consumer it is presented to
+	// - arrival | GetClock time the frame was received
+	void AddVideo(const ofxNDIreceive::SharedFrame &frame, long long arrival);
+
+	// The video frame to show at a presentation time
+	// - frame | the frame nearest the time
+	// - presentTime | GetClock time the frame will be seen, 0 - now
+	// Returns false if no frame has been received
+	bool GetVideo(ofxNDIreceive::SharedFrame &frame, long long presentTime = 0);
+
+	// Add received audio
+	// The planar samples are copied. A change of sample rate
+	// or number of channels empties the audio buffer. The ring
+	// is allocated only for a new format or a longer delay.
+	void AddAudio(const NDIlib_audio_frame_v2_t &audio);
+
+	// Read audio resampled to the render clock
+	// - data | nSamples * nChannels interleaved samples
+	// - nChannels | channels required. Mono is copied to every
+	//   channel and other channels not received are silent.
+	// - sampleRate | render sample rate
+	// Silence is written in place of samples not yet received.
+	// Returns the number of received samples written
+	int GetAudio(float *data, int nSamples, int nChannels, int sampleRate);
+
+	// Frames dropped without being presented
+	unsigned int GetDroppedFrames();
+
+	// Frames presented more than once
+	unsigned int GetRepeatedFrames();
+
+	// Audio reads short of samples
+	unsigned int GetAudioUnderruns();
+
+	// Presentation delay in milliseconds
+	double GetDelay();
+
+	// Video frames waiting
+	unsigned int GetBufferedFrames();
+
+private:
+
+	struct Entry {
+		ofxNDIreceive::SharedFrame frame;
+		long long sourceTime; // Sender time in microseconds
+	};
+
+	std::mutex m_mutex;
+
+	// Video
+	std::deque<Entry> m_frames; // In sender time order
+	ofxNDIreceive::SharedFrame m_current; // Last presented
+	long long m_currentTime; // Its sender time
+	unsigned int m_nFrames;
+	double m_requestedDelay; // msec, 0 - automatic
+	std::atomic<long long> m_delay; // usec, read by the audio functions
+	double m_offset; // Sender to local time
+	bool m_bOffset;
+	unsigned int m_nDropped;
+	unsigned int m_nRepeated;
+
+	// Audio
+	std::mutex m_audioMutex;
+	std::vector<float> m_audio; // Ring of m_audioSize samples for each channel in turn
+	size_t m_audioSize; // Samples for each channel
+	int m_audioChannels;
+	unsigned long long m_audioWrite; // Samples added
+	unsigned long long m_audioRead; // First sample not consumed
+	double m_audioPos; // Fractional read position from m_audioRead
+	double m_audioFill; // Averaged samples waiting
+	int m_audioRate;
+	bool m_bAudioStarted; // Filled to the delay
+	unsigned int m_nUnderruns;
+
+	void Reset();
+	static long long SourceTime(const NDIlib_video_frame_v2_t &frame, long long arrival);
+	long long GetAudioDelay();
+
+};
+
+#endif
@@ -0,0 +1,118 @@
+/*
+	NDI queue
+
+	Lock-free single producer, single consumer queue
+
+	http://NDI.NewTek.com
+
+	Copyright (C) 2016-2018 Lynn Jarvis.
+
+	http://www.spout.zeal.co
+
+	=========================================================================
+	This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+	=========================================================================
+
+	17.10.26 - Create file
+
+*/
+#pragma once
+#ifndef __ofxNDIqueue__
+#define __ofxNDIqueue__
+
+#include <atomic>
+#include <vector>
+
+//
+// Fixed size queue for passing items from one thread to another.
+// One thread only may Push and one thread only may Pop.
+// Allocate must be called while neither thread is using the queue.
+//
+template <typename T>
+class ofxNDIqueue {
+
+public:
+
+	ofxNDIqueue()
+	{
+		m_head = 0;
+		m_tail = 0;
+	}
+
+	// Set the maximum number of items and empty the queue
+	void Allocate(unsigned int capacity)
+	{
+		// One slot is always empty to tell full from empty
+		m_items.assign(capacity + 1, T());
+		m_head = 0;
+		m_tail = 0;
+	}
+
+	// Add an item - producer thread
+	// Returns false if the queue is full
+	bool Push(const T &item)
+	{
+		unsigned int head = m_head.load(std::memory_order_relaxed);
+		unsigned int next = Next(head);
+		if (m_items.empty() || next == m_tail.load(std::memory_order_acquire))
+			return false;
+		m_items[head] = item;
+		m_head.store(next, std::memory_order_release);
+		return true;
+	}
+
+	// Remove the oldest item - consumer thread
+	// Returns false if the queue is empty
+	bool Pop(T &item)
+	{
+		unsigned int tail = m_tail.load(std::memory_order_relaxed);
+		if (tail == m_head.load(std::memory_order_acquire))
+			return false;
+		item = m_items[tail];
+		m_tail.store(Next(tail), std::memory_order_release);
+		return true;
+	}
+
+	// Number of items waiting - either thread
+	unsigned int Size() const
+	{
+		unsigned int n = (unsigned int)m_items.size();
+		if (n == 0)
+			return 0;
+		unsigned int head = m_head.load(std::memory_order_acquire);
+		unsigned int tail = m_tail.load(std::memory_order_acquire);
+		return (head + n - tail) % n;
+	}
+
+	// Maximum number of items
+	unsigned int Capacity() const
+	{
+		return m_items.empty() ? 0 : (unsigned int)m_items.size() - 1;
+	}
+
+private:
+
+	std::vector<T> m_items;
+	// Producer and consumer indices on separate cache lines
+	alignas(64) std::atomic<unsigned int> m_head; // Next slot to write
+	alignas(64) std::atomic<unsigned int> m_tail; // Next slot to read
+
+	unsigned int Next(unsigned int index) const
+	{
+		return (index + 1) % (unsigned int)m_items.size();
+	}
+
+};
+
+#endif
@@ -0,0 +1,406 @@
+/*
+	NDI readback
+
+	Ring of pixel buffers for asynchronous readback of OpenGL
+	frames by ofxNDIsender
+
+	adapted from : http://www.songho.ca/opengl/gl_pbo.html
+
+	http://NDI.NewTek.com
+
+	Copyright (C) 2016-2018 Lynn Jarvis.
+
+	http://www.spout.zeal.co
+
+	=========================================================================
+	This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+	=========================================================================
+
+	17.10.26 - Create file. The PBO ring of ofxNDIsender with the
+			   OpenGL calls behind ofxNDIpbo.
+
+*/
+#include "ofxNDIreadback.h"
+#include "ofxNDIutils.h" // for CopyImage
+
+
+ofxNDIreadback::ofxNDIreadback(ofxNDIsend &sender, ofxNDIpbo &pbo)
+	: m_sender(sender), m_gl(pbo)
+{
+	m_width = 0;
+	m_height = 0;
+	m_nPbos = 3;
+	m_pboHead = 0;
+	m_nPboPending = 0;
+	m_pboRead = -1;
+	m_pboCollected = -1;
+	m_bSkip = false;
+	m_bPersistent = false;
+	m_bPersistentPbos = false;
+	m_frame = 0;
+	m_nSkipped = 0;
+	m_latency = 0.0;
+}
+
+// The PBOs are deleted by Delete while the OpenGL context exists
+ofxNDIreadback::~ofxNDIreadback()
+{
+
+}
+
+// Create the PBOs for a sender size
+void ofxNDIreadback::Allocate(unsigned int width, unsigned int height)
+{
+	Delete();
+
+	// One more for the PBO still used by the pipeline or by NDI
+	// after it has been collected
+	unsigned int nPbos = m_nPbos;
+	if (m_sender.GetPipeline() || m_bPersistent)
+		nPbos++;
+	m_bPersistentPbos = m_bPersistent && m_gl.IsPersistentSupported();
+	m_pbos.resize(nPbos);
+	for (unsigned int i = 0; i < nPbos; i++) {
+		PboFrame &pbo = m_pbos[i];
+		pbo.fence = NULL;
+		pbo.mapped = NULL;
+		pbo.data = NULL;
+		pbo.number = 0;
+		pbo.bRead = false;
+		pbo.frame = 0;
+		pbo.readWidth = pbo.readHeight = 0;
+		pbo.width = pbo.height = pbo.stride = 0;
+		pbo.bInvert = false;
+		// Persistent buffers are mapped for reading by NDI and for invert in place
+		pbo.pbo = m_gl.CreateBuffer((size_t)width*height * 4, m_bPersistentPbos, &pbo.mapped);
+	}
+	m_width = width;
+	m_height = height;
+	m_pboHead = 0;
+	m_nPboPending = 0;
+	m_pboRead = -1;
+	m_pboCollected = -1;
+}
+
+// Delete the PBOs
+void ofxNDIreadback::Delete()
+{
+	Release();
+	for (size_t i = 0; i < m_pbos.size(); i++) {
+		if (m_pbos[i].pbo)
+			m_gl.DeleteBuffer(m_pbos[i].pbo, m_pbos[i].mapped != NULL);
+	}
+	m_pbos.clear();
+	m_bPersistentPbos = false;
+}
+
+// Whether the PBOs have been created
+bool ofxNDIreadback::IsAllocated()
+{
+	return !m_pbos.empty();
+}
+
+// Collect the oldest PBO read if its transfer is complete
+bool ofxNDIreadback::Collect(unsigned char *data)
+{
+	m_pboCollected = -1;
+	m_frame++;
+	if (m_nPboPending == 0)
+		return false;
+
+	// Wait only if there is no PBO free to read this frame
+	// and frames are not to be skipped
+	int index = (int)m_pboHead;
+	PboFrame &pbo = m_pbos[index];
+	PboFrame &next = m_pbos[(m_pboHead + m_nPboPending) % m_pbos.size()];
+	bool bFull = m_nPboPending >= m_nPbos || next.bRead
+		|| (next.data && !IsReleased(next));
+	if (!Wait(pbo, bFull && !m_bSkip))
+		return false;
+
+	m_pboHead = (m_pboHead + 1) % (unsigned int)m_pbos.size();
+	m_nPboPending--;
+	pbo.bRead = false;
+
+	double latency = (double)(m_frame - pbo.frame);
+	if (m_latency <= 0.0)
+		m_latency = latency;
+	else
+		m_latency = m_latency*0.95 + latency*0.05;
+
+	// Sent or queued from the persistent mapping
+	if (pbo.mapped) {
+		pbo.data = pbo.mapped;
+		m_pboCollected = index;
+		return true;
+	}
+
+	if (m_sender.GetPipeline()) {
+		// The PBO stays mapped until its pixels are queued and copied
+		pbo.data = m_gl.MapBuffer(pbo.pbo);
+		if (!pbo.data)
+			return false;
+	}
+	else {
+		// Map the PBO to process its data by CPU
+		void *pboMemory = m_gl.MapBuffer(pbo.pbo);
+		if (!pboMemory || !data) {
+			if (pboMemory) m_gl.UnmapBuffer(pbo.pbo);
+			return false;
+		}
+		// Use SSE2 mempcy
+		ofxNDIutils::CopyImage((unsigned char *)pboMemory, data, pbo.readWidth, pbo.readHeight, pbo.readWidth * 4);
+		m_gl.UnmapBuffer(pbo.pbo);
+	}
+
+	m_pboCollected = index;
+
+	return true;
+}
+
+// Select the PBO to read this frame, false if the ring is full
+bool ofxNDIreadback::Next()
+{
+	m_pboRead = -1;
+	if (m_pbos.empty())
+		return false;
+
+	int index = (int)((m_pboHead + m_nPboPending) % m_pbos.size());
+	PboFrame &pbo = m_pbos[index];
+
+	// Full if the ring size is waiting, or the next has just been
+	// collected to be queued or sent. A PBO still queued or sent
+	// has to be released before it is read into.
+	if (m_nPboPending >= m_nPbos || (pbo.data && index == m_pboCollected)
+		|| (pbo.data && m_bSkip && !IsReleased(pbo))) {
+		m_nSkipped++;
+		return false;
+	}
+	Unmap(index);
+
+	m_pboRead = index;
+
+	return true;
+}
+
+// Read pixels of the bound framebuffer into the selected PBO
+void ofxNDIreadback::Read(unsigned int width, unsigned int height)
+{
+	if (m_pboRead < 0)
+		return;
+
+	PboFrame &pbo = m_pbos[m_pboRead];
+
+	// glReadPixels returns immediately and the transfer
+	// is signalled by the fence when it is complete
+	m_gl.ReadPixels(pbo.pbo, width, height);
+	pbo.fence = m_gl.FenceSync();
+
+	pbo.bRead = true;
+	pbo.frame = m_frame;
+	pbo.readWidth = width;
+	pbo.readHeight = height;
+	m_nPboPending++;
+}
+
+// Send the frame collected and keep the details of the frame read
+bool ofxNDIreadback::Send(unsigned char *buffer, unsigned int width, unsigned int height, unsigned int frameStride, bool bInvert)
+{
+	if (m_pboRead >= 0) {
+		PboFrame &current = m_pbos[m_pboRead];
+		current.width = width;
+		current.height = height;
+		current.stride = frameStride;
+		current.bInvert = bInvert;
+	}
+
+	if (m_pboCollected < 0)
+		return false;
+
+	int index = m_pboCollected;
+	m_pboCollected = -1;
+	PboFrame &frame = m_pbos[index];
+
+	// Sent from the persistent mapping. NDI may hold
+	// an async frame until the next synchronizing event.
+	if (frame.data && !m_sender.GetPipeline()) {
+		unsigned long long submitted = m_sender.GetSubmittedFrames();
+		bool bResult = false;
+		if (frame.stride > 0)
+			bResult = m_sender.SendFrame((const unsigned char *)frame.data,
+				frame.width, frame.height, frame.stride, frame.bInvert);
+		else
+			bResult = m_sender.SendImage((const unsigned char *)frame.data,
+				frame.width, frame.height, false, frame.bInvert);
+		if (m_sender.GetSubmittedFrames() > submitted)
+			frame.number = m_sender.GetSubmittedFrames();
+		else
+			Unmap(index);
+		return bResult;
+	}
+
+	// Queued from the mapped PBO on the pipeline
+	// A PBO mapped by MapBuffer is read only, so it is not inverted in place
+	if (frame.data) {
+		bool bReadOnly = frame.mapped == NULL;
+		if (frame.stride > 0)
+			frame.number = m_sender.QueueFrame((const unsigned char *)frame.data,
+				frame.width, frame.height, frame.stride, frame.bInvert, bReadOnly);
+		else
+			frame.number = m_sender.QueueImage((const unsigned char *)frame.data,
+				frame.width, frame.height, false, frame.bInvert, bReadOnly);
+		// A dropped frame is unmapped at once
+		if (frame.number == 0) {
+			Unmap(index);
+			return false;
+		}
+		return true;
+	}
+
+	// Copied to the buffer when collected
+	if (!buffer)
+		return false;
+	if (frame.stride > 0)
+		return m_sender.SendFrame(buffer, frame.width, frame.height, frame.stride, frame.bInvert);
+	return m_sender.SendImage(buffer, frame.width, frame.height, false, frame.bInvert);
+}
+
+// Unmap all PBOs and discard the frames read
+void ofxNDIreadback::Release()
+{
+	for (size_t i = 0; i < m_pbos.size(); i++) {
+		Unmap((int)i);
+		if (m_pbos[i].fence) {
+			m_gl.DeleteSync(m_pbos[i].fence);
+			m_pbos[i].fence = NULL;
+		}
+		m_pbos[i].bRead = false;
+	}
+	m_pboHead = 0;
+	m_nPboPending = 0;
+	m_pboRead = -1;
+	m_pboCollected = -1;
+}
+
+// Whether frames are queued or sent from the PBO memory
+bool ofxNDIreadback::IsMapped()
+{
+	return m_sender.GetPipeline() || m_bPersistentPbos;
+}
+
+// Set the number of PBOs in the ring
+void ofxNDIreadback::SetBuffers(unsigned int nBuffers)
+{
+	if (nBuffers < 2) nBuffers = 2;
+	if (nBuffers > 8) nBuffers = 8;
+	if (nBuffers == m_nPbos)
+		return;
+	m_nPbos = nBuffers;
+	// The ring is created again for the sender size
+	if (!m_pbos.empty())
+		Allocate(m_width, m_height);
+}
+
+unsigned int ofxNDIreadback::GetBuffers()
+{
+	return m_nPbos;
+}
+
+void ofxNDIreadback::SetSkip(bool bSkip)
+{
+	m_bSkip = bSkip;
+}
+
+bool ofxNDIreadback::GetSkip()
+{
+	return m_bSkip;
+}
+
+// Map the PBOs once for their life
+void ofxNDIreadback::SetPersistent(bool bPersistent)
+{
+	if (bPersistent == m_bPersistent)
+		return;
+	m_bPersistent = bPersistent;
+	if (!m_pbos.empty())
+		Allocate(m_width, m_height);
+}
+
+bool ofxNDIreadback::GetPersistent()
+{
+	return m_bPersistentPbos;
+}
+
+double ofxNDIreadback::GetLatency()
+{
+	return m_latency;
+}
+
+unsigned int ofxNDIreadback::GetSkipped()
+{
+	return m_nSkipped;
+}
+
+unsigned int ofxNDIreadback::GetPending()
+{
+	return m_nPboPending;
+}
+
+//
+// Private functions
+//
+
+// Wait for the transfer to a PBO, or only test it if bWait is false
+bool ofxNDIreadback::Wait(PboFrame &pbo, bool bWait)
+{
+	// Without a fence the map waits for the transfer
+	if (!pbo.fence)
+		return true;
+
+	unsigned long long timeout = bWait ? 1000000000ULL : 0; // 1 second in nanoseconds
+	if (!m_gl.ClientWaitSync(pbo.fence, timeout))
+		return false;
+
+	// Signalled, or failed and the map will wait instead
+	m_gl.DeleteSync(pbo.fence);
+	pbo.fence = NULL;
+
+	return true;
+}
+
+// Whether the pipeline or NDI has finished with a PBO collected
+bool ofxNDIreadback::IsReleased(const PboFrame &pbo)
+{
+	if (pbo.number == 0)
+		return false;
+	if (m_sender.GetPipeline())
+		return m_sender.GetReleasedFrames() >= pbo.number;
+	return m_sender.GetFinishedFrames() >= pbo.number;
+}
+
+// Unmap a PBO once the pipeline or NDI has finished with it
+void ofxNDIreadback::Unmap(int index)
+{
+	PboFrame &pbo = m_pbos[index];
+	if (pbo.data && pbo.number > 0 && !IsReleased(pbo)) {
+		if (m_sender.GetPipeline())
+			m_sender.WaitReleased(pbo.number);
+		else
+			m_sender.FlushAsync(); // Sent asynchronously from the PBO
+	}
+	if (pbo.data && !pbo.mapped)
+		m_gl.UnmapBuffer(pbo.pbo);
+	pbo.data = NULL;
+	pbo.number = 0;
+}
@@ -0,0 +1,215 @@
+/*
+	NDI readback
+
+	Ring of pixel buffers for asynchronous readback of OpenGL
+	frames by ofxNDIsender
+
+	http://NDI.NewTek.com
+
+	Copyright (C) 2016-2018 Lynn Jarvis.
+
+	http://www.spout.zeal.co
+
+	=========================================================================
+	This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+	=========================================================================
+
+	17.10.26 - Create file. The PBO ring of ofxNDIsender with the
+			   OpenGL calls behind ofxNDIpbo.
+
+*/
+#pragma once
+#ifndef __ofxNDIreadback__
+#define __ofxNDIreadback__
+
+#include <stddef.h>
+#include <vector>
+#include "ofxNDIsend.h" // Frames collected are sent or queued
+
+//
+// OpenGL buffer, fence and transfer calls made by the readback ring.
+// ofxNDIsender implements them with OpenGL. Another implementation
+// allows the ring to be run without OpenGL (examples/example-readback).
+//
+class ofxNDIpbo {
+
+public:
+
+	virtual ~ofxNDIpbo() {}
+
+	// Whether buffers can stay mapped while OpenGL reads into them
+	virtual bool IsPersistentSupported() = 0;
+
+	// Create a pixel pack buffer
+	// - bytes | buffer size
+	// - bPersistent | map the buffer for its life
+	// - mapped | the persistent mapping for reading and writing,
+	//   NULL if not persistent
+	// Returns the buffer name, 0 if it could not be created
+	virtual unsigned int CreateBuffer(size_t bytes, bool bPersistent, void **mapped) = 0;
+
+	// Delete a buffer, unmapped first if it is persistently mapped
+	virtual void DeleteBuffer(unsigned int buffer, bool bMapped) = 0;
+
+	// Read RGBA pixels of the bound framebuffer into a buffer (glReadPixels)
+	virtual void ReadPixels(unsigned int buffer, unsigned int width, unsigned int height) = 0;
+
+	// Fence signalled when the commands so far are complete (glFenceSync)
+	virtual void *FenceSync() = 0;
+
+	// Wait for a fence to be signalled (glClientWaitSync)
+	// - timeout | nanoseconds, 0 to test only
+	// Returns false if the timeout expired. A fence that failed
+	// returns true and the map then waits for the transfer.
+	virtual bool ClientWaitSync(void *fence, unsigned long long timeout) = 0;
+
+	// Delete a fence (glDeleteSync)
+	virtual void DeleteSync(void *fence) = 0;
+
+	// Map a buffer for reading (glMapBuffer)
+	// The mapping is read only, so the pixels are not changed in place.
+	// Returns NULL if it could not be mapped
+	virtual void *MapBuffer(unsigned int buffer) = 0;
+
+	// Unmap a buffer mapped by MapBuffer (glUnmapBuffer)
+	virtual void UnmapBuffer(unsigned int buffer) = 0;
+
+};
+
+//
+// Pixels are read into a ring of PBOs. Each frame the oldest PBO read is
+// collected if a fence shows that its transfer is complete, so mapping
+// does not stall the GPU, and the current frame is read into the next.
+// If the ring is full, Collect waits for the oldest transfer, for up to
+// a second, or the frame is not read (SetSkip).
+//
+// With the ofxNDIsend pipeline, or with persistent mapping, a PBO collected
+// is queued or sent from its memory without a copy and is read into again
+// once the pipeline or NDI has finished with it.
+//
+// All functions are called on the OpenGL thread.
+//
+class ofxNDIreadback {
+
+public:
+
+	// - sender | sends or queues the frames collected
+	// - pbo | OpenGL calls
+	ofxNDIreadback(ofxNDIsend &sender, ofxNDIpbo &pbo);
+	~ofxNDIreadback();
+
+	// Create the PBOs for a sender size
+	// PBOs already created are deleted and the frames in them discarded.
+	void Allocate(unsigned int width, unsigned int height);
+
+	// Delete the PBOs
+	void Delete();
+
+	// Whether the PBOs have been created
+	bool IsAllocated();
+
+	// Collect the oldest PBO read if its transfer is complete
+	// The pixels are copied to data, or mapped to be queued or sent.
+	// Returns false if there is no frame to send.
+	bool Collect(unsigned char *data);
+
+	// Select the PBO to read this frame, false if the ring is full
+	bool Next();
+
+	// Read pixels of the bound framebuffer into the selected PBO
+	void Read(unsigned int width, unsigned int height);
+
+	// Send the frame collected and keep the details of the frame read
+	// - buffer | pixels copied by Collect, NULL if mapped
+	// - width, height, frameStride, bInvert | frame read this time, as for ofxNDIsend::SendFrame
+	bool Send(unsigned char *buffer, unsigned int width, unsigned int height, unsigned int frameStride, bool bInvert);
+
+	// Unmap all PBOs and discard the frames read
+	void Release();
+
+	// Whether frames are queued or sent from the PBO memory,
+	// so that Collect needs no buffer
+	bool IsMapped();
+
+	// Number of PBOs in the ring, 2 to 8
+	// The ring is created again if it exists.
+	void SetBuffers(unsigned int nBuffers);
+	unsigned int GetBuffers();
+
+	// Skip a frame instead of waiting when the ring is full
+	void SetSkip(bool bSkip);
+	bool GetSkip();
+
+	// Map the PBOs once for their life if supported
+	// The ring is created again if it exists.
+	void SetPersistent(bool bPersistent);
+
+	// Whether the PBOs are persistently mapped
+	bool GetPersistent();
+
+	// Frames from readback to send (averaged)
+	double GetLatency();
+
+	// Frames not read because the ring was full
+	unsigned int GetSkipped();
+
+	// Frames read and not yet collected
+	unsigned int GetPending();
+
+private:
+
+	// Pixels read into a PBO of the ring
+	struct PboFrame {
+		unsigned int pbo;
+		void *fence; // Set when read, deleted once signalled
+		void *mapped; // Persistent mapping, NULL if not persistent
+		void *data; // Mapped while queued or sent, NULL if unused
+		unsigned long long number; // Pipeline or NDI frame using the data
+		bool bRead; // Pixels read and not yet collected
+		unsigned long long frame; // Readback count when read
+		unsigned int readWidth, readHeight; // RGBA pixels read
+		unsigned int width, height; // Image sent
+		unsigned int stride; // Frame stride, 0 for RGBA pixels
+		bool bInvert;
+	};
+
+	ofxNDIsend &m_sender;
+	ofxNDIpbo &m_gl;
+	std::vector<PboFrame> m_pbos;
+	unsigned int m_width; // Sender size the ring was created for
+	unsigned int m_height;
+	unsigned int m_nPbos; // Ring size requested
+	unsigned int m_pboHead; // Oldest PBO read
+	unsigned int m_nPboPending; // PBOs read and not yet collected
+	int m_pboRead; // PBO read on this frame, -1 if skipped
+	int m_pboCollected; // PBO collected on this frame, -1 if none
+	bool m_bSkip;
+	bool m_bPersistent; // Persistent mapping requested
+	bool m_bPersistentPbos; // The PBOs are persistently mapped
+	unsigned long long m_frame; // Readback count
+	unsigned int m_nSkipped;
+	double m_latency; // frames
+
+	// Wait for the transfer to a PBO, or only test it if bWait is false
+	bool Wait(PboFrame &pbo, bool bWait);
+
+	// Whether the pipeline or NDI has finished with a PBO collected
+	bool IsReleased(const PboFrame &pbo);
+
+	// Unmap a PBO once the pipeline or NDI has finished with it
+	void Unmap(int index);
+
+};
+
+#endif
@@ -74,6 +74,38 @@
 	30.07.18 - const char for GetSenderIndex(const char *sendername, ..
 			 - Added GetSenderIndex(std::string sendername, int &index)
 	06.08.18 - SetSenderIndex return false for the same sender
+	17.10.26 - UYVY to RGBA uses the NDI colour matrix for the frame size
+			 - Add SetCaptureThread - optional capture thread with a frame queue
+			   GetDroppedFrames, GetQueueDepth, GetCaptureLatency
+			 - Free metadata frames after use
+			 - FreeVideoData clears the frame pointer
+			 - ReleaseReceiver frees the video frame before destroying the receiver
+			 - Add ReceivedFrame and ReceiveFrame for frames used without copying
+			   The receiver is destroyed when the last frame is released
+			 - Steady clock timing for RefreshSenders, CreateReceiver and fps
+			   replacing timeGetTime and QueryPerformanceCounter
+			 - GetSenderName : bounded copy in place of strcpy_s
+			 - ReceiveImage : single pass conversion with ConvertImage.
+			   UYVY is inverted if requested and RGBX/BGRX alpha set to 255.
+			 - ReceiveConvert : frames with a negative line stride
+			 - ReceiveImage converts P216 and PA16 frames to RGBA.
+			   Add ReceiveImage16 for 16 bit or half float RGBA.
+			 - Add SetOutputFormat - ReceiveImage to RGBA, BGRA, NV12 or I420.
+			 - Add SetNativeFormat, GetNativeFormat. CreateReceiver(index)
+			   receives the native UYVY or UYVA if set, otherwise RGBA.
+			 - Add ReceivedFrame::GetPixels - conversion to RGBA when first used,
+			   shared by all consumers of the frame. Add ReceiveFrame for SharedFrame.
+			 - ConvertFrame replaces ReceiveConvert for any video frame
+			 - Add SetFrameSync, ReceiveSyncFrame, ReceiveSyncAudio and statistics.
+			   The capture thread receives audio for the frame sync.
+			 - Add SetAudio and ReceiveAudio. Audio received on the capture
+			   thread is passed to the audio callback by a lock-free ring.
+			 - NDI is initialized and destroyed by ofxNDIruntime, once for
+			   all senders and receivers. Pixels are converted into the buffer
+			   pool shared by all of them. Frames received and conversion time
+			   are counted for the stream statistics. Add GetStreamId.
+			 - The audio flag is atomic. SetAudio clears it while the ring
+			   is allocated so that the audio callback reads silence.
 
 	New functions and changes for 3.5 uodate:
 
@@ -91,7 +123,28 @@
 
 */
 #include "ofxNDIreceive.h"
+#include "ofxNDIframesync.h"
+#include <cmath> // for floor
 
+// Steady clock time for capture latency
+static long long GetClockMicroseconds()
+{
+	return (long long)std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Copy a name to a char buffer of maxsize bytes including the terminating null
+// The name is truncated if the buffer is too small
+static void CopyName(char *dest, int maxsize, const std::string &name)
+{
+	if (!dest || maxsize <= 0)
+		return;
+	size_t n = name.size();
+	if (n > (size_t)maxsize - 1)
+		n = (size_t)maxsize - 1;
+	memcpy(dest, name.c_str(), n);
+	dest[n] = 0;
+}
 
 ofxNDIreceive::ofxNDIreceive()
 {
@@ -108,32 +161,49 @@ ofxNDIreceive::ofxNDIreceive()
 	m_Height = 0;
 	senderIndex = 0;
 	senderName = "";
+	m_bMetadata = false;
+
+	// Capture thread
+	m_bCaptureThread = false;
+	m_bCaptureOldest = false;
+	m_bCaptureQuit = false;
+	m_nQueueFrames = 3;
+	m_nDroppedFrames = 0;
+	m_captureLatency = 0.0;
+	m_bThreadMetadata = false;
 	
 	// For received frame fps calculations
 	frameTime = 0.0;
 	fps = frameRate = 1.0; // starting value
-	startTime = lastTime = (double)timeGetTime();
+	startTime = lastTime = 0.0;
+	CounterStart = std::chrono::steady_clock::now();
 
 	m_bandWidth = NDIlib_recv_bandwidth_highest;
+	m_OutputFormat = ofxNDIutils::FORMAT_RGBA;
+	m_bNativeFormat = false;
+	m_pixelPool = ofxNDIruntime::GetBufferPool();
+	m_frameSync.reset(new ofxNDIframesync);
+	m_bFrameSync = false;
+	m_bAudio = false;
 
-	if(!NDIlib_is_supported_CPU() ) {
-		std::cout << "CPU does not support NDI NDILib requires SSE4.1 NDIreceiver" << std::endl;
-	}
-	else {
-		bNDIinitialized = NDIlib_initialize();
-		if(!bNDIinitialized) {
-			std::cout << "Cannot run NDI - NDILib initialization failed" << std::endl;
-		}
-
-	}
+	// NDI is initialized for the first sender or receiver
+	bNDIinitialized = ofxNDIruntime::Acquire();
+	m_streamId = ofxNDIruntime::AddStream(false);
 
 }
 
 ofxNDIreceive::~ofxNDIreceive()
 {
-	if(pNDI_recv) NDIlib_recv_destroy(pNDI_recv);
+	StopCaptureThread();
+	m_frameSync->Clear();
+	m_syncFrame.reset();
+	FreeVideoData();
+	m_recvHandle.reset();
 	if(pNDI_find) NDIlib_find_destroy(pNDI_find);
-	if(bNDIinitialized)	NDIlib_destroy();
+	// Pixels still held by received frames are freed when they are released
+	m_pixelPool->RemoveOwner(this);
+	ofxNDIruntime::RemoveStream(m_streamId);
+	if(bNDIinitialized)	ofxNDIruntime::Release();
 }
 
 // Create a finder to look for a sources on the network
@@ -142,7 +212,7 @@ void ofxNDIreceive::CreateFinder()
 	if(!bNDIinitialized) return;
 
 	if(pNDI_find) NDIlib_find_destroy(pNDI_find);
-	const NDIlib_find_create_t NDI_find_create_desc = { TRUE, NULL, NULL }; // Version 2
+	const NDIlib_find_create_t NDI_find_create_desc = { true, NULL, NULL }; // Version 2
 	// pNDI_find = NDIlib_find_create2(&NDI_find_create_desc);
 	// Vers 3
 	pNDI_find = NDIlib_find_create_v2(&NDI_find_create_desc);
@@ -261,12 +331,12 @@ int ofxNDIreceive::RefreshSenders(uint32_t timeout)
 	// Give it a timeout in case of connection trouble.
 	if(pNDI_find) {
 
-		dwStartTime = timeGetTime();
-		dwElapsedTime = 0;
+		uint32_t startWait = GetMilliseconds();
+		uint32_t elapsedWait = 0;
 		do {
 			p_sources = NDIlib_find_get_current_sources(pNDI_find, &nsources);
-			dwElapsedTime = timeGetTime() - dwStartTime;
-		} while(nsources == 0 && (uint32_t)dwElapsedTime < timeout);
+			elapsedWait = GetMilliseconds() - startWait;
+		} while(nsources == 0 && elapsedWait < timeout);
 		return nsources;
 
 	}
@@ -359,7 +429,7 @@ bool ofxNDIreceive::GetSenderName(char *sendername, int maxsize, int userindex)
 	if (userindex < 0) {
 		// If there is an existing name, return it
 		if (!senderName.empty()) {
-			strcpy_s(sendername, maxsize, senderName.c_str());
+			CopyName(sendername, maxsize, senderName);
 			return true;
 		}
 		// Otherwise use the existing index
@@ -370,7 +440,7 @@ bool ofxNDIreceive::GetSenderName(char *sendername, int maxsize, int userindex)
 		&& (unsigned int)index < NDIsenders.size()
 		&& !NDIsenders.empty()
 		&& NDIsenders.at(index).size() > 0) {
-		strcpy_s(sendername, maxsize, NDIsenders.at(index).c_str());
+		CopyName(sendername, maxsize, NDIsenders.at(index));
 		return true;
 	}
 
@@ -450,6 +520,40 @@ void ofxNDIreceive::SetLowBandwidth(bool bLow)
 
 }
 
+// Set the pixel format of ReceiveImage to a buffer
+bool ofxNDIreceive::SetOutputFormat(ofxNDIutils::PixelFormat format)
+{
+	switch (format) {
+	case ofxNDIutils::FORMAT_RGBA:
+	case ofxNDIutils::FORMAT_BGRA:
+	case ofxNDIutils::FORMAT_NV12:
+	case ofxNDIutils::FORMAT_I420:
+		m_OutputFormat = format;
+		return true;
+	default:
+		printf("SetOutputFormat : format %d not supported\n", (int)format);
+		return false;
+	}
+}
+
+// Return the pixel format of ReceiveImage to a buffer
+ofxNDIutils::PixelFormat ofxNDIreceive::GetOutputFormat()
+{
+	return m_OutputFormat;
+}
+
+// Receive in the native format with CreateReceiver(index)
+void ofxNDIreceive::SetNativeFormat(bool bNative)
+{
+	m_bNativeFormat = bNative;
+}
+
+// Return whether CreateReceiver(index) receives the native format
+bool ofxNDIreceive::GetNativeFormat()
+{
+	return m_bNativeFormat;
+}
+
 // Return the received frame type
 NDIlib_frame_type_e ofxNDIreceive::GetFrameType()
 {
@@ -468,9 +572,11 @@ std::string ofxNDIreceive::GetMetadataString()
 	return m_metadataString;
 }
 
-// Create an RGBA receiver
+// Create a receiver for RGBA, or the native format if set
 bool ofxNDIreceive::CreateReceiver(int userindex)
 {
+	if (m_bNativeFormat)
+		return CreateReceiver(NDIlib_recv_color_format_fastest, userindex);
 	return CreateReceiver(NDIlib_recv_color_format_e_RGBX_RGBA, userindex);
 }
 
@@ -478,7 +584,6 @@ bool ofxNDIreceive::CreateReceiver(int userindex)
 bool ofxNDIreceive::CreateReceiver(NDIlib_recv_color_format_e colorFormat , int userindex)
 {
 	std::string name;
-	int nsources = 0;
 
 	if (!bNDIinitialized) 
 		return false;
@@ -494,11 +599,12 @@ bool ofxNDIreceive::CreateReceiver(NDIlib_recv_color_format_e colorFormat , int
 		// again to get a pointer to the selected sender.
 		// Give it a timeout in case of connection trouble.
 		if (pNDI_find) {
-			dwStartTime = timeGetTime();
+			uint32_t startWait = GetMilliseconds();
+			uint32_t elapsedWait = 0;
 			do {
 				p_sources = NDIlib_find_get_current_sources(pNDI_find, &no_sources);
-				dwElapsedTime = timeGetTime() - dwStartTime;
-			} while (no_sources == 0 && dwElapsedTime < 4000);
+				elapsedWait = GetMilliseconds() - startWait;
+			} while (no_sources == 0 && elapsedWait < 4000);
 		}
 
 		if (p_sources && no_sources > 0) {
@@ -532,7 +638,7 @@ bool ofxNDIreceive::CreateReceiver(NDIlib_recv_color_format_e colorFormat , int
 				p_sources[index],
 				colorFormat,
 				m_bandWidth, // Changed by SetLowBandwidth, default NDIlib_recv_bandwidth_highest
-				FALSE }; // TRUE }; // allow_video_fields FALSE : TODO - test
+				false }; // true }; // allow_video_fields false : TODO - test
 
 			// Create the receiver
 			// Deprecated version sets bandwidth to highest and allow fields to true.
@@ -546,8 +652,12 @@ bool ofxNDIreceive::CreateReceiver(NDIlib_recv_color_format_e colorFormat , int
 				return false;
 			}
 
+			// Shared with received frames that are still held
+			m_recvHandle.reset(pNDI_recv, NDIlib_recv_destroy);
+
 			// Reset the current sender name
 			senderName = NDIsenders.at(index);
+			ofxNDIruntime::SetStreamName(m_streamId, senderName);
 
 			// Reset the sender index
 			senderIndex = index;
@@ -556,9 +666,12 @@ bool ofxNDIreceive::CreateReceiver(NDIlib_recv_color_format_e colorFormat , int
 			StartCounter();
 
 			// on_program = TRUE, on_preview = FALSE
-			const NDIlib_tally_t tally_state = { TRUE, FALSE };
+			const NDIlib_tally_t tally_state = { true, false };
 			NDIlib_recv_set_tally(pNDI_recv, &tally_state);
 
+			// Start capturing if a capture thread is used
+			StartCaptureThread();
+
 			// Set class flag that a receiver has been created
 			bReceiverCreated = true;
 
@@ -581,8 +694,14 @@ void ofxNDIreceive::ReleaseReceiver()
 {
 	if(!bNDIinitialized) return;
 
-	if(pNDI_recv) 
-		NDIlib_recv_destroy(pNDI_recv);
+	// Stop capture and free frames while the receiver is valid
+	StopCaptureThread();
+	m_frameSync->Clear();
+	m_syncFrame.reset();
+	FreeVideoData();
+
+	// Destroyed now or when the last received frame is released
+	m_recvHandle.reset();
 
 	m_Width = 0;
 	m_Height = 0;
@@ -590,21 +709,24 @@ void ofxNDIreceive::ReleaseReceiver()
 	pNDI_recv = NULL;
 	bReceiverCreated = false;
 	bSenderSelected = false;
-	FreeVideoData();
 
 }
 
-// Receive RGBA image pixels to a buffer
+// Receive RGBA, or SetOutputFormat, image pixels to a buffer
 bool ofxNDIreceive::ReceiveImage(unsigned char *pixels,
 								  unsigned int &width, unsigned int &height, bool bInvert)
 {
 	NDIlib_frame_type_e NDI_frame_type;
-	NDIlib_metadata_frame_t metadata_frame;
+	std::string metadata;
 	m_FrameType = NDIlib_frame_type_none;
 
+	// The frame sync presents the frame for the current time
+	if (m_bFrameSync)
+		return ReceiveSyncImage(pixels, width, height, bInvert);
+
 	if (pNDI_recv) {
 
-		NDI_frame_type = NDIlib_recv_capture_v2(pNDI_recv, &video_frame, NULL, &metadata_frame, 0);
+		NDI_frame_type = CaptureFrame(metadata);
 		
 		// Is no data received or the connection lost ?
 		if (NDI_frame_type == NDIlib_frame_type_none)
@@ -620,9 +742,9 @@ bool ofxNDIreceive::ReceiveImage(unsigned char *pixels,
 
 		// Metadata
 		if (NDI_frame_type == NDIlib_frame_type_metadata) {
-			if (metadata_frame.p_data) {
+			if (!metadata.empty()) {
 				m_bMetadata = true;
-				m_metadataString = metadata_frame.p_data;
+				m_metadataString = metadata;
 				// ReceiveImage will return false
 				// Use IsMetadata() to determine whether metadata has been received
 			}
@@ -633,7 +755,7 @@ bool ofxNDIreceive::ReceiveImage(unsigned char *pixels,
 				m_metadataString.clear();
 		}
 
-		// TODO - receive Audio
+		// Audio is received on the capture thread (SetAudio)
 
 		if (video_frame.p_data && NDI_frame_type == NDIlib_frame_type_video) {
 
@@ -653,36 +775,19 @@ bool ofxNDIreceive::ReceiveImage(unsigned char *pixels,
 			// Otherwise sizes are current - copy the received frame data to the local buffer
 			if (video_frame.p_data && (uint8_t*)pixels) {
 
-				// Video frame type
-				switch (video_frame.FourCC) {
-
-				// Note :
-				// The receiver is set up to prefer RGBA format
-				// so other formats should be converted to RGBA by the API
-				// and the conversion functions never used.
-				// They are here as a backup only.
-				
-				// NDIlib_FourCC_type_UYVA not supported
-				// Alpha copied as received
-				case NDIlib_FourCC_type_UYVY: // YCbCr color space
-					ofxNDIutils::YUV422_to_RGBA((const unsigned char *)video_frame.p_data, pixels, m_Width, m_Height, (unsigned int)video_frame.line_stride_in_bytes);
-					break;
-
-				case NDIlib_FourCC_type_BGRA: // BGRA
-				case NDIlib_FourCC_type_BGRX: // BGRX
-					ofxNDIutils::CopyImage((const unsigned char *)video_frame.p_data, pixels, m_Width, m_Height, (unsigned int)video_frame.line_stride_in_bytes, true, bInvert);
-					break;
-
-				case NDIlib_FourCC_type_RGBA: // RGBA
-				case NDIlib_FourCC_type_RGBX: // RGBX
-				default: // RGBA
-					ofxNDIutils::CopyImage((const unsigned char *)video_frame.p_data, pixels, m_Width, m_Height, (unsigned int)video_frame.line_stride_in_bytes, false, bInvert);
-					break;
-
-				} // end switch received format
+				// 16 bit frames convert to RGBA formats only
+				if (ofxNDI_IsHighBitDepth(video_frame.FourCC)
+					&& m_OutputFormat != ofxNDIutils::FORMAT_RGBA && m_OutputFormat != ofxNDIutils::FORMAT_BGRA) {
+					FreeVideoData();
+					return false;
+				}
+
+				// A single pass including invert.
+				// UYVY converts to NV12 and I420 without an RGBA intermediate.
+				ConvertVideo(video_frame, pixels, m_OutputFormat, bInvert);
 
 				// Buffers captured must be freed
-				NDIlib_recv_free_video_v2(pNDI_recv, &video_frame);
+				FreeVideoData();
 
 				// The caller always checks the received dimensions
 				width = m_Width;
@@ -710,12 +815,12 @@ bool ofxNDIreceive::ReceiveImage(unsigned char *pixels,
 bool ofxNDIreceive::ReceiveImage(unsigned int &width, unsigned int &height)
 {
 	NDIlib_frame_type_e NDI_frame_type;
-	NDIlib_metadata_frame_t metadata_frame;
+	std::string metadata;
 	m_FrameType = NDIlib_frame_type_none;
 
 	if (pNDI_recv) {
 
-		NDI_frame_type = NDIlib_recv_capture_v2(pNDI_recv, &video_frame, NULL, &metadata_frame, 0);
+		NDI_frame_type = CaptureFrame(metadata);
 
 		// Is no data received or the connection lost ?
 		if (NDI_frame_type == NDIlib_frame_type_none)
@@ -731,9 +836,9 @@ bool ofxNDIreceive::ReceiveImage(unsigned int &width, unsigned int &height)
 
 		// Metadata
 		if (NDI_frame_type == NDIlib_frame_type_metadata) {
-			if (metadata_frame.p_data) {
+			if (!metadata.empty()) {
 				m_bMetadata = true;
-				m_metadataString = metadata_frame.p_data;
+				m_metadataString = metadata;
 				// ReceiveImage will return false
 				// Use IsMetadata() to determine whether metadata has been received
 			}
@@ -749,6 +854,8 @@ bool ofxNDIreceive::ReceiveImage(unsigned int &width, unsigned int &height)
 			if (m_Width != (unsigned int)video_frame.xres || m_Height != (unsigned int)video_frame.yres) {
 				m_Width = (unsigned int)video_frame.xres;
 				m_Height = (unsigned int)video_frame.yres;
+				// Converted pixels of the old size are not used again
+				m_pixelPool->Clear(this);
 			}
 			
 			// Retain the video frame pointer for external access.
@@ -769,6 +876,67 @@ bool ofxNDIreceive::ReceiveImage(unsigned int &width, unsigned int &height)
 	return false;
 }
 
+// Receive 16 bit RGBA image pixels to a buffer
+bool ofxNDIreceive::ReceiveImage16(unsigned short *pixels,
+									unsigned int &width, unsigned int &height,
+									bool bHalfFloat, bool bInvert)
+{
+	unsigned int oldWidth = m_Width;
+	unsigned int oldHeight = m_Height;
+
+	if (!ReceiveImage(width, height))
+		return false;
+
+	// Return for the app to handle changed dimensions as for ReceiveImage
+	if (width != oldWidth || height != oldHeight) {
+		FreeVideoData();
+		return true;
+	}
+
+	if (!pixels || !ofxNDI_IsHighBitDepth(video_frame.FourCC)) {
+		FreeVideoData();
+		return false;
+	}
+
+	ConvertVideo(video_frame, (unsigned char *)pixels,
+		bHalfFloat ? ofxNDIutils::FORMAT_RGBA16F : ofxNDIutils::FORMAT_RGBA16, bInvert);
+	FreeVideoData();
+
+	return true;
+}
+
+// Receive a video frame without copying
+bool ofxNDIreceive::ReceiveFrame(ReceivedFrame &frame)
+{
+	unsigned int width = 0;
+	unsigned int height = 0;
+
+	if (!ReceiveImage(width, height) || !video_frame.p_data)
+		return false;
+
+	// The frame now owns the NDI buffer
+	frame = ReceivedFrame(m_recvHandle, video_frame, m_pixelPool, this, m_streamId);
+	video_frame.p_data = NULL;
+
+	return true;
+}
+
+// Receive a video frame without copying to share between consumers
+bool ofxNDIreceive::ReceiveFrame(SharedFrame &frame)
+{
+	// The frame sync presents the frame for the current time
+	if (m_bFrameSync)
+		return ReceiveSyncFrame(frame);
+
+	ReceivedFrame received;
+	if (!ReceiveFrame(received))
+		return false;
+
+	frame = std::make_shared<ReceivedFrame>(std::move(received));
+
+	return true;
+}
+
 // Get the video type received
 NDIlib_FourCC_type_e ofxNDIreceive::GetVideoType()
 {
@@ -785,6 +953,7 @@ unsigned char *ofxNDIreceive::GetVideoData()
 void ofxNDIreceive::FreeVideoData()
 {
 	if (video_frame.p_data) NDIlib_recv_free_video_v2(pNDI_recv, &video_frame);
+	video_frame.p_data = NULL;
 }
 
 // Get NDI dll version number
@@ -799,6 +968,344 @@ double ofxNDIreceive::GetFps()
 	return fps;
 }
 
+// Id of the receiver statistics
+unsigned int ofxNDIreceive::GetStreamId()
+{
+	return m_streamId;
+}
+
+// Capture frames on a separate thread
+void ofxNDIreceive::SetCaptureThread(bool bThreaded, unsigned int nFrames, bool bOldest)
+{
+	if (nFrames < 1) nFrames = 1;
+
+	// Restart an existing thread with the new queue
+	StopCaptureThread();
+
+	m_bCaptureThread = bThreaded;
+	m_nQueueFrames = nFrames;
+	m_bCaptureOldest = bOldest;
+	m_nDroppedFrames = 0;
+	m_captureLatency = 0.0;
+
+	StartCaptureThread();
+}
+
+// Present frames at the render clock
+void ofxNDIreceive::SetFrameSync(bool bSync, unsigned int nFrames, double delay)
+{
+	// Restart capture for the frame sync or the queue
+	StopCaptureThread();
+
+	m_bFrameSync = bSync;
+	m_frameSync->Setup(nFrames, delay);
+	m_syncFrame.reset();
+
+	StartCaptureThread();
+}
+
+// Return whether the frame sync is used
+bool ofxNDIreceive::GetFrameSync()
+{
+	return m_bFrameSync;
+}
+
+// Receive the frame for a presentation time
+bool ofxNDIreceive::ReceiveSyncFrame(SharedFrame &frame, long long presentTime)
+{
+	if (!m_bFrameSync || !pNDI_recv)
+		return false;
+
+	if (!m_frameSync->GetVideo(frame, presentTime))
+		return false;
+
+	m_FrameType = NDIlib_frame_type_video;
+
+	// Count new frames only for the received fps
+	if (frame != m_syncFrame) {
+		m_syncFrame = frame;
+		UpdateFps();
+	}
+
+	return true;
+}
+
+// Receive audio resampled to the render clock
+int ofxNDIreceive::ReceiveSyncAudio(float *data, int nSamples, int nChannels, int sampleRate)
+{
+	return m_frameSync->GetAudio(data, nSamples, nChannels, sampleRate);
+}
+
+// Frames dropped by the frame sync
+unsigned int ofxNDIreceive::GetSyncDroppedFrames()
+{
+	return m_frameSync->GetDroppedFrames();
+}
+
+// Frames presented again by the frame sync
+unsigned int ofxNDIreceive::GetSyncRepeatedFrames()
+{
+	return m_frameSync->GetRepeatedFrames();
+}
+
+// Audio reads short of samples
+unsigned int ofxNDIreceive::GetSyncAudioUnderruns()
+{
+	return m_frameSync->GetAudioUnderruns();
+}
+
+// Frame sync delay in milliseconds
+double ofxNDIreceive::GetSyncDelay()
+{
+	return m_frameSync->GetDelay();
+}
+
+// Receive audio for ReceiveAudio
+void ofxNDIreceive::SetAudio(bool bAudio, int nChannels, unsigned int nSamples)
+{
+	// Restart capture with audio or without
+	StopCaptureThread();
+
+	// The audio callback reads silence while the ring is allocated
+	m_bAudio = false;
+	if (bAudio) {
+		m_audioRing.Allocate(nSamples, nChannels);
+		m_bAudio = true;
+	}
+
+	StartCaptureThread();
+}
+
+// Return whether audio is received
+bool ofxNDIreceive::GetAudio()
+{
+	return m_bAudio;
+}
+
+// Read received audio - audio callback
+int ofxNDIreceive::ReceiveAudio(float *data, int nSamples)
+{
+	if (!data || nSamples <= 0)
+		return 0;
+
+	if (!m_bAudio) {
+		memset(data, 0, (size_t)nSamples*m_audioRing.GetChannels()*sizeof(float));
+		return 0;
+	}
+
+	return (int)m_audioRing.Read(data, (unsigned int)nSamples);
+}
+
+// Channels read by ReceiveAudio
+int ofxNDIreceive::GetAudioChannels()
+{
+	return m_audioRing.GetChannels();
+}
+
+// Sample rate of the received audio
+int ofxNDIreceive::GetAudioSampleRate()
+{
+	return m_audioRing.GetSampleRate();
+}
+
+// Samples per channel waiting
+unsigned int ofxNDIreceive::GetAudioAvailable()
+{
+	return m_audioRing.Available();
+}
+
+// Reads short of received samples
+unsigned int ofxNDIreceive::GetAudioUnderruns()
+{
+	return m_audioRing.GetUnderruns();
+}
+
+// Received audio frames that did not fit
+unsigned int ofxNDIreceive::GetAudioOverruns()
+{
+	return m_audioRing.GetOverruns();
+}
+
+// Return whether a capture thread is used
+bool ofxNDIreceive::GetCaptureThread()
+{
+	return m_bCaptureThread;
+}
+
+// Number of frames dropped or skipped
+unsigned int ofxNDIreceive::GetDroppedFrames()
+{
+	return m_nDroppedFrames;
+}
+
+// Number of frames waiting in the queue
+unsigned int ofxNDIreceive::GetQueueDepth()
+{
+	return m_frameQueue.Size();
+}
+
+// Time from capture to receive in milliseconds
+double ofxNDIreceive::GetCaptureLatency()
+{
+	return m_captureLatency;
+}
+
+//
+// ReceivedFrame
+//
+
+// Pixels converted by GetPixels, leased from the receiver pool.
+// The lock makes the first consumer convert and the others wait for it.
+struct ofxNDIreceive::ReceivedFrame::Conversion {
+	std::mutex mutex;
+	std::shared_ptr<ofxNDIbufferpool> pool;
+	const void *owner; // Receiver leasing from the pool
+	unsigned int stream; // Receiver statistics
+	const unsigned char *pixels[2]; // RGBA, BGRA
+};
+
+ofxNDIreceive::ReceivedFrame::ReceivedFrame()
+{
+	m_frame = NDIlib_video_frame_v2_t();
+	m_frame.p_data = NULL;
+}
+
+ofxNDIreceive::ReceivedFrame::ReceivedFrame(const std::shared_ptr<void> &receiver, const NDIlib_video_frame_v2_t &frame,
+	const std::shared_ptr<ofxNDIbufferpool> &pool, const void *owner, unsigned int stream)
+	: m_receiver(receiver), m_frame(frame), m_conversion(new Conversion)
+{
+	m_conversion->pool = pool;
+	m_conversion->owner = owner;
+	m_conversion->stream = stream;
+	m_conversion->pixels[0] = NULL;
+	m_conversion->pixels[1] = NULL;
+}
+
+ofxNDIreceive::ReceivedFrame::~ReceivedFrame()
+{
+	Release();
+}
+
+ofxNDIreceive::ReceivedFrame::ReceivedFrame(ReceivedFrame &&other)
+	: m_receiver(std::move(other.m_receiver)), m_frame(other.m_frame), m_conversion(std::move(other.m_conversion))
+{
+	other.m_frame.p_data = NULL;
+}
+
+ofxNDIreceive::ReceivedFrame &ofxNDIreceive::ReceivedFrame::operator=(ReceivedFrame &&other)
+{
+	if (this != &other) {
+		Release();
+		m_receiver = std::move(other.m_receiver);
+		m_frame = other.m_frame;
+		m_conversion = std::move(other.m_conversion);
+		other.m_frame.p_data = NULL;
+	}
+	return *this;
+}
+
+// Free the frame, its converted pixels and the receiver reference
+void ofxNDIreceive::ReceivedFrame::Release()
+{
+	if (m_frame.p_data && m_receiver)
+		NDIlib_recv_free_video_v2(m_receiver.get(), &m_frame);
+	m_frame.p_data = NULL;
+	m_receiver.reset();
+	if (m_conversion) {
+		m_conversion->pool->Return(m_conversion->pixels[0]);
+		m_conversion->pool->Return(m_conversion->pixels[1]);
+		m_conversion.reset();
+	}
+}
+
+bool ofxNDIreceive::ReceivedFrame::IsValid() const
+{
+	return (m_frame.p_data != NULL);
+}
+
+const unsigned char *ofxNDIreceive::ReceivedFrame::GetData() const
+{
+	return m_frame.p_data;
+}
+
+unsigned int ofxNDIreceive::ReceivedFrame::GetWidth() const
+{
+	return m_frame.p_data ? (unsigned int)m_frame.xres : 0;
+}
+
+unsigned int ofxNDIreceive::ReceivedFrame::GetHeight() const
+{
+	return m_frame.p_data ? (unsigned int)m_frame.yres : 0;
+}
+
+unsigned int ofxNDIreceive::ReceivedFrame::GetStride() const
+{
+	return m_frame.p_data ? (unsigned int)m_frame.line_stride_in_bytes : 0;
+}
+
+NDIlib_FourCC_type_e ofxNDIreceive::ReceivedFrame::GetFourCC() const
+{
+	return m_frame.FourCC;
+}
+
+void ofxNDIreceive::ReceivedFrame::GetFrameRate(int &framerate_N, int &framerate_D) const
+{
+	framerate_N = m_frame.frame_rate_N;
+	framerate_D = m_frame.frame_rate_D;
+}
+
+int64_t ofxNDIreceive::ReceivedFrame::GetTimecode() const
+{
+	return m_frame.timecode;
+}
+
+int64_t ofxNDIreceive::ReceivedFrame::GetTimestamp() const
+{
+	return m_frame.timestamp;
+}
+
+const char *ofxNDIreceive::ReceivedFrame::GetMetadata() const
+{
+	return m_frame.p_data ? m_frame.p_metadata : NULL;
+}
+
+const NDIlib_video_frame_v2_t &ofxNDIreceive::ReceivedFrame::GetVideoFrame() const
+{
+	return m_frame;
+}
+
+// RGBA or BGRA pixels, converted once on first use
+const unsigned char *ofxNDIreceive::ReceivedFrame::GetPixels(ofxNDIutils::PixelFormat format) const
+{
+	if (!m_frame.p_data || !m_conversion)
+		return NULL;
+
+	if (format != ofxNDIutils::FORMAT_RGBA && format != ofxNDIutils::FORMAT_BGRA)
+		return NULL;
+
+	unsigned int width = (unsigned int)m_frame.xres;
+	unsigned int height = (unsigned int)m_frame.yres;
+
+	// Already in the format requested
+	NDIlib_FourCC_type_e fourcc = (format == ofxNDIutils::FORMAT_RGBA) ? NDIlib_FourCC_type_RGBA : NDIlib_FourCC_type_BGRA;
+	if (m_frame.FourCC == fourcc && m_frame.line_stride_in_bytes == (int)(width * 4))
+		return m_frame.p_data;
+
+	std::lock_guard<std::mutex> lock(m_conversion->mutex);
+	const unsigned char *&pixels = m_conversion->pixels[format == ofxNDIutils::FORMAT_BGRA ? 1 : 0];
+	if (!pixels) {
+		unsigned char *buffer = m_conversion->pool->Lease((size_t)width*height * 4, m_conversion->owner);
+		if (!buffer)
+			return NULL;
+		long long start = GetClockMicroseconds();
+		ConvertFrame(m_frame, buffer, format, false);
+		ofxNDIruntime::AddStreamTime(m_conversion->stream, GetClockMicroseconds() - start);
+		pixels = buffer;
+	}
+
+	return pixels;
+}
+
 //
 // Private functions
 //
@@ -824,12 +1331,278 @@ const NDIlib_source_t* ofxNDIreceive::FindGetSources(NDIlib_find_instance_t p_in
 
 }
 
+// Get the next frame from NDI or from the capture thread queue
+NDIlib_frame_type_e ofxNDIreceive::CaptureFrame(std::string &metadata)
+{
+	if (m_captureThread.joinable()) {
+		// Metadata first so that it is not held up by queued video
+		{
+			std::lock_guard<std::mutex> lock(m_metadataMutex);
+			if (m_bThreadMetadata) {
+				metadata.swap(m_threadMetadata);
+				m_threadMetadata.clear();
+				m_bThreadMetadata = false;
+				return NDIlib_frame_type_metadata;
+			}
+		}
+		if (PopFrame())
+			return NDIlib_frame_type_video;
+		return NDIlib_frame_type_none;
+	}
+
+	NDIlib_metadata_frame_t metadata_frame;
+	NDIlib_frame_type_e NDI_frame_type = NDIlib_recv_capture_v2(pNDI_recv, &video_frame, NULL, &metadata_frame, 0);
+	if (NDI_frame_type == NDIlib_frame_type_video && video_frame.p_data)
+		ofxNDIruntime::AddStreamFrame(m_streamId, ofxNDIruntime::GetFrameBytes(video_frame));
+	if (NDI_frame_type == NDIlib_frame_type_metadata) {
+		if (metadata_frame.p_data)
+			metadata = metadata_frame.p_data;
+		NDIlib_recv_free_metadata(pNDI_recv, &metadata_frame);
+	}
+
+	return NDI_frame_type;
+}
+
+// Take a frame from the capture thread queue into the video frame
+// The newest frame is taken unless the oldest is requested
+bool ofxNDIreceive::PopFrame()
+{
+	QueuedFrame queued;
+	if (!m_frameQueue.Pop(queued))
+		return false;
+
+	if (!m_bCaptureOldest) {
+		QueuedFrame newer;
+		while (m_frameQueue.Pop(newer)) {
+			NDIlib_recv_free_video_v2(pNDI_recv, &queued.frame);
+			m_nDroppedFrames++;
+			queued = newer;
+		}
+	}
+
+	// Free a frame that was not freed by the caller
+	FreeVideoData();
+	video_frame = queued.frame;
+
+	// Capture to receive time, damped in the same way as fps
+	double latency = (double)(GetClockMicroseconds() - queued.captureTime) / 1000.0;
+	if (m_captureLatency <= 0.0)
+		m_captureLatency = latency;
+	else
+		m_captureLatency = m_captureLatency*0.95 + latency*0.05;
+
+	return true;
+}
+
+// Start the capture thread if one is used and the receiver is created
+void ofxNDIreceive::StartCaptureThread()
+{
+	if ((!m_bCaptureThread && !m_bFrameSync && !m_bAudio) || !pNDI_recv || m_captureThread.joinable())
+		return;
+
+	m_frameQueue.Allocate(m_nQueueFrames);
+	m_bCaptureQuit = false;
+	m_captureThread = std::thread(&ofxNDIreceive::CaptureThread, this);
+}
+
+// Stop the capture thread and free queued frames
+void ofxNDIreceive::StopCaptureThread()
+{
+	if (!m_captureThread.joinable())
+		return;
+
+	m_bCaptureQuit = true;
+	m_captureThread.join();
+
+	QueuedFrame queued;
+	while (m_frameQueue.Pop(queued))
+		NDIlib_recv_free_video_v2(pNDI_recv, &queued.frame);
+
+	std::lock_guard<std::mutex> lock(m_metadataMutex);
+	m_threadMetadata.clear();
+	m_bThreadMetadata = false;
+}
+
+// Capture frames into the queue until stopped
+void ofxNDIreceive::CaptureThread()
+{
+	NDIlib_video_frame_v2_t frame;
+	NDIlib_audio_frame_v2_t audio_frame;
+	NDIlib_metadata_frame_t metadata_frame;
+
+	// Audio is received for the frame sync and for ReceiveAudio
+	NDIlib_audio_frame_v2_t *p_audio = (m_bFrameSync || m_bAudio) ? &audio_frame : NULL;
+
+	while (!m_bCaptureQuit) {
+
+		// Wait for a frame with a timeout so that the thread can quit
+		switch (NDIlib_recv_capture_v2(pNDI_recv, &frame, p_audio, &metadata_frame, 100)) {
+
+			case NDIlib_frame_type_video:
+				if (frame.p_data)
+					ofxNDIruntime::AddStreamFrame(m_streamId, ofxNDIruntime::GetFrameBytes(frame));
+				if (frame.p_data && m_bFrameSync) {
+					// Held by the frame sync until presented or dropped
+					m_frameSync->AddVideo(std::make_shared<ReceivedFrame>(ReceivedFrame(m_recvHandle, frame, m_pixelPool, this, m_streamId)),
+						ofxNDIframesync::GetClock());
+				}
+				else if (frame.p_data) {
+					QueuedFrame queued;
+					queued.frame = frame;
+					queued.captureTime = GetClockMicroseconds();
+					if (!m_frameQueue.Push(queued)) {
+						// The receiver is not keeping up
+						NDIlib_recv_free_video_v2(pNDI_recv, &frame);
+						m_nDroppedFrames++;
+					}
+				}
+				break;
+
+			case NDIlib_frame_type_metadata:
+				if (metadata_frame.p_data) {
+					std::lock_guard<std::mutex> lock(m_metadataMutex);
+					m_threadMetadata = metadata_frame.p_data;
+					m_bThreadMetadata = true;
+				}
+				NDIlib_recv_free_metadata(pNDI_recv, &metadata_frame);
+				break;
+
+			case NDIlib_frame_type_audio:
+				if (m_bFrameSync)
+					m_frameSync->AddAudio(audio_frame);
+				if (m_bAudio && audio_frame.p_data && audio_frame.no_samples > 0)
+					m_audioRing.Write(audio_frame.p_data, (unsigned int)audio_frame.no_samples,
+						audio_frame.no_channels, audio_frame.channel_stride_in_bytes, audio_frame.sample_rate);
+				NDIlib_recv_free_audio_v2(pNDI_recv, &audio_frame);
+				break;
+
+			case NDIlib_frame_type_error:
+				// Connection lost - try again shortly
+				std::this_thread::sleep_for(std::chrono::milliseconds(10));
+				break;
+
+			default:
+				break;
+		}
+	}
+}
+
+// Receive the frame sync frame for the current time to a buffer
+bool ofxNDIreceive::ReceiveSyncImage(unsigned char *pixels, unsigned int &width, unsigned int &height, bool bInvert)
+{
+	// Metadata is received from the capture thread
+	std::string metadata;
+	if (pNDI_recv && CaptureFrame(metadata) == NDIlib_frame_type_metadata) {
+		m_FrameType = NDIlib_frame_type_metadata;
+		m_bMetadata = true;
+		m_metadataString = metadata;
+		return false;
+	}
+
+	SharedFrame frame;
+	if (!ReceiveSyncFrame(frame))
+		return false;
+
+	const NDIlib_video_frame_v2_t &video = frame->GetVideoFrame();
+
+	// Return for the app to handle changed dimensions
+	if (m_Width != (unsigned int)video.xres || m_Height != (unsigned int)video.yres) {
+		m_Width = (unsigned int)video.xres;
+		m_Height = (unsigned int)video.yres;
+		width = m_Width;
+		height = m_Height;
+		return true;
+	}
+
+	if (!pixels)
+		return false;
+
+	// 16 bit frames convert to RGBA formats only
+	if (ofxNDI_IsHighBitDepth(video.FourCC)
+		&& m_OutputFormat != ofxNDIutils::FORMAT_RGBA && m_OutputFormat != ofxNDIutils::FORMAT_BGRA)
+		return false;
+
+	ConvertVideo(video, pixels, m_OutputFormat, bInvert);
+	width = m_Width;
+	height = m_Height;
+
+	return true;
+}
+
+// Convert a video frame and count the time for the stream statistics
+void ofxNDIreceive::ConvertVideo(const NDIlib_video_frame_v2_t &frame, unsigned char *pixels,
+	ofxNDIutils::PixelFormat destFormat, bool bInvert)
+{
+	long long start = GetClockMicroseconds();
+	ConvertFrame(frame, pixels, destFormat, bInvert);
+	ofxNDIruntime::AddStreamTime(m_streamId, GetClockMicroseconds() - start);
+}
+
+// Convert a video frame to packed RGBA pixels or destFormat
+// The frame line stride is used and the pixels are packed
+void ofxNDIreceive::ConvertFrame(const NDIlib_video_frame_v2_t &frame, unsigned char *pixels,
+	ofxNDIutils::PixelFormat destFormat, bool bInvert)
+{
+	ofxNDIutils::PixelFormat format = ofxNDIutils::FORMAT_RGBA;
+	bool bAlphaFill = false;
+
+	// Video frame type
+	switch (frame.FourCC) {
+
+	case NDIlib_FourCC_type_UYVY: // YCbCr color space
+		format = ofxNDIutils::FORMAT_UYVY;
+		break;
+
+	case NDIlib_FourCC_type_UYVA: // YCbCr and alpha
+		format = ofxNDIutils::FORMAT_UYVA;
+		break;
+
+	case ofxNDI_FourCC_type_P216: // 16 bit YCbCr
+		format = ofxNDIutils::FORMAT_P216;
+		break;
+
+	case ofxNDI_FourCC_type_PA16: // 16 bit YCbCr and alpha
+		format = ofxNDIutils::FORMAT_PA16;
+		break;
+
+	case NDIlib_FourCC_type_BGRA: // BGRA
+		format = ofxNDIutils::FORMAT_BGRA;
+		break;
+
+	case NDIlib_FourCC_type_BGRX: // BGRX - alpha is undefined
+		format = ofxNDIutils::FORMAT_BGRA;
+		bAlphaFill = true;
+		break;
+
+	case NDIlib_FourCC_type_RGBX: // RGBX
+		bAlphaFill = true;
+		break;
+
+	case NDIlib_FourCC_type_RGBA: // RGBA
+	default: // RGBA
+		break;
+
+	} // end switch received format
+
+	unsigned int width = (unsigned int)frame.xres;
+	unsigned int height = (unsigned int)frame.yres;
+	const unsigned char *source = (const unsigned char *)frame.p_data;
+	int stride = frame.line_stride_in_bytes;
+	if (stride < 0) {
+		// A bottom-up frame from its last line.
+		// Read it top down from the first line in memory and invert.
+		source += (ptrdiff_t)stride * (int)(height - 1);
+		stride = -stride;
+		bInvert = !bInvert;
+	}
+	ofxNDIutils::ConvertImage(source, (unsigned int)stride, format,
+		pixels, ofxNDIutils::GetLineBytes(destFormat, width), destFormat, width, height,
+		bInvert, bAlphaFill, ofxNDIutils::GetColorMatrix(width, height));
+}
+
 // Received fps is independent of the application draw rate
 void ofxNDIreceive::UpdateFps() {
 
-	unsigned int width = 0;
-	unsigned int height = 0;
-
 	// Calculate received frame fps
 	lastTime = startTime;
 	startTime = GetCounter();
@@ -845,15 +1618,8 @@ void ofxNDIreceive::UpdateFps() {
 
 void ofxNDIreceive::StartCounter()
 {
-	LARGE_INTEGER li;
-	if (!QueryPerformanceFrequency(&li)) {
-		printf("QueryPerformanceFrequency failed!\n");
-		return;
-	}
-
-	PCFreq = double(li.QuadPart) / 1000.0;
-	QueryPerformanceCounter(&li);
-	CounterStart = li.QuadPart;
+	CounterStart = std::chrono::steady_clock::now();
+	startTime = lastTime = 0.0;
 
 	// Reset starting frame rate value
 	fps = frameRate = 1.0;
@@ -861,7 +1627,14 @@ void ofxNDIreceive::StartCounter()
 
 double ofxNDIreceive::GetCounter()
 {
-	LARGE_INTEGER li;
-	QueryPerformanceCounter(&li);
-	return double(li.QuadPart - CounterStart) / PCFreq;
+	return std::chrono::duration<double, std::milli>(
+		std::chrono::steady_clock::now() - CounterStart).count();
+}
+
+// Steady clock msec for timeouts
+// Wraps like timeGetTime, so compare elapsed times only
+uint32_t ofxNDIreceive::GetMilliseconds()
+{
+	return (uint32_t)std::chrono::duration_cast<std::chrono::milliseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
 }
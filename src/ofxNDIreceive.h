@@ -41,6 +41,21 @@
 	11.07.18 - Change class name to ofxReceive
 			   Class can be used independently of Openframeworks
 			   Function additions see ofxReceive.cpp
+	17.10.26 - Add SetCaptureThread and capture queue statistics
+			 - Add ReceivedFrame and ReceiveFrame
+			 - Steady clock timing in place of timeGetTime and QueryPerformanceCounter
+			   for Linux and OSX. Winmm and OpenGL headers no longer needed.
+			 - ReceiveImage converts in a single pass including invert for UYVY
+			 - ReceiveImage converts P216 and PA16. Add ReceiveImage16
+			 - Add SetOutputFormat for NV12 and I420 from ReceiveImage
+			 - Add SetNativeFormat - receive in the native format
+			 - Add ReceivedFrame::GetPixels - RGBA converted once when first used
+			 - Add SharedFrame and ReceiveFrame for frames shared between consumers
+			 - Add SetFrameSync - frames presented at the render clock (ofxNDIframesync)
+			 - Add SetAudio and ReceiveAudio - received audio for an audio callback
+			 - NDI initialized once for the process and pixels converted into
+			   the shared buffer pool (ofxNDIruntime). Add GetStreamId.
+			 - m_bAudio atomic, read by the capture thread and the audio callback
 
 
 */
@@ -51,23 +66,30 @@
 #if defined(_WIN32)
 #include <windows.h>
 #include <intrin.h> // for _movsd
-#include <gl\GL.h>
-#include <mmsystem.h> // for timegettime if ofMain is included
-#pragma comment(lib, "Winmm.lib") // for timegettime
-#endif
-
-#if defined(__APPLE__)
-#include <x86intrin.h> // for _movsd
-#include <sys/time.h>
+#else
+#include <x86intrin.h> // OSX and Linux
 #endif
 
+#include <stdint.h>
+#include <string.h>
 #include <string>
-#include <iostream>
 #include <vector>
 #include <emmintrin.h> // for SSE2
 #include <iostream> // for cout
+#include <chrono> // for timing
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <memory> // for shared_ptr
 #include "Processing.NDI.Lib.h" // NDI SDK
 #include "ofxNDIutils.h" // buffer copy utilities
+#include "ofxNDIqueue.h" // capture thread frame queue
+#include "ofxNDIformats.h" // P216 and PA16
+#include "ofxNDIbufferpool.h" // converted frame pixels
+#include "ofxNDIruntime.h" // shared NDI library, buffer pool and statistics
+#include "ofxNDIaudioring.h" // received audio
+
+class ofxNDIframesync;
 
 class ofxNDIreceive {
 
@@ -76,7 +98,87 @@ public:
 	ofxNDIreceive();
 	~ofxNDIreceive();
 
-	// Create an RGBA receiver
+	// A received NDI video frame
+	// The frame data is used directly from the NDI buffer
+	// and is freed when the frame is destroyed or released.
+	// Frames can be moved but not copied.
+	// Any number of frames can be held at once
+	// and remain valid after ReleaseReceiver.
+	// They must be released before the ofxNDIreceive object is deleted.
+	// The data is in the format received, UYVY or UYVA by default.
+	// GetPixels converts to RGBA only when it is first asked for.
+	class ReceivedFrame {
+
+	public:
+
+		ReceivedFrame();
+		~ReceivedFrame();
+		ReceivedFrame(ReceivedFrame &&other);
+		ReceivedFrame &operator=(ReceivedFrame &&other);
+		ReceivedFrame(const ReceivedFrame &) = delete;
+		ReceivedFrame &operator=(const ReceivedFrame &) = delete;
+
+		// Free the frame
+		void Release();
+
+		// Whether the frame holds data
+		bool IsValid() const;
+
+		// Frame data
+		const unsigned char *GetData() const;
+
+		// Frame dimensions
+		unsigned int GetWidth() const;
+		unsigned int GetHeight() const;
+
+		// Bytes per line of the frame data
+		unsigned int GetStride() const;
+
+		// Pixel format of the frame data
+		NDIlib_FourCC_type_e GetFourCC() const;
+
+		// Frame rate numerator and denominator
+		void GetFrameRate(int &framerate_N, int &framerate_D) const;
+
+		// Sender timecode in 100ns intervals
+		int64_t GetTimecode() const;
+
+		// Time the frame was submitted by the sender in 100ns intervals
+		// NDIlib_recv_timestamp_undefined if not supported by the sender
+		int64_t GetTimestamp() const;
+
+		// Frame metadata or NULL
+		const char *GetMetadata() const;
+
+		// The NDI video frame
+		const NDIlib_video_frame_v2_t &GetVideoFrame() const;
+
+		// Packed RGBA or BGRA pixels of the frame, width * 4 bytes per line
+		// Other formats are converted on the first call and the pixels
+		// kept with the frame, so that any number of consumers on any
+		// thread share one conversion. A frame that is only passed on
+		// or recorded is never converted.
+		// Frames already in the format requested are returned directly.
+		// - format | FORMAT_RGBA or FORMAT_BGRA
+		// Returns NULL for no frame, other formats or out of memory
+		const unsigned char *GetPixels(ofxNDIutils::PixelFormat format = ofxNDIutils::FORMAT_RGBA) const;
+
+	private:
+
+		friend class ofxNDIreceive;
+		struct Conversion; // Converted pixels and their lock
+		ReceivedFrame(const std::shared_ptr<void> &receiver, const NDIlib_video_frame_v2_t &frame,
+			const std::shared_ptr<ofxNDIbufferpool> &pool, const void *owner, unsigned int stream);
+		std::shared_ptr<void> m_receiver; // Keeps the receiver until the frame is freed
+		NDIlib_video_frame_v2_t m_frame;
+		std::unique_ptr<Conversion> m_conversion;
+
+	};
+
+	// A received frame held by more than one consumer
+	typedef std::shared_ptr<ReceivedFrame> SharedFrame;
+
+	// Create a receiver for RGBA, or the native format (see SetNativeFormat)
 	// - index | index in the sender list to connect to
 	//   -1 - connect to the selected sender
 	//        if none selected connect to the first sender
@@ -84,6 +186,8 @@ public:
 
 	// Create a receiver with preferred colour format
 	// - colorFormat | the preferred format
+	//   ofxNDI_recv_color_format_best receives P216 and PA16
+	//   from high bit depth senders with an NDI 4 runtime
 	// - index | index in the sender list to connect to
 	//   -1 - connect to the selected sender
 	//        if none selected connect to the first sender
@@ -96,6 +200,7 @@ public:
 	void ReleaseReceiver();
 
 	// Receive image pixels to a buffer
+	// The pixels are RGBA or the format set by SetOutputFormat.
 	// - pixel | received pixel data
 	// - width | received image width
 	// - height | received image height
@@ -112,9 +217,31 @@ public:
 	// - height | received image height
 	bool ReceiveImage(unsigned int &width, unsigned int &height);
 
+	// Receive 16 bit RGBA image pixels to a buffer
+	// For P216 and PA16 frames. Other frames are freed and false returned.
+	// - pixels | 4 components per pixel
+	// - width | received image width
+	// - height | received image height
+	// - bHalfFloat | half float 0-1 components rather than 0-65535
+	// - bInvert | flip the image
+	bool ReceiveImage16(unsigned short *pixels,
+		unsigned int &width, unsigned int &height,
+		bool bHalfFloat = false, bool bInvert = false);
+
+	// Receive a video frame without copying
+	// The frame is held until it is released or destroyed,
+	// or replaced by the next frame received into it.
+	// - frame | the received frame
+	bool ReceiveFrame(ReceivedFrame &frame);
+
+	// Receive a video frame without copying to share between consumers
+	// The frame is released when the last consumer releases it.
+	// - frame | the received frame
+	bool ReceiveFrame(SharedFrame &frame);
+
 	// Get the video type received
-	// The receiver should always receive RGBA.
-	// This function is backup only - no error checking.
+	// UYVY or UYVA for a native format receiver, otherwise RGBA, RGBX, BGRA or BGRX.
+	// No error checking.
 	NDIlib_FourCC_type_e GetVideoType();
 
 	// Get a pointer to the current video frame data
@@ -180,6 +307,30 @@ public:
 	// Refer to NDI documentation
 	void SetLowBandwidth(bool bLow = true);
 
+	// Receive in the native format with CreateReceiver(index)
+	// Frames are received as NDI decodes them (UYVY, or UYVA from
+	// senders with alpha) with NDIlib_recv_color_format_fastest.
+	// The NDI runtime does no colour conversion and RGBA is only made
+	// when a consumer needs it. GetVideoData and GetVideoType then give
+	// UYVY or UYVA frames. Initialized false - RGBX_RGBA is received.
+	// Takes effect when the receiver is next created.
+	void SetNativeFormat(bool bNative = true);
+
+	// Return whether CreateReceiver(index) receives the native format
+	bool GetNativeFormat();
+
+	// Set the pixel format of ReceiveImage to a buffer
+	// FORMAT_RGBA (default), FORMAT_BGRA, FORMAT_NV12 or FORMAT_I420
+	// NV12 and I420 are for video encoders. Create the receiver with
+	// NDIlib_recv_color_format_UYVY_RGBA, UYVY_BGRA or fastest so that
+	// UYVY frames are converted directly without an RGBA intermediate.
+	// P216 and PA16 frames are not received to NV12 or I420.
+	// The buffer size is ofxNDIutils::GetImageBytes(format, width, height).
+	bool SetOutputFormat(ofxNDIutils::PixelFormat format);
+
+	// Return the pixel format of ReceiveImage to a buffer
+	ofxNDIutils::PixelFormat GetOutputFormat();
+
 	// Return the received frame type
 	NDIlib_frame_type_e GetFrameType();
 
@@ -196,6 +347,110 @@ public:
 	// The received frame rate
 	double GetFps();
 
+	// Id of the receiver statistics in ofxNDIruntime::GetStreams
+	unsigned int GetStreamId();
+
+	// Capture frames continuously on a separate thread
+	// Frames wait in a queue until taken by ReceiveImage.
+	// If the queue is full, new frames are dropped.
+	// - bThreaded | use a capture thread
+	// - nFrames | maximum number of frames in the queue
+	// - bOldest | receive the oldest frame rather than the newest
+	//   false - older frames are skipped for the lowest latency (default)
+	//   true - every frame is received unless the queue is full
+	void SetCaptureThread(bool bThreaded = true, unsigned int nFrames = 3, bool bOldest = false);
+
+	// Return whether a capture thread is used
+	bool GetCaptureThread();
+
+	// Number of frames dropped because the queue was full
+	// or skipped to receive the newest frame
+	unsigned int GetDroppedFrames();
+
+	// Number of frames waiting in the queue
+	unsigned int GetQueueDepth();
+
+	// Time from capture to receive in milliseconds (averaged)
+	double GetCaptureLatency();
+
+	// Frame sync
+	// Video frames are buffered with their sender time and the one
+	// nearest to the presentation time is received, so that a render
+	// rate different from the sender rate repeats or skips frames
+	// evenly. Audio is received and resampled to the render clock.
+	// ReceiveImage to a buffer and ReceiveFrame for a SharedFrame receive
+	// the frame for the current time. Frames are captured on the capture
+	// thread, which is started whether or not SetCaptureThread is used.
+	// - bSync | use the frame sync
+	// - nFrames | most video frames buffered
+	// - delay | milliseconds from sender time to presentation,
+	//   0 - one and a half frame periods
+	void SetFrameSync(bool bSync = true, unsigned int nFrames = 4, double delay = 0.0);
+
+	// Return whether the frame sync is used
+	bool GetFrameSync();
+
+	// Receive the frame for a presentation time
+	// - frame | the frame nearest to the time, repeated if none is newer
+	// - presentTime | ofxNDIframesync::GetClock time it will be seen, 0 - now
+	bool ReceiveSyncFrame(SharedFrame &frame, long long presentTime = 0);
+
+	// Receive audio resampled to the render clock
+	// - data | nSamples * nChannels interleaved samples
+	// - nChannels | channels required
+	// - sampleRate | render sample rate
+	// Silence is written in place of audio not received.
+	// Returns the number of received samples written
+	int ReceiveSyncAudio(float *data, int nSamples, int nChannels, int sampleRate);
+
+	// Frames dropped by the frame sync without being presented
+	unsigned int GetSyncDroppedFrames();
+
+	// Frames presented again by the frame sync
+	unsigned int GetSyncRepeatedFrames();
+
+	// Audio reads short of samples
+	unsigned int GetSyncAudioUnderruns();
+
+	// Frame sync delay in milliseconds
+	double GetSyncDelay();
+
+	// Receive audio
+	// Audio is received on the capture thread, which is started whether
+	// or not SetCaptureThread is used, and held interleaved for ReceiveAudio.
+	// Call before the audio stream is started. Audio can be
+	// stopped at any time, ReceiveAudio then returns silence.
+	// - bAudio | receive audio
+	// - nChannels | channels read by ReceiveAudio
+	// - nSamples | samples per channel held
+	void SetAudio(bool bAudio = true, int nChannels = 2, unsigned int nSamples = 16384);
+
+	// Return whether audio is received
+	bool GetAudio();
+
+	// Read received audio
+	// Can be called from an audio callback. It does not lock or allocate.
+	// - data | nSamples * GetAudioChannels() interleaved samples
+	// Silence is written in place of audio not received.
+	// Returns the number of received samples read
+	int ReceiveAudio(float *data, int nSamples);
+
+	// Channels read by ReceiveAudio
+	int GetAudioChannels();
+
+	// Sample rate of the received audio, 0 if none
+	// Audio is not resampled, use the frame sync for that.
+	int GetAudioSampleRate();
+
+	// Samples per channel waiting
+	unsigned int GetAudioAvailable();
+
+	// Reads short of received samples
+	unsigned int GetAudioUnderruns();
+
+	// Received audio frames that did not fit
+	unsigned int GetAudioOverruns();
+
 	// ====================================================================
 
 private:
@@ -205,6 +460,7 @@ private:
 	NDIlib_send_create_t NDI_send_create_desc;
 	NDIlib_find_instance_t pNDI_find;
 	NDIlib_recv_instance_t pNDI_recv;
+	std::shared_ptr<void> m_recvHandle; // Destroys the receiver when no frames are held
 	/// NDIlib_video_frame_t video_frame;
 	/// Vers 3
 	NDIlib_video_frame_v2_t video_frame;
@@ -220,26 +476,73 @@ private:
 	bool bReceiverCreated; // Is the receiver reated
 	bool bSenderSelected; // Sender index has been changed by the user
 	NDIlib_recv_bandwidth_e m_bandWidth; // Bandwidth receive option
+	ofxNDIutils::PixelFormat m_OutputFormat; // ReceiveImage buffer format
+	bool m_bNativeFormat; // Receive UYVY or UYVA rather than RGBA
+	std::shared_ptr<ofxNDIbufferpool> m_pixelPool; // Pixels converted by ReceivedFrame::GetPixels, shared
+	unsigned int m_streamId; // ofxNDIruntime statistics
 
-	DWORD dwStartTime; // For timing delay
-	DWORD dwElapsedTime;
+	// Steady clock msec for timing delays
+	static uint32_t GetMilliseconds();
 
 	// For received frame fps calculations
-	double startTime, lastTime, frameTime, frameRate, fps, PCFreq;
-	__int64 CounterStart;
+	double startTime, lastTime, frameTime, frameRate, fps;
+	std::chrono::steady_clock::time_point CounterStart;
 	void StartCounter();
-	double GetCounter();
+	double GetCounter(); // msec since StartCounter
 	void UpdateFps();
 
+	// Convert a video frame to packed RGBA or another format
+	static void ConvertFrame(const NDIlib_video_frame_v2_t &frame, unsigned char *pixels,
+		ofxNDIutils::PixelFormat destFormat, bool bInvert);
+
+	// ConvertFrame with the time counted for the stream statistics
+	void ConvertVideo(const NDIlib_video_frame_v2_t &frame, unsigned char *pixels,
+		ofxNDIutils::PixelFormat destFormat, bool bInvert);
+
 	// Metadata
 	bool m_bMetadata;
 	std::string m_metadataString; // XML message format string NULL terminated
 
+	// Get the next frame from NDI or from the capture thread queue
+	// Metadata received is returned in the string
+	NDIlib_frame_type_e CaptureFrame(std::string &metadata);
+
+	// Capture thread
+	struct QueuedFrame {
+		NDIlib_video_frame_v2_t frame;
+		long long captureTime; // Steady clock microseconds
+	};
+	ofxNDIqueue<QueuedFrame> m_frameQueue;
+	std::thread m_captureThread;
+	std::atomic<bool> m_bCaptureQuit;
+	bool m_bCaptureThread; // Use a capture thread
+	bool m_bCaptureOldest; // Receive the oldest queued frame rather than the newest
+	unsigned int m_nQueueFrames; // Queue size
+	std::atomic<unsigned int> m_nDroppedFrames;
+	double m_captureLatency; // Capture to receive msec
+	std::mutex m_metadataMutex; // Protects the thread metadata
+	std::string m_threadMetadata;
+	bool m_bThreadMetadata; // Metadata waiting
+	void StartCaptureThread();
+	void StopCaptureThread();
+	void CaptureThread();
+	bool PopFrame();
+
+	// Frame sync
+	std::unique_ptr<ofxNDIframesync> m_frameSync;
+	bool m_bFrameSync;
+	SharedFrame m_syncFrame; // Last presented, for fps
+	bool ReceiveSyncImage(unsigned char *pixels, unsigned int &width, unsigned int &height, bool bInvert);
+
+	// Audio
+	ofxNDIaudioring m_audioRing;
+	std::atomic<bool> m_bAudio; // Read by the capture thread and the audio callback
+
 	// Replacement function for deprecated NDIlib_find_get_sources
 	// If no timeout specified, return the sources that exist right now
 	// For a timeout, wait for that timeout and return the sources that exist then
 	// If that fails, return NULL
-	const NDIlib_source_t* ofxNDIreceive::FindGetSources(NDIlib_find_instance_t p_instance,
+	const NDIlib_source_t* FindGetSources(NDIlib_find_instance_t p_instance,
 		uint32_t* p_no_sources,
 		uint32_t timeout_in_ms);
 
@@ -33,6 +33,16 @@
 	16.07.18 - Add GetFrameType
 	06.08.18 - Add receive to ofFbo
 			 - Check for receiver creation in ReceiveImage to unsigned char array
+	17.10.26 - ReceiveImage for fbo, texture, image and pixels use ReceiveFrame
+			   and load the NDI frame directly
+			 - ofPixels are copied rather than pointing to the freed NDI buffer
+			 - Add ReceiveFrame
+			 - Add ReceiveImage for ofShortPixels from P216 and PA16 senders
+			 - Add SetOutputFormat for NV12 and I420 char buffers
+			 - ReceiveImage for fbo, texture, image and pixels converts
+			   native format frames with ReceivedFrame::GetPixels
+			 - Add SetNativeFormat, GetNativeFormat
+			 - Add SetAudio, GetAudio and ReceiveAudio for ofSoundBuffer
 
 	New functions and changes for 3.5 update:
 
@@ -139,29 +149,25 @@ bool ofxNDIreceiver::ReceiveImage(ofFbo &fbo)
 	if (!OpenReceiver())
 		return false;
 
-	unsigned int width = (unsigned int)fbo.getWidth();
-	unsigned int height = (unsigned int)fbo.getHeight();
+	// Receive the NDI frame without a copy
+	// It is freed when it goes out of scope
+	ofxNDIreceive::ReceivedFrame frame;
+	if (NDIreceiver.ReceiveFrame(frame)) {
 
-	// Receive a pixel image first
-	if (NDIreceiver.ReceiveImage(width, height)) {
-
-		// Get the video frame buffer pointer
-		unsigned char *videoData = NDIreceiver.GetVideoData();
-		if (!videoData) {
-			printf("ReceiveTexture : No video data\n");
-			return false;
-		}
+		unsigned int width = frame.GetWidth();
+		unsigned int height = frame.GetHeight();
 
 		// Check for changed sender dimensions
 		// to re-allocate the receiving texture
 		if (width != (unsigned int)fbo.getWidth() || height != (unsigned int)fbo.getHeight())
 			fbo.allocate(width, height, GL_RGBA);
 
-		// Get the NDI frame pixel data into the fbo texture
-		fbo.getTexture().loadData((const unsigned char *)videoData, width, height, GL_RGBA);
-
-		// Free the NDI video buffer
-		NDIreceiver.FreeVideoData();
+		// Get the frame RGBA pixels into the fbo texture
+		// Native format frames are converted here
+		const unsigned char *pixels = frame.GetPixels();
+		if (!pixels)
+			return false;
+		fbo.getTexture().loadData(pixels, width, height, GL_RGBA);
 
 		return true;
 	}
@@ -183,29 +189,24 @@ bool ofxNDIreceiver::ReceiveImage(ofTexture &texture)
 	if (!OpenReceiver())
 		return false;
 
-	unsigned int width = (unsigned int)texture.getWidth();
-	unsigned int height = (unsigned int)texture.getHeight();
+	// Receive the NDI frame without a copy
+	// It is freed when it goes out of scope
+	ofxNDIreceive::ReceivedFrame frame;
+	if (NDIreceiver.ReceiveFrame(frame)) {
 
-	// Receive a pixel image first
-	if (NDIreceiver.ReceiveImage(width, height)) {
-
-		// Get the video frame buffer pointer
-		unsigned char *videoData = NDIreceiver.GetVideoData();
-		if (!videoData) {
-			printf("ReceiveTexture : No video data\n");
-			return false;
-		}
+		unsigned int width = frame.GetWidth();
+		unsigned int height = frame.GetHeight();
 
 		// Check for changed sender dimensions
 		// to re-allocate the receiving texture
 		if (width != (unsigned int)texture.getWidth() || height != (unsigned int)texture.getHeight())
 			texture.allocate(width, height, GL_RGBA);
 
-		// Get the NDI frame pixel data into the texture
-		texture.loadData((const unsigned char *)videoData, width, height, GL_RGBA);
-
-		// Free the NDI video buffer
-		NDIreceiver.FreeVideoData();
+		// Get the frame RGBA pixels into the texture
+		const unsigned char *pixels = frame.GetPixels();
+		if (!pixels)
+			return false;
+		texture.loadData(pixels, width, height, GL_RGBA);
 
 		return true;
 	}
@@ -226,27 +227,24 @@ bool ofxNDIreceiver::ReceiveImage(ofImage &image)
 	if (!OpenReceiver())
 		return false;
 
-	unsigned int width = (unsigned int)image.getWidth();
-	unsigned int height = (unsigned int)image.getHeight();
-
-	// Receive a pixel image first
-	if (NDIreceiver.ReceiveImage(width, height)) {
+	// Receive the NDI frame without a copy
+	// It is freed when it goes out of scope
+	ofxNDIreceive::ReceivedFrame frame;
+	if (NDIreceiver.ReceiveFrame(frame)) {
 
-		// Get the video frame buffer pointer
-		unsigned char *videoData = NDIreceiver.GetVideoData();
-		if (!videoData)
-			return false;
+		unsigned int width = frame.GetWidth();
+		unsigned int height = frame.GetHeight();
 
 		// Check for changed sender dimensions
 		// to re-allocate the receiving image
 		if (width != (unsigned int)image.getWidth() || height != (unsigned int)image.getHeight())
 			image.allocate(width, height, OF_IMAGE_COLOR_ALPHA);
 
-		// Get the NDI frame pixel data into the image texture
-		image.getTexture().loadData((const unsigned char *)videoData, width, height, GL_RGBA);
-
-		// Free the NDI video buffer
-		NDIreceiver.FreeVideoData();
+		// Get the frame RGBA pixels into the image texture
+		const unsigned char *pixels = frame.GetPixels();
+		if (!pixels)
+			return false;
+		image.getTexture().loadData(pixels, width, height, GL_RGBA);
 
 		return true;
 	}
@@ -267,27 +265,24 @@ bool ofxNDIreceiver::ReceiveImage(ofPixels &buffer)
 	if (!OpenReceiver())
 		return false;
 
-	unsigned int width = (unsigned int)buffer.getWidth();
-	unsigned int height = (unsigned int)buffer.getHeight();
-
-	// Receive a pixel image first
-	if (NDIreceiver.ReceiveImage(width, height)) {
+	// Receive the NDI frame without a copy
+	// It is freed when it goes out of scope
+	ofxNDIreceive::ReceivedFrame frame;
+	if (NDIreceiver.ReceiveFrame(frame)) {
 
-		// Get the video frame buffer pointer
-		unsigned char *videoData = NDIreceiver.GetVideoData();
-		if (!videoData)
-			return false;
+		unsigned int width = frame.GetWidth();
+		unsigned int height = frame.GetHeight();
 
 		// Check for changed sender dimensions
 		// to re-allocate the receiving image
 		if (width != (unsigned int)buffer.getWidth() || height != (unsigned int)buffer.getHeight())
 			buffer.allocate(width, height, OF_IMAGE_COLOR_ALPHA);
 
-		// Get the NDI frame pixel data into the pixel buffer
-		buffer.setFromExternalPixels((unsigned char *)videoData, width, height, OF_PIXELS_RGBA);
-
-		// Free the NDI video buffer
-		NDIreceiver.FreeVideoData();
+		// Get the frame RGBA pixels into the pixel buffer
+		const unsigned char *pixels = frame.GetPixels();
+		if (!pixels)
+			return false;
+		buffer.setFromPixels(pixels, width, height, OF_PIXELS_RGBA);
 
 		return true;
 	}
@@ -296,6 +291,43 @@ bool ofxNDIreceiver::ReceiveImage(ofPixels &buffer)
 
 }
 
+// Receive a 16 bit pixel buffer
+// Buffer re-allocated with changed sender dimensions
+bool ofxNDIreceiver::ReceiveImage(ofShortPixels &buffer)
+{
+	if (!buffer.isAllocated())
+		return false;
+
+	if (!OpenReceiver())
+		return false;
+
+	unsigned int width = (unsigned int)buffer.getWidth();
+	unsigned int height = (unsigned int)buffer.getHeight();
+	if (buffer.getImageType() != OF_IMAGE_COLOR_ALPHA)
+		buffer.allocate(width, height, OF_IMAGE_COLOR_ALPHA);
+
+	if (!NDIreceiver.ReceiveImage16(buffer.getData(), width, height))
+		return false;
+
+	// Nothing is received for changed sender dimensions
+	if (width != (unsigned int)buffer.getWidth() || height != (unsigned int)buffer.getHeight()) {
+		buffer.allocate(width, height, OF_IMAGE_COLOR_ALPHA);
+		return false;
+	}
+
+	return true;
+}
+
+// Receive a video frame without copying
+bool ofxNDIreceiver::ReceiveFrame(ofxNDIreceive::ReceivedFrame &frame)
+{
+	// Check for receiver creation
+	if (!OpenReceiver())
+		return false;
+
+	return NDIreceiver.ReceiveFrame(frame);
+}
+
 // Receive image pixels to a char buffer
 // Retained for compatibility with previous version of ofxNDI
 // Return sender width and height
@@ -418,6 +450,53 @@ void ofxNDIreceiver::SetLowBandwidth(bool bLow)
 	NDIreceiver.SetLowBandwidth(bLow);
 }
 
+// Receive in the native format rather than RGBA
+void ofxNDIreceiver::SetNativeFormat(bool bNative)
+{
+	NDIreceiver.SetNativeFormat(bNative);
+}
+
+// Return whether the native format is received
+bool ofxNDIreceiver::GetNativeFormat()
+{
+	return NDIreceiver.GetNativeFormat();
+}
+
+// Set the pixel format of ReceiveImage to a char buffer
+bool ofxNDIreceiver::SetOutputFormat(ofxNDIutils::PixelFormat format)
+{
+	return NDIreceiver.SetOutputFormat(format);
+}
+
+// Return the pixel format of ReceiveImage to a char buffer
+ofxNDIutils::PixelFormat ofxNDIreceiver::GetOutputFormat()
+{
+	return NDIreceiver.GetOutputFormat();
+}
+
+// Receive audio for ReceiveAudio
+void ofxNDIreceiver::SetAudio(bool bAudio, int nChannels)
+{
+	NDIreceiver.SetAudio(bAudio, nChannels);
+}
+
+// Return whether audio is received
+bool ofxNDIreceiver::GetAudio()
+{
+	return NDIreceiver.GetAudio();
+}
+
+// Read received audio into a sound stream buffer
+int ofxNDIreceiver::ReceiveAudio(ofSoundBuffer &buffer)
+{
+	if ((int)buffer.getNumChannels() != NDIreceiver.GetAudioChannels()) {
+		buffer.set(0.0f);
+		return 0;
+	}
+
+	return NDIreceiver.ReceiveAudio(buffer.getBuffer().data(), (int)buffer.getNumFrames());
+}
+
 // Return the received frame type
 NDIlib_frame_type_e ofxNDIreceiver::GetFrameType()
 {
@@ -25,6 +25,11 @@
 	=========================================================================
 
 	08.07.16 - Use ofxNDIreceive class
+	17.10.26 - Add ReceiveFrame
+			 - Add ReceiveImage for ofShortPixels
+			 - Add SetOutputFormat, GetOutputFormat
+			 - Add SetNativeFormat, GetNativeFormat
+			 - Add SetAudio, GetAudio and ReceiveAudio for ofSoundBuffer
 
 
 */
@@ -102,6 +107,17 @@ public:
 	// - buffer re-allocated for changed sender dimensions
 	bool ReceiveImage(ofPixels &pixels);
 
+	// Receive a 16 bit pixel buffer from a P216 or PA16 sender
+	// The receiver must be created with ofxNDI_recv_color_format_best.
+	// - buffer re-allocated for changed sender dimensions
+	bool ReceiveImage(ofShortPixels &pixels);
+
+	// Receive a video frame without copying
+	// The frame data is used directly from the NDI buffer
+	// and freed when the frame is released or destroyed.
+	// - frame | the received frame
+	bool ReceiveFrame(ofxNDIreceive::ReceivedFrame &frame);
+
 	// Receive image pixels to a char buffer
 	// - pixel | received pixel data
 	// - width | received image width
@@ -158,6 +174,34 @@ public:
 	// Set NDI low banwidth option
 	void SetLowBandwidth(bool bLow = true);
 
+	// Receive UYVY or UYVA as decoded by NDI
+	// RGBA is converted once for fbo, texture, image and pixels.
+	// Initialized false - RGBA is received from the NDI runtime.
+	void SetNativeFormat(bool bNative = true);
+
+	// Return whether the native format is received
+	bool GetNativeFormat();
+
+	// Set the pixel format of ReceiveImage to a char buffer
+	// RGBA (default), BGRA, NV12 or I420 - see ofxNDIreceive
+	bool SetOutputFormat(ofxNDIutils::PixelFormat format);
+
+	// Return the pixel format of ReceiveImage to a char buffer
+	ofxNDIutils::PixelFormat GetOutputFormat();
+
+	// Receive audio for ReceiveAudio
+	// - nChannels | channels of the sound stream
+	// Call before the sound stream is started
+	void SetAudio(bool bAudio = true, int nChannels = 2);
+
+	// Return whether audio is received
+	bool GetAudio();
+
+	// Read received audio from ofBaseSoundOutput::audioOut
+	// The buffer is silent if the channels differ from SetAudio.
+	// Returns the number of received samples read
+	int ReceiveAudio(ofSoundBuffer &buffer);
+
 	// Return the received frame type
 	NDIlib_frame_type_e GetFrameType();
 
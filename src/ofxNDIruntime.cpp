@@ -0,0 +1,292 @@
+/*
+	NDI runtime
+
+	The NDI library, buffer pool and stream statistics
+	shared by all senders and receivers in the process
+
+	http://NDI.NewTek.com
+
+	Copyright (C) 2016-2018 Lynn Jarvis.
+
+	http://www.spout.zeal.co
+
+	=========================================================================
+	This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+	=========================================================================
+
+	17.10.26 - Create file
+
+*/
+#include "ofxNDIruntime.h"
+#include "ofxNDIformats.h" // P216 and PA16
+#include <iostream> // for cout
+#include <mutex>
+#include <map>
+#include <chrono>
+
+// Period over which stream rates are calculated
+static const long long RATE_PERIOD = 1000000; // microseconds
+
+static long long GetClockMicroseconds()
+{
+	return (long long)std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Counters of a registered stream
+struct StreamCounters {
+	ofxNDIruntime::Stream stats;
+	unsigned long long periodBytes; // Counted in the current period
+	long long periodTime;
+	long long periodStart;
+};
+
+// Process state, created on first use so that it exists
+// before any static sender or receiver and is destroyed after it
+struct RuntimeState {
+	std::mutex mutex;
+	unsigned int users;
+	bool bInitialized;
+	std::shared_ptr<ofxNDIbufferpool> pool;
+	std::map<unsigned int, StreamCounters> streams;
+	unsigned int nextId;
+	RuntimeState() : users(0), bInitialized(false), nextId(1) {}
+};
+
+static RuntimeState &GetState()
+{
+	static RuntimeState state;
+	return state;
+}
+
+// Calculate the rates at the end of each period - called with the lock held
+static void UpdateRates(StreamCounters &counters, long long now)
+{
+	long long elapsed = now - counters.periodStart;
+	if (elapsed < RATE_PERIOD)
+		return;
+
+	counters.stats.bandwidth = (double)counters.periodBytes * 8.0 / (double)elapsed; // bits per usec = Mbps
+	counters.stats.cpu = (double)counters.periodTime * 100.0 / (double)elapsed;
+	counters.periodBytes = 0;
+	counters.periodTime = 0;
+	counters.periodStart = now;
+}
+
+
+// Initialize NDI for the first user
+bool ofxNDIruntime::Acquire()
+{
+	RuntimeState &state = GetState();
+	std::lock_guard<std::mutex> lock(state.mutex);
+
+	if (state.users == 0) {
+		if (!NDIlib_is_supported_CPU()) {
+			std::cout << "CPU does not support NDI NDILib requires SSE4.1" << std::endl;
+			return false;
+		}
+		if (!NDIlib_initialize()) {
+			std::cout << "Cannot run NDI - NDILib initialization failed" << std::endl;
+			return false;
+		}
+		state.bInitialized = true;
+	}
+	state.users++;
+
+	return true;
+}
+
+// Release NDI and destroy it for the last user
+void ofxNDIruntime::Release()
+{
+	RuntimeState &state = GetState();
+	std::lock_guard<std::mutex> lock(state.mutex);
+
+	if (state.users == 0)
+		return;
+
+	if (--state.users == 0 && state.bInitialized) {
+		NDIlib_destroy();
+		state.bInitialized = false;
+	}
+}
+
+// Number of users holding NDI
+unsigned int ofxNDIruntime::GetUsers()
+{
+	RuntimeState &state = GetState();
+	std::lock_guard<std::mutex> lock(state.mutex);
+	return state.users;
+}
+
+// Buffer pool shared by all senders and receivers
+std::shared_ptr<ofxNDIbufferpool> ofxNDIruntime::GetBufferPool()
+{
+	RuntimeState &state = GetState();
+	std::lock_guard<std::mutex> lock(state.mutex);
+	if (!state.pool)
+		state.pool = std::make_shared<ofxNDIbufferpool>();
+	return state.pool;
+}
+
+// Threads used for conversion
+void ofxNDIruntime::SetThreads(unsigned int nThreads, bool bAffinity)
+{
+	ofxNDIutils::SetThreads(nThreads, bAffinity);
+}
+
+unsigned int ofxNDIruntime::GetThreads()
+{
+	return ofxNDIutils::GetThreads();
+}
+
+// Conversions that ran on the calling thread only
+unsigned long long ofxNDIruntime::GetThreadFallbacks()
+{
+	return ofxNDIutils::GetThreadFallbacks();
+}
+
+// Register a sender or receiver
+unsigned int ofxNDIruntime::AddStream(bool bSender)
+{
+	RuntimeState &state = GetState();
+	std::lock_guard<std::mutex> lock(state.mutex);
+
+	StreamCounters counters;
+	counters.stats.id = state.nextId++;
+	counters.stats.bSender = bSender;
+	counters.stats.frames = 0;
+	counters.stats.bytes = 0;
+	counters.stats.bandwidth = 0.0;
+	counters.stats.cpu = 0.0;
+	counters.periodBytes = 0;
+	counters.periodTime = 0;
+	counters.periodStart = GetClockMicroseconds();
+	state.streams[counters.stats.id] = counters;
+
+	return counters.stats.id;
+}
+
+// Remove a stream from the registry
+void ofxNDIruntime::RemoveStream(unsigned int id)
+{
+	RuntimeState &state = GetState();
+	std::lock_guard<std::mutex> lock(state.mutex);
+	state.streams.erase(id);
+}
+
+// Set the sender name shown for a stream
+void ofxNDIruntime::SetStreamName(unsigned int id, const std::string &name)
+{
+	RuntimeState &state = GetState();
+	std::lock_guard<std::mutex> lock(state.mutex);
+	std::map<unsigned int, StreamCounters>::iterator it = state.streams.find(id);
+	if (it != state.streams.end())
+		it->second.stats.name = name;
+}
+
+// Count a video frame sent or received
+void ofxNDIruntime::AddStreamFrame(unsigned int id, size_t bytes)
+{
+	long long now = GetClockMicroseconds();
+	RuntimeState &state = GetState();
+	std::lock_guard<std::mutex> lock(state.mutex);
+	std::map<unsigned int, StreamCounters>::iterator it = state.streams.find(id);
+	if (it == state.streams.end())
+		return;
+
+	StreamCounters &counters = it->second;
+	UpdateRates(counters, now);
+	counters.stats.frames++;
+	counters.stats.bytes += bytes;
+	counters.periodBytes += bytes;
+}
+
+// Count time spent converting for a stream
+void ofxNDIruntime::AddStreamTime(unsigned int id, long long usec)
+{
+	long long now = GetClockMicroseconds();
+	RuntimeState &state = GetState();
+	std::lock_guard<std::mutex> lock(state.mutex);
+	std::map<unsigned int, StreamCounters>::iterator it = state.streams.find(id);
+	if (it == state.streams.end())
+		return;
+
+	UpdateRates(it->second, now);
+	it->second.periodTime += usec;
+}
+
+// Statistics of all streams registered
+std::vector<ofxNDIruntime::Stream> ofxNDIruntime::GetStreams()
+{
+	long long now = GetClockMicroseconds();
+	RuntimeState &state = GetState();
+	std::lock_guard<std::mutex> lock(state.mutex);
+
+	// Rates of a stream that has stopped fall to zero
+	// after the period in which the last frame was counted
+	std::vector<Stream> streams;
+	std::map<unsigned int, StreamCounters>::iterator it;
+	for (it = state.streams.begin(); it != state.streams.end(); it++) {
+		UpdateRates(it->second, now);
+		streams.push_back(it->second.stats);
+	}
+
+	return streams;
+}
+
+// Number of senders or receivers registered
+unsigned int ofxNDIruntime::GetStreamCount(bool bSender)
+{
+	RuntimeState &state = GetState();
+	std::lock_guard<std::mutex> lock(state.mutex);
+	unsigned int n = 0;
+	std::map<unsigned int, StreamCounters>::const_iterator it;
+	for (it = state.streams.begin(); it != state.streams.end(); it++) {
+		if (it->second.stats.bSender == bSender) n++;
+	}
+	return n;
+}
+
+// Total bandwidth of all streams in megabits per second
+double ofxNDIruntime::GetBandwidth()
+{
+	std::vector<Stream> streams = GetStreams();
+	double bandwidth = 0.0;
+	for (size_t i = 0; i < streams.size(); i++)
+		bandwidth += streams[i].bandwidth;
+	return bandwidth;
+}
+
+// Total conversion time of all streams, percent of one core
+double ofxNDIruntime::GetCpu()
+{
+	std::vector<Stream> streams = GetStreams();
+	double cpu = 0.0;
+	for (size_t i = 0; i < streams.size(); i++)
+		cpu += streams[i].cpu;
+	return cpu;
+}
+
+// Data size of a video frame including every plane
+size_t ofxNDIruntime::GetFrameBytes(const NDIlib_video_frame_v2_t &frame)
+{
+	int stride = frame.line_stride_in_bytes;
+	size_t lineBytes = (size_t)(stride < 0 ? -stride : stride);
+	size_t height = (size_t)(frame.yres > 0 ? frame.yres : 0);
+	size_t planes = ofxNDI_IsHighBitDepth(frame.FourCC) ? ofxNDIutils::GetPlanes(ofxNDI_HighBitDepthFormat(frame.FourCC)) : 1;
+	size_t alpha = frame.FourCC == NDIlib_FourCC_type_UYVA ? (size_t)frame.xres*height : 0;
+
+	return lineBytes*height*planes + alpha;
+}
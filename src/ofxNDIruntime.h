@@ -0,0 +1,133 @@
+/*
+	NDI runtime
+
+	The NDI library, buffer pool and stream statistics
+	shared by all senders and receivers in the process
+
+	http://NDI.NewTek.com
+
+	Copyright (C) 2016-2018 Lynn Jarvis.
+
+	http://www.spout.zeal.co
+
+	=========================================================================
+	This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+	=========================================================================
+
+	17.10.26 - Create file
+
+*/
+#pragma once
+#ifndef __ofxNDIruntime__
+#define __ofxNDIruntime__
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include <memory> // for shared_ptr
+#include "Processing.NDI.Lib.h" // NDI SDK
+#include "ofxNDIbufferpool.h"
+
+//
+// NDIlib_initialize is called for the first user and NDIlib_destroy
+// when the last user has released it, so that any number of senders
+// and receivers can be created and destroyed in any order.
+//
+// Every sender and receiver is registered as a stream. Frame data
+// sent or received and the time spent converting it are counted for
+// each stream. Rates are calculated over periods of one second,
+// or longer if the statistics are not read or updated for a while.
+// Bandwidth is of the uncompressed frames passed to or from NDI.
+// Conversion time is the elapsed time of each conversion on the thread
+// making it, the render or a pipeline thread, as a percentage of one core.
+//
+// Conversions split into bands use one thread pool (ofxNDIutils::SetThreads).
+// Conversions from several streams at once share its threads. Conversion
+// buffers are leased from one pool for every stream.
+//
+// All functions can be called from any thread.
+//
+class ofxNDIruntime {
+
+public:
+
+	// Statistics of one stream
+	struct Stream {
+		unsigned int id; // Registered id
+		bool bSender; // Sender or receiver
+		std::string name; // Sender name
+		unsigned long long frames; // Video frames since registered
+		unsigned long long bytes; // Frame data bytes since registered
+		double bandwidth; // Megabits per second over the last period
+		double cpu; // Conversion time over the last period, percent of one core
+	};
+
+	// Initialize NDI for the first user
+	// Returns false if the CPU is not supported or initialization failed
+	static bool Acquire();
+
+	// Release NDI. It is destroyed when the last user releases it.
+	static void Release();
+
+	// Number of users holding NDI
+	static unsigned int GetUsers();
+
+	// Buffer pool shared by all senders and receivers
+	static std::shared_ptr<ofxNDIbufferpool> GetBufferPool();
+
+	// Threads used for conversion by all senders and receivers
+	// (ofxNDIutils::SetThreads)
+	static void SetThreads(unsigned int nThreads, bool bAffinity = false);
+	static unsigned int GetThreads();
+
+	// Conversions that ran on the calling thread only
+	// (ofxNDIutils::GetThreadFallbacks)
+	static unsigned long long GetThreadFallbacks();
+
+	// Register a sender or receiver
+	// Returns the id used for the statistics
+	static unsigned int AddStream(bool bSender);
+
+	// Remove a stream from the registry
+	static void RemoveStream(unsigned int id);
+
+	// Set the sender name shown for a stream
+	static void SetStreamName(unsigned int id, const std::string &name);
+
+	// Count a video frame sent or received
+	// - bytes | frame data size (GetFrameBytes)
+	static void AddStreamFrame(unsigned int id, size_t bytes);
+
+	// Count time spent converting for a stream
+	// - usec | microseconds
+	static void AddStreamTime(unsigned int id, long long usec);
+
+	// Statistics of all streams registered
+	static std::vector<Stream> GetStreams();
+
+	// Number of senders or receivers registered
+	static unsigned int GetStreamCount(bool bSender);
+
+	// Total bandwidth of all streams in megabits per second
+	static double GetBandwidth();
+
+	// Total conversion time of all streams, percent of one core
+	static double GetCpu();
+
+	// Data size of a video frame including every plane
+	static size_t GetFrameBytes(const NDIlib_video_frame_v2_t &frame);
+
+};
+
+#endif
@@ -59,16 +59,67 @@
 	14.07.18	- Add Sender dimensions m_Width, m_Height and bSenderInitialized
 				- Add GetWidth and GetHeight
 				- Add SenderCreated
+	17.10.26	- SendImage converts RGBA or BGRA pixels to YUV422 on the CPU
+				  for a UYVY sender so that OpenGL is not needed. UYVY and UYVA
+				  lines of an odd width are rounded up to a pixel pair.
+				- Add SendFrame for data already in the sender format
+				- Invert buffer re-allocated for a changed size
+				- Conversion and invert buffers are leased from a pool of
+				  64 byte aligned buffers. An async frame is held until the next
+				  send so that the buffer being sent is not overwritten.
+				- Add LeaseBuffer, ReturnBuffer, GetBufferAllocations
+				- sizeof(float) for audio stride in place of the Windows FLOAT type
+				- SendFrame : CopyLines for invert of any line stride
+				- Invert and swap in place for SetInPlace or a leased buffer
+				  so that no invert buffer is needed
+				- Add SetNegativeStride - invert by a negative line stride
+				- P216 and PA16 senders (NDI 4). SendImage converts 8 bit pixels,
+				  SendImage16 16 bit or half float pixels and SendFrameV210 v210.
+				  SendFrame inverts each plane. Line stride set for the format.
+				- UYVA senders. SendImage converts RGBA or BGRA to the UYVY
+				  and alpha planes in one pass. SendFrame inverts both planes.
+				- Add SetPipeline - conversion and the NDI send on separate threads
+				  with bounded queues between them. Add QueueImage, QueueFrame
+				  and pipeline statistics. SendImage, SendImage16, SendFrame and
+				  SendFrameV210 share PrepareImage etc. with the pipeline and
+				  copy the caller's data to a pool buffer as it is queued.
+				- Add GetSubmittedFrames, GetFinishedFrames and FlushAsync
+				  so that pixels sent asynchronously from the caller's memory,
+				  such as a mapped PBO, can be re-used once NDI is done with them.
+				- Add SetPacing - frames sent asynchronously at the frame rate
+				  by the pipeline send thread, repeated or dropped to keep time,
+				  instead of NDI clocking. Add pacing statistics.
+				- NDI is initialized and destroyed by ofxNDIruntime, once for
+				  all senders and receivers. Buffers are leased from the pool
+				  shared by all of them. Frames sent and conversion time are
+				  counted for the stream statistics. Add GetStreamId.
 
 
 */
 #include "ofxNDIsend.h"
 
+// Steady clock time in microseconds
+static long long GetClockMicroseconds()
+{
+	return (long long)std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Average a stage latency, damped in the same way as fps
+static void UpdateLatency(std::atomic<double> &average, long long usec)
+{
+	double latency = (double)usec / 1000.0;
+	double last = average.load();
+	average.store(last <= 0.0 ? latency : last*0.95 + latency*0.05);
+}
 
 ofxNDIsend::ofxNDIsend()
 {
 	pNDI_send = NULL;
 	p_frame = NULL;
+	p_async_frame = NULL;
+	m_nSubmitted = 0;
+	m_nFinished = 0;
 	m_frame_rate_N = 60000; // 60 fps default : 30000 - 29.97 fps
 	m_frame_rate_D = 1000; // 1001 - 29.97 fps
 	m_horizontal_aspect = 1; // source aspect ratio by default
@@ -77,7 +128,26 @@ ofxNDIsend::ofxNDIsend()
 	m_bProgressive = true; // progressive default
 	m_bClockVideo = true; // clock video default
 	m_bAsync = false;
+	m_bInPlace = false;
+	m_bNegativeStride = false;
 	m_bNDIinitialized = false;
+
+	// Pipeline
+	m_bPipeline = false;
+	m_nPipelineFrames = 2;
+	m_bPipelineQuit = false;
+	m_bConvertDone = false;
+	m_nQueued = 0;
+	m_nReleased = 0;
+	m_nPipelineDropped = 0;
+	m_convertLatency = 0.0;
+	m_sendLatency = 0.0;
+	m_bPacing = false;
+	m_nPacingRepeated = 0;
+	m_nPacingDropped = 0;
+	m_nPacingMissed = 0;
+	m_pacingJitter = 0.0;
+	m_pacingMaxJitter = 0.0;
 	m_Width = m_Height = 0;
 	bSenderInitialized = false;
 	m_ColorFormat = NDIlib_FourCC_type_RGBA; // default rgba output format
@@ -90,16 +160,10 @@ ofxNDIsend::ofxNDIsend()
 	m_AudioTimecode = NDIlib_send_timecode_synthesize; // Timecode (synthesized for us !)
 	m_AudioData = NULL; // Audio buffer
 
-	if(!NDIlib_is_supported_CPU() ) {
-		std::cout << "CPU does not support NDI NDILib requires SSE4.1 NDIsender" << std::endl;
-		m_bNDIinitialized = false;
-	}
-	else {
-		m_bNDIinitialized = NDIlib_initialize();
-		if(!m_bNDIinitialized) {
-			std::cout << "Cannot run NDI - NDILib initialization failed" << std::endl;
-		}
-	}
+	// NDI is initialized for the first sender or receiver
+	m_bNDIinitialized = ofxNDIruntime::Acquire();
+	m_BufferPool = ofxNDIruntime::GetBufferPool();
+	m_streamId = ofxNDIruntime::AddStream(true);
 }
 
 
@@ -110,8 +174,11 @@ ofxNDIsend::~ofxNDIsend()
 		ReleaseSender();
 	bSenderInitialized = false;
 
-	// Release the library
-	NDIlib_destroy();
+	// Free the buffers of this sender and release the library
+	m_BufferPool->RemoveOwner(this);
+	ofxNDIruntime::RemoveStream(m_streamId);
+	if (m_bNDIinitialized)
+		ofxNDIruntime::Release();
 	m_bNDIinitialized = false;
 
 }
@@ -123,7 +190,7 @@ bool ofxNDIsend::CreateSender(const char *sendername, unsigned int width, unsign
 }
 
 // Create a sender of specified colour format
-// Formats supported are RGBA, BGRA and UVYV
+// Formats supported are RGBA, BGRA, UVYV, UYVA, P216 and PA16
 bool ofxNDIsend::CreateSender(const char *sendername, unsigned int width, unsigned int height, NDIlib_FourCC_type_e colorFormat)
 {
 	// printf("ofxNDIsender::CreateSender(%s, %d, %d, (%d)\n", sendername, width, height, colorFormat);
@@ -132,8 +199,9 @@ bool ofxNDIsend::CreateSender(const char *sendername, unsigned int width, unsign
 	// unless async sending has been selected.
 	NDI_send_create_desc.p_ndi_name = sendername;
 	NDI_send_create_desc.p_groups = NULL;
-	// Do not clock the video for async sending
-	if (m_bAsync)
+	// Do not clock the video for async sending,
+	// or if it is paced by the send thread
+	if (m_bAsync || m_bPacing)
 		NDI_send_create_desc.clock_video = false;
 	else
 		NDI_send_create_desc.clock_video = m_bClockVideo;
@@ -155,9 +223,12 @@ bool ofxNDIsend::CreateSender(const char *sendername, unsigned int width, unsign
 
 	if (pNDI_send) {
 
+		if (sendername)
+			ofxNDIruntime::SetStreamName(m_streamId, sendername);
+
 		// Provide a meta-data registration that allows people to know what we are. Note that this is optional.
 		// Note that it is possible for senders to also register their preferred video formats.
-		char* p_connection_string = "<ndi_product long_name=\"ofxNDI sender\" "
+		char p_connection_string[] = "<ndi_product long_name=\"ofxNDI sender\" "
 												 "             short_name=\"ofxNDI Sender\" "
 												 "             manufacturer=\"spout@zeal.co\" "
 												 "             version=\"1.001.000\" "
@@ -177,8 +248,7 @@ bool ofxNDIsend::CreateSender(const char *sendername, unsigned int width, unsign
 		NDIlib_send_add_connection_metadata(pNDI_send, &NDI_connection_type);
 		
 		// We are going to create an non-interlaced frame at 60fps
-		if(p_frame) free((void *)p_frame);
-		p_frame = NULL; // invert  buffer
+		m_BufferPool->Clear(this);
 
 		video_frame.xres = (int)width;
 		video_frame.yres = (int)height;
@@ -194,7 +264,7 @@ bool ofxNDIsend::CreateSender(const char *sendername, unsigned int width, unsign
 		// The timecode of this frame in 100ns intervals
 		video_frame.timecode = NDIlib_send_timecode_synthesize; // 0LL; // Let the API fill in the timecodes for us.
 		video_frame.p_data = NULL;
-		video_frame.line_stride_in_bytes = (int)width*4; // The stride of a line BGRA
+		video_frame.line_stride_in_bytes = (int)GetLineStride(width, colorFormat);
 
 		// Keep the sender dimensions locally
 		m_Width = width;
@@ -210,9 +280,11 @@ bool ofxNDIsend::CreateSender(const char *sendername, unsigned int width, unsign
 			m_audio_frame.timecode    = m_AudioTimecode;
 			m_audio_frame.p_data      = m_AudioData;
 			// mono/stereo inter channel stride
-			m_audio_frame.channel_stride_in_bytes = (m_AudioChannels-1)*m_AudioSamples*sizeof(FLOAT);
+			m_audio_frame.channel_stride_in_bytes = (m_AudioChannels-1)*m_AudioSamples*sizeof(float);
 		}
 
+		StartPipeline();
+
 		return true;
 	}
 
@@ -228,7 +300,10 @@ bool ofxNDIsend::UpdateSender(unsigned int width, unsigned int height)
 // Update sender dimensions and colour format
 bool ofxNDIsend::UpdateSender(unsigned int width, unsigned int height, NDIlib_FourCC_type_e colorFormat)
 {
-	if(pNDI_send && m_bAsync) {
+	// Frames already queued are sent at the old size
+	StopPipeline();
+
+	if(pNDI_send && (m_bAsync || m_bPacing)) {
 		// Because one buffer is in flight we need to make sure that 
 		// there is no chance that we might free it before NDI is done with it. 
 		// You can ensure this either by sending another frame, or just by
@@ -236,21 +311,26 @@ bool ofxNDIsend::UpdateSender(unsigned int width, unsigned int height, NDIlib_Fo
 		// NDIlib_send_send_video_async(pNDI_send, NULL);
 		NDIlib_send_send_video_async_v2(pNDI_send, NULL);
 	}
+	ReleaseAsyncFrame();
+	m_nFinished = m_nSubmitted.load();
 
-	// Free the local buffer, it is re-created in SendImage if invert is needed
-	if(p_frame) free((void *)p_frame);
-	p_frame = NULL;
+	// Free buffers of the old size, new ones are leased when needed
+	if (width != m_Width || height != m_Height || colorFormat != m_ColorFormat)
+		m_BufferPool->Clear(this);
 	video_frame.p_data = NULL;
 
 	// Reset video frame size
 	video_frame.xres = (int)width;
 	video_frame.yres = (int)height;
-	video_frame.line_stride_in_bytes = (int)width * 4;
+	video_frame.line_stride_in_bytes = (int)GetLineStride(width, colorFormat);
 	video_frame.FourCC = colorFormat;
 
 	// Update the sender dimensions
 	m_Width = width;
 	m_Height = height;
+	m_ColorFormat = colorFormat;
+
+	StartPipeline();
 
 	return true;
 }
@@ -263,82 +343,250 @@ bool ofxNDIsend::SendImage(const unsigned char * pixels,
 {
 	// printf("SendImage (%x, %d, %d, (%d, %d) )\n", pixels, width, height, bSwapRB, bInvert);
 
+	if (m_bPipeline)
+		return SendPipeline(PIPELINE_IMAGE, pixels, width, height, 0, bSwapRB, bInvert);
+
+	if (!PrepareVideo(GetPipelineFrame(PIPELINE_IMAGE, pixels, width, height, 0, bSwapRB, bInvert)))
+		return false;
+
+	SubmitFrame();
+	return true;
+}
+
+// Send 16 bit image pixels to a P216 or PA16 sender
+bool ofxNDIsend::SendImage16(const unsigned short * pixels,
+	unsigned int width, unsigned int height,
+	bool bHalfFloat, bool bInvert)
+{
+	if (m_bPipeline)
+		return SendPipeline(PIPELINE_IMAGE16, (const unsigned char *)pixels, width, height, 0, bHalfFloat, bInvert);
+
+	if (!PrepareVideo(GetPipelineFrame(PIPELINE_IMAGE16, (const unsigned char *)pixels, width, height, 0, bHalfFloat, bInvert)))
+		return false;
+
+	SubmitFrame();
+	return true;
+}
+
+// Send a frame already in the sender colour format
+bool ofxNDIsend::SendFrame(const unsigned char * frame,
+	unsigned int width, unsigned int height, unsigned int stride,
+	bool bInvert)
+{
+	if (m_bPipeline)
+		return SendPipeline(PIPELINE_FRAME, frame, width, height, stride, false, bInvert);
+
+	if (!PrepareVideo(GetPipelineFrame(PIPELINE_FRAME, frame, width, height, stride, false, bInvert)))
+		return false;
+
+	SubmitFrame();
+	return true;
+}
+
+// Send a v210 frame to a P216 or PA16 sender
+bool ofxNDIsend::SendFrameV210(const unsigned char * frame,
+	unsigned int width, unsigned int height, unsigned int stride,
+	bool bInvert)
+{
+	if (m_bPipeline)
+		return SendPipeline(PIPELINE_V210, frame, width, height, stride, false, bInvert);
+
+	if (!PrepareVideo(GetPipelineFrame(PIPELINE_V210, frame, width, height, stride, false, bInvert)))
+		return false;
+
+	SubmitFrame();
+	return true;
+}
+
+// Convert image pixels to the video frame
+bool ofxNDIsend::PrepareImage(const unsigned char * pixels,
+	unsigned int width, unsigned int height,
+	bool bSwapRB, bool bInvert,
+	NDIlib_FourCC_type_e colorFormat, bool bNegativeStride, bool bInPlace)
+{
 	if (pixels && width > 0 && height > 0) {
 
 		// Allow for forgotten UpdateSender
 		if (video_frame.xres != (int)width || video_frame.yres != (int)height) {
 			video_frame.xres = (int)width;
 			video_frame.yres = (int)height;
-			video_frame.line_stride_in_bytes = width * 4;
-			// Release pframe for invert because the size is different
-			// It will be re-created at the correct size
-			if (p_frame) free((void *)p_frame);
-			p_frame = NULL;
 		}
 
-		if (bSwapRB || bInvert) {
+		if (colorFormat == NDIlib_FourCC_type_UYVY) {
+			// RGBA or BGRA pixels are converted to YUV422 by the CPU.
+			// The local buffer is always needed for the converted data.
+			// An odd width is rounded up to a whole UYVY pair.
+			unsigned int lineBytes = ofxNDIutils::GetLineBytes(ofxNDIutils::FORMAT_UYVY, width);
+			if (!GetFrameBuffer(ofxNDIutils::GetImageBytes(ofxNDIutils::FORMAT_UYVY, width, height)))
+				return false;
+			if (bSwapRB)
+				ofxNDIutils::BGRA_to_YUV422(pixels, video_frame.p_data, width, height, lineBytes, bInvert);
+			else
+				ofxNDIutils::RGBA_to_YUV422(pixels, video_frame.p_data, width, height, lineBytes, bInvert);
+			video_frame.line_stride_in_bytes = (int)lineBytes;
+		}
+		else if (colorFormat == NDIlib_FourCC_type_UYVA) {
+			// UYVY lines followed by the alpha plane
+			if (!GetFrameBuffer(ofxNDIutils::GetImageBytes(ofxNDIutils::FORMAT_UYVA, width, height)))
+				return false;
+			ofxNDIutils::ConvertImage(pixels, width * 4, bSwapRB ? ofxNDIutils::FORMAT_BGRA : ofxNDIutils::FORMAT_RGBA,
+				video_frame.p_data, 0, ofxNDIutils::FORMAT_UYVA, width, height, bInvert);
+			video_frame.line_stride_in_bytes = (int)ofxNDIutils::GetLineBytes(ofxNDIutils::FORMAT_UYVA, width);
+		}
+		else if (ofxNDI_IsHighBitDepth(colorFormat)) {
+			// Converted to 16 bit planes
+			if (!ConvertFrame(pixels, width * 4, bSwapRB ? ofxNDIutils::FORMAT_BGRA : ofxNDIutils::FORMAT_RGBA,
+				width, height, bInvert, colorFormat))
+				return false;
+		}
+		else if (bInvert && !bSwapRB && bNegativeStride) {
+			// No pass over the pixels at all
+			SetInvertedFrameData(pixels, width * 4, height);
+		}
+		else if ((bSwapRB || bInvert) && bInPlace) {
+			// The caller's pixels are changed, so no local buffer is needed
+			unsigned char *image = const_cast<unsigned char *>(pixels);
+			if (bInvert)
+				ofxNDIutils::FlipImage(image, width * 4, width * 4, height, bSwapRB);
+			else
+				ofxNDIutils::rgba_bgra(image, image, width, height);
+			SetFrameData(pixels);
+			video_frame.line_stride_in_bytes = (int)width * 4;
+		}
+		else if (bSwapRB || bInvert) {
 			// printf("bSwapRB = %d, bInvert = %d\n", bSwapRB, bInvert);
 			// Local memory buffer is only needed for rgba to bgra or invert
-			if (!p_frame) {
-				p_frame = (uint8_t*)malloc(width*height * 4 * sizeof(unsigned char));
-				if (!p_frame) {
-					std::cout << "Out of memory in SendImage" << std::endl;
-					return false;
-				}
-				video_frame.p_data = p_frame;
-			}
+			if (!GetFrameBuffer(width*height * 4))
+				return false;
+			video_frame.line_stride_in_bytes = (int)width * 4;
 			ofxNDIutils::CopyImage((const unsigned char *)pixels, (unsigned char *)video_frame.p_data,
 				width, height, (unsigned int)video_frame.line_stride_in_bytes, bSwapRB, bInvert);
 		}
 		else {
 			// No bgra conversion or invert, so use the pointer directly
-			video_frame.p_data = (uint8_t*)pixels;
+			SetFrameData(pixels);
+			video_frame.line_stride_in_bytes = (int)width * 4;
 		}
 
-		// Submit the audio buffer first.
-		// Refer to the NDI SDK example where for 48000 sample rate
-		// and 29.97 fps, an alternating sample number is used.
-		// Do this in the application using SetAudioSamples(nSamples);
-		// General reference : http://jacklinstudios.com/docs/post-primer.html
-		if (m_bAudio && m_audio_frame.p_data != NULL)
-			NDIlib_send_send_audio_v2(pNDI_send, &m_audio_frame);
-
-		// Metadata
-		if (m_bMetadata && !m_metadataString.empty()) {
-			metadata_frame.length = (int)m_metadataString.size();
-			metadata_frame.timecode = NDIlib_send_timecode_synthesize;
-			metadata_frame.p_data = (char *)m_metadataString.c_str(); // XML message format
-			NDIlib_send_send_metadata(pNDI_send, &metadata_frame);
-			// printf("Metadata\n%s\n", m_metadataString.c_str());
+		return true;
+	}
+
+	return false;
+}
+
+// Convert 16 bit image pixels to the video frame
+bool ofxNDIsend::PrepareImage16(const unsigned short * pixels,
+	unsigned int width, unsigned int height,
+	bool bHalfFloat, bool bInvert, NDIlib_FourCC_type_e colorFormat)
+{
+	if (!pixels || width == 0 || height == 0)
+		return false;
+
+	if (!ofxNDI_IsHighBitDepth(colorFormat)) {
+		std::cout << "SendImage16 - sender format is not P216 or PA16" << std::endl;
+		return false;
+	}
+
+	if (video_frame.xres != (int)width || video_frame.yres != (int)height) {
+		video_frame.xres = (int)width;
+		video_frame.yres = (int)height;
+	}
+
+	if (!ConvertFrame((const unsigned char *)pixels, width * 8,
+		bHalfFloat ? ofxNDIutils::FORMAT_RGBA16F : ofxNDIutils::FORMAT_RGBA16,
+		width, height, bInvert, colorFormat))
+		return false;
+
+	return true;
+}
+
+// Set the video frame for a frame in the sender colour format
+bool ofxNDIsend::PrepareFrame(const unsigned char * frame,
+	unsigned int width, unsigned int height, unsigned int stride,
+	bool bInvert, NDIlib_FourCC_type_e colorFormat, bool bNegativeStride, bool bInPlace)
+{
+	if (frame && width > 0 && height > 0 && stride > 0) {
+
+		if (video_frame.xres != (int)width || video_frame.yres != (int)height) {
+			video_frame.xres = (int)width;
+			video_frame.yres = (int)height;
 		}
 
-		if (m_bAsync) {
-			// Submit the frame asynchronously. This means that this call will return immediately and the 
-			// API will "own" the memory location until there is a synchronizing event. A synchronouzing event is 
-			// one of : NDIlib_send_send_video_async, NDIlib_send_send_video, NDIlib_send_destroy
-			NDIlib_send_send_video_async_v2(pNDI_send, &video_frame);
+		// Planes after the first are found from the stride
+		// so a planar frame cannot be inverted by a negative stride.
+		// The UYVA alpha plane is width bytes per line.
+		unsigned int planes = ofxNDI_IsHighBitDepth(colorFormat) ? ofxNDIutils::GetPlanes(ofxNDI_HighBitDepthFormat(colorFormat)) : 1;
+		size_t planeSize = (size_t)height*stride;
+		size_t alphaSize = colorFormat == NDIlib_FourCC_type_UYVA ? (size_t)width*height : 0;
+
+		video_frame.line_stride_in_bytes = (int)stride;
+		if (bInvert && bNegativeStride && planes == 1 && alphaSize == 0) {
+			SetInvertedFrameData(frame, stride, height);
+		}
+		else if (bInvert && bInPlace) {
+			for (unsigned int i = 0; i < planes; i++)
+				ofxNDIutils::FlipImage(const_cast<unsigned char *>(frame) + i*planeSize, stride, stride, height);
+			if (alphaSize > 0)
+				ofxNDIutils::FlipImage(const_cast<unsigned char *>(frame) + planeSize, width, width, height);
+			SetFrameData(frame);
+		}
+		else if (bInvert) {
+			if (!GetFrameBuffer(planeSize*planes + alphaSize))
+				return false;
+			// Lines of "stride" bytes are flipped whatever the format
+			for (unsigned int i = 0; i < planes; i++)
+				ofxNDIutils::CopyLines(frame + i*planeSize, stride, video_frame.p_data + i*planeSize, stride, stride, height, true);
+			if (alphaSize > 0)
+				ofxNDIutils::CopyLines(frame + planeSize, width, video_frame.p_data + planeSize, width, width, height, true);
 		}
 		else {
-			// Submit the frame. Note that this call will be clocked
-			// so that we end up submitting at exactly the predetermined fps.
-			NDIlib_send_send_video_v2(pNDI_send, &video_frame);
+			SetFrameData(frame);
 		}
+
 		return true;
 	}
 
 	return false;
 }
 
+// Convert a v210 frame to the video frame
+bool ofxNDIsend::PrepareFrameV210(const unsigned char * frame,
+	unsigned int width, unsigned int height, unsigned int stride,
+	bool bInvert, NDIlib_FourCC_type_e colorFormat)
+{
+	if (!frame || width == 0 || height == 0)
+		return false;
+
+	if (!ofxNDI_IsHighBitDepth(colorFormat)) {
+		std::cout << "SendFrameV210 - sender format is not P216 or PA16" << std::endl;
+		return false;
+	}
+
+	if (video_frame.xres != (int)width || video_frame.yres != (int)height) {
+		video_frame.xres = (int)width;
+		video_frame.yres = (int)height;
+	}
+
+	if (!ConvertFrame(frame, stride, ofxNDIutils::FORMAT_V210, width, height, bInvert, colorFormat))
+		return false;
+
+	return true;
+}
+
 // Close sender and release resources
 void ofxNDIsend::ReleaseSender()
 {
+	// Frames queued are sent first
+	StopPipeline();
+
 	// Destroy the NDI sender
 	if (pNDI_send) NDIlib_send_destroy(pNDI_send);
 
-	// Release the invert buffer
-	if (p_frame) free((void*)p_frame);
+	// NDI has finished with any async frame
+	ReleaseAsyncFrame();
+	m_nFinished = m_nSubmitted.load();
+	m_BufferPool->Clear(this);
 
-	p_frame = NULL;
 	pNDI_send = NULL;
 
 	// Reset sender dimensions
@@ -460,6 +708,57 @@ bool ofxNDIsend::GetAsync()
 	return m_bAsync;
 }
 
+// Number of video frames submitted to NDI
+unsigned long long ofxNDIsend::GetSubmittedFrames()
+{
+	return m_nSubmitted.load();
+}
+
+// Number of video frames NDI has finished with
+unsigned long long ofxNDIsend::GetFinishedFrames()
+{
+	return m_nFinished.load();
+}
+
+// Wait until NDI has finished with an async frame
+void ofxNDIsend::FlushAsync()
+{
+	// Pipeline frames are sent and released by the send thread
+	if (m_sendThread.joinable())
+		return;
+
+	if (pNDI_send && m_nFinished.load() < m_nSubmitted.load()) {
+		// A NULL frame is a synchronizing event
+		NDIlib_send_send_video_async_v2(pNDI_send, NULL);
+	}
+	ReleaseAsyncFrame();
+	m_nFinished = m_nSubmitted.load();
+}
+
+// Set to invert and swap the caller's pixels in place
+void ofxNDIsend::SetInPlace(bool bInPlace)
+{
+	m_bInPlace = bInPlace;
+}
+
+// Get whether in place mode
+bool ofxNDIsend::GetInPlace()
+{
+	return m_bInPlace;
+}
+
+// Set to send inverted frames with a negative line stride
+void ofxNDIsend::SetNegativeStride(bool bNegative)
+{
+	m_bNegativeStride = bNegative;
+}
+
+// Get whether inverted frames are sent with a negative stride
+bool ofxNDIsend::GetNegativeStride()
+{
+	return m_bNegativeStride;
+}
+
 // Set to send Audio
 void ofxNDIsend::SetAudio(bool bAudio)
 {
@@ -478,7 +777,7 @@ void ofxNDIsend::SetAudioChannels(int nChannels)
 {
 	m_AudioChannels = nChannels;
 	m_audio_frame.no_channels = nChannels;
-	m_audio_frame.channel_stride_in_bytes = (m_AudioChannels-1)*m_AudioSamples*sizeof(FLOAT);
+	m_audio_frame.channel_stride_in_bytes = (m_AudioChannels-1)*m_AudioSamples*sizeof(float);
 }
 
 // Set number of audio samples
@@ -486,7 +785,7 @@ void ofxNDIsend::SetAudioSamples(int nSamples)
 {
 	m_AudioSamples = nSamples;
 	m_audio_frame.no_samples  = nSamples;
-	m_audio_frame.channel_stride_in_bytes = (m_AudioChannels-1)*m_AudioSamples*sizeof(FLOAT);
+	m_audio_frame.channel_stride_in_bytes = (m_AudioChannels-1)*m_AudioSamples*sizeof(float);
 }
 
 // Set audio timecode
@@ -515,9 +814,667 @@ void ofxNDIsend::SetMetadataString(std::string datastring)
 	m_metadataString = datastring;
 }
 
+// Convert and send frames on separate threads
+void ofxNDIsend::SetPipeline(bool bPipeline, unsigned int nFrames)
+{
+	StopPipeline();
+
+	m_bPipeline = bPipeline;
+	m_nPipelineFrames = (nFrames < 1) ? 1 : nFrames;
+	m_nPipelineDropped = 0;
+	m_convertLatency = 0.0;
+	m_sendLatency = 0.0;
+
+	StartPipeline();
+}
+
+// Get whether the pipeline is used
+bool ofxNDIsend::GetPipeline()
+{
+	return m_bPipeline;
+}
+
+// Send the video at the frame rate from the pipeline send thread
+void ofxNDIsend::SetPacing(bool bPacing)
+{
+	StopPipeline();
+
+	m_bPacing = bPacing;
+	if (bPacing)
+		m_bPipeline = true;
+	m_nPacingRepeated = 0;
+	m_nPacingDropped = 0;
+	m_nPacingMissed = 0;
+	m_pacingJitter = 0.0;
+	m_pacingMaxJitter = 0.0;
+
+	StartPipeline();
+}
+
+// Get whether the video is paced by the send thread
+bool ofxNDIsend::GetPacing()
+{
+	return m_bPacing;
+}
+
+// Frames sent again because no new frame was ready
+unsigned int ofxNDIsend::GetPacingRepeated()
+{
+	return m_nPacingRepeated.load();
+}
+
+// Frames not sent because a newer frame was ready
+unsigned int ofxNDIsend::GetPacingDropped()
+{
+	return m_nPacingDropped.load();
+}
+
+// Frame times passed while the send thread was late
+unsigned int ofxNDIsend::GetPacingMissed()
+{
+	return m_nPacingMissed.load();
+}
+
+// Difference of send from frame time in milliseconds (averaged)
+double ofxNDIsend::GetPacingJitter()
+{
+	return m_pacingJitter.load();
+}
+
+// Largest difference of send from frame time in milliseconds
+double ofxNDIsend::GetPacingMaxJitter()
+{
+	return m_pacingMaxJitter.load();
+}
+
+// Queue image pixels on the pipeline
+unsigned long long ofxNDIsend::QueueImage(const unsigned char *image,
+	unsigned int width, unsigned int height, bool bSwapRB, bool bInvert, bool bReadOnly)
+{
+	return QueuePipeline(PIPELINE_IMAGE, image, width, height, 0, bSwapRB, bInvert, bReadOnly);
+}
+
+// Queue a frame in the sender colour format on the pipeline
+unsigned long long ofxNDIsend::QueueFrame(const unsigned char *frame,
+	unsigned int width, unsigned int height, unsigned int stride, bool bInvert, bool bReadOnly)
+{
+	return QueuePipeline(PIPELINE_FRAME, frame, width, height, stride, false, bInvert, bReadOnly);
+}
+
+// Number of the last queued frame no longer used
+unsigned long long ofxNDIsend::GetReleasedFrames()
+{
+	return m_nReleased.load();
+}
+
+// Wait until a queued frame is no longer used
+void ofxNDIsend::WaitReleased(unsigned long long frame)
+{
+	std::unique_lock<std::mutex> lock(m_pipelineMutex);
+	m_pipelineWake.wait(lock, [this, frame] { return m_nReleased.load() >= frame; });
+}
+
+// Frames dropped because the pipeline was full
+unsigned int ofxNDIsend::GetPipelineDropped()
+{
+	return m_nPipelineDropped.load();
+}
+
+// Frames waiting for conversion
+unsigned int ofxNDIsend::GetConvertQueueDepth()
+{
+	return m_convertQueue.Size();
+}
+
+// Frames waiting to be sent
+unsigned int ofxNDIsend::GetSendQueueDepth()
+{
+	return m_sendQueue.Size();
+}
+
+// Queued to converted in milliseconds (averaged)
+double ofxNDIsend::GetConvertLatency()
+{
+	return m_convertLatency.load();
+}
+
+// Converted to sent in milliseconds (averaged)
+double ofxNDIsend::GetSendLatency()
+{
+	return m_sendLatency.load();
+}
+
+// Lease an aligned buffer from the sender pool
+unsigned char *ofxNDIsend::LeaseBuffer(size_t size)
+{
+	return m_BufferPool->Lease(size, this);
+}
+
+// Return a buffer from LeaseBuffer
+void ofxNDIsend::ReturnBuffer(const unsigned char *buffer)
+{
+	m_BufferPool->Return(buffer);
+}
+
+// Number of pool buffers allocated
+unsigned int ofxNDIsend::GetBufferAllocations()
+{
+	return m_BufferPool->GetAllocations(this);
+}
+
+// Id of the sender statistics
+unsigned int ofxNDIsend::GetStreamId()
+{
+	return m_streamId;
+}
+
 // Get the current NDI SDK version
 std::string ofxNDIsend::GetNDIversion()
 {
 	return NDIlib_version();
 }
 
+//
+// Private functions
+//
+
+// Frame buffer for conversion or invert
+// Leased from the pool and released after the frame is sent
+uint8_t *ofxNDIsend::GetFrameBuffer(size_t size)
+{
+	m_BufferPool->Return(p_frame);
+	uint8_t *buffer = m_BufferPool->Lease(size, this);
+	p_frame = buffer;
+	video_frame.p_data = buffer;
+	return buffer;
+}
+
+// Send the caller's data directly
+void ofxNDIsend::SetFrameData(const unsigned char *data)
+{
+	m_BufferPool->Return(p_frame);
+	p_frame = NULL;
+	// Hold a pool buffer in case the caller returns it before NDI is done
+	if (m_BufferPool->AddRef(data))
+		p_frame = data;
+	video_frame.p_data = (uint8_t*)data;
+}
+
+// Send the caller's data from the last line up
+void ofxNDIsend::SetInvertedFrameData(const unsigned char *data, unsigned int stride, unsigned int height)
+{
+	// A pool buffer is referenced by its start
+	SetFrameData(data);
+	video_frame.p_data = (uint8_t*)data + (size_t)(height - 1)*stride;
+	video_frame.line_stride_in_bytes = -(int)stride;
+}
+
+// Whether the data can be changed by the send
+// A buffer leased by another sender or receiver may be in use by it
+bool ofxNDIsend::IsInPlace(const unsigned char *data)
+{
+	return m_bInPlace || m_BufferPool->Owns(data, this);
+}
+
+// Line stride of a packed frame of the colour format
+unsigned int ofxNDIsend::GetLineStride(unsigned int width, NDIlib_FourCC_type_e colorFormat)
+{
+	if (ofxNDI_IsHighBitDepth(colorFormat))
+		return ofxNDIutils::GetLineBytes(ofxNDI_HighBitDepthFormat(colorFormat), width);
+	if (colorFormat == NDIlib_FourCC_type_UYVY)
+		return ofxNDIutils::GetLineBytes(ofxNDIutils::FORMAT_UYVY, width);
+	if (colorFormat == NDIlib_FourCC_type_UYVA)
+		return ofxNDIutils::GetLineBytes(ofxNDIutils::FORMAT_UYVA, width);
+	return width * 4;
+}
+
+// Convert to a frame buffer for a P216 or PA16 sender
+// Source lines are read once and the planes written in the same pass
+bool ofxNDIsend::ConvertFrame(const unsigned char *source, unsigned int stride, ofxNDIutils::PixelFormat format,
+	unsigned int width, unsigned int height, bool bInvert, NDIlib_FourCC_type_e colorFormat)
+{
+	ofxNDIutils::PixelFormat destFormat = ofxNDI_HighBitDepthFormat(colorFormat);
+	if (!GetFrameBuffer(ofxNDIutils::GetImageBytes(destFormat, width, height)))
+		return false;
+	ofxNDIutils::ConvertImage(source, stride, format,
+		video_frame.p_data, 0, destFormat, width, height, bInvert, false,
+		ofxNDIutils::GetColorMatrix(width, height));
+	video_frame.line_stride_in_bytes = (int)ofxNDIutils::GetLineBytes(destFormat, width);
+	return true;
+}
+
+// Send audio, metadata and the current video frame
+void ofxNDIsend::SubmitFrame()
+{
+	SubmitAudioMetadata();
+	SubmitVideo(video_frame, p_frame, m_bAsync);
+	p_frame = NULL;
+}
+
+// Send audio and metadata
+void ofxNDIsend::SubmitAudioMetadata()
+{
+	// Submit the audio buffer first.
+	// Refer to the NDI SDK example where for 48000 sample rate
+	// and 29.97 fps, an alternating sample number is used.
+	// Do this in the application using SetAudioSamples(nSamples);
+	// General reference : http://jacklinstudios.com/docs/post-primer.html
+	if (m_bAudio && m_audio_frame.p_data != NULL)
+		NDIlib_send_send_audio_v2(pNDI_send, &m_audio_frame);
+
+	// Metadata
+	if (m_bMetadata && !m_metadataString.empty()) {
+		metadata_frame.length = (int)m_metadataString.size();
+		metadata_frame.timecode = NDIlib_send_timecode_synthesize;
+		metadata_frame.p_data = (char *)m_metadataString.c_str(); // XML message format
+		NDIlib_send_send_metadata(pNDI_send, &metadata_frame);
+		// printf("Metadata\n%s\n", m_metadataString.c_str());
+	}
+}
+
+// Send a video frame and release the pool buffers NDI has finished with
+void ofxNDIsend::SubmitVideo(const NDIlib_video_frame_v2_t &frame, const uint8_t *buffer, bool bAsync)
+{
+	ofxNDIruntime::AddStreamFrame(m_streamId, ofxNDIruntime::GetFrameBytes(frame));
+
+	if (bAsync) {
+		// Submit the frame asynchronously. This means that this call will return immediately and the 
+		// API will "own" the memory location until there is a synchronizing event. A synchronouzing event is 
+		// one of : NDIlib_send_send_video_async, NDIlib_send_send_video, NDIlib_send_destroy
+		NDIlib_send_send_video_async_v2(pNDI_send, &frame);
+		// The previous frame has been released by NDI.
+		// The new one is held until the next synchronizing event.
+		ReleaseAsyncFrame();
+		p_async_frame = buffer;
+		m_nFinished = m_nSubmitted.load();
+		m_nSubmitted++;
+	}
+	else {
+		// Submit the frame. Note that this call will be clocked
+		// so that we end up submitting at exactly the predetermined fps.
+		NDIlib_send_send_video_v2(pNDI_send, &frame);
+		// The frame and any previous async frame are no longer used
+		ReleaseAsyncFrame();
+		m_BufferPool->Return(buffer);
+		m_nSubmitted++;
+		m_nFinished = m_nSubmitted.load();
+	}
+}
+
+// Return the async frame buffer to the pool
+void ofxNDIsend::ReleaseAsyncFrame()
+{
+	m_BufferPool->Return(p_async_frame);
+	p_async_frame = NULL;
+}
+
+
+// Copy the caller's data referenced by the video frame to a pool buffer
+// so that it can be released before the frame is sent
+bool ofxNDIsend::HoldFrameData(NDIlib_FourCC_type_e colorFormat)
+{
+	if (p_frame || !video_frame.p_data)
+		return true;
+
+	int stride = video_frame.line_stride_in_bytes;
+	unsigned int lineBytes = (unsigned int)(stride < 0 ? -stride : stride);
+	unsigned int height = (unsigned int)video_frame.yres;
+	unsigned int planes = ofxNDI_IsHighBitDepth(colorFormat) ? ofxNDIutils::GetPlanes(ofxNDI_HighBitDepthFormat(colorFormat)) : 1;
+	size_t planeSize = (size_t)height*lineBytes;
+	size_t alphaSize = colorFormat == NDIlib_FourCC_type_UYVA ? (size_t)video_frame.xres*height : 0;
+
+	uint8_t *buffer = m_BufferPool->Lease(planeSize*planes + alphaSize, this);
+	if (!buffer)
+		return false;
+
+	if (stride < 0) {
+		// Lines from the last up are copied top down
+		const uint8_t *first = video_frame.p_data - (size_t)(height - 1)*lineBytes;
+		ofxNDIutils::CopyLines(first, lineBytes, buffer, lineBytes, lineBytes, height, true);
+		video_frame.line_stride_in_bytes = (int)lineBytes;
+	}
+	else {
+		memcpy(buffer, video_frame.p_data, planeSize*planes + alphaSize);
+	}
+
+	p_frame = buffer;
+	video_frame.p_data = buffer;
+
+	return true;
+}
+
+// Prepare the video frame for the data type
+// The time taken is counted for the stream statistics
+bool ofxNDIsend::PrepareVideo(const PipelineFrame &frame)
+{
+	long long start = GetClockMicroseconds();
+
+	bool bResult = false;
+	switch (frame.type) {
+	case PIPELINE_IMAGE:
+		bResult = PrepareImage(frame.data, frame.width, frame.height, frame.bOption, frame.bInvert,
+			frame.colorFormat, frame.bNegativeStride, frame.bInPlace);
+		break;
+	case PIPELINE_IMAGE16:
+		bResult = PrepareImage16((const unsigned short *)frame.data, frame.width, frame.height,
+			frame.bOption, frame.bInvert, frame.colorFormat);
+		break;
+	case PIPELINE_FRAME:
+		bResult = PrepareFrame(frame.data, frame.width, frame.height, frame.stride, frame.bInvert,
+			frame.colorFormat, frame.bNegativeStride, frame.bInPlace);
+		break;
+	case PIPELINE_V210:
+		bResult = PrepareFrameV210(frame.data, frame.width, frame.height, frame.stride, frame.bInvert,
+			frame.colorFormat);
+		break;
+	}
+
+	ofxNDIruntime::AddStreamTime(m_streamId, GetClockMicroseconds() - start);
+
+	return bResult;
+}
+
+// Start the pipeline threads if the pipeline is used and the sender is created
+void ofxNDIsend::StartPipeline()
+{
+	if (!m_bPipeline || !bSenderInitialized || m_convertThread.joinable())
+		return;
+
+	m_convertQueue.Allocate(m_nPipelineFrames);
+	m_sendQueue.Allocate(m_nPipelineFrames);
+	m_bPipelineQuit = false;
+	m_bConvertDone = false;
+	m_convertThread = std::thread(&ofxNDIsend::ConvertThread, this);
+	if (m_bPacing)
+		m_sendThread = std::thread(&ofxNDIsend::PacingThread, this);
+	else
+		m_sendThread = std::thread(&ofxNDIsend::SendThread, this);
+}
+
+// Stop the pipeline threads once queued frames are sent
+void ofxNDIsend::StopPipeline()
+{
+	if (!m_convertThread.joinable())
+		return;
+
+	m_bPipelineQuit = true;
+	WakePipeline();
+	m_convertThread.join();
+	m_sendThread.join();
+}
+
+// Wake the pipeline threads and any WaitReleased
+void ofxNDIsend::WakePipeline()
+{
+	// Taking the lock means a thread cannot miss the change
+	// between testing for it and waiting
+	{
+		std::lock_guard<std::mutex> lock(m_pipelineMutex);
+	}
+	m_pipelineWake.notify_all();
+}
+
+// A frame to prepare with the sender settings at the time - caller thread
+// The convert thread uses the copies so that the settings can be changed
+// while frames are queued.
+ofxNDIsend::PipelineFrame ofxNDIsend::GetPipelineFrame(PipelineType type, const unsigned char *data,
+	unsigned int width, unsigned int height, unsigned int stride, bool bOption, bool bInvert, bool bReadOnly)
+{
+	PipelineFrame frame;
+	frame.type = type;
+	frame.data = data;
+	frame.width = width;
+	frame.height = height;
+	frame.stride = stride;
+	frame.bOption = bOption;
+	frame.bInvert = bInvert;
+	frame.bAsync = m_bAsync;
+	frame.colorFormat = m_ColorFormat;
+	frame.bNegativeStride = m_bNegativeStride;
+	frame.bInPlace = !bReadOnly && IsInPlace(data);
+	frame.bPoolData = false;
+	frame.number = 0;
+	frame.queueTime = 0;
+	frame.convertTime = 0;
+	frame.buffer = NULL;
+	return frame;
+}
+
+// Queue a frame for conversion - caller thread
+unsigned long long ofxNDIsend::QueuePipeline(PipelineType type, const unsigned char *data,
+	unsigned int width, unsigned int height, unsigned int stride, bool bOption, bool bInvert, bool bReadOnly)
+{
+	if (!m_convertThread.joinable() || !data || width == 0 || height == 0)
+		return 0;
+
+	// Audio and metadata are not held up by the video
+	SubmitAudioMetadata();
+
+	PipelineFrame queued = GetPipelineFrame(type, data, width, height, stride, bOption, bInvert, bReadOnly);
+	queued.number = m_nQueued + 1;
+	queued.queueTime = GetClockMicroseconds();
+	// A pool buffer is held so that the caller can return it now
+	queued.bPoolData = m_BufferPool->AddRef(data);
+
+	if (!m_convertQueue.Push(queued)) {
+		// The render thread does not wait for a full pipeline
+		if (queued.bPoolData)
+			m_BufferPool->Return(data);
+		m_nPipelineDropped++;
+		return 0;
+	}
+
+	m_nQueued = queued.number;
+	WakePipeline();
+
+	return queued.number;
+}
+
+// Queue the caller's data, copied to a pool buffer unless it is one,
+// so that the caller does not wait for the convert thread - caller thread
+bool ofxNDIsend::SendPipeline(PipelineType type, const unsigned char *data,
+	unsigned int width, unsigned int height, unsigned int stride, bool bOption, bool bInvert)
+{
+	if (!m_convertThread.joinable() || !data || width == 0 || height == 0)
+		return false;
+
+	// The pipeline holds a pool buffer until it is converted
+	if (m_BufferPool->Owns(data))
+		return QueuePipeline(type, data, width, height, stride, bOption, bInvert) != 0;
+
+	size_t size = GetDataBytes(type, width, height, stride);
+	unsigned char *copy = size > 0 ? m_BufferPool->Lease(size, this) : NULL;
+	if (!copy)
+		return false;
+	memcpy(copy, data, size);
+
+	// The copy is owned by this sender, so it is inverted or swapped in place
+	bool bQueued = QueuePipeline(type, copy, width, height, stride, bOption, bInvert) != 0;
+	m_BufferPool->Return(copy);
+
+	return bQueued;
+}
+
+// Bytes of the caller's data for a type of frame
+size_t ofxNDIsend::GetDataBytes(PipelineType type, unsigned int width, unsigned int height, unsigned int stride)
+{
+	switch (type) {
+	case PIPELINE_IMAGE:
+		return (size_t)width*height * 4;
+	case PIPELINE_IMAGE16:
+		return (size_t)width*height * 8;
+	case PIPELINE_V210:
+		if (stride == 0)
+			stride = ofxNDIutils::GetLineBytes(ofxNDIutils::FORMAT_V210, width);
+		return (size_t)height*stride;
+	case PIPELINE_FRAME:
+		// Planes and the UYVA alpha plane as for PrepareFrame
+		{
+			unsigned int planes = ofxNDI_IsHighBitDepth(m_ColorFormat) ? ofxNDIutils::GetPlanes(ofxNDI_HighBitDepthFormat(m_ColorFormat)) : 1;
+			size_t alphaSize = m_ColorFormat == NDIlib_FourCC_type_UYVA ? (size_t)width*height : 0;
+			return (size_t)height*stride*planes + alphaSize;
+		}
+	}
+	return 0;
+}
+
+// Convert queued frames to pool buffers for the send thread
+void ofxNDIsend::ConvertThread()
+{
+	PipelineFrame queued;
+
+	for (;;) {
+		{
+			// Wait for a frame and room for it in the send queue
+			std::unique_lock<std::mutex> lock(m_pipelineMutex);
+			m_pipelineWake.wait(lock, [this] {
+				return (m_convertQueue.Size() > 0 && m_sendQueue.Size() < m_sendQueue.Capacity())
+					|| (m_bPipelineQuit && m_convertQueue.Size() == 0); });
+		}
+
+		// Quit once every frame is converted
+		if (!m_convertQueue.Pop(queued))
+			break;
+
+		bool bResult = PrepareVideo(queued);
+
+		// The caller's data is no longer used
+		if (bResult)
+			bResult = HoldFrameData(queued.colorFormat);
+		if (queued.bPoolData)
+			m_BufferPool->Return(queued.data);
+		m_nReleased = queued.number;
+
+		long long now = GetClockMicroseconds();
+		UpdateLatency(m_convertLatency, now - queued.queueTime);
+
+		if (bResult) {
+			queued.frame = video_frame;
+			queued.buffer = p_frame;
+			queued.convertTime = now;
+			m_sendQueue.Push(queued);
+		}
+		else {
+			m_BufferPool->Return(p_frame);
+			m_nPipelineDropped++;
+		}
+		p_frame = NULL;
+
+		WakePipeline();
+	}
+
+	m_bConvertDone = true;
+	WakePipeline();
+}
+
+// Send converted frames
+// With clocked video, the NDI send waits here for the frame time
+void ofxNDIsend::SendThread()
+{
+	PipelineFrame queued;
+
+	for (;;) {
+		{
+			std::unique_lock<std::mutex> lock(m_pipelineMutex);
+			m_pipelineWake.wait(lock, [this] {
+				return m_sendQueue.Size() > 0 || m_bConvertDone; });
+		}
+
+		// Quit once conversion has stopped and every frame is sent
+		if (!m_sendQueue.Pop(queued))
+			break;
+
+		SubmitVideo(queued.frame, queued.buffer, queued.bAsync);
+		UpdateLatency(m_sendLatency, GetClockMicroseconds() - queued.convertTime);
+
+		// Room in the send queue
+		WakePipeline();
+	}
+}
+
+// Send converted frames at the frame rate
+// The NDI sender is not clocked, so async sends return at once
+// and the wait for each frame time is made here.
+void ofxNDIsend::PacingThread()
+{
+	typedef std::chrono::steady_clock clock;
+
+	// Frame times are counted from a start time that moves on by D seconds
+	// every N frames, so the period is the exact rational and never drifts.
+	long long rateN = m_frame_rate_N > 0 ? m_frame_rate_N : 60000;
+	long long rateD = m_frame_rate_D > 0 ? m_frame_rate_D : 1000;
+	std::chrono::nanoseconds period(rateD * 1000000000LL / rateN);
+	clock::time_point start = clock::now();
+	long long frame = 0;
+
+	PipelineFrame queued;
+	PipelineFrame last; // Sent last and held as the async frame
+	bool bLast = false;
+	bool bQuit = false;
+
+	while (!bQuit) {
+
+		clock::time_point frameTime = start + std::chrono::nanoseconds(frame * rateD * 1000000000LL / rateN);
+
+		// Sleep until shortly before the frame time, then yield
+		// to the time itself because sleeps can be a millisecond late
+		{
+			std::unique_lock<std::mutex> lock(m_pipelineMutex);
+			m_pipelineWake.wait_until(lock, frameTime - std::chrono::milliseconds(2),
+				[this] { return m_bConvertDone.load(); });
+		}
+		bQuit = m_bConvertDone.load();
+		while (!bQuit && clock::now() < frameTime)
+			std::this_thread::yield();
+
+		// The newest frame converted is sent and any older are dropped.
+		// Frames left when conversion has stopped are sent at once.
+		bool bFrame = false;
+		while (m_sendQueue.Pop(queued)) {
+			if (bFrame) {
+				m_BufferPool->Return(last.buffer);
+				m_nPacingDropped++;
+			}
+			last = queued;
+			bFrame = true;
+		}
+		WakePipeline(); // Room in the send queue
+
+		clock::time_point now = clock::now();
+		if (bFrame) {
+			bLast = true;
+			SubmitVideo(last.frame, last.buffer, true);
+			UpdateLatency(m_sendLatency, GetClockMicroseconds() - last.convertTime);
+		}
+		else if (bLast && !bQuit) {
+			// The async frame is held again for the repeat
+			m_BufferPool->AddRef(last.buffer);
+			SubmitVideo(last.frame, last.buffer, true);
+			m_nPacingRepeated++;
+		}
+
+		if (bQuit)
+			break;
+
+		// Jitter of the send from the frame time
+		double jitter = (double)std::chrono::duration_cast<std::chrono::microseconds>(now - frameTime).count() / 1000.0;
+		double average = m_pacingJitter.load();
+		m_pacingJitter = average <= 0.0 ? jitter : average*0.95 + jitter*0.05;
+		if (jitter > m_pacingMaxJitter.load())
+			m_pacingMaxJitter = jitter;
+
+		// Frame times already passed are missed rather than sent late
+		frame++;
+		long long behind = (long long)((now - frameTime) / period);
+		if (behind > 0) {
+			m_nPacingMissed += (unsigned int)behind;
+			frame += behind;
+		}
+
+		// Move the start on every N frames to keep the count small
+		if (frame >= rateN) {
+			start += std::chrono::seconds(rateD);
+			frame -= rateN;
+		}
+	}
+}
@@ -38,6 +38,19 @@
 	         - Header function comments expanded so that they are visible to the user
 			 - Add changes for OSX (https://github.com/ThomasLengeling/ofxNDI)
 			 - add "m_" prefix to all class variables
+	17.10.26 - SendImage converts to YUV422 for a UYVY sender
+			 - Add SendFrame
+			 - Add LeaseBuffer, ReturnBuffer - frame buffers from a pool
+			 - Add SetInPlace, GetInPlace
+			 - Add SetNegativeStride, GetNegativeStride
+			 - P216 and PA16 senders. Add SendImage16, SendFrameV210
+			 - UYVA senders
+			 - Windows headers for Windows only, x86intrin for other platforms
+			 - Add SetPipeline, QueueImage, QueueFrame and pipeline statistics
+			 - Add GetSubmittedFrames, GetFinishedFrames, FlushAsync
+			 - Add SetPacing and pacing statistics
+			 - NDI initialized once for the process and buffers leased from
+			   the shared pool (ofxNDIruntime). Add GetStreamId.
 
 */
 #pragma once
@@ -47,18 +60,25 @@
 #if defined(_WIN32)
 #include <windows.h>
 #include <intrin.h> // for _movsd
-#endif
-
-#if defined(__APPLE__)
-#include <x86intrin.h> // for _movsd
+#else
+#include <x86intrin.h> // OSX and Linux
 #endif
 
 #include <stdio.h>
 #include <string>
 #include <emmintrin.h> // for SSE2
 #include <iostream> // for cout
+#include <chrono> // for timing
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
 #include "Processing.NDI.Lib.h" // NDI SDK
 #include "ofxNDIutils.h" // buffer copy utilities
+#include "ofxNDIbufferpool.h" // frame buffers
+#include "ofxNDIruntime.h" // shared NDI library, buffer pool and statistics
+#include "ofxNDIqueue.h" // pipeline queues
+#include "ofxNDIformats.h" // P216 and PA16
 
 class ofxNDIsend {
 
@@ -74,7 +94,8 @@ public:
 	bool CreateSender(const char *sendername, unsigned int width, unsigned int height);
 
 	// Create a sender of specified colour format
-	// Formats supported are RGBA, BGRA and UVYV
+	// Formats supported are RGBA, BGRA, UVYV, UYVA and, with an NDI 4 runtime,
+	// ofxNDI_FourCC_type_P216 and ofxNDI_FourCC_type_PA16
 	// - sendername | name for the sender
 	// - width | sender image width
 	// - height | sender image height
@@ -98,9 +119,142 @@ public:
 	// - height | image height
 	// - bSwapRB | swap red and blue components - default false
 	// - bInvert | flip the image - default false
+	// For a UYVY, UYVA, P216 or PA16 sender the pixels are converted
+	// and bSwapRB indicates BGRA pixel data.
+	// UYVA is the UYVY lines followed by the alpha of each pixel.
 	bool SendImage(const unsigned char *image, unsigned int width, unsigned int height,
 		bool bSwapRB = false, bool bInvert = false);
 
+	// Send 16 bit RGBA image pixels to a P216 or PA16 sender
+	// - image | 4 components per pixel
+	// - width | image width
+	// - height | image height
+	// - bHalfFloat | half float 0-1 components rather than 0-65535
+	// - bInvert | flip the image - default false
+	bool SendImage16(const unsigned short *image, unsigned int width, unsigned int height,
+		bool bHalfFloat = false, bool bInvert = false);
+
+	// Send a frame already in the sender colour format
+	// e.g. UYVY produced by a shader. No conversion is done.
+	// - frame | frame data
+	// - width | image width
+	// - height | image height
+	// - stride | bytes per line of the frame data
+	// - bInvert | flip the image - default false
+	// P216 and PA16 planes follow each other with the same stride.
+	// The UYVA alpha plane follows the UYVY lines with width bytes per line.
+	bool SendFrame(const unsigned char *frame, unsigned int width, unsigned int height,
+		unsigned int stride, bool bInvert = false);
+
+	// Send a v210 frame to a P216 or PA16 sender
+	// - frame | 10 bit 4:2:2 frame data
+	// - width | image width
+	// - height | image height
+	// - stride | bytes per line, at least 128 per 48 pixels, 0 - packed
+	// - bInvert | flip the image - default false
+	bool SendFrameV210(const unsigned char *frame, unsigned int width, unsigned int height,
+		unsigned int stride = 0, bool bInvert = false);
+
+	// Lease a 64 byte aligned buffer from the sender buffer pool
+	// The buffer can be filled and passed to SendImage or SendFrame.
+	// For async sending the sender holds it until NDI has finished with it,
+	// so the caller can return it as soon as the send function returns.
+	// The sender owns the contents once it is passed, so invert and
+	// RGBA/BGRA swap are done in place as for SetInPlace.
+	// - size | bytes required
+	unsigned char *LeaseBuffer(size_t size);
+
+	// Return a buffer from LeaseBuffer
+	void ReturnBuffer(const unsigned char *buffer);
+
+	// Number of pool buffers allocated since the sender was created
+	// This should not increase while sending frames of the same size.
+	// Buffers come from a pool shared by all senders and receivers
+	// and a buffer returned by one can be leased by another.
+	unsigned int GetBufferAllocations();
+
+	// Id of the sender statistics in ofxNDIruntime::GetStreams
+	unsigned int GetStreamId();
+
+	// Convert and send frames on separate threads
+	// SendImage, SendImage16, SendFrame and SendFrameV210 copy the frame
+	// to a pool buffer, or hold a LeaseBuffer buffer without a copy,
+	// queue it and return at once. The caller never waits for the
+	// convert thread. The NDI send, which waits for the frame time
+	// with clocked video, is made by the send thread. A frame is dropped if the pipeline is full, so the caller
+	// never waits for the send. Audio and metadata are sent by the caller.
+	// - bPipeline | use the pipeline
+	// - nFrames | frames waiting for each stage
+	void SetPipeline(bool bPipeline = true, unsigned int nFrames = 2);
+
+	// Get whether the pipeline is used
+	bool GetPipeline();
+
+	// Queue image pixels on the pipeline without waiting
+	// Arguments as for SendImage.
+	// - bReadOnly | the pixels cannot be written, such as a buffer
+	//   mapped for reading, so they are not inverted or swapped in place
+	//   even with SetInPlace - default false
+	// Returns the frame number, or 0 if the pipeline is full or not used.
+	// The pixels must not change until GetReleasedFrames reaches the number.
+	unsigned long long QueueImage(const unsigned char *image, unsigned int width, unsigned int height,
+		bool bSwapRB = false, bool bInvert = false, bool bReadOnly = false);
+
+	// Queue a frame in the sender colour format without waiting
+	// Arguments as for SendFrame and bReadOnly as for QueueImage.
+	// Returns as for QueueImage.
+	unsigned long long QueueFrame(const unsigned char *frame, unsigned int width, unsigned int height,
+		unsigned int stride, bool bInvert = false, bool bReadOnly = false);
+
+	// Number of the last queued frame that is no longer used by the pipeline
+	unsigned long long GetReleasedFrames();
+
+	// Wait until a queued frame is no longer used by the pipeline
+	void WaitReleased(unsigned long long frame);
+
+	// Frames dropped because the pipeline was full
+	unsigned int GetPipelineDropped();
+
+	// Frames waiting for conversion
+	unsigned int GetConvertQueueDepth();
+
+	// Frames waiting to be sent
+	unsigned int GetSendQueueDepth();
+
+	// Time from queued to converted in milliseconds (averaged)
+	double GetConvertLatency();
+
+	// Time from converted to sent in milliseconds (averaged)
+	// With clocked video this includes the wait for the frame time.
+	double GetSendLatency();
+
+	// Send the video at the frame rate from the pipeline send thread
+	// instead of by NDI clocking. Frame times are calculated from the
+	// steady clock and the frame rate numerator and denominator, so they
+	// do not drift, and frames are sent asynchronously at each time.
+	// The newest frame converted is sent. A frame is repeated if no new
+	// one is ready and frames are dropped if more than one is ready.
+	// Set before CreateSender. The pipeline is started if it is not used.
+	void SetPacing(bool bPacing = true);
+
+	// Get whether the video is paced by the send thread
+	bool GetPacing();
+
+	// Frames sent again because no new frame was ready
+	unsigned int GetPacingRepeated();
+
+	// Frames not sent because a newer frame was ready
+	unsigned int GetPacingDropped();
+
+	// Frame times passed while the send thread was late
+	unsigned int GetPacingMissed();
+
+	// Difference of send from frame time in milliseconds (averaged)
+	double GetPacingJitter();
+
+	// Largest difference of send from frame time in milliseconds
+	double GetPacingMaxJitter();
+
 	// Close sender and release resources
 	void ReleaseSender();
 
@@ -168,6 +322,41 @@ public:
 	// Get whether async sending mode
 	bool GetAsync();
 
+	// Number of video frames submitted to NDI
+	unsigned long long GetSubmittedFrames();
+
+	// Number of video frames NDI has finished with
+	// An async frame is finished at the next synchronizing event,
+	// so the caller's pixels it was sent from must not change until then.
+	unsigned long long GetFinishedFrames();
+
+	// Wait until NDI has finished with an async frame
+	// Not for use with the pipeline, which holds its own frames.
+	void FlushAsync();
+
+	// Invert and swap red and blue in the pixels passed to
+	// SendImage and SendFrame instead of in a copy.
+	// No frame buffer is needed and the image is written once,
+	// but the caller's pixels are changed by the send.
+	// Pipeline frames use the setting when they are queued.
+	// Initialized false
+	void SetInPlace(bool bInPlace = true);
+
+	// Get whether in place mode
+	bool GetInPlace();
+
+	// Send an inverted image without flipping it. The frame is described
+	// by its last line and a negative line stride, so the pixels are
+	// neither copied nor changed. Only for NDI runtimes that accept a
+	// negative stride. Conversions to UYVY or BGRA are inverted in the
+	// same pass whether this is set or not.
+	// Pipeline frames use the setting when they are queued.
+	// Initialized false
+	void SetNegativeStride(bool bNegative = true);
+
+	// Get whether inverted frames are sent with a negative stride
+	bool GetNegativeStride();
+
 	// Set to send Audio
 	// Initialized false
 	void SetAudio(bool bAudio = true);
@@ -213,7 +402,12 @@ private:
 	NDIlib_send_create_t NDI_send_create_desc;
 	NDIlib_send_instance_t pNDI_send;
 	NDIlib_video_frame_v2_t video_frame;
-	uint8_t* p_frame;
+	std::shared_ptr<ofxNDIbufferpool> m_BufferPool; // Shared buffers for conversion, invert or the application
+	unsigned int m_streamId; // ofxNDIruntime statistics
+	const uint8_t* p_frame; // Pool buffer referenced for the frame being sent
+	const uint8_t* p_async_frame; // Pool buffer referenced while NDI sends it asynchronously
+	std::atomic<unsigned long long> m_nSubmitted; // Video frames submitted
+	std::atomic<unsigned long long> m_nFinished; // Video frames NDI has finished with
 
 	// Sender dimensions
 	unsigned int m_Width, m_Height;
@@ -229,6 +423,8 @@ private:
 	bool m_bProgressive; // Progressive output flag
 	bool m_bClockVideo; // Clock video flag
 	bool m_bAsync; // NDI asynchronous sender
+	bool m_bInPlace; // Invert and swap the caller's pixels
+	bool m_bNegativeStride; // Describe inverted frames with a negative stride
 	bool m_bNDIinitialized; // NDI initialized
 
 	// Audio
@@ -245,6 +441,126 @@ private:
 	NDIlib_metadata_frame_t metadata_frame; // The frame that will be sent
 	std::string m_metadataString; // XML message format string NULL terminated - application provided
 
+	// Lease a frame buffer of the size required for the video frame
+	uint8_t *GetFrameBuffer(size_t size);
+
+	// Use the caller's data for the video frame
+	// A pool buffer is referenced until it has been sent
+	void SetFrameData(const unsigned char *data);
+
+	// Use the caller's data for the video frame from the last line up
+	void SetInvertedFrameData(const unsigned char *data, unsigned int stride, unsigned int height);
+
+	// Whether the data can be inverted or swapped in place
+	// (SetInPlace or a leased buffer)
+	bool IsInPlace(const unsigned char *data);
+
+	// Line stride of a packed frame of the colour format
+	unsigned int GetLineStride(unsigned int width, NDIlib_FourCC_type_e colorFormat);
+
+	// Convert to a frame buffer for a P216 or PA16 sender
+	// - colorFormat | sender format the frame is prepared for
+	bool ConvertFrame(const unsigned char *source, unsigned int stride, ofxNDIutils::PixelFormat format,
+		unsigned int width, unsigned int height, bool bInvert, NDIlib_FourCC_type_e colorFormat);
+
+	// Convert or reference the data for the video frame
+	// The Send functions without the NDI send. The sender settings
+	// are passed as copied for the frame (GetPipelineFrame).
+	// - bInPlace | the data can be inverted or swapped in place
+	bool PrepareImage(const unsigned char *image, unsigned int width, unsigned int height,
+		bool bSwapRB, bool bInvert, NDIlib_FourCC_type_e colorFormat, bool bNegativeStride, bool bInPlace);
+	bool PrepareImage16(const unsigned short *image, unsigned int width, unsigned int height,
+		bool bHalfFloat, bool bInvert, NDIlib_FourCC_type_e colorFormat);
+	bool PrepareFrame(const unsigned char *frame, unsigned int width, unsigned int height,
+		unsigned int stride, bool bInvert, NDIlib_FourCC_type_e colorFormat, bool bNegativeStride, bool bInPlace);
+	bool PrepareFrameV210(const unsigned char *frame, unsigned int width, unsigned int height,
+		unsigned int stride, bool bInvert, NDIlib_FourCC_type_e colorFormat);
+
+	// Send audio, metadata and the current video frame
+	// then release the buffers that NDI has finished with
+	void SubmitFrame();
+
+	// Send audio and metadata
+	void SubmitAudioMetadata();
+
+	// Send a video frame referencing a pool buffer (or NULL)
+	// then release the buffers that NDI has finished with
+	void SubmitVideo(const NDIlib_video_frame_v2_t &frame, const uint8_t *buffer, bool bAsync);
+
+	// Pipeline
+	enum PipelineType {
+		PIPELINE_IMAGE,
+		PIPELINE_IMAGE16,
+		PIPELINE_FRAME,
+		PIPELINE_V210
+	};
+	struct PipelineFrame {
+		PipelineType type;
+		const unsigned char *data; // Caller's data
+		unsigned int width, height, stride;
+		bool bOption; // Swap RB or half float
+		bool bInvert;
+		bool bAsync;
+		NDIlib_FourCC_type_e colorFormat; // Sender settings when queued
+		bool bNegativeStride;
+		bool bInPlace; // IsInPlace when queued, false for read only data
+		bool bPoolData; // The data is a pool buffer held by the pipeline
+		unsigned long long number;
+		long long queueTime; // Steady clock microseconds
+		long long convertTime;
+		NDIlib_video_frame_v2_t frame; // Converted frame
+		const uint8_t *buffer; // Pool buffer referenced by the converted frame
+	};
+	// Frame details with a copy of the sender settings to prepare it with
+	PipelineFrame GetPipelineFrame(PipelineType type, const unsigned char *data,
+		unsigned int width, unsigned int height, unsigned int stride, bool bOption, bool bInvert,
+		bool bReadOnly = false);
+	// Prepare the video frame with the Prepare function for the type
+	// and count the time for the stream statistics
+	bool PrepareVideo(const PipelineFrame &frame);
+	bool m_bPipeline;
+	unsigned int m_nPipelineFrames; // Queue size
+	ofxNDIqueue<PipelineFrame> m_convertQueue; // Caller to convert thread
+	ofxNDIqueue<PipelineFrame> m_sendQueue; // Convert thread to send thread
+	std::thread m_convertThread;
+	std::thread m_sendThread;
+	std::mutex m_pipelineMutex; // For m_pipelineWake only
+	std::condition_variable m_pipelineWake;
+	std::atomic<bool> m_bPipelineQuit;
+	std::atomic<bool> m_bConvertDone;
+	unsigned long long m_nQueued; // Caller thread only
+	std::atomic<unsigned long long> m_nReleased;
+	std::atomic<unsigned int> m_nPipelineDropped;
+	std::atomic<double> m_convertLatency;
+	std::atomic<double> m_sendLatency;
+	bool m_bPacing;
+	std::atomic<unsigned int> m_nPacingRepeated;
+	std::atomic<unsigned int> m_nPacingDropped;
+	std::atomic<unsigned int> m_nPacingMissed;
+	std::atomic<double> m_pacingJitter;
+	std::atomic<double> m_pacingMaxJitter;
+	void StartPipeline();
+	void StopPipeline();
+	void WakePipeline();
+	unsigned long long QueuePipeline(PipelineType type, const unsigned char *data,
+		unsigned int width, unsigned int height, unsigned int stride, bool bOption, bool bInvert,
+		bool bReadOnly = false);
+	// Queue the caller's data, copied to a pool buffer unless it is one
+	bool SendPipeline(PipelineType type, const unsigned char *data,
+		unsigned int width, unsigned int height, unsigned int stride, bool bOption, bool bInvert);
+	// Bytes of the caller's data for a type of frame
+	size_t GetDataBytes(PipelineType type, unsigned int width, unsigned int height, unsigned int stride);
+	void ConvertThread();
+	void SendThread();
+	void PacingThread();
+
+	// Copy the caller's data referenced by the video frame
+	// so that it can be released before the frame is sent
+	// - colorFormat | sender format the frame was prepared for
+	bool HoldFrameData(NDIlib_FourCC_type_e colorFormat);
+
+	// Release the asynchronous frame after a synchronizing event
+	void ReleaseAsyncFrame();
 
 };
 
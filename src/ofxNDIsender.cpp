@@ -30,17 +30,55 @@
 	19.07.18 - ofDisableAlphaBlending before RGBA to YUV conversion
 	29.07.18 - Quit SendImage if fbo or texture is not RGBA
 	06.08.18 - Add GetSenderName()
+	17.10.26 - Send shader converted UYVY with SendFrame
+			   ofImage and ofPixels are converted to UYVY by ofxNDIsend
+			 - Read pixels into buffers leased from the ofxNDIsend pool
+			   instead of alternating between two ofPixels
+			 - Leased fbo and texture pixels are inverted in place by ofxNDIsend
+			 - Add SetInPlace, GetInPlace
+			 - UYVY and BGRA fbo or texture images are inverted by the
+			   colour conversion draw instead of a CPU pass
+			 - Add SetNegativeStride, GetNegativeStride
+			 - Add SendImage for ofShortPixels. P216 and PA16 senders
+			   convert fbo, texture and 8 bit pixels in ofxNDIsend.
+			 - UYVA fbo and texture sending. One shader draw produces the
+			   UYVY lines and the alpha plane, read back as a single frame.
+			   Images the shader cannot draw are converted by ofxNDIsend.
+			 - UpdateSender with a colour format changes the format
+			 - Add SetPipeline. Fbo and texture pixels read into a PBO are
+			   queued from the mapped PBO, and converted and sent on the
+			   ofxNDIsend pipeline threads. Add GetReadbackTime and
+			   pipeline statistics.
+			 - Readback through a ring of PBOs, default 3. A PBO is mapped
+			   only once its fence has signalled. Add SetReadbackBuffers,
+			   SetReadbackSkip, GetReadbackLatency and GetReadbackSkipped.
+			 - SendImage for an fbo or texture of a new size updates
+			   the PBOs and utility fbos as well as the sender
+			 - Add SetReadbackPersistent. PBOs mapped with GL_MAP_PERSISTENT_BIT
+			   are sent from the mapped memory instead of copied to a buffer,
+			   and read into again once NDI has finished with the frame.
+			 - Add SetPacing and pacing statistics. Paced frames are sent
+			   from the ofxNDIsend pipeline, which is started if not used.
+			 - Add GetStreamId for ofxNDIruntime statistics
+			 - PBO ring moved to ofxNDIreadback. The OpenGL calls are made
+			   by ofxNDIpboGL so that the ring can be tested without OpenGL.
 
 */
 #include "ofxNDIsender.h"
 
+// Steady clock time in microseconds
+static long long GetClockMicroseconds()
+{
+	return (long long)std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
 
 ofxNDIsender::ofxNDIsender()
+	: m_readback(NDIsender, m_pboGL)
 {
 	m_ColorFormat = NDIlib_FourCC_type_RGBA; // default rgba output format
 	m_bReadback = false; // Asynchronous fbo pixel data readback option
-	ndiPbo[0] = 0;
-	ndiPbo[1] = 0;
+	m_readbackTime = 0.0;
 	m_SenderName = "";
 
 }
@@ -63,25 +101,15 @@ bool ofxNDIsender::CreateSender(const char *sendername, unsigned int width, unsi
 
 	// printf("ofxNDIsender::CreateSender %s, %dx%d\n", sendername, width, height);
 
-	// Initialize pixel buffers for sending
-	ndiBuffer[0].allocate(width, height, 4);
-	ndiBuffer[1].allocate(width, height, 4);
-	m_idx = 0;
-
 	// Initialize OpenGL pbos for asynchronous readback of fbo data
-	glGenBuffers(2, ndiPbo);
-	glBindBufferARB(GL_PIXEL_UNPACK_BUFFER_ARB, ndiPbo[0]);
-	glBufferDataARB(GL_PIXEL_UNPACK_BUFFER_ARB, width*height * 4, 0, GL_STREAM_READ);
-	glBindBufferARB(GL_PIXEL_UNPACK_BUFFER_ARB, ndiPbo[1]);
-	glBufferDataARB(GL_PIXEL_UNPACK_BUFFER_ARB, width*height * 4, 0, GL_STREAM_READ);
-	glBindBufferARB(GL_PIXEL_UNPACK_BUFFER_ARB, 0);
-	PboIndex = NextPboIndex = 0; // index used for asynchronous fbo readback
+	m_readback.Allocate(width, height);
 
 	// Allocate utility fbo
 	ndiFbo.allocate(width, height, GL_RGBA);
 
 	// Set user specified colour format
 	m_ColorFormat = colorFormat;
+	AllocateUyvaFbo(width, height);
 
 	if (NDIsender.CreateSender(sendername, width, height, colorFormat)) {
 		m_SenderName = sendername;
@@ -102,39 +130,28 @@ bool ofxNDIsender::UpdateSender(unsigned int width, unsigned int height)
 // Update sender dimensions and colour format
 bool ofxNDIsender::UpdateSender(unsigned int width, unsigned int height, NDIlib_FourCC_type_e colorFormat)
 {
-	// Re-initialize pixel buffers
-	ndiBuffer[0].allocate(width, height, 4);
-	ndiBuffer[1].allocate(width, height, 4);
-	m_idx = 0;
-
 	// Delete and re-initialize OpenGL pbos
-	if (ndiPbo[0])	glDeleteBuffers(2, ndiPbo);
-	glGenBuffers(2, ndiPbo);
-	glBindBufferARB(GL_PIXEL_UNPACK_BUFFER_ARB, ndiPbo[0]);
-	glBufferDataARB(GL_PIXEL_UNPACK_BUFFER_ARB, width*height * 4, 0, GL_STREAM_READ);
-	glBindBufferARB(GL_PIXEL_UNPACK_BUFFER_ARB, ndiPbo[1]);
-	glBufferDataARB(GL_PIXEL_UNPACK_BUFFER_ARB, width*height * 4, 0, GL_STREAM_READ);
-	glBindBufferARB(GL_PIXEL_UNPACK_BUFFER_ARB, 0);
-	PboIndex = NextPboIndex = 0; // reset index used for asynchronous fbo readback
+	// Frames still in the ring are of the previous size and are discarded
+	m_readback.Allocate(width, height);
 
 	// Re-initialize utility fbo
 	ndiFbo.allocate(width, height, GL_RGBA);
 
-	return NDIsender.UpdateSender(width, height);
+	m_ColorFormat = colorFormat;
+	AllocateUyvaFbo(width, height);
+
+	return NDIsender.UpdateSender(width, height, colorFormat);
 }
 
 // Close sender and release resources
 void ofxNDIsender::ReleaseSender()
 {
-	// Delete async sending buffers
-	if (ndiBuffer[0].isAllocated())	ndiBuffer[0].clear();
-	if (ndiBuffer[1].isAllocated())	ndiBuffer[1].clear();
-
 	// Delete fbo readback pbos
-	if (ndiPbo[0]) glDeleteBuffers(2, ndiPbo);
+	m_readback.Delete();
 
 	// Release utility fbo
 	if (ndiFbo.isAllocated()) ndiFbo.clear();
+	if (ndiUyvaFbo.isAllocated()) ndiUyvaFbo.clear();
 
 	// Release sender
 	NDIsender.ReleaseSender();
@@ -163,7 +180,7 @@ unsigned int ofxNDIsender::GetHeight()
 // Send ofFbo
 bool ofxNDIsender::SendImage(ofFbo fbo, bool bInvert)
 {
-	if (!ndiBuffer[0].isAllocated() || !ndiBuffer[1].isAllocated())
+	if (!NDIsender.SenderCreated())
 		return false;
 
 	// Quit if the fbo is not RGBA
@@ -174,46 +191,85 @@ bool ofxNDIsender::SendImage(ofFbo fbo, bool bInvert)
 	unsigned int height = (unsigned int)fbo.getHeight();
 
 
-	// Update the sender if the dimensions are changed
+	// Update the sender, PBOs and utility fbos if the dimensions are changed
 	if (width != NDIsender.GetWidth() || height != NDIsender.GetHeight())
-		NDIsender.UpdateSender(width, height);
+		UpdateSender(width, height);
+
+	long long startTime = GetClockMicroseconds();
+
+	// With the pipeline, pixels read into a PBO are queued from the
+	// PBO memory so that the copy is made by the convert thread.
+	// Persistent mapped PBOs are sent from the PBO memory.
+	bool bQueue = m_bReadback && m_readback.IsMapped();
+
+	// Lease a buffer for the pixels. For asynchronous NDI sending
+	// the sender holds the buffer while it is "in flight" and being
+	// processed by the API, so it can be returned after sending.
+	unsigned char *buffer = NULL;
+	if (!bQueue) {
+		buffer = NDIsender.LeaseBuffer(width*height * 4);
+		if (!buffer)
+			return false;
+	}
 
-	// For asynchronous NDI sending, alternate between buffers because
-	// one buffer is being filled in while the second is "in flight"
-	// and being processed by the API.
-	if (GetAsync())
-		m_idx = (m_idx + 1) % 2;
+	// Frame stride if the buffer is converted to the sender format
+	unsigned int frameStride = 0;
 
 	switch (m_ColorFormat) {
 	case NDIlib_FourCC_type_UYVY:
-		// case NDIlib_FourCC_type_UYVA: // Alpha out not supported yet
 		ofDisableAlphaBlending();
-		ColorConvert(fbo); // RGBA to YUV422
-		ReadPixels(ndiFbo, width, height, ndiBuffer[m_idx].getData());
+		ColorConvert(fbo, bInvert); // RGBA to YUV422
+		ReadPixels(ndiFbo, width, height, buffer);
+		bInvert = false; // Inverted by the conversion
+		// The shader output is already UYVY with RGBA line stride
+		frameStride = width * 4;
+		break;
+	case NDIlib_FourCC_type_UYVA:
+		ofDisableAlphaBlending(); // Alpha is written as data
+		if (AlphaConvert(fbo.getTexture(), bInvert)) {
+			// UYVY lines then the alpha plane
+			ReadPixels(ndiUyvaFbo, width / 2, height * 3 / 2, buffer);
+			bInvert = false;
+			frameStride = width * 2;
+		}
+		else {
+			ReadPixels(fbo, width, height, buffer);
+		}
 		break;
 	case NDIlib_FourCC_type_BGRA:
 	case NDIlib_FourCC_type_BGRX:
 		// RGBA to BGRA into the utilty fbo
-		ColorSwap(fbo);
+		ColorSwap(fbo, bInvert);
 		// Get pixel data from the fbo
-		ReadPixels(ndiFbo, width, height, ndiBuffer[m_idx].getData());
+		ReadPixels(ndiFbo, width, height, buffer);
+		bInvert = false;
 		break;
 	default:
 		// Default RGBA output
-		ReadPixels(fbo, width, height, ndiBuffer[m_idx].getData());
+		ReadPixels(fbo, width, height, buffer);
 		break;
 	}
 
-	// return NDIsender.SendImage((const unsigned char *)ndiBuffer[m_idx].getPixels(), width, height, false, bInvert); // for < OF10
-	return NDIsender.SendImage((const unsigned char *)ndiBuffer[m_idx].getData(), width, height, false, bInvert);
+	bool bResult = false;
+	if (m_bReadback)
+		bResult = m_readback.Send(buffer, width, height, frameStride, bInvert);
+	else if (frameStride > 0)
+		bResult = NDIsender.SendFrame(buffer, width, height, frameStride, bInvert);
+	else
+		bResult = NDIsender.SendImage(buffer, width, height, false, bInvert);
+
+	NDIsender.ReturnBuffer(buffer);
+	UpdateReadbackTime(startTime);
+
+	return bResult;
 
 }
 
 // Send ofTexture
 bool ofxNDIsender::SendImage(ofTexture tex, bool bInvert)
 {
-	if (!ndiBuffer[0].isAllocated() || !ndiBuffer[1].isAllocated()) {
-		printf("Buffers not allocated\n");
+	if (!NDIsender.SenderCreated()) {
+		printf("Sender not created\n");
 		return false;
 	}
 
@@ -227,35 +283,69 @@ bool ofxNDIsender::SendImage(ofTexture tex, bool bInvert)
 	unsigned int height = (unsigned int)tex.getHeight();
 
 	if (width != NDIsender.GetWidth() || height != NDIsender.GetHeight())
-		NDIsender.UpdateSender(width, height);
+		UpdateSender(width, height);
+
+	long long startTime = GetClockMicroseconds();
+
+	bool bQueue = m_bReadback && m_readback.IsMapped();
+	unsigned char *buffer = NULL;
+	if (!bQueue) {
+		buffer = NDIsender.LeaseBuffer(width*height * 4);
+		if (!buffer)
+			return false;
+	}
 
-	if (GetAsync())
-		m_idx = (m_idx + 1) % 2;
+	unsigned int frameStride = 0;
 
 	switch (m_ColorFormat) {
 	case NDIlib_FourCC_type_UYVY:
 		ofDisableAlphaBlending(); // Avoid alpha trails
-		ColorConvert(tex);
-		ReadPixels(ndiFbo, width, height, ndiBuffer[m_idx].getData());
+		ColorConvert(tex, bInvert);
+		ReadPixels(ndiFbo, width, height, buffer);
+		bInvert = false;
+		frameStride = width * 4;
+		break;
+	case NDIlib_FourCC_type_UYVA:
+		ofDisableAlphaBlending();
+		if (AlphaConvert(tex, bInvert)) {
+			ReadPixels(ndiUyvaFbo, width / 2, height * 3 / 2, buffer);
+			bInvert = false;
+			frameStride = width * 2;
+		}
+		else {
+			ReadPixels(tex, width, height, buffer);
+		}
 		break;
 	case NDIlib_FourCC_type_BGRA:
 	case NDIlib_FourCC_type_BGRX:
-		ColorSwap(tex);
-		ReadPixels(ndiFbo, width, height, ndiBuffer[m_idx].getData());
+		ColorSwap(tex, bInvert);
+		ReadPixels(ndiFbo, width, height, buffer);
+		bInvert = false;
 		break;
 	default:
-		ReadPixels(tex, width, height, ndiBuffer[m_idx].getData());
+		ReadPixels(tex, width, height, buffer);
 		break;
 	}
 
-	return NDIsender.SendImage((const unsigned char *)ndiBuffer[m_idx].getData(), width, height, false, bInvert);
+	bool bResult = false;
+	if (m_bReadback)
+		bResult = m_readback.Send(buffer, width, height, frameStride, bInvert);
+	else if (frameStride > 0)
+		bResult = NDIsender.SendFrame(buffer, width, height, frameStride, bInvert);
+	else
+		bResult = NDIsender.SendImage(buffer, width, height, false, bInvert);
+
+	NDIsender.ReturnBuffer(buffer);
+	UpdateReadbackTime(startTime);
+
+	return bResult;
 
 }
 
 // Send ofImage
 bool ofxNDIsender::SendImage(ofImage img, bool bInvert)
 {
-	if (!ndiBuffer[0].isAllocated() || !ndiBuffer[1].isAllocated())
+	if (!NDIsender.SenderCreated())
 		return false;
 
 	// RGBA only for images and pixels
@@ -270,7 +360,7 @@ bool ofxNDIsender::SendImage(ofImage img, bool bInvert)
 // Send ofPixels
 bool ofxNDIsender::SendImage(ofPixels pix, bool bInvert)
 {
-	if (!ndiBuffer[0].isAllocated() || !ndiBuffer[1].isAllocated()) 
+	if (!NDIsender.SenderCreated())
 		return false;
 
 	if (pix.getImageType() != OF_IMAGE_COLOR_ALPHA)
@@ -281,6 +371,20 @@ bool ofxNDIsender::SendImage(ofPixels pix, bool bInvert)
 
 }
 
+// Send 16 bit ofShortPixels
+bool ofxNDIsender::SendImage(ofShortPixels pix, bool bInvert)
+{
+	if (!NDIsender.SenderCreated())
+		return false;
+
+	if (pix.getImageType() != OF_IMAGE_COLOR_ALPHA)
+		pix.setImageType(OF_IMAGE_COLOR_ALPHA);
+
+	return NDIsender.SendImage16(pix.getData(),
+		(unsigned int)pix.getWidth(), (unsigned int)pix.getHeight(), false, bInvert);
+
+}
+
 // Send RGBA image pixels
 bool ofxNDIsender::SendImage(const unsigned char * pixels,
 	unsigned int width, unsigned int height,
@@ -315,6 +419,12 @@ void ofxNDIsender::SetFrameRate(int framerate_N, int framerate_D)
 	NDIsender.SetFrameRate(framerate_N, framerate_D);
 }
 
+// Id of the sender statistics
+unsigned int ofxNDIsender::GetStreamId()
+{
+	return NDIsender.GetStreamId();
+}
+
 // Return current fps
 double ofxNDIsender::GetFps()
 {
@@ -383,6 +493,30 @@ bool ofxNDIsender::GetAsync()
 	return NDIsender.GetAsync();
 }
 
+// Set to invert and swap the caller's pixels in place
+void ofxNDIsender::SetInPlace(bool bInPlace)
+{
+	NDIsender.SetInPlace(bInPlace);
+}
+
+// Get whether in place mode
+bool ofxNDIsender::GetInPlace()
+{
+	return NDIsender.GetInPlace();
+}
+
+// Set to send inverted frames with a negative line stride
+void ofxNDIsender::SetNegativeStride(bool bNegative)
+{
+	NDIsender.SetNegativeStride(bNegative);
+}
+
+// Get whether inverted frames are sent with a negative stride
+bool ofxNDIsender::GetNegativeStride()
+{
+	return NDIsender.GetNegativeStride();
+}
+
 // Set asynchronous readback of pixels from FBO or texture
 void ofxNDIsender::SetReadback(bool bReadback)
 {
@@ -395,6 +529,157 @@ bool ofxNDIsender::GetReadback()
 	return m_bReadback;
 }
 
+// Set the number of PBOs used for readback
+void ofxNDIsender::SetReadbackBuffers(unsigned int nBuffers)
+{
+	// The ring is created again for the sender size
+	m_readback.SetBuffers(nBuffers);
+}
+
+// Get the number of readback PBOs
+unsigned int ofxNDIsender::GetReadbackBuffers()
+{
+	return m_readback.GetBuffers();
+}
+
+// Skip a frame instead of waiting when the readback ring is full
+void ofxNDIsender::SetReadbackSkip(bool bSkip)
+{
+	m_readback.SetSkip(bSkip);
+}
+
+// Get whether frames are skipped when the readback ring is full
+bool ofxNDIsender::GetReadbackSkip()
+{
+	return m_readback.GetSkip();
+}
+
+// Frames from readback to send (averaged)
+double ofxNDIsender::GetReadbackLatency()
+{
+	return m_readback.GetLatency();
+}
+
+// Frames not read back because the ring was full
+unsigned int ofxNDIsender::GetReadbackSkipped()
+{
+	return m_readback.GetSkipped();
+}
+
+// Map the readback PBOs once for the life of the sender
+void ofxNDIsender::SetReadbackPersistent(bool bPersistent)
+{
+	m_readback.SetPersistent(bPersistent);
+}
+
+// Get whether persistent mapped PBOs are used
+bool ofxNDIsender::GetReadbackPersistent()
+{
+	return m_readback.GetPersistent();
+}
+
+// Read back, convert and send on separate threads
+void ofxNDIsender::SetPipeline(bool bPipeline, unsigned int nFrames)
+{
+	// PBOs queued are released while the pipeline is stopped
+	// and the ring is created again for the pipeline (ofxNDIreadback::Allocate)
+	bool bPbos = m_readback.IsAllocated();
+	m_readback.Delete();
+	NDIsender.SetPipeline(bPipeline, nFrames);
+	if (bPbos)
+		m_readback.Allocate(NDIsender.GetWidth(), NDIsender.GetHeight());
+}
+
+// Get whether the pipeline is used
+bool ofxNDIsender::GetPipeline()
+{
+	return NDIsender.GetPipeline();
+}
+
+// Render thread time of SendImage for an fbo or texture
+double ofxNDIsender::GetReadbackTime()
+{
+	return m_readbackTime;
+}
+
+// Frames dropped because the pipeline was full
+unsigned int ofxNDIsender::GetPipelineDropped()
+{
+	return NDIsender.GetPipelineDropped();
+}
+
+// Frames waiting for conversion
+unsigned int ofxNDIsender::GetConvertQueueDepth()
+{
+	return NDIsender.GetConvertQueueDepth();
+}
+
+// Frames waiting to be sent
+unsigned int ofxNDIsender::GetSendQueueDepth()
+{
+	return NDIsender.GetSendQueueDepth();
+}
+
+// Queued to converted in milliseconds
+double ofxNDIsender::GetConvertLatency()
+{
+	return NDIsender.GetConvertLatency();
+}
+
+// Converted to sent in milliseconds
+double ofxNDIsender::GetSendLatency()
+{
+	return NDIsender.GetSendLatency();
+}
+
+// Send the video at the frame rate from the pipeline send thread
+void ofxNDIsender::SetPacing(bool bPacing)
+{
+	// Pacing uses the pipeline, so the ring is created again
+	// with the extra PBO for the pipeline (ofxNDIreadback::Allocate)
+	bool bPbos = m_readback.IsAllocated();
+	m_readback.Delete();
+	NDIsender.SetPacing(bPacing);
+	if (bPbos)
+		m_readback.Allocate(NDIsender.GetWidth(), NDIsender.GetHeight());
+}
+
+// Get whether the video is paced by the send thread
+bool ofxNDIsender::GetPacing()
+{
+	return NDIsender.GetPacing();
+}
+
+// Frames sent again because no new frame was ready
+unsigned int ofxNDIsender::GetPacingRepeated()
+{
+	return NDIsender.GetPacingRepeated();
+}
+
+// Frames not sent because a newer frame was ready
+unsigned int ofxNDIsender::GetPacingDropped()
+{
+	return NDIsender.GetPacingDropped();
+}
+
+// Frame times passed while the send thread was late
+unsigned int ofxNDIsender::GetPacingMissed()
+{
+	return NDIsender.GetPacingMissed();
+}
+
+// Send from frame time in milliseconds
+double ofxNDIsender::GetPacingJitter()
+{
+	return NDIsender.GetPacingJitter();
+}
+
+// Largest send from frame time in milliseconds
+double ofxNDIsender::GetPacingMaxJitter()
+{
+	return NDIsender.GetPacingMaxJitter();
+}
+
 // Get current sender name
 std::string ofxNDIsender::GetSenderName()
 {
@@ -460,38 +745,84 @@ std::string ofxNDIsender::GetNDIversion()
 //
 
 // Convert fbo texture from RGBA to UVYV
-void ofxNDIsender::ColorConvert(ofFbo fbo) {
+void ofxNDIsender::ColorConvert(ofFbo fbo, bool bInvert) {
 
 	ndiFbo.begin();
 	yuvshaders.rgba2yuvShader.begin();
 	fbo.getTexture().bind(1); // Source of RGBA pixels
 	yuvshaders.rgba2yuvShader.setUniformTexture("rgbatex", fbo.getTexture(), 1);
-	ndiFbo.draw(0, 0);
+	// A negative height flips the texture coordinates used by the shader
+	if (bInvert)
+		ndiFbo.draw(0, ndiFbo.getHeight(), ndiFbo.getWidth(), -ndiFbo.getHeight());
+	else
+		ndiFbo.draw(0, 0);
 	yuvshaders.rgba2yuvShader.end();
 	ndiFbo.end(); // result is in the utility fbo
 
 }
 
 // Convert texture from RGBA to UVYV
-void ofxNDIsender::ColorConvert(ofTexture texture) {
+void ofxNDIsender::ColorConvert(ofTexture texture, bool bInvert) {
 
 	ndiFbo.begin();
 	yuvshaders.rgba2yuvShader.begin();
 	texture.bind(1);
 	yuvshaders.rgba2yuvShader.setUniformTexture("rgbatex", texture, 1);
-	ndiFbo.draw(0, 0);
+	if (bInvert)
+		ndiFbo.draw(0, ndiFbo.getHeight(), ndiFbo.getWidth(), -ndiFbo.getHeight());
+	else
+		ndiFbo.draw(0, 0);
 	yuvshaders.rgba2yuvShader.end();
 	ndiFbo.end();
 }
 
+// Convert texture from RGBA to UYVY and alpha planes
+bool ofxNDIsender::AlphaConvert(ofTexture texture, bool bInvert) {
+
+	unsigned int width = (unsigned int)texture.getWidth();
+	unsigned int height = (unsigned int)texture.getHeight();
+	if (!ndiUyvaFbo.isAllocated()
+		|| (unsigned int)ndiUyvaFbo.getWidth() * 2 != width
+		|| (unsigned int)ndiUyvaFbo.getHeight() != height * 3 / 2)
+		return false;
+
+	ndiUyvaFbo.begin();
+	yuvshaders.rgba2uyvaShader.begin();
+	texture.bind(1);
+	yuvshaders.rgba2uyvaShader.setUniformTexture("rgbatex", texture, 1);
+	yuvshaders.rgba2uyvaShader.setUniform1f("width", (float)width);
+	yuvshaders.rgba2uyvaShader.setUniform1f("height", (float)height);
+	// The shader flips the UYVY lines and alpha plane separately
+	yuvshaders.rgba2uyvaShader.setUniform1f("invert", bInvert ? 1.0f : 0.0f);
+	ndiUyvaFbo.draw(0, 0);
+	yuvshaders.rgba2uyvaShader.end();
+	ndiUyvaFbo.end();
+
+	return true;
+}
+
+// Allocate the UYVA planes fbo
+// Four pixels of alpha for each texel and two alpha lines for each fbo line
+void ofxNDIsender::AllocateUyvaFbo(unsigned int width, unsigned int height) {
+
+	if (ndiUyvaFbo.isAllocated())
+		ndiUyvaFbo.clear();
+	if (m_ColorFormat == NDIlib_FourCC_type_UYVA && width % 4 == 0 && height % 2 == 0)
+		ndiUyvaFbo.allocate(width / 2, height * 3 / 2, GL_RGBA);
+}
+
 // Convert fbo texture RGBA <> BGRA
-void ofxNDIsender::ColorSwap(ofFbo fbo) {
+void ofxNDIsender::ColorSwap(ofFbo fbo, bool bInvert) {
 
 	ndiFbo.begin();
 	fbo.getTexture().bind(0);
 	yuvshaders.rgba2bgra.begin();
 	yuvshaders.rgba2bgra.setUniformTexture("texInput", fbo.getTexture(), 0);
-	fbo.draw(0, 0); // Result goes to the ndiFbo texture
+	// Result goes to the ndiFbo texture
+	if (bInvert)
+		fbo.draw(0, fbo.getHeight(), fbo.getWidth(), -fbo.getHeight());
+	else
+		fbo.draw(0, 0);
 	yuvshaders.rgba2bgra.end();
 	fbo.getTexture().unbind();
 	ndiFbo.end();
@@ -499,13 +830,16 @@ void ofxNDIsender::ColorSwap(ofFbo fbo) {
 }
 
 // Convert texture RGBA <> BGRA
-void ofxNDIsender::ColorSwap(ofTexture texture) {
+void ofxNDIsender::ColorSwap(ofTexture texture, bool bInvert) {
 
 	ndiFbo.begin();
 	texture.bind(0);
 	yuvshaders.rgba2bgra.begin();
 	yuvshaders.rgba2bgra.setUniformTexture("texInput", texture, 0);
-	texture.draw(0, 0); // Result goes to the ndiFbo texture
+	if (bInvert)
+		texture.draw(0, texture.getHeight(), texture.getWidth(), -texture.getHeight());
+	else
+		texture.draw(0, 0); // Result goes to the ndiFbo texture
 	yuvshaders.rgba2bgra.end();
 	texture.unbind();
 	ndiFbo.end();
@@ -515,19 +849,29 @@ void ofxNDIsender::ColorSwap(ofTexture texture) {
 // Read pixels from fbo to buffer
 void ofxNDIsender::ReadPixels(ofFbo fbo, unsigned int width, unsigned int height, unsigned char *data)
 {
-	if (m_bReadback) // Asynchronous readback using two pbos
-		ReadFboPixels(fbo, width, height, ndiBuffer[m_idx].getData());
-	else // Read fbo directly
-		fbo.readToPixels(ndiBuffer[m_idx]);
+	if (m_bReadback) { // Asynchronous readback using two pbos
+		ReadFboPixels(fbo, width, height, data);
+	}
+	else { // Read fbo directly into the buffer
+		m_readback.Release();
+		ofPixels pixels;
+		pixels.setFromExternalPixels(data, width, height, OF_PIXELS_RGBA);
+		fbo.readToPixels(pixels);
+	}
 }
 
 // Read pixels from texture to buffer
 void ofxNDIsender::ReadPixels(ofTexture tex, unsigned int width, unsigned int height, unsigned char *data)
 {
-	if (m_bReadback)
-		ReadTexturePixels(tex, width, height, ndiBuffer[m_idx].getData());
-	else
-		tex.readToPixels(ndiBuffer[m_idx]);
+	if (m_bReadback) {
+		ReadTexturePixels(tex, width, height, data);
+	}
+	else {
+		m_readback.Release();
+		ofPixels pixels;
+		pixels.setFromExternalPixels(data, width, height, OF_PIXELS_RGBA);
+		tex.readToPixels(pixels);
+	}
 }
 
 //
@@ -535,99 +879,165 @@ void ofxNDIsender::ReadPixels(ofTexture tex, unsigned int width, unsigned int he
 //
 // adapted from : http://www.songho.ca/opengl/gl_pbo.html
 //
+// Pixels are read into a ring of PBOs (ofxNDIreadback). Each frame the
+// oldest PBO read is collected if a fence shows that its transfer is
+// complete, so mapping does not stall the GPU, and the current frame is
+// read into the next. If the ring is full, SendImage waits for the oldest
+// transfer or skips reading the frame (SetReadbackSkip).
+//
 bool ofxNDIsender::ReadFboPixels(ofFbo fbo, unsigned int width, unsigned int height, unsigned char *data)
 {
-	void *pboMemory;
-
-	if (ndiPbo[0] == 0 || ndiPbo[1] == 0)
+	if (!m_readback.IsAllocated())
 		return false;
 
-	PboIndex = (PboIndex + 1) % 2;
-	NextPboIndex = (PboIndex + 1) % 2;
-
-	// Bind the fbo passed in
-	fbo.bind();
-
-	// Set the target framebuffer to read
-	glReadBuffer(GL_FRONT);
-
-	// Bind the current PBO
-	glBindBuffer(GL_PIXEL_PACK_BUFFER, ndiPbo[PboIndex]);
+	// Collect the oldest frame read back
+	bool bFrame = m_readback.Collect(data);
 
-	// Read pixels from framebuffer to the current PBO
-	// After a buffer is bound, glReadPixels() will pack(write) data into the Pixel Buffer Object.
-	// glReadPixels() should return immediately.
-	glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, (GLvoid *)0);
-
-	// Map the previous PBO to process its data by CPU
-	glBindBuffer(GL_PIXEL_PACK_BUFFER, ndiPbo[NextPboIndex]);
-	pboMemory = glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
-	if (pboMemory) {
-		// Use SSE2 mempcy
-		ofxNDIutils::CopyImage((unsigned char *)pboMemory, data, width, height, width * 4);
-		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
-	}
-	else {
-		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	// Read this frame into the next PBO
+	if (m_readback.Next()) {
+		// Bind the fbo passed in
+		fbo.bind();
+		// Set the target framebuffer to read
+		glReadBuffer(GL_FRONT);
+		m_readback.Read(width, height);
 		fbo.unbind();
-		return false;
 	}
 
-	// Back to conventional pixel operation
-	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
-	fbo.unbind();
-
-	return true;
+	return bFrame;
 
 }
 
 // Asynchronous texture pixel Read-back via fbo
 bool ofxNDIsender::ReadTexturePixels(ofTexture tex, unsigned int width, unsigned int height, unsigned char *data)
 {
-	void *pboMemory;
-
-	if (ndiPbo[0] == 0 || ndiPbo[1] == 0)
+	if (!m_readback.IsAllocated())
 		return false;
 
-	PboIndex = (PboIndex + 1) % 2;
-	NextPboIndex = (PboIndex + 1) % 2;
+	bool bFrame = m_readback.Collect(data);
+
+	if (m_readback.Next()) {
+		// The local fbo will be the same size as the sender texture
+		ndiFbo.bind();
+		// Attach the texture passed in
+		ndiFbo.attachTexture(tex, GL_RGBA, 0);
+		// Set the target framebuffer to read
+		glReadBuffer(GL_FRONT);
+		m_readback.Read(width, height);
+		ndiFbo.unbind();
+	}
+
+	return bFrame;
 
-	// The local fbo will be the same size as the sender texture
-	ndiFbo.bind();
+}
+
+//
+// OpenGL calls of the readback ring
+//
+
+// Whether buffers can stay mapped while OpenGL reads into them
+bool ofxNDIpboGL::IsPersistentSupported()
+{
+#ifdef GL_MAP_PERSISTENT_BIT
+	return GLEW_ARB_buffer_storage ? true : false;
+#else
+	return false;
+#endif
+}
 
-	// Attach the texture passed in
-	ndiFbo.attachTexture(tex, GL_RGBA, 0);
+// Create a pixel pack buffer, mapped for its life if persistent
+unsigned int ofxNDIpboGL::CreateBuffer(size_t bytes, bool bPersistent, void **mapped)
+{
+	GLuint pbo = 0;
+	glGenBuffers(1, &pbo);
+	*mapped = NULL;
+#ifdef GL_MAP_PERSISTENT_BIT
+	if (bPersistent) {
+		// Mapped for reading by NDI and for invert in place,
+		// and coherent so that a signalled fence is enough
+		GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo);
+		glBufferStorage(GL_PIXEL_PACK_BUFFER, bytes, 0, flags | GL_CLIENT_STORAGE_BIT);
+		*mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, bytes, flags);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		return pbo;
+	}
+#else
+	(void)bPersistent;
+#endif
+	glBindBufferARB(GL_PIXEL_UNPACK_BUFFER_ARB, pbo);
+	glBufferDataARB(GL_PIXEL_UNPACK_BUFFER_ARB, bytes, 0, GL_STREAM_READ);
+	glBindBufferARB(GL_PIXEL_UNPACK_BUFFER_ARB, 0);
+	return pbo;
+}
 
-	// Set the target framebuffer to read
-	glReadBuffer(GL_FRONT);
+// Delete a buffer, unmapped first if persistently mapped
+void ofxNDIpboGL::DeleteBuffer(unsigned int buffer, bool bMapped)
+{
+	GLuint pbo = buffer;
+	if (bMapped) {
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo);
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	}
+	glDeleteBuffers(1, &pbo);
+}
 
+// Read pixels of the bound framebuffer into a buffer
+void ofxNDIpboGL::ReadPixels(unsigned int buffer, unsigned int width, unsigned int height)
+{
 	// Bind the current PBO
-	glBindBuffer(GL_PIXEL_PACK_BUFFER, ndiPbo[PboIndex]);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer);
 
 	// Read pixels from framebuffer to the current PBO
 	// After a buffer is bound, glReadPixels() will pack(write) data into the Pixel Buffer Object.
 	// glReadPixels() should return immediately.
 	glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, (GLvoid *)0);
 
-	// Map the previous PBO to process its data by CPU
-	glBindBuffer(GL_PIXEL_PACK_BUFFER, ndiPbo[NextPboIndex]);
-	pboMemory = glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
-	if (pboMemory) {
-		// Use SSE2 mempcy
-		ofxNDIutils::CopyImage((unsigned char *)pboMemory, data, width, height, width * 4);
-		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
-	}
-	else {
-		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
-		ndiFbo.unbind();
-		return false;
-	}
+	// Back to conventional pixel operation
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
 
-	ndiFbo.unbind();
+// Fence signalled when the transfer is complete
+void *ofxNDIpboGL::FenceSync()
+{
+	return (void *)glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
 
-	// Back to conventional pixel operation
+// Wait for a fence, false if the timeout expired
+bool ofxNDIpboGL::ClientWaitSync(void *fence, unsigned long long timeout)
+{
+	// The flush makes sure that the fence will be signalled
+	GLenum status = glClientWaitSync((GLsync)fence, GL_SYNC_FLUSH_COMMANDS_BIT, (GLuint64)timeout);
+	return status != GL_TIMEOUT_EXPIRED;
+}
+
+void ofxNDIpboGL::DeleteSync(void *fence)
+{
+	glDeleteSync((GLsync)fence);
+}
+
+// Map a buffer for reading
+void *ofxNDIpboGL::MapBuffer(unsigned int buffer)
+{
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer);
+	void *data = glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
 	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	return data;
+}
 
-	return true;
+void ofxNDIpboGL::UnmapBuffer(unsigned int buffer)
+{
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer);
+	glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
 
+// Average the render thread time of SendImage for an fbo or texture
+void ofxNDIsender::UpdateReadbackTime(long long startTime)
+{
+	double elapsed = (double)(GetClockMicroseconds() - startTime) / 1000.0;
+	if (m_readbackTime <= 0.0)
+		m_readbackTime = elapsed;
+	else
+		m_readbackTime = m_readbackTime*0.95 + elapsed*0.05;
 }
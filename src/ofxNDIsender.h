@@ -25,6 +25,20 @@
 	=========================================================================
 
 	08.07.18 - Use ofxNDIsend class
+	17.10.26 - Remove ndiBuffer, pixels are read into ofxNDIsend pool buffers
+			 - Add SetInPlace, GetInPlace
+			 - Add SetNegativeStride, GetNegativeStride
+			 - Add SendImage for ofShortPixels
+			 - UYVA output by shader for fbo and texture
+			 - Add SetPipeline, GetReadbackTime and pipeline statistics
+			 - Readback through a ring of PBOs gated by fences.
+			   Add SetReadbackBuffers, SetReadbackSkip and readback statistics.
+			 - Add SetReadbackPersistent - persistent mapped PBOs are sent
+			   without a copy
+			 - Add SetPacing and pacing statistics
+			 - Add GetStreamId for ofxNDIruntime statistics
+			 - PBO ring moved to ofxNDIreadback with the OpenGL calls
+			   in ofxNDIpboGL
 
 */
 #pragma once
@@ -44,12 +58,31 @@
 
 #include <stdio.h>
 #include <string>
+#include <vector>
 #include <emmintrin.h> // for SSE2
 #include <iostream> // for cout
 #include "Processing.NDI.Lib.h" // NDI SDK
 #include "ofxNDIsend.h" // basic sender functions
 #include "ofxNDIshaders.h" // Openframeworks shader functions
 #include "ofxNDIutils.h" // buffer copy utilities
+#include "ofxNDIreadback.h" // PBO ring
+
+// OpenGL calls of the readback ring
+class ofxNDIpboGL : public ofxNDIpbo {
+
+public:
+
+	bool IsPersistentSupported();
+	unsigned int CreateBuffer(size_t bytes, bool bPersistent, void **mapped);
+	void DeleteBuffer(unsigned int buffer, bool bMapped);
+	void ReadPixels(unsigned int buffer, unsigned int width, unsigned int height);
+	void *FenceSync();
+	bool ClientWaitSync(void *fence, unsigned long long timeout);
+	void DeleteSync(void *fence);
+	void *MapBuffer(unsigned int buffer);
+	void UnmapBuffer(unsigned int buffer);
+
+};
 
 class ofxNDIsender {
 
@@ -120,6 +153,12 @@ public:
 	// - buffer is converted to RGBA if not already
 	bool SendImage(ofPixels pix, bool bInvert = false);
 
+	// Send 16 bit ofShortPixels to a P216 or PA16 sender
+	// - pix | Openframeworks pixel buffer to send
+	// - bInvert | flip the image - default false
+	// - buffer is converted to RGBA if not already
+	bool SendImage(ofShortPixels pix, bool bInvert = false);
+
 	// Send RGBA image pixels
 	// - image | pixel data
 	// - width | image width
@@ -149,6 +188,9 @@ public:
 	// Return current fps
 	double GetFps();
 
+	// Id of the sender statistics in ofxNDIruntime::GetStreams
+	unsigned int GetStreamId();
+
 	// Get current frame rate numerator and denominator
 	// - framerate_N | numerator
 	// - framerate_D | denominator
@@ -189,12 +231,115 @@ public:
 	// Get whether async sending mode
 	bool GetAsync();
 
+	// Invert and swap red and blue in the pixels passed to SendImage
+	// instead of in a copy. The caller's pixels are changed.
+	// Fbo and texture pixels are always inverted in place.
+	void SetInPlace(bool bInPlace = true);
+
+	// Get whether in place mode
+	bool GetInPlace();
+
+	// Send inverted RGBA or BGRA images with a negative line stride
+	// instead of flipping them. Only for NDI runtimes that support it.
+	void SetNegativeStride(bool bNegative = true);
+
+	// Get whether inverted frames are sent with a negative stride
+	bool GetNegativeStride();
+
 	// Set asynchronous readback of pixels from FBO or texture
 	void SetReadback(bool bReadback = true);
 
 	// Get current readback mode
 	bool GetReadback();
 
+	// Set the number of PBOs used for readback
+	// Pixels are read into the next free PBO and each is mapped, oldest
+	// first, only once its fence shows that the transfer is complete.
+	// More buffers allow more frames of latency before the ring is full.
+	// - nBuffers | 2 to 8, default 3
+	void SetReadbackBuffers(unsigned int nBuffers = 3);
+
+	// Get the number of readback PBOs
+	unsigned int GetReadbackBuffers();
+
+	// Skip a frame instead of waiting for the GPU when the ring is full
+	// Otherwise SendImage waits for the oldest transfer to complete.
+	void SetReadbackSkip(bool bSkip = true);
+
+	// Get whether frames are skipped when the ring is full
+	bool GetReadbackSkip();
+
+	// Frames from readback to send (averaged)
+	double GetReadbackLatency();
+
+	// Frames not read back because the ring was full
+	unsigned int GetReadbackSkipped();
+
+	// Map the readback PBOs once for the life of the sender (OpenGL 4.4)
+	// RGBA pixels and shader converted frames are sent directly from
+	// the PBO memory, so there is no copy on the render thread. A PBO sent
+	// asynchronously is read into again once NDI has finished with it.
+	// Ignored if persistent mapping is not supported.
+	void SetReadbackPersistent(bool bPersistent = true);
+
+	// Get whether persistent mapped PBOs are used
+	bool GetReadbackPersistent();
+
+	// Read back, convert and send on separate stages
+	// Conversion and the NDI send are made on ofxNDIsend threads.
+	// With SetReadback, fbo and texture pixels read into a PBO are queued
+	// from the mapped PBO on the next frame, so the render thread only
+	// starts the read. Frames are dropped if the pipeline is full.
+	// - bPipeline | use the pipeline
+	// - nFrames | frames waiting for each stage
+	void SetPipeline(bool bPipeline = true, unsigned int nFrames = 2);
+
+	// Get whether the pipeline is used
+	bool GetPipeline();
+
+	// Render thread time of SendImage for an fbo or texture
+	// in milliseconds (averaged)
+	double GetReadbackTime();
+
+	// Frames dropped because the pipeline was full
+	unsigned int GetPipelineDropped();
+
+	// Frames waiting for conversion
+	unsigned int GetConvertQueueDepth();
+
+	// Frames waiting to be sent
+	unsigned int GetSendQueueDepth();
+
+	// Time from queued to converted in milliseconds (averaged)
+	double GetConvertLatency();
+
+	// Time from converted to sent in milliseconds (averaged)
+	double GetSendLatency();
+
+	// Send the video at the frame rate from the pipeline send thread
+	// instead of by NDI clocking. The newest frame is sent at each frame
+	// time, repeated if there is no new frame, and older frames dropped.
+	// Set before CreateSender. The pipeline is started if it is not used.
+	void SetPacing(bool bPacing = true);
+
+	// Get whether the video is paced by the send thread
+	bool GetPacing();
+
+	// Frames sent again because no new frame was ready
+	unsigned int GetPacingRepeated();
+
+	// Frames not sent because a newer frame was ready
+	unsigned int GetPacingDropped();
+
+	// Frame times passed while the send thread was late
+	unsigned int GetPacingMissed();
+
+	// Difference of send from frame time in milliseconds (averaged)
+	double GetPacingJitter();
+
+	// Largest difference of send from frame time in milliseconds
+	double GetPacingMaxJitter();
+
 	// Set to send Audio
 	// Initialized false
 	void SetAudio(bool bAudio = true);
@@ -237,31 +382,42 @@ public:
 private:
 
 	ofxNDIsend NDIsender; // Basic sender functions
-	bool m_bReadback; // Asynchronous readback of pixels from FBO using two PBOs
+	bool m_bReadback; // Asynchronous readback of pixels from FBO using a ring of PBOs
 	NDIlib_FourCC_type_e m_ColorFormat; // Color format to send
-	ofPixels ndiBuffer[2]; // Two pixel buffers for async sending
-	int m_idx; // Index used for async buffer swapping
-	GLuint ndiPbo[2]; // PBOs used for asynchronous read-back from fbo
-	int PboIndex; // Index used for asynchronous read-back from fbo
-	int NextPboIndex;
 	std::string m_SenderName; // current sender name
 
+	// Ring of PBOs for readback
+	ofxNDIpboGL m_pboGL;
+	ofxNDIreadback m_readback;
+	double m_readbackTime; // msec
+
 	// RGBA to YUV and RGBA to BGRA conversion
 	ofxNDIshaders yuvshaders;
 	ofFbo ndiFbo; // Utility Fbo
+	ofFbo ndiUyvaFbo; // UYVY lines and alpha plane for a UYVA sender
 	ofTexture ndiTexture; // utility texture
 
 	// Convert fbo texture from RGBA to YUV
-	void ColorConvert(ofFbo fbo);
+	// bInvert flips the image in the same draw
+	void ColorConvert(ofFbo fbo, bool bInvert = false);
 
 	// Convert texture from RGBA to YUV
-	void ColorConvert(ofTexture tex);
+	void ColorConvert(ofTexture tex, bool bInvert = false);
+
+	// Convert texture from RGBA to UYVY and alpha planes in one draw
+	// The planes are in ndiUyvaFbo ready to be read as one frame.
+	// Returns false if the size is not supported by the shader,
+	// and the sender then converts RGBA pixels instead.
+	bool AlphaConvert(ofTexture tex, bool bInvert = false);
+
+	// Allocate ndiUyvaFbo for a UYVA sender
+	void AllocateUyvaFbo(unsigned int width, unsigned int height);
 
 	// Convert fbo texture RGBA <> BGRA
-	void ColorSwap(ofFbo fbo);
+	void ColorSwap(ofFbo fbo, bool bInvert = false);
 
 	// Convert texture RGBA <> BGRA
-	void ColorSwap(ofTexture tex);
+	void ColorSwap(ofTexture tex, bool bInvert = false);
 
 	// Read pixels from fbo to buffer
 	void ReadPixels(ofFbo fbo, unsigned int width, unsigned int height, unsigned char *data);
@@ -275,6 +431,9 @@ private:
 	// Asynchronous texture pixel readback
 	bool ReadTexturePixels(ofTexture tex, unsigned int width, unsigned int height, unsigned char *data);
 
+	// Average the render thread time of SendImage
+	void UpdateReadbackTime(long long startTime);
+
 
 };
 
@@ -27,6 +27,7 @@
 	11.04.18 - Create file
 			 - rgba to yuv shader : NDIlib_FourCC_type_UYVY
 	12.04.18 - Add rgba2bgra
+	17.10.26 - Add rgba2uyva : NDIlib_FourCC_type_UYVA in one pass
 
 */
 #include "ofxNDIshaders.h"
@@ -257,6 +258,160 @@ ofxNDIshaders::ofxNDIshaders()
 	if(!rgba2yuvShader.linkProgram())
 		printf("RGBA to YUV shader link failure\n");
 
+
+	//
+	// Sender : RGBA to UYVA
+	//
+	// Drawn to an fbo half the image width and one and a half times the height.
+	// The first "height" lines are UYVY as for rgba2yuv. Each line after that
+	// holds the alpha of two image lines, four pixels to a texel, so that
+	// the fbo pixels are the UYVY plane followed by the packed alpha plane.
+	// The image width must be a multiple of 4 and the height even.
+	//
+	std::string rgba2uyvaFragGL2 = STRINGIFY(
+
+		#extension GL_ARB_texture_rectangle : enable\n
+
+		uniform sampler2DRect rgbatex; // rgba source texture
+		uniform float width; // source image width
+		uniform float height; // source image height
+		uniform float invert; // 1.0 to flip the image
+
+		void main(void) {
+
+			vec2 texel = floor(gl_TexCoord[0].xy);
+			vec4 result = vec4(0.0);
+
+			if (texel.y < height) {
+				// UYVY from two pixels
+				float y = (invert > 0.5 ? height - 1.0 - texel.y : texel.y) + 0.5;
+				vec4 rgba0 = texture2DRect(rgbatex, vec2(texel.x * 2.0 + 0.5, y));
+				vec4 rgba1 = texture2DRect(rgbatex, vec2(texel.x * 2.0 + 1.5, y));
+				// BT.709 with Y 16-235
+				result.x = -0.1145*rgba0.r - 0.3855*rgba0.g + 0.5000*rgba0.b + 0.5;
+				result.y = (0.2215*rgba0.r + 0.7154*rgba0.g + 0.0721*rgba0.b) / 1.16438 + 0.06274;
+				result.z = 0.5016*rgba0.r - 0.4556*rgba0.g - 0.0459*rgba0.b + 0.5;
+				result.w = (0.2215*rgba1.r + 0.7154*rgba1.g + 0.0721*rgba1.b) / 1.16438 + 0.06274;
+			}
+			else {
+				// Alpha of four pixels
+				float quarter = width / 4.0;
+				float line = (texel.y - height) * 2.0 + (texel.x < quarter ? 0.0 : 1.0);
+				float x = mod(texel.x, quarter) * 4.0 + 0.5;
+				float y = (invert > 0.5 ? height - 1.0 - line : line) + 0.5;
+				result.x = texture2DRect(rgbatex, vec2(x, y)).a;
+				result.y = texture2DRect(rgbatex, vec2(x + 1.0, y)).a;
+				result.z = texture2DRect(rgbatex, vec2(x + 2.0, y)).a;
+				result.w = texture2DRect(rgbatex, vec2(x + 3.0, y)).a;
+			}
+
+			gl_FragColor = result;
+		}
+	);
+
+	std::string rgba2uyvaFragGL3 = STRINGIFY(
+
+		#extension GL_ARB_texture_rectangle : enable\n
+
+		uniform sampler2DRect rgbatex; // rgba source texture
+		uniform float width; // source image width
+		uniform float height; // source image height
+		uniform float invert; // 1.0 to flip the image
+
+		in vec2 texCoord;
+		out vec4 outputColor;
+
+		void main()
+		{
+			vec2 texel = floor(texCoord);
+			vec4 result = vec4(0.0);
+
+			if (texel.y < height) {
+				float y = (invert > 0.5 ? height - 1.0 - texel.y : texel.y) + 0.5;
+				vec4 rgba0 = texture2DRect(rgbatex, vec2(texel.x * 2.0 + 0.5, y));
+				vec4 rgba1 = texture2DRect(rgbatex, vec2(texel.x * 2.0 + 1.5, y));
+				result.x = -0.1145*rgba0.r - 0.3855*rgba0.g + 0.5000*rgba0.b + 0.5;
+				result.y = (0.2215*rgba0.r + 0.7154*rgba0.g + 0.0721*rgba0.b) / 1.16438 + 0.06274;
+				result.z = 0.5016*rgba0.r - 0.4556*rgba0.g - 0.0459*rgba0.b + 0.5;
+				result.w = (0.2215*rgba1.r + 0.7154*rgba1.g + 0.0721*rgba1.b) / 1.16438 + 0.06274;
+			}
+			else {
+				float quarter = width / 4.0;
+				float line = (texel.y - height) * 2.0 + (texel.x < quarter ? 0.0 : 1.0);
+				float x = mod(texel.x, quarter) * 4.0 + 0.5;
+				float y = (invert > 0.5 ? height - 1.0 - line : line) + 0.5;
+				result.x = texture2DRect(rgbatex, vec2(x, y)).a;
+				result.y = texture2DRect(rgbatex, vec2(x + 1.0, y)).a;
+				result.z = texture2DRect(rgbatex, vec2(x + 2.0, y)).a;
+				result.w = texture2DRect(rgbatex, vec2(x + 3.0, y)).a;
+			}
+
+			outputColor = result;
+		}
+	);
+
+	std::string rgba2uyvaFragES2 = STRINGIFY(
+
+		//
+		// TARGET_OPENGLES : Untested
+		// Normalized coordinates of the source texture
+		//
+
+		precision highp float;
+
+		uniform sampler2D rgbatex; // rgba source texture
+		uniform float width; // source image width
+		uniform float height; // source image height
+		uniform float invert; // 1.0 to flip the image
+		vec2 texCoord; // Texture coords from the vertex shader
+
+		void main()
+		{
+			vec2 texel = floor(texCoord * vec2(width / 2.0, height * 1.5));
+			vec4 result = vec4(0.0);
+
+			if (texel.y < height) {
+				float y = ((invert > 0.5 ? height - 1.0 - texel.y : texel.y) + 0.5) / height;
+				vec4 rgba0 = texture2D(rgbatex, vec2((texel.x * 2.0 + 0.5) / width, y));
+				vec4 rgba1 = texture2D(rgbatex, vec2((texel.x * 2.0 + 1.5) / width, y));
+				result.x = -0.1145*rgba0.r - 0.3855*rgba0.g + 0.5000*rgba0.b + 0.5;
+				result.y = (0.2215*rgba0.r + 0.7154*rgba0.g + 0.0721*rgba0.b) / 1.16438 + 0.06274;
+				result.z = 0.5016*rgba0.r - 0.4556*rgba0.g - 0.0459*rgba0.b + 0.5;
+				result.w = (0.2215*rgba1.r + 0.7154*rgba1.g + 0.0721*rgba1.b) / 1.16438 + 0.06274;
+			}
+			else {
+				float quarter = width / 4.0;
+				float line = (texel.y - height) * 2.0 + (texel.x < quarter ? 0.0 : 1.0);
+				float x = (mod(texel.x, quarter) * 4.0 + 0.5) / width;
+				float y = ((invert > 0.5 ? height - 1.0 - line : line) + 0.5) / height;
+				result.x = texture2D(rgbatex, vec2(x, y)).a;
+				result.y = texture2D(rgbatex, vec2(x + 1.0 / width, y)).a;
+				result.z = texture2D(rgbatex, vec2(x + 2.0 / width, y)).a;
+				result.w = texture2D(rgbatex, vec2(x + 3.0 / width, y)).a;
+			}
+
+			gl_FragColor = result;
+		}
+	);
+
+	// The vertex shaders are the same as for rgba2yuv
+#ifdef TARGET_OPENGLES
+	rgba2uyvaShader.setupShaderFromSource(GL_VERTEX_SHADER, rgba2yuvVertES2, "");
+	rgba2uyvaShader.setupShaderFromSource(GL_FRAGMENT_SHADER, rgba2uyvaFragES2, "");
+#else
+	if (ofIsGLProgrammableRenderer()) {
+		rgba2uyvaShader.setupShaderFromSource(GL_VERTEX_SHADER, rgba2yuvVertGL3, "");
+		rgba2uyvaShader.setupShaderFromSource(GL_FRAGMENT_SHADER, rgba2uyvaFragGL3, "");
+	}
+	else {
+		rgba2uyvaShader.setupShaderFromSource(GL_VERTEX_SHADER, rgba2yuvVertGL2, "");
+		rgba2uyvaShader.setupShaderFromSource(GL_FRAGMENT_SHADER, rgba2uyvaFragGL2, "");
+	}
+#endif
+
+	if (!rgba2uyvaShader.linkProgram())
+		printf("RGBA to UYVA shader link failure\n");
+
 	
 	//
 	// Sender : RGBA to BGRA (or vice versa)
@@ -25,6 +25,7 @@
 	=========================================================================
 
 	11.04.16 - Create file
+	17.10.26 - Add rgba2uyvaShader
 
 */
 #pragma once
@@ -55,6 +56,7 @@ public:
 	ofxNDIshaders::~ofxNDIshaders();
 
 	ofShader rgba2yuvShader;
+	ofShader rgba2uyvaShader;
 	ofShader rgba2bgra;
 
 };
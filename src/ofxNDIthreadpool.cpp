@@ -0,0 +1,236 @@
+/*
+	NDI thread pool
+
+	Worker threads for splitting frame conversions into bands of rows
+
+	http://NDI.NewTek.com
+
+	Copyright (C) 2016-2018 Lynn Jarvis.
+
+	http://www.spout.zeal.co
+
+	=========================================================================
+	This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+	=========================================================================
+
+	17.10.26 - Create file
+			 - Persistent workers, the calling thread does one band
+			   and waits for the others
+			 - Jobs queued so that concurrent calls to Run share the workers
+			   in place of running on the calling thread. Add GetFallbacks.
+
+*/
+#include "ofxNDIthreadpool.h"
+#include <algorithm> // for find
+
+#if defined(_WIN32)
+#include <windows.h> // for SetThreadAffinityMask
+#elif !defined(__APPLE__)
+#include <pthread.h> // for pthread_setaffinity_np
+#endif
+
+// Minimum number of rows in a band
+static const unsigned int minBandRows = 16;
+
+// Set for a thread while it is processing a band
+// so that a conversion inside a band does not use the pool again
+static thread_local bool bInBand = false;
+
+
+ofxNDIthreadpool::ofxNDIthreadpool()
+{
+	m_bQuit = false;
+	m_nWorkers = 0;
+	m_nFallbacks = 0;
+}
+
+ofxNDIthreadpool::~ofxNDIthreadpool()
+{
+	StopWorkers();
+}
+
+// Set the number of threads used by Run
+// Jobs already queued are completed by their calling threads
+// while the workers are replaced.
+void ofxNDIthreadpool::SetThreads(unsigned int nThreads, bool bAffinity, unsigned int firstCore)
+{
+	std::lock_guard<std::mutex> threadslock(m_threadsMutex);
+
+	StopWorkers();
+
+	unsigned int nCores = std::thread::hardware_concurrency();
+	if (nCores == 0) nCores = 1;
+	if (nThreads == 0) nThreads = nCores;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_bQuit = false;
+		m_nWorkers = nThreads - 1;
+	}
+	for (unsigned int i = 1; i < nThreads; i++) {
+		m_workers.push_back(std::thread(&ofxNDIthreadpool::Worker, this));
+		if (bAffinity)
+			SetAffinity(m_workers.back(), (firstCore + i - 1) % nCores);
+	}
+}
+
+// Return the number of threads including the calling thread
+unsigned int ofxNDIthreadpool::GetThreads()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_nWorkers + 1;
+}
+
+// Process bands of rows with all threads
+void ofxNDIthreadpool::Run(unsigned int height, const std::function<void(unsigned int, unsigned int)> &func)
+{
+	Job job;
+	job.func = &func;
+	job.height = height;
+	job.nextBand = 0;
+	job.bandsDone = 0;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		job.nBands = m_nWorkers + 1;
+		if (job.nBands > height / minBandRows)
+			job.nBands = height / minBandRows;
+		if (job.nBands > 1 && (bInBand || m_bQuit)) {
+			m_nFallbacks++;
+			job.nBands = 1;
+		}
+		if (job.nBands > 1)
+			m_jobs.push_back(&job);
+	}
+
+	// Not worth splitting, called from a band or the workers are being replaced
+	if (job.nBands <= 1) {
+		func(0, height);
+		return;
+	}
+	m_wake.notify_all();
+
+	// The calling thread takes bands of its own job
+	for (;;) {
+		unsigned int band = 0;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (!ClaimBand(job, band))
+				break;
+		}
+		DoBand(job, band);
+	}
+
+	// Wait for the workers to finish theirs
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_done.wait(lock, [&job] { return job.bandsDone == job.nBands; });
+}
+
+// Jobs that ran on the calling thread only
+unsigned long long ofxNDIthreadpool::GetFallbacks()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_nFallbacks;
+}
+
+//
+// Private functions
+//
+
+// Workers finish the band they have claimed and stop
+void ofxNDIthreadpool::StopWorkers()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_bQuit = true;
+		m_nWorkers = 0;
+	}
+	m_wake.notify_all();
+	for (size_t i = 0; i < m_workers.size(); i++) {
+		if (m_workers[i].joinable())
+			m_workers[i].join();
+	}
+	m_workers.clear();
+}
+
+void ofxNDIthreadpool::Worker()
+{
+	for (;;) {
+		Job *job = NULL;
+		unsigned int band = 0;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_wake.wait(lock, [this] { return m_bQuit || !m_jobs.empty(); });
+			if (m_bQuit)
+				return;
+			job = m_jobs.front();
+			ClaimBand(*job, band);
+		}
+		DoBand(*job, band);
+	}
+}
+
+// Claim the next band of a job - called with the lock held.
+// A job leaves the queue when its last band is claimed, and
+// it is valid until that band is done because Run waits for it.
+bool ofxNDIthreadpool::ClaimBand(Job &job, unsigned int &band)
+{
+	if (job.nextBand >= job.nBands)
+		return false;
+
+	band = job.nextBand++;
+	if (job.nextBand == job.nBands) {
+		std::deque<Job *>::iterator it = std::find(m_jobs.begin(), m_jobs.end(), &job);
+		if (it != m_jobs.end())
+			m_jobs.erase(it);
+	}
+
+	return true;
+}
+
+// Process one band and wake the calling thread of the job after the last
+void ofxNDIthreadpool::DoBand(Job &job, unsigned int band)
+{
+	unsigned int y0 = (unsigned int)((unsigned long long)job.height*band / job.nBands);
+	unsigned int y1 = (unsigned int)((unsigned long long)job.height*(band + 1) / job.nBands);
+	bInBand = true;
+	(*job.func)(y0, y1);
+	bInBand = false;
+
+	bool bLast = false;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		bLast = (++job.bandsDone == job.nBands);
+	}
+	// The job may be gone once the lock is released
+	if (bLast)
+		m_done.notify_all();
+}
+
+// Pin a worker thread to a core
+void ofxNDIthreadpool::SetAffinity(std::thread &thread, unsigned int core)
+{
+#if defined(_WIN32)
+	SetThreadAffinityMask(thread.native_handle(), (DWORD_PTR)1 << core);
+#elif defined(__APPLE__)
+	// OSX has no thread to core binding, affinity is a hint only
+	(void)thread;
+	(void)core;
+#else
+	cpu_set_t cpuset;
+	CPU_ZERO(&cpuset);
+	CPU_SET(core, &cpuset);
+	pthread_setaffinity_np(thread.native_handle(), sizeof(cpu_set_t), &cpuset);
+#endif
+}
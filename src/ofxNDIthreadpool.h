@@ -0,0 +1,105 @@
+/*
+	NDI thread pool
+
+	Worker threads for splitting frame conversions into bands of rows
+
+	http://NDI.NewTek.com
+
+	Copyright (C) 2016-2018 Lynn Jarvis.
+
+	http://www.spout.zeal.co
+
+	=========================================================================
+	This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+	=========================================================================
+
+	17.10.26 - Create file
+			 - Concurrent jobs share the workers. Add GetFallbacks.
+
+*/
+#pragma once
+#ifndef __ofxNDIthreadpool__
+#define __ofxNDIthreadpool__
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <vector>
+#include <deque>
+
+class ofxNDIthreadpool {
+
+public:
+
+	ofxNDIthreadpool();
+	~ofxNDIthreadpool();
+
+	// Set the number of threads used by Run
+	// - nThreads | total including the calling thread
+	//   0 - one for each core
+	//   1 - no worker threads (default)
+	// - bAffinity | pin each worker thread to a core
+	// - firstCore | core for the first worker, others follow on
+	void SetThreads(unsigned int nThreads, bool bAffinity = false, unsigned int firstCore = 0);
+
+	// Return the number of threads used by Run including the calling thread
+	unsigned int GetThreads();
+
+	// Split rows 0 to height into bands and process them with all threads.
+	// Returns when every band is complete.
+	// - height | number of rows
+	// - func | called with the first and one past the last row of each band
+	// Run can be called from any number of threads at once. The bands of
+	// each job are queued and the workers take them oldest job first,
+	// while each calling thread takes bands of its own job, so that no call
+	// waits for another to finish. A job runs on the calling thread only if
+	// Run is called from inside a band or while SetThreads is replacing
+	// the workers. Each of these is counted by GetFallbacks.
+	void Run(unsigned int height, const std::function<void(unsigned int, unsigned int)> &func);
+
+	// Number of jobs that could have been split into bands
+	// but ran on the calling thread only
+	unsigned long long GetFallbacks();
+
+private:
+
+	// A job of Run, held by the calling thread until its bands are done
+	struct Job {
+		const std::function<void(unsigned int, unsigned int)> *func;
+		unsigned int height;
+		unsigned int nBands;
+		unsigned int nextBand; // Next band to be claimed
+		unsigned int bandsDone;
+	};
+
+	std::vector<std::thread> m_workers;
+	std::mutex m_mutex; // Protects the jobs and counters below
+	std::mutex m_threadsMutex; // One SetThreads at a time
+	std::condition_variable m_wake; // Workers wait for a job
+	std::condition_variable m_done; // Run waits for the bands of its job
+	bool m_bQuit;
+	unsigned int m_nWorkers; // Workers taking bands
+	std::deque<Job *> m_jobs; // Jobs with bands not yet claimed, oldest first
+	unsigned long long m_nFallbacks;
+
+	void StopWorkers();
+	void Worker();
+	bool ClaimBand(Job &job, unsigned int &band);
+	void DoBand(Job &job, unsigned int band);
+	static void SetAffinity(std::thread &thread, unsigned int core);
+
+};
+
+#endif
@@ -31,36 +31,92 @@
 	Chages with update to 3.5
 	11.06.18 - __movsd for OSX (https://github.com/ThomasLengeling/ofxNDI)
 			- _rotl replacement for OSX
+	17.10.26 - CPU feature detection using CPUID
+			 - rgba_bgra_avx2 and rgba_bgra_avx512 variants of rgba_bgra_sse2
+			 - rgba_bgra selects the fastest variant on first use
+			 - rgba_bgra_c for CPUs without SSE2 and for comparison
+			 - YUV422_to_RGBA : SSE4.1 and AVX2 fixed point versions
+			   with selectable colour matrix and range.
+			   Corrected source line stride.
+			 - RGBA_to_YUV422 and BGRA_to_YUV422 for sending UYVY
+			   without OpenGL
+			 - SetThreads - conversions split into bands of rows
+			   processed by a thread pool (ofxNDIthreadpool)
+			 - CopyImage : corrected __movsd count and copy
+			   the remainder after memcpy_sse2
+			 - Portable rotate and 4 byte copy for Linux and OSX
+			   replacing _rotl, ROL and __movsd.
+			   The OSX __movsd copied bytes instead of 4 byte words.
+			 - uint32_t instead of unsigned __int32
+			 - memcpy_sse2 : any size and alignment, head and tail bytes
+			   copied with memcpy and an sfence after the stores
+			 - CopyLines with separate source and destination strides
+			 - CopyImage : source stride used for every option and optional
+			   destination stride. Padded received lines were copied
+			   beyond the end of a packed destination.
+			 - Copies use non-temporal stores only above the stream threshold
+			   (largest cache size from CPUID) and otherwise rep movsb
+			   if the CPU has ERMSB
+			 - ConvertImage : line functions instantiated for each combination
+			   of format, swap and alpha fill. Flip and strides for all.
+			   YUV422_to_RGBA and RGBA_to_YUV422 use it.
+			 - FlipImage : exchange line pairs in place with SSE2 or AVX2,
+			   optionally swapping red and blue at the same time
+			 - ConvertImage : P216 and PA16 to and from RGBA16, RGBA16F
+			   and 8 bit RGBA/BGRA (C, SSE4.1, AVX2 with F16C). Single
+			   precision float, BT.601/709/2020 limited or full range.
+			   P216 and PA16 to and from v210 (C and SSE4.1).
+			 - ConvertImage : RGBA and BGRA to UYVA, the alpha plane
+			   written in the same SSE4.1 pass as the UYVY line
+			 - Add SetInstructionSet - limit the SIMD paths of the conversions
+			   so that each can be compared with the C version
 
 
 */
 #include "ofxNDIutils.h"
+#include "ofxNDIthreadpool.h"
+#include <atomic>
+#include <vector>
 
-// _rotl replacement
-// Other solutions possible
-// https://stackoverflow.com/questions/776508/best-practices-for-circular-shift-rotate-operations-in-c
-#define BitsCount( val ) ( sizeof( val ) * CHAR_BIT )
-#define Shift( val, steps ) ( steps % BitsCount( val ) )
-#define ROL( val, steps ) ( ( val << Shift( val, steps ) ) | ( val >> ( BitsCount( val ) - Shift( val, steps ) ) ) )
-#define ROR( val, steps ) ( ( val >> Shift( val, steps ) ) | ( val << ( BitsCount( val )
+// Compile individual functions for an instruction set
+// without changing the build options of the whole file.
+// Visual Studio allows intrinsics for any instruction set.
+#if defined(_MSC_VER)
+#define NDI_TARGET(isa)
+#else
+#include <cpuid.h> // for __cpuid_count
+#define NDI_TARGET(isa) __attribute__((target(isa)))
+#endif
 
 
 namespace ofxNDIutils {
 
+	// Rotate a 32 bit value left
+	// GCC and Clang recognise the shift pattern and use a single rol
+	// https://stackoverflow.com/questions/776508/best-practices-for-circular-shift-rotate-operations-in-c
+	static inline uint32_t rotl32(uint32_t value, unsigned int steps)
+	{
+#if defined(_MSC_VER)
+		return _rotl(value, steps);
+#else
+		steps &= 31;
+		return (value << steps) | (value >> ((32 - steps) & 31));
+#endif
+	}
 
-#if defined(__APPLE__)
-	static inline void *__movsd(void *d, const void *s, size_t n) {
+	// Copy bytes with the string move instruction
+	// Fast for any alignment on CPUs with enhanced rep movsb (ERMSB)
+	static inline void movsb(void *dst, const void *src, size_t count)
+	{
+#if defined(_MSC_VER)
+		__movsb((unsigned char *)dst, (const unsigned char *)src, count);
+#else
 		asm volatile ("rep movsb"
-			: "=D" (d),
-			"=S" (s),
-			"=c" (n)
-			: "0" (d),
-			"1" (s),
-			"2" (n)
+			: "+D" (dst), "+S" (src), "+c" (count)
+			:
 			: "memory");
-		return d;
-	}
 #endif
+	}
 
 	//
 	// Fast memcpy
@@ -72,16 +128,34 @@ namespace ofxNDIutils {
 	//	http://www.gamedev.net/topic/502313-special-case---faster-than-memcpy/
 	//	and others.
 	//
-	// Approx 1.7 times speed of memcpy (0.84 msec per frame 1920x1080)
+	// Non-temporal stores write to memory without reading the destination
+	// into the caches. This is faster for copies larger than the last level
+	// cache but slower for smaller ones, so CopyBytes selects it by size.
+	//
+	// Any size and alignment. Bytes before the first 16 byte aligned
+	// destination address and after the last 128 byte block are copied
+	// with memcpy.
 	//
 	void memcpy_sse2(void* dst, const void* src, size_t Size)
 	{
 		char * pSrc = (char *)src;				  // Source buffer
 		char * pDst = (char *)dst;				  // Destination buffer
-		unsigned int n = (unsigned int)Size >> 7; // Counter = size divided by 128 (8 * 128bit registers)
+
+		// Head bytes up to an aligned destination for the stores
+		size_t head = (16 - ((uintptr_t)pDst & 15)) & 15;
+		if (head > Size)
+			head = Size;
+		if (head > 0) {
+			memcpy(pDst, pSrc, head);
+			pSrc += head;
+			pDst += head;
+			Size -= head;
+		}
+
+		size_t n = Size >> 7; // Counter = size divided by 128 (8 * 128bit registers)
 
 		__m128i Reg0, Reg1, Reg2, Reg3, Reg4, Reg5, Reg6, Reg7;
-		for (unsigned int Index = n; Index > 0; --Index) {
+		for (size_t Index = n; Index > 0; --Index) {
 
 			// SSE2 prefetch
 			_mm_prefetch(pSrc + 256, _MM_HINT_NTA);
@@ -89,16 +163,15 @@ namespace ofxNDIutils {
 
 			// move data from src to registers
 			// 8 x 128 bit (16 bytes each)
-			// Increment source pointer by 16 bytes each
-			// for a total of 128 bytes per cycle
-			Reg0 = _mm_load_si128((__m128i *)(pSrc));
-			Reg1 = _mm_load_si128((__m128i *)(pSrc + 16));
-			Reg2 = _mm_load_si128((__m128i *)(pSrc + 32));
-			Reg3 = _mm_load_si128((__m128i *)(pSrc + 48));
-			Reg4 = _mm_load_si128((__m128i *)(pSrc + 64));
-			Reg5 = _mm_load_si128((__m128i *)(pSrc + 80));
-			Reg6 = _mm_load_si128((__m128i *)(pSrc + 96));
-			Reg7 = _mm_load_si128((__m128i *)(pSrc + 112));
+			// The source need not be aligned
+			Reg0 = _mm_loadu_si128((__m128i *)(pSrc));
+			Reg1 = _mm_loadu_si128((__m128i *)(pSrc + 16));
+			Reg2 = _mm_loadu_si128((__m128i *)(pSrc + 32));
+			Reg3 = _mm_loadu_si128((__m128i *)(pSrc + 48));
+			Reg4 = _mm_loadu_si128((__m128i *)(pSrc + 64));
+			Reg5 = _mm_loadu_si128((__m128i *)(pSrc + 80));
+			Reg6 = _mm_loadu_si128((__m128i *)(pSrc + 96));
+			Reg7 = _mm_loadu_si128((__m128i *)(pSrc + 112));
 
 			// move data from registers to dest
 			_mm_stream_si128((__m128i *)(pDst), Reg0);
@@ -113,10 +186,228 @@ namespace ofxNDIutils {
 			pSrc += 128;
 			pDst += 128;
 		}
+
+		// Non-temporal stores are not ordered with other stores
+		_mm_sfence();
+
+		// Tail bytes
+		size_t tail = Size & 127;
+		if (tail > 0)
+			memcpy(pDst, pSrc, tail);
+
 	} // end memcpy_sse2
 
 
 
+	//
+	// CPU feature detection
+	//
+	// Instruction sets using the AVX registers also need
+	// the OS to save them on a context switch (XCR0).
+	//
+	struct CPUfeatures {
+		bool bSSE2;
+		bool bSSE41;
+		bool bAVX2;
+		bool bAVX512;
+		bool bF16C; // Half float conversion
+		bool bERMSB; // Enhanced rep movsb
+		size_t cacheSize; // Largest data cache in bytes
+	};
+
+	static void cpuid(int info[4], int leaf, int subleaf)
+	{
+#if defined(_MSC_VER)
+		__cpuidex(info, leaf, subleaf);
+#else
+		__cpuid_count(leaf, subleaf, info[0], info[1], info[2], info[3]);
+#endif
+	}
+
+	static unsigned long long xgetbv0()
+	{
+#if defined(_MSC_VER)
+		return _xgetbv(0);
+#else
+		unsigned int eax = 0;
+		unsigned int edx = 0;
+		__asm__ volatile ("xgetbv" : "=a" (eax), "=d" (edx) : "c" (0));
+		return ((unsigned long long)edx << 32) | eax;
+#endif
+	}
+
+	// Size of the largest data cache from the deterministic cache parameters
+	// Intel leaf 4 and AMD leaf 0x8000001D have the same format
+	static size_t DetectCacheSize(int leaf)
+	{
+		size_t largest = 0;
+		int info[4] = { 0, 0, 0, 0 };
+		for (int i = 0; i < 16; i++) {
+			cpuid(info, leaf, i);
+			unsigned int type = (unsigned int)info[0] & 0x1F;
+			if (type == 0) // no more caches
+				break;
+			if (type == 2) // instruction cache
+				continue;
+			size_t ways       = ((unsigned int)info[1] >> 22) + 1;
+			size_t partitions = (((unsigned int)info[1] >> 12) & 0x3FF) + 1;
+			size_t lineSize   = ((unsigned int)info[1] & 0xFFF) + 1;
+			size_t sets       = (unsigned int)info[2] + 1;
+			size_t size = ways*partitions*lineSize*sets;
+			if (size > largest)
+				largest = size;
+		}
+		return largest;
+	}
+
+	static CPUfeatures DetectCPUfeatures()
+	{
+		CPUfeatures features = { false, false, false, false, false, false, 0 };
+		int info[4] = { 0, 0, 0, 0 };
+
+		cpuid(info, 0, 0);
+		int maxleaf = info[0];
+		if (maxleaf < 1)
+			return features;
+
+		cpuid(info, 1, 0);
+		features.bSSE2  = (info[3] & (1 << 26)) != 0;
+		features.bSSE41 = (info[2] & (1 << 19)) != 0;
+		bool bOSXSAVE   = (info[2] & (1 << 27)) != 0;
+		bool bAVX       = (info[2] & (1 << 28)) != 0;
+
+		unsigned long long xcr0 = 0;
+		if (bOSXSAVE)
+			xcr0 = xgetbv0();
+		bool bYMM = bAVX && (xcr0 & 0x06) == 0x06; // XMM and YMM state
+		bool bZMM = bYMM && (xcr0 & 0xE0) == 0xE0; // opmask and ZMM state
+		features.bF16C = bYMM && (info[2] & (1 << 29)) != 0;
+
+		if (maxleaf >= 7) {
+			cpuid(info, 7, 0);
+			features.bAVX2   = bYMM && (info[1] & (1 << 5)) != 0;
+			features.bAVX512 = bZMM && (info[1] & (1 << 16)) != 0  // AVX512F
+				                    && (info[1] & (1 << 30)) != 0; // AVX512BW
+			features.bERMSB  = (info[1] & (1 << 9)) != 0;
+		}
+
+		if (maxleaf >= 4)
+			features.cacheSize = DetectCacheSize(4);
+		if (features.cacheSize == 0) {
+			cpuid(info, (int)0x80000000, 0);
+			if ((unsigned int)info[0] >= 0x8000001D)
+				features.cacheSize = DetectCacheSize((int)0x8000001D);
+		}
+
+		return features;
+	}
+
+	static const CPUfeatures &GetCPUfeatures()
+	{
+		static const CPUfeatures features = DetectCPUfeatures();
+		return features;
+	}
+
+	bool HasSSE2()   { return GetCPUfeatures().bSSE2; }
+	bool HasSSE41()  { return GetCPUfeatures().bSSE41; }
+	bool HasAVX2()   { return GetCPUfeatures().bAVX2; }
+	bool HasAVX512() { return GetCPUfeatures().bAVX512; }
+	bool HasF16C()   { return GetCPUfeatures().bF16C; }
+	bool HasERMSB()  { return GetCPUfeatures().bERMSB; }
+
+	// Highest instruction set the conversions can use
+	static std::atomic<int> maxInstructionSet(INSTRUCTIONS_AVX512);
+
+	void SetInstructionSet(InstructionSet maximum)
+	{
+		maxInstructionSet = (int)maximum;
+	}
+
+	InstructionSet GetInstructionSet()
+	{
+		return (InstructionSet)maxInstructionSet.load();
+	}
+
+	// Instruction sets supported and not excluded by SetInstructionSet
+	static inline bool UseSSE2()  { return maxInstructionSet.load(std::memory_order_relaxed) >= INSTRUCTIONS_SSE2 && HasSSE2(); }
+	static inline bool UseSSE41() { return maxInstructionSet.load(std::memory_order_relaxed) >= INSTRUCTIONS_SSE41 && HasSSE41(); }
+	static inline bool UseAVX2()  { return maxInstructionSet.load(std::memory_order_relaxed) >= INSTRUCTIONS_AVX2 && HasAVX2(); }
+
+	size_t GetCacheSize()
+	{
+		return GetCPUfeatures().cacheSize;
+	}
+
+	// Copies of more bytes than this use non-temporal stores
+	// 0 - the size of the largest cache (8MB if not known)
+	static std::atomic<size_t> streamThreshold(0);
+
+	void SetStreamThreshold(size_t bytes)
+	{
+		streamThreshold = bytes;
+	}
+
+	size_t GetStreamThreshold()
+	{
+		size_t bytes = streamThreshold;
+		if (bytes == 0)
+			bytes = GetCacheSize();
+		if (bytes == 0)
+			bytes = 8 * 1024 * 1024;
+		return bytes;
+	}
+
+	//
+	// Copy bytes using the fastest method for the size
+	//
+	// - bStream | the copy is part of a transfer larger than the stream threshold.
+	//   memcpy_sse2 is used so that data not needed again does not evict
+	//   everything else from the caches.
+	// Otherwise "rep movsb" is used for larger copies if the CPU has ERMSB.
+	//
+	static inline void CopyBytes(void *dst, const void *src, size_t size, bool bStream)
+	{
+		if (bStream && size >= 256)
+			memcpy_sse2(dst, src, size);
+		else if (size >= 1024 && GetCPUfeatures().bERMSB)
+			movsb(dst, src, size);
+		else
+			memcpy(dst, src, size);
+	}
+
+
+	// Swap r and b of one 32bit pixel
+	static inline uint32_t rgba_bgra_pixel(uint32_t rgbapix)
+	{
+		// rgbapix << 16		: a r g b > g b a r
+		//        & 0x00ff00ff  : r g b . > . b . r
+		// rgbapix & 0xff00ff00 : a r g b > a . g .
+		// result of or			:           a b g r
+		return (rotl32(rgbapix, 16) & 0x00ff00ff) | (rgbapix & 0xff00ff00);
+	}
+
+	// Source line for rgba_bgra, bottom up if inverted
+	static inline const uint32_t *rgba_bgra_line(const void *source, unsigned int width, unsigned int height, unsigned int y, bool bInvert)
+	{
+		const uint32_t *src = (const uint32_t *)source;
+		if (bInvert)
+			return src + (size_t)(height - 1 - y)*width;
+		return src + (size_t)y*width;
+	}
+
+	//
+	// Plain C version for comparison and CPUs without SSE2
+	//
+	void rgba_bgra_c(const void *source, void *dest, unsigned int width, unsigned int height, bool bInvert)
+	{
+		for (unsigned int y = 0; y < height; y++) {
+			const uint32_t *src = rgba_bgra_line(source, width, height, y, bInvert);
+			uint32_t *dst = (uint32_t *)dest + (size_t)y*width;
+			for (unsigned int x = 0; x < width; x++)
+				dst[x] = rgba_bgra_pixel(src[x]);
+		}
+	}
+
 	//
 	// Adapted from : https://searchcode.com/codesearch/view/5070982/
 	// 
@@ -130,9 +421,8 @@ namespace ofxNDIutils {
 	//
 	void rgba_bgra_sse2(const void *source, void *dest, unsigned int width, unsigned int height, bool bInvert)
 	{
-		unsigned __int32 *src = NULL;
-		unsigned __int32 *dst = NULL;
-		unsigned __int32 rgbapix; // 32bit rgba pixel
+		const uint32_t *src = NULL;
+		uint32_t *dst = NULL;
 		unsigned int x = 0;
 		unsigned int y = 0;
 		__m128i brMask = _mm_set1_epi32(0x00ff00ff); // argb
@@ -140,33 +430,13 @@ namespace ofxNDIutils {
 		// std::cout << "rgba_bgra_sse2" << std::endl;
 	    for (y = 0; y < height; y++) {
 
-  			// Start of buffer
-			src = (unsigned __int32*)source; // unsigned int = 4 bytes
-			dst = (unsigned __int32*)dest;
-	
-			// Increment to current line
-			if(bInvert) {
-				src += (unsigned __int32)(width*height); // end of rgba buffer
-				src -= (unsigned __int32)width;          // beginning of the last rgba line
-				src -= (unsigned __int32)y*width;        // current line
-			}
-			else {
-				src += (unsigned __int32)y*width;
-			}
-			dst += (unsigned __int32)y*width; // dest is not inverted
+			// Current line, source is inverted if required
+			src = rgba_bgra_line(source, width, height, y, bInvert);
+			dst = (uint32_t*)dest + (size_t)y*width; // dest is not inverted
 
 			// Make output writes aligned
 			for (x = 0; ((reinterpret_cast<intptr_t>(&dst[x]) & 15) != 0) && x < width; x++) {
-				rgbapix = src[x];
-				// rgbapix << 16		: a r g b > g b a r
-				//        & 0x00ff00ff  : r g b . > . b . r
-				// rgbapix & 0xff00ff00 : a r g b > a . g .
-				// result of or			:           a b g r
-#if defined(__APPLE__)
-				dst[x] = (ROL(rgbapix, 16) & 0x00ff00ff) | (rgbapix & 0xff00ff00);
-#else
-				dst[x] = (_rotl(rgbapix, 16) & 0x00ff00ff) | (rgbapix & 0xff00ff00);
-#endif
+				dst[x] = rgba_bgra_pixel(src[x]);
 			}
 
 			for (; x + 3 < width; x += 4) {
@@ -183,78 +453,381 @@ namespace ofxNDIutils {
 
 			// Perform leftover writes
 			for (; x < width; x++) {
-				rgbapix = src[x];
-#if defined(__APPLE__)
-				dst[x] = (ROL(rgbapix, 16) & 0x00ff00ff) | (rgbapix & 0xff00ff00);
-#else
-				dst[x] = (_rotl(rgbapix, 16) & 0x00ff00ff) | (rgbapix & 0xff00ff00);
-#endif
+				dst[x] = rgba_bgra_pixel(src[x]);
 			}
 		}
 
 	} // end rgba_bgra_sse2
 
 
+	//
+	// AVX2 version of rgba_bgra_sse2
+	//
+	// vpshufb swaps r and b of 8 pixels per instruction.
+	//
+	NDI_TARGET("avx2")
+	void rgba_bgra_avx2(const void *source, void *dest, unsigned int width, unsigned int height, bool bInvert)
+	{
+		const uint32_t *src = NULL;
+		uint32_t *dst = NULL;
+		unsigned int x = 0;
+		const __m256i swapMask = _mm256_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+			                                      2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+
+		for (unsigned int y = 0; y < height; y++) {
+
+			src = rgba_bgra_line(source, width, height, y, bInvert);
+			dst = (uint32_t*)dest + (size_t)y*width;
+
+			// Make output writes aligned
+			for (x = 0; ((reinterpret_cast<intptr_t>(&dst[x]) & 31) != 0) && x < width; x++) {
+				dst[x] = rgba_bgra_pixel(src[x]);
+			}
+
+			// 16 pixels per loop to keep two loads in flight
+			for (; x + 15 < width; x += 16) {
+				__m256i s0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&src[x]));
+				__m256i s1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&src[x + 8]));
+				_mm256_store_si256(reinterpret_cast<__m256i*>(&dst[x]), _mm256_shuffle_epi8(s0, swapMask));
+				_mm256_store_si256(reinterpret_cast<__m256i*>(&dst[x + 8]), _mm256_shuffle_epi8(s1, swapMask));
+			}
+
+			for (; x + 7 < width; x += 8) {
+				__m256i s0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&src[x]));
+				_mm256_store_si256(reinterpret_cast<__m256i*>(&dst[x]), _mm256_shuffle_epi8(s0, swapMask));
+			}
+
+			for (; x < width; x++) {
+				dst[x] = rgba_bgra_pixel(src[x]);
+			}
+		}
+
+	} // end rgba_bgra_avx2
+
+
+	//
+	// AVX-512 version of rgba_bgra_sse2
+	//
+	// Byte shuffle (vpshufb zmm) requires AVX512BW.
+	// 16 pixels per instruction.
+	//
+	NDI_TARGET("avx512f,avx512bw")
+	void rgba_bgra_avx512(const void *source, void *dest, unsigned int width, unsigned int height, bool bInvert)
+	{
+		const uint32_t *src = NULL;
+		uint32_t *dst = NULL;
+		unsigned int x = 0;
+		// Byte order 2, 1, 0, 3, 6, 5, 4, 7 ... in each 128 bit lane.
+		// _mm512_set4_epi32 rather than _mm512_broadcast_i32x4, which gives
+		// a -Wuninitialized warning from the GCC 12 intrinsic header.
+		const __m512i swapMask = _mm512_set4_epi32(0x0F0C0D0E, 0x0B08090A, 0x07040506, 0x03000102);
+
+		for (unsigned int y = 0; y < height; y++) {
+
+			src = rgba_bgra_line(source, width, height, y, bInvert);
+			dst = (uint32_t*)dest + (size_t)y*width;
+
+			// Make output writes aligned
+			for (x = 0; ((reinterpret_cast<intptr_t>(&dst[x]) & 63) != 0) && x < width; x++) {
+				dst[x] = rgba_bgra_pixel(src[x]);
+			}
+
+			for (; x + 31 < width; x += 32) {
+				__m512i s0 = _mm512_loadu_si512(reinterpret_cast<const void*>(&src[x]));
+				__m512i s1 = _mm512_loadu_si512(reinterpret_cast<const void*>(&src[x + 16]));
+				_mm512_store_si512(reinterpret_cast<void*>(&dst[x]), _mm512_shuffle_epi8(s0, swapMask));
+				_mm512_store_si512(reinterpret_cast<void*>(&dst[x + 16]), _mm512_shuffle_epi8(s1, swapMask));
+			}
+
+			for (; x + 15 < width; x += 16) {
+				__m512i s0 = _mm512_loadu_si512(reinterpret_cast<const void*>(&src[x]));
+				_mm512_store_si512(reinterpret_cast<void*>(&dst[x]), _mm512_shuffle_epi8(s0, swapMask));
+			}
+
+			for (; x < width; x++) {
+				dst[x] = rgba_bgra_pixel(src[x]);
+			}
+		}
+
+	} // end rgba_bgra_avx512
+
+
+	//
+	// Thread pool for conversions split into bands of rows
+	//
+	static ofxNDIthreadpool &GetThreadPool()
+	{
+		static ofxNDIthreadpool pool;
+		return pool;
+	}
+
+	void SetThreads(unsigned int nThreads, bool bAffinity)
+	{
+		GetThreadPool().SetThreads(nThreads, bAffinity);
+	}
+
+	unsigned int GetThreads()
+	{
+		return GetThreadPool().GetThreads();
+	}
+
+	unsigned long long GetThreadFallbacks()
+	{
+		return GetThreadPool().GetFallbacks();
+	}
+
+	// Frames smaller than 640x480 are not worth splitting
+	static inline bool UseThreads(unsigned int width, unsigned int height)
+	{
+		return (width > 640 || height > 480) && GetThreadPool().GetThreads() > 1;
+	}
+
+
+	//
+	// Select the fastest rgba_bgra function once, on first use
+	//
+	typedef void (*rgba_bgra_func)(const void *source, void *dest, unsigned int width, unsigned int height, bool bInvert);
+
+	static rgba_bgra_func SelectRgbaBgra()
+	{
+		if (HasAVX512()) return rgba_bgra_avx512;
+		if (HasAVX2())   return rgba_bgra_avx2;
+		if (HasSSE2())   return rgba_bgra_sse2;
+		return rgba_bgra_c;
+	}
+
+	static rgba_bgra_func GetRgbaBgra()
+	{
+		static const rgba_bgra_func best = SelectRgbaBgra();
+		return best;
+	}
+
+	void rgba_bgra(const void *source, void *dest, unsigned int width, unsigned int height, bool bInvert)
+	{
+		rgba_bgra_func rgba_bgra_best = GetRgbaBgra();
+		if (!UseThreads(width, height)) {
+			rgba_bgra_best(source, dest, width, height, bInvert);
+			return;
+		}
+
+		const uint32_t *src = (const uint32_t *)source;
+		uint32_t *dst = (uint32_t *)dest;
+		GetThreadPool().Run(height, [=](unsigned int y0, unsigned int y1) {
+			// The source band is at the other end if inverted
+			unsigned int line = bInvert ? height - y1 : y0;
+			rgba_bgra_best(src + (size_t)line*width, dst + (size_t)y0*width, width, y1 - y0, bInvert);
+		});
+	}
+
+
+	//
+	// Copy lines y0 to y1 of an image
+	//
+	static void CopyLineBand(const unsigned char *source, unsigned int sourceStride,
+		unsigned char *dest, unsigned int destStride,
+		unsigned int lineBytes, unsigned int height,
+		unsigned int y0, unsigned int y1, bool bInvert, bool bStream)
+	{
+		// One copy if the lines are contiguous in both
+		if (!bInvert && sourceStride == lineBytes && destStride == lineBytes) {
+			CopyBytes(dest + (size_t)y0*destStride, source + (size_t)y0*sourceStride, (size_t)(y1 - y0)*lineBytes, bStream);
+			return;
+		}
+
+		for (unsigned int y = y0; y < y1; y++) {
+			unsigned int line = bInvert ? height - 1 - y : y;
+			CopyBytes(dest + (size_t)y*destStride, source + (size_t)line*sourceStride, lineBytes, bStream);
+		}
+	}
+
 	void FlipBuffer(const unsigned char *src, 
 					unsigned char *dst,
 					unsigned int width,
 					unsigned int height)
 	{
-		const unsigned char * From = src;
-		unsigned char * To = dst;
 		unsigned int pitch = width * 4; // RGBA default
-		unsigned int line_s = 0;
-		unsigned int line_t = (height - 1)*pitch;
-
-		for (unsigned int y = 0; y<height; y++) {
-			if (width <= 640 || height <= 480) // too small for assembler
-				memcpy((void *)(To + line_t), (void *)(From + line_s), pitch);
-			else if ((pitch % 16) == 0) // use sse assembler function
-				memcpy_sse2((void *)(To + line_t), (void *)(From + line_s), pitch);
-			else if ((pitch % 4) == 0) // use 4 byte move assembler function
-				__movsd((unsigned long *)(To + line_t), (unsigned long *)(From + line_s), pitch / 4);
-			else
-				memcpy((void *)(To + line_t), (void *)(From + line_s), pitch);
-			line_s += pitch;
-			line_t -= pitch;
-		}
+		bool bStream = (size_t)pitch*height >= GetStreamThreshold();
+		CopyLineBand(src, pitch, dst, pitch, pitch, height, 0, height, true, bStream);
 
 	} // end FlipBuffer
 
 
+	//
+	// Copy lines with different source and destination strides
+	//
+	// Non-temporal stores are used if the image is larger than the stream threshold.
+	// Large images are split into bands of rows if SetThreads has been used.
+	//
+	void CopyLines(const unsigned char *source, unsigned int sourceStride,
+		unsigned char *dest, unsigned int destStride,
+		unsigned int lineBytes, unsigned int height, bool bInvert)
+	{
+		if (source == NULL || dest == NULL || lineBytes == 0 || height == 0)
+			return;
+
+		bool bStream = (size_t)lineBytes*height >= GetStreamThreshold();
+
+		if (!UseThreads(lineBytes / 4, height)) {
+			CopyLineBand(source, sourceStride, dest, destStride, lineBytes, height, 0, height, bInvert, bStream);
+			return;
+		}
+
+		GetThreadPool().Run(height, [=](unsigned int y0, unsigned int y1) {
+			CopyLineBand(source, sourceStride, dest, destStride, lineBytes, height, y0, y1, bInvert, bStream);
+		});
+	}
+
+
+	//
+	// Exchange two lines, optionally swapping red and blue
+	//
+	// Both lines are loaded before either is stored, so a line
+	// exchanged with itself (the middle line) is only swapped.
+	// With bSwap the line is RGBA pixels and lineBytes is width*4.
+	//
+	template <bool bSwap>
+	static void swap_lines_c(unsigned char *a, unsigned char *b, unsigned int lineBytes)
+	{
+		unsigned int x = 0;
+		for (; x + 3 < lineBytes; x += 4) {
+			uint32_t pa, pb;
+			memcpy(&pa, a + x, 4);
+			memcpy(&pb, b + x, 4);
+			if (bSwap) {
+				pa = rgba_bgra_pixel(pa);
+				pb = rgba_bgra_pixel(pb);
+			}
+			memcpy(a + x, &pb, 4);
+			memcpy(b + x, &pa, 4);
+		}
+		for (; x < lineBytes; x++) {
+			unsigned char t = a[x];
+			a[x] = b[x];
+			b[x] = t;
+		}
+	}
+
+	template <bool bSwap>
+	NDI_TARGET("sse2")
+	static void swap_lines_sse2(unsigned char *a, unsigned char *b, unsigned int lineBytes)
+	{
+		const __m128i brMask = _mm_set1_epi32(0x00ff00ff);
+		unsigned int x = 0;
+		for (; x + 15 < lineBytes; x += 16) {
+			__m128i pa = _mm_loadu_si128((const __m128i *)(a + x));
+			__m128i pb = _mm_loadu_si128((const __m128i *)(b + x));
+			if (bSwap) {
+				// As rgba_bgra_sse2
+				__m128i br = _mm_and_si128(pa, brMask);
+				br = _mm_shufflehi_epi16(_mm_shufflelo_epi16(br, _MM_SHUFFLE(2, 3, 0, 1)), _MM_SHUFFLE(2, 3, 0, 1));
+				pa = _mm_or_si128(_mm_andnot_si128(brMask, pa), br);
+				br = _mm_and_si128(pb, brMask);
+				br = _mm_shufflehi_epi16(_mm_shufflelo_epi16(br, _MM_SHUFFLE(2, 3, 0, 1)), _MM_SHUFFLE(2, 3, 0, 1));
+				pb = _mm_or_si128(_mm_andnot_si128(brMask, pb), br);
+			}
+			_mm_storeu_si128((__m128i *)(a + x), pb);
+			_mm_storeu_si128((__m128i *)(b + x), pa);
+		}
+		swap_lines_c<bSwap>(a + x, b + x, lineBytes - x);
+	}
+
+	template <bool bSwap>
+	NDI_TARGET("avx2")
+	static void swap_lines_avx2(unsigned char *a, unsigned char *b, unsigned int lineBytes)
+	{
+		const __m256i swapShuffle = _mm256_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+			                                         2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+		unsigned int x = 0;
+		// 64 bytes of each line per loop
+		for (; x + 63 < lineBytes; x += 64) {
+			__m256i pa0 = _mm256_loadu_si256((const __m256i *)(a + x));
+			__m256i pa1 = _mm256_loadu_si256((const __m256i *)(a + x + 32));
+			__m256i pb0 = _mm256_loadu_si256((const __m256i *)(b + x));
+			__m256i pb1 = _mm256_loadu_si256((const __m256i *)(b + x + 32));
+			if (bSwap) {
+				pa0 = _mm256_shuffle_epi8(pa0, swapShuffle);
+				pa1 = _mm256_shuffle_epi8(pa1, swapShuffle);
+				pb0 = _mm256_shuffle_epi8(pb0, swapShuffle);
+				pb1 = _mm256_shuffle_epi8(pb1, swapShuffle);
+			}
+			_mm256_storeu_si256((__m256i *)(a + x), pb0);
+			_mm256_storeu_si256((__m256i *)(a + x + 32), pb1);
+			_mm256_storeu_si256((__m256i *)(b + x), pa0);
+			_mm256_storeu_si256((__m256i *)(b + x + 32), pa1);
+		}
+		swap_lines_c<bSwap>(a + x, b + x, lineBytes - x);
+	}
+
+	typedef void (*swap_lines_func)(unsigned char *a, unsigned char *b, unsigned int lineBytes);
+
+	static swap_lines_func SelectSwapLines(bool bSwapRB)
+	{
+		if (UseAVX2()) return bSwapRB ? swap_lines_avx2<true> : swap_lines_avx2<false>;
+		if (UseSSE2()) return bSwapRB ? swap_lines_sse2<true> : swap_lines_sse2<false>;
+		return bSwapRB ? swap_lines_c<true> : swap_lines_c<false>;
+	}
+
+	//
+	// Flip an image in place
+	//
+	// Lines from the top and bottom are exchanged through registers,
+	// so no second frame buffer is needed and each line is written once.
+	// Pairs of lines are split into bands if SetThreads has been used.
+	//
+	void FlipImage(unsigned char *image, unsigned int stride, unsigned int lineBytes,
+		unsigned int height, bool bSwapRB)
+	{
+		if (image == NULL || lineBytes == 0 || height == 0)
+			return;
+
+		swap_lines_func swap_lines = SelectSwapLines(bSwapRB);
+
+		// Line y is exchanged with line height-1-y,
+		// including the middle line of an odd height
+		unsigned int pairs = (height + 1) / 2;
+		auto band = [=](unsigned int y0, unsigned int y1) {
+			for (unsigned int y = y0; y < y1; y++)
+				swap_lines(image + (size_t)y*stride, image + (size_t)(height - 1 - y)*stride, lineBytes);
+		};
+
+		if (!UseThreads(lineBytes / 4, height))
+			band(0, pairs);
+		else
+			GetThreadPool().Run(pairs, band);
+	}
+
 	//
 	// Copy source image to dest, optionally converting bgra<>rgba and/or inverting image
 	//
+	// Large images are split into bands of rows if SetThreads has been used.
+	//
 	void CopyImage(const unsigned char *source, unsigned char *dest, 
 				   unsigned int width, unsigned int height, unsigned int stride,
-				   bool bSwapRB, bool bInvert)
+				   bool bSwapRB, bool bInvert, unsigned int destStride)
 	{
 
 		// printf("CopyImage(%x, %x, %d, %d, %d, (%d, %d)\n", source, dest, width, height, stride, bSwapRB, bInvert);
 		if (source == NULL || dest == NULL)
 			return;
 
-		if(bSwapRB) { // user requires bgra->rgba or rgba->bgra conversion from source to dest
-			rgba_bgra_sse2((const void *)source, (void *)dest, width, height, bInvert);
+		unsigned int lineBytes = width * 4;
+		if (destStride == 0)
+			destStride = lineBytes;
+
+		if (!bSwapRB) {
+			CopyLines(source, stride, dest, destStride, lineBytes, height, bInvert);
+			return;
 		}
-		else {
-			if(bInvert) {
-				FlipBuffer(source, dest, width, height);
-			}
-			else if (width <= 640 || height <= 480) {
-				memcpy((void *)dest, (const void *)source, height*stride);
-			}
-			else if((stride % 16) == 0) { // 16 byte aligned
-				memcpy_sse2((void *)dest, (const void *)source, height*stride);
-			}
-			else if((stride % 4) == 0) { // 4 byte aligned
-				__movsd((unsigned long *)dest, (const unsigned long *)source, height*stride);
-			}
-			else {
-				memcpy((void *)dest, (const void *)source, height*stride);
-			}
+
+		// user requires bgra->rgba or rgba->bgra conversion from source to dest
+		if (stride == lineBytes && destStride == lineBytes) {
+			rgba_bgra((const void *)source, (void *)dest, width, height, bInvert);
+			return;
 		}
 
+		// Padded lines
+		ConvertImage(source, stride, FORMAT_RGBA, dest, destStride, FORMAT_BGRA, width, height, bInvert);
+
 	} // end CopyImage
 
 
@@ -265,59 +838,1703 @@ namespace ofxNDIutils {
 	// U and V sampled at every second pixel 
 	// 2 pixels in 1 DWORD
 	//
-	//	R = Y + 1.403V
-	//	G = Y - 0.344U - 0.714V
-	//	B = Y + 1.770U
+	//	R = Y + 2(1-Kr)V
+	//	G = Y - 2Kb(1-Kb)/Kg U - 2Kr(1-Kr)/Kg V
+	//	B = Y + 2(1-Kb)U
 	//
-	//	R = 298*y + 409*v + 128 >> 8
-	//  G = 298*y - 100*u-208*v +128 >> 8
-	//  B = 298*y + 516*u +128 >> 8
+	//	Kg = 1 - Kr - Kb
+	//	BT.601  : Kr = 0.299,  Kb = 0.114
+	//	BT.709  : Kr = 0.2126, Kb = 0.0722
+	//	BT.2020 : Kr = 0.2627, Kb = 0.0593
 	//
-	void YUV422_to_RGBA(const unsigned char * source, unsigned char * dest, unsigned int width, unsigned int height, unsigned int stride)
-	{
-		// Clamp out of range values
-		#define CLAMPRGB(t) (((t)>255)?255:(((t)<0)?0:(t)))
+	// Limited range scales Y-16 by 255/219 and U, V by 255/224.
+	//
+	// Fixed point for 16 bit SIMD multiply :
+	// Y-16, U-128 and V-128 are shifted left by 6 and multiplied by
+	// coefficients scaled by 8192 keeping the high 16 bits.
+	// The sum of the terms has 3 fractional bits which are rounded off
+	// and the result saturated to 0-255. The C version does the same
+	// arithmetic so that all versions produce identical output.
+	//
+	struct YUVcoefficients {
+		short y;  // Y gain
+		short rv; // V to R
+		short gu; // U to G (subtracted)
+		short gv; // V to G (subtracted)
+		short bu; // U to B
+		short yoffset; // 16 for limited range
+	};
 
-		const unsigned char *yuv = source;
-		unsigned char *rgba = dest;
-		int r1 = 0 , g1 = 0 , b1 = 0; // , a1 = 0;
-		int r2 = 0 , g2 = 0 , b2 = 0; // a2 = 0;
-		int u0 = 0 , y0 = 0 , v0 = 0, y1 = 0;
+	static YUVcoefficients GetYUVcoefficients(ColorMatrix matrix, bool bFullRange)
+	{
+		double Kr = 0.299;
+		double Kb = 0.114;
+		if (matrix == BT709) {
+			Kr = 0.2126;
+			Kb = 0.0722;
+		}
+		else if (matrix == BT2020) {
+			Kr = 0.2627;
+			Kb = 0.0593;
+		}
+		double Kg = 1.0 - Kr - Kb;
+		double ygain = bFullRange ? 1.0 : 255.0 / 219.0;
+		double cgain = bFullRange ? 1.0 : 255.0 / 224.0;
 
-		unsigned int padding = stride - width*4;
+		YUVcoefficients c;
+		c.y  = (short)(ygain*8192.0 + 0.5);
+		c.rv = (short)(cgain*2.0*(1.0 - Kr)*8192.0 + 0.5);
+		c.gu = (short)(cgain*2.0*Kb*(1.0 - Kb) / Kg*8192.0 + 0.5);
+		c.gv = (short)(cgain*2.0*Kr*(1.0 - Kr) / Kg*8192.0 + 0.5);
+		c.bu = (short)(cgain*2.0*(1.0 - Kb)*8192.0 + 0.5);
+		c.yoffset = bFullRange ? 0 : 16;
+		return c;
+	}
 
-	    // Loop through 4 bytes at a time
-		for (unsigned int y = 0; y <height; y ++ ) {
-			for (unsigned int x = 0; x <width*2; x +=4 ) {
-				u0  = (int)*yuv++;
-				y0  = (int)*yuv++;
-				v0  = (int)*yuv++;
-				y1  = (int)*yuv++;
-				// u and v are +-0.5
-				u0 -= 128;
-				v0 -= 128;
+	// Colour matrix used by NDI for the image size
+	ColorMatrix GetColorMatrix(unsigned int width, unsigned int height)
+	{
+		if (width > 1920 || height > 1080)
+			return BT2020; // UHD
+		if (height >= 720)
+			return BT709; // HD
+		return BT601; // SD
+	}
 
-				// Color space conversion for RGB
-				r1 = CLAMPRGB((298*y0+409*v0+128)>>8);
-				g1 = CLAMPRGB((298*y0-100*u0-208*v0+128)>>8);
-				b1 = CLAMPRGB((298*y0+516*u0+128)>>8);
-				r2 = CLAMPRGB((298*y1+409*v0+128)>>8);
-				g2 = CLAMPRGB((298*y1-100*u0-208*v0+128)>>8);
-				b2 = CLAMPRGB((298*y1+516*u0+128)>>8);
+	// High 16 bits of a signed 16 bit multiply as for _mm_mulhi_epi16
+	static inline int mulhi16(int a, int b)
+	{
+		return (a*b) >> 16;
+	}
 
-				*rgba++ = (unsigned char)r1;
-				*rgba++ = (unsigned char)g1;
-				*rgba++ = (unsigned char)b1;
-				*rgba++ = 255;
-				*rgba++ = (unsigned char)r2;
-				*rgba++ = (unsigned char)g2;
-				*rgba++ = (unsigned char)b2;
-				*rgba++ = 255;
-			}
-			yuv += width*2; // half width source data
-			yuv += padding; // if any
-		}
+	// Clamp out of range values
+	static inline unsigned char clamp255(int t)
+	{
+		return (unsigned char)((t > 255) ? 255 : ((t < 0) ? 0 : t));
 	}
 
-} // end YUV422_to_RGBA
+	// Convert one UYVY pixel pair to RGBA, or BGRA if bSwap
+	static inline void uyvy_rgba_pair(const unsigned char *yuv, unsigned char *rgba, const YUVcoefficients &c, bool bSecond, bool bSwap)
+	{
+		const int ri = bSwap ? 2 : 0;
+		const int bi = bSwap ? 0 : 2;
+		int u0 = ((int)yuv[0] - 128) * 64;
+		int y0 = ((int)yuv[1] - c.yoffset) * 64;
+		int v0 = ((int)yuv[2] - 128) * 64;
+		int y1 = ((int)yuv[3] - c.yoffset) * 64;
+
+		int rt = mulhi16(v0, c.rv);
+		int gt = -mulhi16(u0, c.gu) - mulhi16(v0, c.gv);
+		int bt = mulhi16(u0, c.bu);
+
+		int yt = mulhi16(y0, c.y);
+		rgba[ri] = clamp255((yt + rt + 4) >> 3);
+		rgba[1]  = clamp255((yt + gt + 4) >> 3);
+		rgba[bi] = clamp255((yt + bt + 4) >> 3);
+		rgba[3]  = 255;
+		if (bSecond) {
+			yt = mulhi16(y1, c.y);
+			rgba[4 + ri] = clamp255((yt + rt + 4) >> 3);
+			rgba[5]      = clamp255((yt + gt + 4) >> 3);
+			rgba[4 + bi] = clamp255((yt + bt + 4) >> 3);
+			rgba[7]      = 255;
+		}
+	}
+
+	// Convert the remainder of a line from pixel x
+	static inline void uyvy_rgba_line(const unsigned char *yuv, unsigned char *rgba, unsigned int x, unsigned int width, const YUVcoefficients &c,
+		bool bSwap = false)
+	{
+		for (; x < width; x += 2)
+			uyvy_rgba_pair(yuv + x * 2, rgba + x * 4, c, x + 1 < width, bSwap);
+	}
+
+	void YUV422_to_RGBA_c(const unsigned char * source, unsigned char * dest, unsigned int width, unsigned int height, unsigned int stride,
+		ColorMatrix matrix, bool bFullRange)
+	{
+		YUVcoefficients c = GetYUVcoefficients(matrix, bFullRange);
+		for (unsigned int y = 0; y < height; y++)
+			uyvy_rgba_line(source + (size_t)y*stride, dest + (size_t)y*width * 4, 0, width, c);
+	}
+
+	//
+	// SSE4.1 version - 16 pixels per loop
+	//
+	// 8 pixels (16 bytes of UYVY) are expanded to 16 bit Y, U and V
+	// with pshufb, converted, then packed with unsigned saturation
+	// and interleaved to RGBA.
+	//
+	NDI_TARGET("sse4.1")
+	static inline void uyvy_rgb_sse41(__m128i yuv, const YUVcoefficients &c, __m128i &r, __m128i &g, __m128i &b)
+	{
+		const __m128i yShuffle = _mm_setr_epi8(1, -1, 3, -1, 5, -1, 7, -1, 9, -1, 11, -1, 13, -1, 15, -1);
+		const __m128i uShuffle = _mm_setr_epi8(0, -1, 0, -1, 4, -1, 4, -1, 8, -1, 8, -1, 12, -1, 12, -1);
+		const __m128i vShuffle = _mm_setr_epi8(2, -1, 2, -1, 6, -1, 6, -1, 10, -1, 10, -1, 14, -1, 14, -1);
+
+		__m128i y = _mm_slli_epi16(_mm_sub_epi16(_mm_shuffle_epi8(yuv, yShuffle), _mm_set1_epi16(c.yoffset)), 6);
+		__m128i u = _mm_slli_epi16(_mm_sub_epi16(_mm_shuffle_epi8(yuv, uShuffle), _mm_set1_epi16(128)), 6);
+		__m128i v = _mm_slli_epi16(_mm_sub_epi16(_mm_shuffle_epi8(yuv, vShuffle), _mm_set1_epi16(128)), 6);
+
+		__m128i yt = _mm_mulhi_epi16(y, _mm_set1_epi16(c.y));
+		__m128i rt = _mm_mulhi_epi16(v, _mm_set1_epi16(c.rv));
+		__m128i gt = _mm_add_epi16(_mm_mulhi_epi16(u, _mm_set1_epi16(c.gu)), _mm_mulhi_epi16(v, _mm_set1_epi16(c.gv)));
+		__m128i bt = _mm_mulhi_epi16(u, _mm_set1_epi16(c.bu));
+
+		const __m128i round = _mm_set1_epi16(4);
+		yt = _mm_add_epi16(yt, round);
+		r = _mm_srai_epi16(_mm_add_epi16(yt, rt), 3);
+		g = _mm_srai_epi16(_mm_sub_epi16(yt, gt), 3);
+		b = _mm_srai_epi16(_mm_add_epi16(yt, bt), 3);
+	}
+
+	// One line to RGBA, or BGRA if bSwap
+	template <bool bSwap>
+	NDI_TARGET("sse4.1")
+	static void uyvy_rgba_line_sse41(const unsigned char *yuv, unsigned char *rgba, unsigned int width, const YUVcoefficients &c)
+	{
+		const __m128i alpha = _mm_set1_epi8(-1);
+		unsigned int x = 0;
+		for (; x + 15 < width; x += 16) {
+			__m128i r0, g0, b0, r1, g1, b1;
+			uyvy_rgb_sse41(_mm_loadu_si128((const __m128i *)(yuv + x * 2)), c, r0, g0, b0);
+			uyvy_rgb_sse41(_mm_loadu_si128((const __m128i *)(yuv + x * 2 + 16)), c, r1, g1, b1);
+			__m128i r = _mm_packus_epi16(r0, r1);
+			__m128i g = _mm_packus_epi16(g0, g1);
+			__m128i b = _mm_packus_epi16(b0, b1);
+			if (bSwap) {
+				__m128i t = r; r = b; b = t;
+			}
+			__m128i rg0 = _mm_unpacklo_epi8(r, g);
+			__m128i rg1 = _mm_unpackhi_epi8(r, g);
+			__m128i ba0 = _mm_unpacklo_epi8(b, alpha);
+			__m128i ba1 = _mm_unpackhi_epi8(b, alpha);
+			_mm_storeu_si128((__m128i *)(rgba + x * 4),      _mm_unpacklo_epi16(rg0, ba0));
+			_mm_storeu_si128((__m128i *)(rgba + x * 4 + 16), _mm_unpackhi_epi16(rg0, ba0));
+			_mm_storeu_si128((__m128i *)(rgba + x * 4 + 32), _mm_unpacklo_epi16(rg1, ba1));
+			_mm_storeu_si128((__m128i *)(rgba + x * 4 + 48), _mm_unpackhi_epi16(rg1, ba1));
+		}
+		uyvy_rgba_line(yuv, rgba, x, width, c, bSwap);
+	}
+
+	void YUV422_to_RGBA_sse41(const unsigned char * source, unsigned char * dest, unsigned int width, unsigned int height, unsigned int stride,
+		ColorMatrix matrix, bool bFullRange)
+	{
+		YUVcoefficients c = GetYUVcoefficients(matrix, bFullRange);
+		for (unsigned int y = 0; y < height; y++)
+			uyvy_rgba_line_sse41<false>(source + (size_t)y*stride, dest + (size_t)y*width * 4, width, c);
+	}
+
+	//
+	// AVX2 version - 32 pixels per loop
+	//
+	// Pack and unpack work within each 128 bit lane,
+	// so the pixel order is restored with a lane permute on store.
+	//
+	NDI_TARGET("avx2")
+	static inline void uyvy_rgb_avx2(__m256i yuv, const YUVcoefficients &c, __m256i &r, __m256i &g, __m256i &b)
+	{
+		const __m256i yShuffle = _mm256_setr_epi8(1, -1, 3, -1, 5, -1, 7, -1, 9, -1, 11, -1, 13, -1, 15, -1,
+			                                      1, -1, 3, -1, 5, -1, 7, -1, 9, -1, 11, -1, 13, -1, 15, -1);
+		const __m256i uShuffle = _mm256_setr_epi8(0, -1, 0, -1, 4, -1, 4, -1, 8, -1, 8, -1, 12, -1, 12, -1,
+			                                      0, -1, 0, -1, 4, -1, 4, -1, 8, -1, 8, -1, 12, -1, 12, -1);
+		const __m256i vShuffle = _mm256_setr_epi8(2, -1, 2, -1, 6, -1, 6, -1, 10, -1, 10, -1, 14, -1, 14, -1,
+			                                      2, -1, 2, -1, 6, -1, 6, -1, 10, -1, 10, -1, 14, -1, 14, -1);
+
+		__m256i y = _mm256_slli_epi16(_mm256_sub_epi16(_mm256_shuffle_epi8(yuv, yShuffle), _mm256_set1_epi16(c.yoffset)), 6);
+		__m256i u = _mm256_slli_epi16(_mm256_sub_epi16(_mm256_shuffle_epi8(yuv, uShuffle), _mm256_set1_epi16(128)), 6);
+		__m256i v = _mm256_slli_epi16(_mm256_sub_epi16(_mm256_shuffle_epi8(yuv, vShuffle), _mm256_set1_epi16(128)), 6);
+
+		__m256i yt = _mm256_mulhi_epi16(y, _mm256_set1_epi16(c.y));
+		__m256i rt = _mm256_mulhi_epi16(v, _mm256_set1_epi16(c.rv));
+		__m256i gt = _mm256_add_epi16(_mm256_mulhi_epi16(u, _mm256_set1_epi16(c.gu)), _mm256_mulhi_epi16(v, _mm256_set1_epi16(c.gv)));
+		__m256i bt = _mm256_mulhi_epi16(u, _mm256_set1_epi16(c.bu));
+
+		yt = _mm256_add_epi16(yt, _mm256_set1_epi16(4));
+		r = _mm256_srai_epi16(_mm256_add_epi16(yt, rt), 3);
+		g = _mm256_srai_epi16(_mm256_sub_epi16(yt, gt), 3);
+		b = _mm256_srai_epi16(_mm256_add_epi16(yt, bt), 3);
+	}
+
+	// One line to RGBA, or BGRA if bSwap
+	template <bool bSwap>
+	NDI_TARGET("avx2")
+	static void uyvy_rgba_line_avx2(const unsigned char *yuv, unsigned char *rgba, unsigned int width, const YUVcoefficients &c)
+	{
+		const __m256i alpha = _mm256_set1_epi8(-1);
+		unsigned int x = 0;
+		for (; x + 31 < width; x += 32) {
+			__m256i r0, g0, b0, r1, g1, b1;
+			uyvy_rgb_avx2(_mm256_loadu_si256((const __m256i *)(yuv + x * 2)), c, r0, g0, b0);
+			uyvy_rgb_avx2(_mm256_loadu_si256((const __m256i *)(yuv + x * 2 + 32)), c, r1, g1, b1);
+			// Lane 0 : pixels 0-7, 16-23  Lane 1 : pixels 8-15, 24-31
+			__m256i r = _mm256_packus_epi16(r0, r1);
+			__m256i g = _mm256_packus_epi16(g0, g1);
+			__m256i b = _mm256_packus_epi16(b0, b1);
+			if (bSwap) {
+				__m256i t = r; r = b; b = t;
+			}
+			__m256i rg0 = _mm256_unpacklo_epi8(r, g); // 0-7, 8-15
+			__m256i rg1 = _mm256_unpackhi_epi8(r, g); // 16-23, 24-31
+			__m256i ba0 = _mm256_unpacklo_epi8(b, alpha);
+			__m256i ba1 = _mm256_unpackhi_epi8(b, alpha);
+			__m256i p0 = _mm256_unpacklo_epi16(rg0, ba0); // 0-3, 8-11
+			__m256i p1 = _mm256_unpackhi_epi16(rg0, ba0); // 4-7, 12-15
+			__m256i p2 = _mm256_unpacklo_epi16(rg1, ba1); // 16-19, 24-27
+			__m256i p3 = _mm256_unpackhi_epi16(rg1, ba1); // 20-23, 28-31
+			_mm256_storeu_si256((__m256i *)(rgba + x * 4),      _mm256_permute2x128_si256(p0, p1, 0x20));
+			_mm256_storeu_si256((__m256i *)(rgba + x * 4 + 32), _mm256_permute2x128_si256(p0, p1, 0x31));
+			_mm256_storeu_si256((__m256i *)(rgba + x * 4 + 64), _mm256_permute2x128_si256(p2, p3, 0x20));
+			_mm256_storeu_si256((__m256i *)(rgba + x * 4 + 96), _mm256_permute2x128_si256(p2, p3, 0x31));
+		}
+		uyvy_rgba_line(yuv, rgba, x, width, c, bSwap);
+	}
+
+	void YUV422_to_RGBA_avx2(const unsigned char * source, unsigned char * dest, unsigned int width, unsigned int height, unsigned int stride,
+		ColorMatrix matrix, bool bFullRange)
+	{
+		YUVcoefficients c = GetYUVcoefficients(matrix, bFullRange);
+		for (unsigned int y = 0; y < height; y++)
+			uyvy_rgba_line_avx2<false>(source + (size_t)y*stride, dest + (size_t)y*width * 4, width, c);
+	}
+
+	void YUV422_to_RGBA(const unsigned char * source, unsigned char * dest, unsigned int width, unsigned int height, unsigned int stride,
+		ColorMatrix matrix, bool bFullRange)
+	{
+		ConvertImage(source, stride, FORMAT_UYVY, dest, 0, FORMAT_RGBA, width, height, false, false, matrix, bFullRange);
+	}
+
+
+	//
+	//        RGBA_to_YUV422
+	//
+	// The same conversion as the rgba2yuv sender shader (ofxNDIshaders)
+	// so that CPU and GPU output agree within 1 LSB.
+	//
+	//	Y = (0.2215*R + 0.7154*G + 0.0721*B)/1.16438 + 16
+	//	U = -0.1145*R - 0.3855*G + 0.5000*B + 128
+	//	V =  0.5016*R - 0.4556*G - 0.0459*B + 128
+	//
+	// U and V are taken from the first pixel of each pair as in the shader.
+	// Coefficients are scaled by 16384 for 16 bit multiply-add.
+	// A BGRA source uses the same arithmetic with r and b coefficients exchanged.
+	//
+	struct RGBYUVcoefficients {
+		short yr, yg, yb;
+		short ur, ug, ub;
+		short vr, vg, vb;
+	};
+
+	static RGBYUVcoefficients GetRGBYUVcoefficients(bool bSwapRB)
+	{
+		RGBYUVcoefficients c;
+		c.yr = (short)(0.2215 / 1.16438*16384.0 + 0.5);
+		c.yg = (short)(0.7154 / 1.16438*16384.0 + 0.5);
+		c.yb = (short)(0.0721 / 1.16438*16384.0 + 0.5);
+		c.ur = -(short)(0.1145*16384.0 + 0.5);
+		c.ug = -(short)(0.3855*16384.0 + 0.5);
+		c.ub = (short)(0.5000*16384.0 + 0.5);
+		c.vr = (short)(0.5016*16384.0 + 0.5);
+		c.vg = -(short)(0.4556*16384.0 + 0.5);
+		c.vb = -(short)(0.0459*16384.0 + 0.5);
+		if (bSwapRB) {
+			short t = 0;
+			t = c.yr; c.yr = c.yb; c.yb = t;
+			t = c.ur; c.ur = c.ub; c.ub = t;
+			t = c.vr; c.vr = c.vb; c.vb = t;
+		}
+		return c;
+	}
+
+	// Offsets including rounding (0.5 << 14)
+	static const int yuvYoffset = (16 << 14) + (1 << 13);
+	static const int yuvCoffset = (128 << 14) + (1 << 13);
+
+	// Convert the remainder of a line from pixel x
+	static inline void rgba_uyvy_line(const unsigned char *rgba, unsigned char *yuv, unsigned int x, unsigned int width, const RGBYUVcoefficients &c)
+	{
+		for (; x < width; x += 2) {
+			const unsigned char *p0 = rgba + x * 4;
+			const unsigned char *p1 = (x + 1 < width) ? p0 + 4 : p0;
+			unsigned char *q = yuv + x * 2;
+			q[0] = clamp255((c.ur*p0[0] + c.ug*p0[1] + c.ub*p0[2] + yuvCoffset) >> 14);
+			q[1] = clamp255((c.yr*p0[0] + c.yg*p0[1] + c.yb*p0[2] + yuvYoffset) >> 14);
+			q[2] = clamp255((c.vr*p0[0] + c.vg*p0[1] + c.vb*p0[2] + yuvCoffset) >> 14);
+			q[3] = clamp255((c.yr*p1[0] + c.yg*p1[1] + c.yb*p1[2] + yuvYoffset) >> 14);
+		}
+	}
+
+	void RGBA_to_YUV422_c(const unsigned char * source, unsigned char * dest, unsigned int width, unsigned int height, unsigned int stride,
+		bool bSwapRB, bool bInvert)
+	{
+		RGBYUVcoefficients c = GetRGBYUVcoefficients(bSwapRB);
+		for (unsigned int y = 0; y < height; y++) {
+			unsigned int line = bInvert ? height - 1 - y : y;
+			rgba_uyvy_line(source + (size_t)line*width * 4, dest + (size_t)y*stride, 0, width, c);
+		}
+	}
+
+	//
+	// SSE4.1 version - 16 pixels per loop
+	//
+	// pmaddwd on 16 bit r g b a gives r*cr + g*cg and b*cb for each pixel.
+	// phaddd then completes Y for four pixels, or U and V for the two
+	// even pixels when the first pixel of each pair is duplicated.
+	//
+	NDI_TARGET("sse4.1")
+	static inline __m128i rgba_uyvy_sse41(__m128i px, __m128i yCoeffs, __m128i uvCoeffs, __m128i yOffset, __m128i uvOffset)
+	{
+		const __m128i zero = _mm_setzero_si128();
+		__m128i p01 = _mm_unpacklo_epi8(px, zero); // pixels 0, 1
+		__m128i p23 = _mm_unpackhi_epi8(px, zero); // pixels 2, 3
+
+		__m128i y = _mm_hadd_epi32(_mm_madd_epi16(p01, yCoeffs), _mm_madd_epi16(p23, yCoeffs));
+		__m128i uv = _mm_hadd_epi32(_mm_madd_epi16(_mm_unpacklo_epi64(p01, p01), uvCoeffs),
+			                        _mm_madd_epi16(_mm_unpacklo_epi64(p23, p23), uvCoeffs));
+		y  = _mm_srai_epi32(_mm_add_epi32(y, yOffset), 14);  // Y0 Y1 Y2 Y3
+		uv = _mm_srai_epi32(_mm_add_epi32(uv, uvOffset), 14); // U0 V0 U2 V2
+
+		// U0 Y0 V0 Y1 U2 Y2 V2 Y3 as 16 bit
+		return _mm_packs_epi32(_mm_unpacklo_epi32(uv, y), _mm_unpackhi_epi32(uv, y));
+	}
+
+	// One line of RGBA, or BGRA with swapped coefficients
+	// bAlpha also writes the alpha of each pixel to a UYVA alpha line
+	// from the pixels already loaded.
+	template <bool bAlpha>
+	NDI_TARGET("sse4.1")
+	static void rgba_uyva_line_sse41(const unsigned char *rgba, unsigned char *yuv, unsigned char *alpha,
+		unsigned int width, const RGBYUVcoefficients &c)
+	{
+		const __m128i yCoeffs  = _mm_setr_epi16(c.yr, c.yg, c.yb, 0, c.yr, c.yg, c.yb, 0);
+		const __m128i uvCoeffs = _mm_setr_epi16(c.ur, c.ug, c.ub, 0, c.vr, c.vg, c.vb, 0);
+		const __m128i yOffset  = _mm_set1_epi32(yuvYoffset);
+		const __m128i uvOffset = _mm_set1_epi32(yuvCoffset);
+		// Alpha bytes of four pixels to the low 32 bits
+		const __m128i alphaMask = _mm_setr_epi8(3, 7, 11, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+		unsigned int x = 0;
+		for (; x + 15 < width; x += 16) {
+			__m128i p0 = _mm_loadu_si128((const __m128i *)(rgba + x * 4));
+			__m128i p1 = _mm_loadu_si128((const __m128i *)(rgba + x * 4 + 16));
+			__m128i p2 = _mm_loadu_si128((const __m128i *)(rgba + x * 4 + 32));
+			__m128i p3 = _mm_loadu_si128((const __m128i *)(rgba + x * 4 + 48));
+			__m128i q0 = rgba_uyvy_sse41(p0, yCoeffs, uvCoeffs, yOffset, uvOffset);
+			__m128i q1 = rgba_uyvy_sse41(p1, yCoeffs, uvCoeffs, yOffset, uvOffset);
+			__m128i q2 = rgba_uyvy_sse41(p2, yCoeffs, uvCoeffs, yOffset, uvOffset);
+			__m128i q3 = rgba_uyvy_sse41(p3, yCoeffs, uvCoeffs, yOffset, uvOffset);
+			_mm_storeu_si128((__m128i *)(yuv + x * 2),      _mm_packus_epi16(q0, q1));
+			_mm_storeu_si128((__m128i *)(yuv + x * 2 + 16), _mm_packus_epi16(q2, q3));
+			if (bAlpha) {
+				__m128i a01 = _mm_unpacklo_epi32(_mm_shuffle_epi8(p0, alphaMask), _mm_shuffle_epi8(p1, alphaMask));
+				__m128i a23 = _mm_unpacklo_epi32(_mm_shuffle_epi8(p2, alphaMask), _mm_shuffle_epi8(p3, alphaMask));
+				_mm_storeu_si128((__m128i *)(alpha + x), _mm_unpacklo_epi64(a01, a23));
+			}
+		}
+		rgba_uyvy_line(rgba, yuv, x, width, c);
+		if (bAlpha) {
+			for (; x < width; x++)
+				alpha[x] = rgba[x * 4 + 3];
+		}
+	}
+
+	static void rgba_uyvy_line_sse41(const unsigned char *rgba, unsigned char *yuv, unsigned int width, const RGBYUVcoefficients &c)
+	{
+		rgba_uyva_line_sse41<false>(rgba, yuv, NULL, width, c);
+	}
+
+	void RGBA_to_YUV422_sse41(const unsigned char * source, unsigned char * dest, unsigned int width, unsigned int height, unsigned int stride,
+		bool bSwapRB, bool bInvert)
+	{
+		RGBYUVcoefficients c = GetRGBYUVcoefficients(bSwapRB);
+		for (unsigned int y = 0; y < height; y++) {
+			unsigned int line = bInvert ? height - 1 - y : y;
+			rgba_uyvy_line_sse41(source + (size_t)line*width * 4, dest + (size_t)y*stride, width, c);
+		}
+	}
+
+	void RGBA_to_YUV422(const unsigned char * source, unsigned char * dest, unsigned int width, unsigned int height, unsigned int stride, bool bInvert)
+	{
+		ConvertImage(source, 0, FORMAT_RGBA, dest, stride, FORMAT_UYVY, width, height, bInvert);
+	}
+
+	void BGRA_to_YUV422(const unsigned char * source, unsigned char * dest, unsigned int width, unsigned int height, unsigned int stride, bool bInvert)
+	{
+		ConvertImage(source, 0, FORMAT_BGRA, dest, stride, FORMAT_UYVY, width, height, bInvert);
+	}
+
+
+	//
+	//        ConvertImage
+	//
+	// Every combination of source and destination format, swap and alpha fill
+	// has its own line function, instantiated from the templates below for each
+	// instruction set. Each pixel is read and written once. Flip and line strides
+	// only change the line addresses and are handled by the common line loop.
+	//
+
+	// Float coefficients for P216 and PA16
+	struct DeepCoefficients {
+		float yoffset; // Y black level
+		float yscale;  // Y to 0-1
+		float cscale;  // Cb Cr to +-0.5
+		float rv, gu, gv, bu; // YUV to RGB
+		float kr, kg, kb; // RGB to Y
+		float ygain;  // 0-1 to Y
+		float cbgain; // Sum of two (B - Y) to Cb
+		float crgain; // Sum of two (R - Y) to Cr
+	};
+
+	static DeepCoefficients GetDeepCoefficients(ColorMatrix matrix, bool bFullRange)
+	{
+		double Kr = 0.299;
+		double Kb = 0.114;
+		if (matrix == BT709) {
+			Kr = 0.2126;
+			Kb = 0.0722;
+		}
+		else if (matrix == BT2020) {
+			Kr = 0.2627;
+			Kb = 0.0593;
+		}
+		double Kg = 1.0 - Kr - Kb;
+		// 8 bit limited range scaled by 256
+		double yrange = bFullRange ? 65535.0 : 219.0*256.0;
+		double crange = bFullRange ? 65535.0 : 224.0*256.0;
+
+		DeepCoefficients c;
+		c.yoffset = bFullRange ? 0.0f : 16.0f*256.0f;
+		c.yscale = (float)(1.0 / yrange);
+		c.cscale = (float)(1.0 / crange);
+		c.rv = (float)(2.0*(1.0 - Kr));
+		c.gu = (float)(2.0*Kb*(1.0 - Kb) / Kg);
+		c.gv = (float)(2.0*Kr*(1.0 - Kr) / Kg);
+		c.bu = (float)(2.0*(1.0 - Kb));
+		c.kr = (float)Kr;
+		c.kg = (float)Kg;
+		c.kb = (float)Kb;
+		c.ygain = (float)yrange;
+		c.cbgain = (float)(0.5*crange / (2.0*(1.0 - Kb)));
+		c.crgain = (float)(0.5*crange / (2.0*(1.0 - Kr)));
+		return c;
+	}
+
+	struct ConvertParams {
+		YUVcoefficients yuv;       // UYVY source
+		RGBYUVcoefficients rgbyuv; // UYVY destination
+		DeepCoefficients deep;     // P216 and PA16
+		size_t sourcePlane; // Bytes from one plane to the next
+		size_t destPlane;
+	};
+
+	typedef void (*convert_line_func)(const unsigned char *source, unsigned char *dest, unsigned int width, const ConvertParams &params);
+
+	// RGBA to RGBA with r and b swapped and/or alpha set to 255
+	template <bool bSwap, bool bAlpha>
+	static void convert_rgba_rgba_c(const unsigned char *source, unsigned char *dest, unsigned int width, const ConvertParams &)
+	{
+		const uint32_t *src = (const uint32_t *)source;
+		uint32_t *dst = (uint32_t *)dest;
+		for (unsigned int x = 0; x < width; x++) {
+			uint32_t pixel = src[x];
+			if (bSwap)
+				pixel = rgba_bgra_pixel(pixel);
+			if (bAlpha)
+				pixel |= 0xff000000;
+			dst[x] = pixel;
+		}
+	}
+
+	template <bool bSwap, bool bAlpha>
+	NDI_TARGET("sse2")
+	static void convert_rgba_rgba_sse2(const unsigned char *source, unsigned char *dest, unsigned int width, const ConvertParams &params)
+	{
+		const __m128i brMask = _mm_set1_epi32(0x00ff00ff);
+		const __m128i alpha = _mm_set1_epi32((int)0xff000000);
+		unsigned int x = 0;
+		for (; x + 3 < width; x += 4) {
+			__m128i pixels = _mm_loadu_si128((const __m128i *)(source + x * 4));
+			if (bSwap) {
+				// As rgba_bgra_sse2
+				__m128i ga = _mm_andnot_si128(brMask, pixels);
+				__m128i br = _mm_and_si128(pixels, brMask);
+				br = _mm_shufflehi_epi16(_mm_shufflelo_epi16(br, _MM_SHUFFLE(2, 3, 0, 1)), _MM_SHUFFLE(2, 3, 0, 1));
+				pixels = _mm_or_si128(ga, br);
+			}
+			if (bAlpha)
+				pixels = _mm_or_si128(pixels, alpha);
+			_mm_storeu_si128((__m128i *)(dest + x * 4), pixels);
+		}
+		convert_rgba_rgba_c<bSwap, bAlpha>(source + x * 4, dest + x * 4, width - x, params);
+	}
+
+	template <bool bSwap, bool bAlpha>
+	NDI_TARGET("avx2")
+	static void convert_rgba_rgba_avx2(const unsigned char *source, unsigned char *dest, unsigned int width, const ConvertParams &params)
+	{
+		const __m256i swapShuffle = _mm256_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+			                                         2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+		const __m256i alpha = _mm256_set1_epi32((int)0xff000000);
+		unsigned int x = 0;
+		for (; x + 7 < width; x += 8) {
+			__m256i pixels = _mm256_loadu_si256((const __m256i *)(source + x * 4));
+			if (bSwap)
+				pixels = _mm256_shuffle_epi8(pixels, swapShuffle);
+			if (bAlpha)
+				pixels = _mm256_or_si256(pixels, alpha);
+			_mm256_storeu_si256((__m256i *)(dest + x * 4), pixels);
+		}
+		convert_rgba_rgba_c<bSwap, bAlpha>(source + x * 4, dest + x * 4, width - x, params);
+	}
+
+	// UYVY to RGBA, or BGRA if bSwap
+	template <bool bSwap>
+	static void convert_uyvy_rgba_c(const unsigned char *source, unsigned char *dest, unsigned int width, const ConvertParams &params)
+	{
+		uyvy_rgba_line(source, dest, 0, width, params.yuv, bSwap);
+	}
+
+	template <bool bSwap>
+	static void convert_uyvy_rgba_sse41(const unsigned char *source, unsigned char *dest, unsigned int width, const ConvertParams &params)
+	{
+		uyvy_rgba_line_sse41<bSwap>(source, dest, width, params.yuv);
+	}
+
+	template <bool bSwap>
+	static void convert_uyvy_rgba_avx2(const unsigned char *source, unsigned char *dest, unsigned int width, const ConvertParams &params)
+	{
+		uyvy_rgba_line_avx2<bSwap>(source, dest, width, params.yuv);
+	}
+
+	// UYVA to RGBA, or BGRA if bSwap
+	// The alpha line is sourcePlane bytes from the UYVY line
+	// and replaces the opaque alpha of the converted line in the cache.
+	static void uyva_alpha_line_c(const unsigned char *alpha, unsigned char *rgba, unsigned int x, unsigned int width)
+	{
+		for (; x < width; x++)
+			rgba[x * 4 + 3] = alpha[x];
+	}
+
+	NDI_TARGET("sse4.1")
+	static void uyva_alpha_line_sse41(const unsigned char *alpha, unsigned char *rgba, unsigned int width)
+	{
+		const __m128i rgbMask = _mm_set1_epi32(0x00ffffff);
+		unsigned int x = 0;
+		for (; x + 16 <= width; x += 16) {
+			__m128i a = _mm_loadu_si128((const __m128i *)(alpha + x));
+			__m128i *p = (__m128i *)(rgba + x * 4);
+			_mm_storeu_si128(p, _mm_or_si128(_mm_and_si128(_mm_loadu_si128(p), rgbMask),
+				_mm_slli_epi32(_mm_cvtepu8_epi32(a), 24)));
+			_mm_storeu_si128(p + 1, _mm_or_si128(_mm_and_si128(_mm_loadu_si128(p + 1), rgbMask),
+				_mm_slli_epi32(_mm_cvtepu8_epi32(_mm_srli_si128(a, 4)), 24)));
+			_mm_storeu_si128(p + 2, _mm_or_si128(_mm_and_si128(_mm_loadu_si128(p + 2), rgbMask),
+				_mm_slli_epi32(_mm_cvtepu8_epi32(_mm_srli_si128(a, 8)), 24)));
+			_mm_storeu_si128(p + 3, _mm_or_si128(_mm_and_si128(_mm_loadu_si128(p + 3), rgbMask),
+				_mm_slli_epi32(_mm_cvtepu8_epi32(_mm_srli_si128(a, 12)), 24)));
+		}
+		uyva_alpha_line_c(alpha, rgba, x, width);
+	}
+
+	template <bool bSwap>
+	static void convert_uyva_rgba_c(const unsigned char *source, unsigned char *dest, unsigned int width, const ConvertParams &params)
+	{
+		uyvy_rgba_line(source, dest, 0, width, params.yuv, bSwap);
+		uyva_alpha_line_c(source + params.sourcePlane, dest, 0, width);
+	}
+
+	template <bool bSwap>
+	static void convert_uyva_rgba_sse41(const unsigned char *source, unsigned char *dest, unsigned int width, const ConvertParams &params)
+	{
+		uyvy_rgba_line_sse41<bSwap>(source, dest, width, params.yuv);
+		uyva_alpha_line_sse41(source + params.sourcePlane, dest, width);
+	}
+
+	template <bool bSwap>
+	static void convert_uyva_rgba_avx2(const unsigned char *source, unsigned char *dest, unsigned int width, const ConvertParams &params)
+	{
+		uyvy_rgba_line_avx2<bSwap>(source, dest, width, params.yuv);
+		uyva_alpha_line_sse41(source + params.sourcePlane, dest, width);
+	}
+
+	// RGBA or BGRA to UYVY
+	static void convert_rgba_uyvy_c(const unsigned char *source, unsigned char *dest, unsigned int width, const ConvertParams &params)
+	{
+		rgba_uyvy_line(source, dest, 0, width, params.rgbyuv);
+	}
+
+	static void convert_rgba_uyvy_sse41(const unsigned char *source, unsigned char *dest, unsigned int width, const ConvertParams &params)
+	{
+		rgba_uyvy_line_sse41(source, dest, width, params.rgbyuv);
+	}
+
+	// RGBA or BGRA to UYVA
+	// The alpha line is destPlane bytes from the UYVY line
+	static void convert_rgba_uyva_c(const unsigned char *source, unsigned char *dest, unsigned int width, const ConvertParams &params)
+	{
+		rgba_uyvy_line(source, dest, 0, width, params.rgbyuv);
+		unsigned char *alpha = dest + params.destPlane;
+		for (unsigned int x = 0; x < width; x++)
+			alpha[x] = source[x * 4 + 3];
+	}
+
+	static void convert_rgba_uyva_sse41(const unsigned char *source, unsigned char *dest, unsigned int width, const ConvertParams &params)
+	{
+		rgba_uyva_line_sse41<true>(source, dest, dest + params.destPlane, width, params.rgbyuv);
+	}
+
+	//
+	// 4:2:0 planar formats for video encoders
+	//
+	// NV12 is a plane of Y followed by a plane of interleaved Cb Cr with
+	// the same line stride. I420 is a plane of Y followed by planes of Cb
+	// and Cr with half the line stride. Each chroma line is the average
+	// of a pair of UYVY lines, rounded up as pavgb. Both lines of a pair
+	// are converted together, so these are not line functions.
+	//
+
+	typedef void(*convert_420_func)(const unsigned char *source0, const unsigned char *source1,
+		unsigned char *Y0, unsigned char *Y1, unsigned char *U, unsigned char *V, unsigned int width);
+
+	// NV12 if bNV12, otherwise I420. V is not used for NV12.
+	template <bool bNV12>
+	static void uyvy_420_line_c(const unsigned char *source0, const unsigned char *source1,
+		unsigned char *Y0, unsigned char *Y1, unsigned char *U, unsigned char *V, unsigned int x, unsigned int width)
+	{
+		for (; x < width; x += 2) {
+			const unsigned char *p0 = source0 + x * 2;
+			const unsigned char *p1 = source1 + x * 2;
+			Y0[x] = p0[1];
+			Y1[x] = p1[1];
+			if (x + 1 < width) {
+				Y0[x + 1] = p0[3];
+				Y1[x + 1] = p1[3];
+			}
+			unsigned char cb = (unsigned char)((p0[0] + p1[0] + 1) >> 1);
+			unsigned char cr = (unsigned char)((p0[2] + p1[2] + 1) >> 1);
+			if (bNV12) {
+				U[x] = cb;
+				U[x + 1] = cr;
+			}
+			else {
+				U[x / 2] = cb;
+				V[x / 2] = cr;
+			}
+		}
+	}
+
+	template <bool bNV12>
+	static void convert_uyvy_420_c(const unsigned char *source0, const unsigned char *source1,
+		unsigned char *Y0, unsigned char *Y1, unsigned char *U, unsigned char *V, unsigned int width)
+	{
+		uyvy_420_line_c<bNV12>(source0, source1, Y0, Y1, U, V, 0, width);
+	}
+
+	// 16 pixels of each line at a time
+	template <bool bNV12>
+	NDI_TARGET("sse2")
+	static void convert_uyvy_420_sse2(const unsigned char *source0, const unsigned char *source1,
+		unsigned char *Y0, unsigned char *Y1, unsigned char *U, unsigned char *V, unsigned int width)
+	{
+		const __m128i lowBytes = _mm_set1_epi16(0x00ff);
+		unsigned int x = 0;
+		for (; x + 16 <= width; x += 16) {
+			__m128i a0 = _mm_loadu_si128((const __m128i *)(source0 + x * 2));
+			__m128i b0 = _mm_loadu_si128((const __m128i *)(source0 + x * 2 + 16));
+			__m128i a1 = _mm_loadu_si128((const __m128i *)(source1 + x * 2));
+			__m128i b1 = _mm_loadu_si128((const __m128i *)(source1 + x * 2 + 16));
+			_mm_storeu_si128((__m128i *)(Y0 + x), _mm_packus_epi16(_mm_srli_epi16(a0, 8), _mm_srli_epi16(b0, 8)));
+			_mm_storeu_si128((__m128i *)(Y1 + x), _mm_packus_epi16(_mm_srli_epi16(a1, 8), _mm_srli_epi16(b1, 8)));
+			// Cb Cr Cb Cr ...
+			__m128i c = _mm_packus_epi16(_mm_and_si128(_mm_avg_epu8(a0, a1), lowBytes),
+				                         _mm_and_si128(_mm_avg_epu8(b0, b1), lowBytes));
+			if (bNV12) {
+				_mm_storeu_si128((__m128i *)(U + x), c);
+			}
+			else {
+				__m128i uv = _mm_packus_epi16(_mm_and_si128(c, lowBytes), _mm_srli_epi16(c, 8));
+				_mm_storel_epi64((__m128i *)(U + x / 2), uv);
+				_mm_storel_epi64((__m128i *)(V + x / 2), _mm_srli_si128(uv, 8));
+			}
+		}
+		uyvy_420_line_c<bNV12>(source0, source1, Y0, Y1, U, V, x, width);
+	}
+
+	// 32 pixels of each line at a time
+	// packus works within lanes, so the quadwords are put back in order.
+	template <bool bNV12>
+	NDI_TARGET("avx2")
+	static void convert_uyvy_420_avx2(const unsigned char *source0, const unsigned char *source1,
+		unsigned char *Y0, unsigned char *Y1, unsigned char *U, unsigned char *V, unsigned int width)
+	{
+		const __m256i lowBytes = _mm256_set1_epi16(0x00ff);
+		unsigned int x = 0;
+		for (; x + 32 <= width; x += 32) {
+			__m256i a0 = _mm256_loadu_si256((const __m256i *)(source0 + x * 2));
+			__m256i b0 = _mm256_loadu_si256((const __m256i *)(source0 + x * 2 + 32));
+			__m256i a1 = _mm256_loadu_si256((const __m256i *)(source1 + x * 2));
+			__m256i b1 = _mm256_loadu_si256((const __m256i *)(source1 + x * 2 + 32));
+			__m256i y0 = _mm256_packus_epi16(_mm256_srli_epi16(a0, 8), _mm256_srli_epi16(b0, 8));
+			__m256i y1 = _mm256_packus_epi16(_mm256_srli_epi16(a1, 8), _mm256_srli_epi16(b1, 8));
+			_mm256_storeu_si256((__m256i *)(Y0 + x), _mm256_permute4x64_epi64(y0, _MM_SHUFFLE(3, 1, 2, 0)));
+			_mm256_storeu_si256((__m256i *)(Y1 + x), _mm256_permute4x64_epi64(y1, _MM_SHUFFLE(3, 1, 2, 0)));
+			__m256i c = _mm256_packus_epi16(_mm256_and_si256(_mm256_avg_epu8(a0, a1), lowBytes),
+				                            _mm256_and_si256(_mm256_avg_epu8(b0, b1), lowBytes));
+			c = _mm256_permute4x64_epi64(c, _MM_SHUFFLE(3, 1, 2, 0));
+			if (bNV12) {
+				_mm256_storeu_si256((__m256i *)(U + x), c);
+			}
+			else {
+				__m256i uv = _mm256_packus_epi16(_mm256_and_si256(c, lowBytes), _mm256_srli_epi16(c, 8));
+				uv = _mm256_permute4x64_epi64(uv, _MM_SHUFFLE(3, 1, 2, 0));
+				_mm_storeu_si128((__m128i *)(U + x / 2), _mm256_castsi256_si128(uv));
+				_mm_storeu_si128((__m128i *)(V + x / 2), _mm256_extracti128_si256(uv, 1));
+			}
+		}
+		uyvy_420_line_c<bNV12>(source0, source1, Y0, Y1, U, V, x, width);
+	}
+
+	template <bool bNV12>
+	static convert_420_func Select420Line()
+	{
+		if (UseAVX2()) return convert_uyvy_420_avx2<bNV12>;
+		if (UseSSE2()) return convert_uyvy_420_sse2<bNV12>;
+		return convert_uyvy_420_c<bNV12>;
+	}
+
+	//
+	// 16 bit 4:2:2 formats
+	//
+	// P216 is a plane of 16 bit Y followed by a plane of interleaved 16 bit
+	// Cb Cr with the same line stride. PA16 adds a plane of 16 bit alpha.
+	// The line functions are given the Y line and find the other planes
+	// at a fixed offset, so flip and strides are handled by the common loop.
+	//
+	// RGBA conversions are in float so that no precision is lost
+	// and the same arithmetic in the same order is used by the C and SIMD
+	// versions. Chroma is the average of each pair of pixels.
+	//
+	// v210 packs three 10 bit components in each 32 bit word,
+	// 6 pixels in 4 words :
+	//   Cb0 Y0 Cr0 | Y1 Cb1 Y2 | Cr1 Y3 Cb2 | Y4 Cr2 Y5
+	//
+
+	// Half float conversion rounded to nearest even as F16C
+	static inline uint16_t float_to_half(float value)
+	{
+		uint32_t f = 0;
+		memcpy(&f, &value, 4);
+		uint32_t sign = (f >> 16) & 0x8000;
+		uint32_t bits = f & 0x7fffffff;
+		uint32_t e = bits >> 23;
+		uint32_t m = bits & 0x7fffff;
+		if (e == 255) // Inf or NaN
+			return (uint16_t)(sign | 0x7c00 | (m ? 0x200 | (m >> 13) : 0));
+		if (e >= 143) // Too large
+			return (uint16_t)(sign | 0x7c00);
+		uint32_t h = 0;
+		uint32_t rem = 0;
+		uint32_t halfway = 0;
+		if (e >= 113) { // Normal
+			h = ((e - 112) << 10) | (m >> 13);
+			rem = m & 0x1fff;
+			halfway = 0x1000;
+		}
+		else if (e >= 102) { // Denormal
+			m |= 0x800000;
+			unsigned int shift = 126 - e;
+			h = m >> shift;
+			rem = m & ((1u << shift) - 1);
+			halfway = 1u << (shift - 1);
+		}
+		// A carry into the exponent is correct, up to infinity
+		if (rem > halfway || (rem == halfway && (h & 1)))
+			h++;
+		return (uint16_t)(sign | h);
+	}
+
+	static inline float half_to_float(uint16_t h)
+	{
+		uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+		uint32_t e = (h >> 10) & 0x1f;
+		uint32_t m = h & 0x3ff;
+		uint32_t f = 0;
+		if (e == 0) {
+			float value = (float)m * 5.9604644775390625e-8f; // 2^-24
+			return sign ? -value : value;
+		}
+		if (e == 31)
+			f = sign | 0x7f800000 | (m << 13);
+		else
+			f = sign | ((e + 112) << 23) | (m << 13);
+		float value = 0.0f;
+		memcpy(&value, &f, 4);
+		return value;
+	}
+
+	// RGBA pixel formats converted to and from P216
+	enum DeepRgba { DEEP_RGBA, DEEP_BGRA, DEEP_RGBA16, DEEP_RGBA16F };
+
+	static inline unsigned short clamp_u16(float v)
+	{
+		v = v < 0.0f ? 0.0f : (v > 65535.0f ? 65535.0f : v);
+		return (unsigned short)(v + 0.5f);
+	}
+
+	static inline unsigned char clamp_u8(float v)
+	{
+		v = v < 0.0f ? 0.0f : (v > 1.0f ? 1.0f : v);
+		return (unsigned char)(v*255.0f + 0.5f);
+	}
+
+	// Store a pixel of 0-1 components
+	template <int Out>
+	static inline void store_deep_pixel(unsigned char *dest, unsigned int x, float r, float g, float b, float a)
+	{
+		if (Out == DEEP_RGBA || Out == DEEP_BGRA) {
+			unsigned char *d = dest + x * 4;
+			d[Out == DEEP_BGRA ? 2 : 0] = clamp_u8(r);
+			d[1] = clamp_u8(g);
+			d[Out == DEEP_BGRA ? 0 : 2] = clamp_u8(b);
+			d[3] = clamp_u8(a);
+		}
+		else if (Out == DEEP_RGBA16) {
+			unsigned short *d = (unsigned short *)dest + x * 4;
+			d[0] = clamp_u16(r*65535.0f);
+			d[1] = clamp_u16(g*65535.0f);
+			d[2] = clamp_u16(b*65535.0f);
+			d[3] = clamp_u16(a*65535.0f);
+		}
+		else {
+			// Half float is not clamped
+			unsigned short *d = (unsigned short *)dest + x * 4;
+			d[0] = float_to_half(r);
+			d[1] = float_to_half(g);
+			d[2] = float_to_half(b);
+			d[3] = float_to_half(a);
+		}
+	}
+
+	// Load a pixel as 0-1 components
+	template <int In>
+	static inline void load_deep_pixel(const unsigned char *source, unsigned int x, float &r, float &g, float &b, float &a)
+	{
+		if (In == DEEP_RGBA || In == DEEP_BGRA) {
+			const unsigned char *s = source + x * 4;
+			const float scale = 1.0f / 255.0f;
+			r = (float)s[In == DEEP_BGRA ? 2 : 0] * scale;
+			g = (float)s[1] * scale;
+			b = (float)s[In == DEEP_BGRA ? 0 : 2] * scale;
+			a = (float)s[3] * scale;
+		}
+		else if (In == DEEP_RGBA16) {
+			const unsigned short *s = (const unsigned short *)source + x * 4;
+			const float scale = 1.0f / 65535.0f;
+			r = (float)s[0] * scale;
+			g = (float)s[1] * scale;
+			b = (float)s[2] * scale;
+			a = (float)s[3] * scale;
+		}
+		else {
+			const unsigned short *s = (const unsigned short *)source + x * 4;
+			r = half_to_float(s[0]);
+			g = half_to_float(s[1]);
+			b = half_to_float(s[2]);
+			a = half_to_float(s[3]);
+		}
+	}
+
+	// P216 or PA16 (bAlpha) to an RGBA format
+	template <int Out, bool bAlpha>
+	static void convert_p216_rgba_c(const unsigned char *source, unsigned char *dest, unsigned int width, const ConvertParams &params)
+	{
+		const DeepCoefficients &c = params.deep;
+		const unsigned short *Y = (const unsigned short *)source;
+		const unsigned short *UV = (const unsigned short *)(source + params.sourcePlane);
+		const unsigned short *A = (const unsigned short *)(source + params.sourcePlane * 2);
+		for (unsigned int x = 0; x < width; x++) {
+			float yn = ((float)Y[x] - c.yoffset) * c.yscale;
+			float cb = ((float)UV[x & ~1u] - 32768.0f) * c.cscale;
+			float cr = ((float)UV[x | 1u] - 32768.0f) * c.cscale;
+			float r = yn + c.rv*cr;
+			float g = (yn - c.gu*cb) - c.gv*cr;
+			float b = yn + c.bu*cb;
+			float a = bAlpha ? (float)A[x] * (1.0f / 65535.0f) : 1.0f;
+			store_deep_pixel<Out>(dest, x, r, g, b, a);
+		}
+	}
+
+	// An RGBA format to P216 or PA16 (bAlpha)
+	template <int In, bool bAlpha>
+	static void convert_rgba_p216_c(const unsigned char *source, unsigned char *dest, unsigned int width, const ConvertParams &params)
+	{
+		const DeepCoefficients &c = params.deep;
+		unsigned short *Y = (unsigned short *)dest;
+		unsigned short *UV = (unsigned short *)(dest + params.destPlane);
+		unsigned short *A = (unsigned short *)(dest + params.destPlane * 2);
+		for (unsigned int x = 0; x < width; x += 2) {
+			float r0, g0, b0, a0, r1, g1, b1, a1;
+			load_deep_pixel<In>(source, x, r0, g0, b0, a0);
+			// An odd last pixel is its own pair
+			load_deep_pixel<In>(source, x + 1 < width ? x + 1 : x, r1, g1, b1, a1);
+			float y0 = (c.kr*r0 + c.kg*g0) + c.kb*b0;
+			float y1 = (c.kr*r1 + c.kg*g1) + c.kb*b1;
+			Y[x] = clamp_u16(y0*c.ygain + c.yoffset);
+			UV[x] = clamp_u16(((b0 - y0) + (b1 - y1))*c.cbgain + 32768.0f);
+			UV[x + 1] = clamp_u16(((r0 - y0) + (r1 - y1))*c.crgain + 32768.0f);
+			if (bAlpha)
+				A[x] = clamp_u16(a0*65535.0f);
+			if (x + 1 < width) {
+				Y[x + 1] = clamp_u16(y1*c.ygain + c.yoffset);
+				if (bAlpha)
+					A[x + 1] = clamp_u16(a1*65535.0f);
+			}
+		}
+	}
+
+	// 4x4 transpose of the components of four pixels
+	static inline void transpose_ps(__m128 &a, __m128 &b, __m128 &c, __m128 &d)
+	{
+		_MM_TRANSPOSE4_PS(a, b, c, d);
+	}
+
+	// 4 pixels per loop. Half float output needs F16C and uses the AVX2 version.
+	template <int Out, bool bAlpha>
+	NDI_TARGET("sse4.1")
+	static void convert_p216_rgba_sse41(const unsigned char *source, unsigned char *dest, unsigned int width, const ConvertParams &params)
+	{
+		const DeepCoefficients &c = params.deep;
+		const unsigned short *Y = (const unsigned short *)source;
+		const unsigned short *UV = (const unsigned short *)(source + params.sourcePlane);
+		const unsigned short *A = (const unsigned short *)(source + params.sourcePlane * 2);
+		const __m128 yoffset = _mm_set1_ps(c.yoffset);
+		const __m128 yscale = _mm_set1_ps(c.yscale);
+		const __m128 cscale = _mm_set1_ps(c.cscale);
+		const __m128 coffset = _mm_set1_ps(32768.0f);
+		const __m128 rv = _mm_set1_ps(c.rv);
+		const __m128 gu = _mm_set1_ps(c.gu);
+		const __m128 gv = _mm_set1_ps(c.gv);
+		const __m128 bu = _mm_set1_ps(c.bu);
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 half = _mm_set1_ps(0.5f);
+		const __m128 scale = _mm_set1_ps(Out == DEEP_RGBA16 ? 65535.0f : 255.0f);
+		unsigned int x = 0;
+		for (; x + 3 < width; x += 4) {
+			__m128 yn = _mm_cvtepi32_ps(_mm_cvtepu16_epi32(_mm_loadl_epi64((const __m128i *)(Y + x))));
+			__m128 uv = _mm_cvtepi32_ps(_mm_cvtepu16_epi32(_mm_loadl_epi64((const __m128i *)(UV + x))));
+			yn = _mm_mul_ps(_mm_sub_ps(yn, yoffset), yscale);
+			uv = _mm_mul_ps(_mm_sub_ps(uv, coffset), cscale);
+			__m128 cb = _mm_shuffle_ps(uv, uv, _MM_SHUFFLE(2, 2, 0, 0));
+			__m128 cr = _mm_shuffle_ps(uv, uv, _MM_SHUFFLE(3, 3, 1, 1));
+			__m128 r = _mm_add_ps(yn, _mm_mul_ps(rv, cr));
+			__m128 g = _mm_sub_ps(_mm_sub_ps(yn, _mm_mul_ps(gu, cb)), _mm_mul_ps(gv, cr));
+			__m128 b = _mm_add_ps(yn, _mm_mul_ps(bu, cb));
+			__m128 a = one;
+			if (bAlpha)
+				a = _mm_mul_ps(_mm_cvtepi32_ps(_mm_cvtepu16_epi32(_mm_loadl_epi64((const __m128i *)(A + x)))), _mm_set1_ps(1.0f / 65535.0f));
+			if (Out == DEEP_BGRA) {
+				__m128 t = r; r = b; b = t;
+			}
+			// Clamp and scale as store_deep_pixel
+			if (Out == DEEP_RGBA16) {
+				r = _mm_min_ps(_mm_max_ps(_mm_mul_ps(r, scale), zero), scale);
+				g = _mm_min_ps(_mm_max_ps(_mm_mul_ps(g, scale), zero), scale);
+				b = _mm_min_ps(_mm_max_ps(_mm_mul_ps(b, scale), zero), scale);
+				a = _mm_min_ps(_mm_max_ps(_mm_mul_ps(a, scale), zero), scale);
+			}
+			else {
+				r = _mm_mul_ps(_mm_min_ps(_mm_max_ps(r, zero), one), scale);
+				g = _mm_mul_ps(_mm_min_ps(_mm_max_ps(g, zero), one), scale);
+				b = _mm_mul_ps(_mm_min_ps(_mm_max_ps(b, zero), one), scale);
+				a = _mm_mul_ps(_mm_min_ps(_mm_max_ps(a, zero), one), scale);
+			}
+			transpose_ps(r, g, b, a); // now pixels 0 to 3
+			__m128i p0 = _mm_cvttps_epi32(_mm_add_ps(r, half));
+			__m128i p1 = _mm_cvttps_epi32(_mm_add_ps(g, half));
+			__m128i p2 = _mm_cvttps_epi32(_mm_add_ps(b, half));
+			__m128i p3 = _mm_cvttps_epi32(_mm_add_ps(a, half));
+			__m128i p01 = _mm_packus_epi32(p0, p1);
+			__m128i p23 = _mm_packus_epi32(p2, p3);
+			if (Out == DEEP_RGBA16) {
+				_mm_storeu_si128((__m128i *)(dest + x * 8), p01);
+				_mm_storeu_si128((__m128i *)(dest + x * 8 + 16), p23);
+			}
+			else {
+				_mm_storeu_si128((__m128i *)(dest + x * 4), _mm_packus_epi16(p01, p23));
+			}
+		}
+		// The planes move with the Y line
+		convert_p216_rgba_c<Out, bAlpha>(source + x * 2, dest + x * (Out == DEEP_RGBA16 ? 8 : 4), width - x, params);
+	}
+
+	// 4x4 transpose within each 128 bit lane
+	NDI_TARGET("avx2")
+	static inline void transpose_ps(__m256 &a, __m256 &b, __m256 &c, __m256 &d)
+	{
+		__m256 t0 = _mm256_unpacklo_ps(a, b);
+		__m256 t1 = _mm256_unpacklo_ps(c, d);
+		__m256 t2 = _mm256_unpackhi_ps(a, b);
+		__m256 t3 = _mm256_unpackhi_ps(c, d);
+		a = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(1, 0, 1, 0));
+		b = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(3, 2, 3, 2));
+		c = _mm256_shuffle_ps(t2, t3, _MM_SHUFFLE(1, 0, 1, 0));
+		d = _mm256_shuffle_ps(t2, t3, _MM_SHUFFLE(3, 2, 3, 2));
+	}
+
+	// 8 pixels per loop. F16C for half float.
+	// After the transpose in each lane the pixel vectors
+	// are 0|4, 1|5, 2|6 and 3|7.
+	template <int Out, bool bAlpha>
+	NDI_TARGET("avx2,f16c")
+	static void convert_p216_rgba_avx2(const unsigned char *source, unsigned char *dest, unsigned int width, const ConvertParams &params)
+	{
+		const DeepCoefficients &c = params.deep;
+		const unsigned short *Y = (const unsigned short *)source;
+		const unsigned short *UV = (const unsigned short *)(source + params.sourcePlane);
+		const unsigned short *A = (const unsigned short *)(source + params.sourcePlane * 2);
+		const __m256 yoffset = _mm256_set1_ps(c.yoffset);
+		const __m256 yscale = _mm256_set1_ps(c.yscale);
+		const __m256 cscale = _mm256_set1_ps(c.cscale);
+		const __m256 coffset = _mm256_set1_ps(32768.0f);
+		const __m256 rv = _mm256_set1_ps(c.rv);
+		const __m256 gu = _mm256_set1_ps(c.gu);
+		const __m256 gv = _mm256_set1_ps(c.gv);
+		const __m256 bu = _mm256_set1_ps(c.bu);
+		const __m256 zero = _mm256_setzero_ps();
+		const __m256 one = _mm256_set1_ps(1.0f);
+		const __m256 half = _mm256_set1_ps(0.5f);
+		const __m256 scale = _mm256_set1_ps(Out == DEEP_RGBA16 ? 65535.0f : 255.0f);
+		unsigned int x = 0;
+		for (; x + 7 < width; x += 8) {
+			__m256 yn = _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)(Y + x))));
+			__m256 uv = _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)(UV + x))));
+			yn = _mm256_mul_ps(_mm256_sub_ps(yn, yoffset), yscale);
+			uv = _mm256_mul_ps(_mm256_sub_ps(uv, coffset), cscale);
+			__m256 cb = _mm256_shuffle_ps(uv, uv, _MM_SHUFFLE(2, 2, 0, 0));
+			__m256 cr = _mm256_shuffle_ps(uv, uv, _MM_SHUFFLE(3, 3, 1, 1));
+			__m256 r = _mm256_add_ps(yn, _mm256_mul_ps(rv, cr));
+			__m256 g = _mm256_sub_ps(_mm256_sub_ps(yn, _mm256_mul_ps(gu, cb)), _mm256_mul_ps(gv, cr));
+			__m256 b = _mm256_add_ps(yn, _mm256_mul_ps(bu, cb));
+			__m256 a = one;
+			if (bAlpha)
+				a = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)(A + x)))), _mm256_set1_ps(1.0f / 65535.0f));
+			if (Out == DEEP_BGRA) {
+				__m256 t = r; r = b; b = t;
+			}
+
+			if (Out == DEEP_RGBA16F) {
+				transpose_ps(r, g, b, a);
+				__m128i h0 = _mm256_cvtps_ph(r, _MM_FROUND_TO_NEAREST_INT); // 0|4
+				__m128i h1 = _mm256_cvtps_ph(g, _MM_FROUND_TO_NEAREST_INT); // 1|5
+				__m128i h2 = _mm256_cvtps_ph(b, _MM_FROUND_TO_NEAREST_INT); // 2|6
+				__m128i h3 = _mm256_cvtps_ph(a, _MM_FROUND_TO_NEAREST_INT); // 3|7
+				unsigned char *d = dest + x * 8;
+				_mm_storeu_si128((__m128i *)(d), _mm_unpacklo_epi64(h0, h1));
+				_mm_storeu_si128((__m128i *)(d + 16), _mm_unpacklo_epi64(h2, h3));
+				_mm_storeu_si128((__m128i *)(d + 32), _mm_unpackhi_epi64(h0, h1));
+				_mm_storeu_si128((__m128i *)(d + 48), _mm_unpackhi_epi64(h2, h3));
+				continue;
+			}
+
+			if (Out == DEEP_RGBA16) {
+				r = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(r, scale), zero), scale);
+				g = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(g, scale), zero), scale);
+				b = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(b, scale), zero), scale);
+				a = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(a, scale), zero), scale);
+			}
+			else {
+				r = _mm256_mul_ps(_mm256_min_ps(_mm256_max_ps(r, zero), one), scale);
+				g = _mm256_mul_ps(_mm256_min_ps(_mm256_max_ps(g, zero), one), scale);
+				b = _mm256_mul_ps(_mm256_min_ps(_mm256_max_ps(b, zero), one), scale);
+				a = _mm256_mul_ps(_mm256_min_ps(_mm256_max_ps(a, zero), one), scale);
+			}
+			transpose_ps(r, g, b, a);
+			__m256i p0 = _mm256_cvttps_epi32(_mm256_add_ps(r, half));
+			__m256i p1 = _mm256_cvttps_epi32(_mm256_add_ps(g, half));
+			__m256i p2 = _mm256_cvttps_epi32(_mm256_add_ps(b, half));
+			__m256i p3 = _mm256_cvttps_epi32(_mm256_add_ps(a, half));
+			__m256i p01 = _mm256_packus_epi32(p0, p1); // 0 1 | 4 5
+			__m256i p23 = _mm256_packus_epi32(p2, p3); // 2 3 | 6 7
+			if (Out == DEEP_RGBA16) {
+				_mm256_storeu_si256((__m256i *)(dest + x * 8), _mm256_permute2x128_si256(p01, p23, 0x20));
+				_mm256_storeu_si256((__m256i *)(dest + x * 8 + 32), _mm256_permute2x128_si256(p01, p23, 0x31));
+			}
+			else {
+				// 0 1 2 3 | 4 5 6 7
+				_mm256_storeu_si256((__m256i *)(dest + x * 4), _mm256_packus_epi16(p01, p23));
+			}
+		}
+		convert_p216_rgba_c<Out, bAlpha>(source + x * 2, dest + x * (Out == DEEP_RGBA || Out == DEEP_BGRA ? 4 : 8), width - x, params);
+	}
+
+	// 4 pixels per loop. Half float input uses the AVX2 version.
+	template <int In, bool bAlpha>
+	NDI_TARGET("sse4.1")
+	static void convert_rgba_p216_sse41(const unsigned char *source, unsigned char *dest, unsigned int width, const ConvertParams &params)
+	{
+		const DeepCoefficients &c = params.deep;
+		unsigned short *Y = (unsigned short *)dest;
+		unsigned short *UV = (unsigned short *)(dest + params.destPlane);
+		unsigned short *A = (unsigned short *)(dest + params.destPlane * 2);
+		const __m128 kr = _mm_set1_ps(c.kr);
+		const __m128 kg = _mm_set1_ps(c.kg);
+		const __m128 kb = _mm_set1_ps(c.kb);
+		const __m128 ygain = _mm_set1_ps(c.ygain);
+		const __m128 yoffset = _mm_set1_ps(c.yoffset);
+		const __m128 cgain = _mm_setr_ps(c.cbgain, c.crgain, c.cbgain, c.crgain);
+		const __m128 coffset = _mm_set1_ps(32768.0f);
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 maximum = _mm_set1_ps(65535.0f);
+		const __m128 half = _mm_set1_ps(0.5f);
+		const __m128 scale = _mm_set1_ps(In == DEEP_RGBA16 ? 1.0f / 65535.0f : 1.0f / 255.0f);
+		unsigned int x = 0;
+		for (; x + 3 < width; x += 4) {
+			__m128i q0, q1, q2, q3;
+			if (In == DEEP_RGBA16) {
+				__m128i s0 = _mm_loadu_si128((const __m128i *)(source + x * 8));
+				__m128i s1 = _mm_loadu_si128((const __m128i *)(source + x * 8 + 16));
+				q0 = _mm_cvtepu16_epi32(s0);
+				q1 = _mm_cvtepu16_epi32(_mm_srli_si128(s0, 8));
+				q2 = _mm_cvtepu16_epi32(s1);
+				q3 = _mm_cvtepu16_epi32(_mm_srli_si128(s1, 8));
+			}
+			else {
+				__m128i s0 = _mm_loadu_si128((const __m128i *)(source + x * 4));
+				q0 = _mm_cvtepu8_epi32(s0);
+				q1 = _mm_cvtepu8_epi32(_mm_srli_si128(s0, 4));
+				q2 = _mm_cvtepu8_epi32(_mm_srli_si128(s0, 8));
+				q3 = _mm_cvtepu8_epi32(_mm_srli_si128(s0, 12));
+			}
+			__m128 r = _mm_mul_ps(_mm_cvtepi32_ps(q0), scale);
+			__m128 g = _mm_mul_ps(_mm_cvtepi32_ps(q1), scale);
+			__m128 b = _mm_mul_ps(_mm_cvtepi32_ps(q2), scale);
+			__m128 a = _mm_mul_ps(_mm_cvtepi32_ps(q3), scale);
+			transpose_ps(r, g, b, a); // now components
+			if (In == DEEP_BGRA) {
+				__m128 t = r; r = b; b = t;
+			}
+			__m128 yn = _mm_add_ps(_mm_add_ps(_mm_mul_ps(kr, r), _mm_mul_ps(kg, g)), _mm_mul_ps(kb, b));
+			__m128 y16 = _mm_min_ps(_mm_max_ps(_mm_add_ps(_mm_mul_ps(yn, ygain), yoffset), zero), maximum);
+			__m128i yi = _mm_cvttps_epi32(_mm_add_ps(y16, half));
+			_mm_storel_epi64((__m128i *)(Y + x), _mm_packus_epi32(yi, yi));
+			// (B - Y) and (R - Y) summed for each pair : cb01 cr01 cb23 cr23
+			__m128 sums = _mm_hadd_ps(_mm_sub_ps(b, yn), _mm_sub_ps(r, yn));
+			sums = _mm_shuffle_ps(sums, sums, _MM_SHUFFLE(3, 1, 2, 0));
+			__m128 c16 = _mm_min_ps(_mm_max_ps(_mm_add_ps(_mm_mul_ps(sums, cgain), coffset), zero), maximum);
+			__m128i ci = _mm_cvttps_epi32(_mm_add_ps(c16, half));
+			_mm_storel_epi64((__m128i *)(UV + x), _mm_packus_epi32(ci, ci));
+			if (bAlpha) {
+				__m128 a16 = _mm_min_ps(_mm_max_ps(_mm_mul_ps(a, maximum), zero), maximum);
+				__m128i ai = _mm_cvttps_epi32(_mm_add_ps(a16, half));
+				_mm_storel_epi64((__m128i *)(A + x), _mm_packus_epi32(ai, ai));
+			}
+		}
+		convert_rgba_p216_c<In, bAlpha>(source + x * (In == DEEP_RGBA16 ? 8 : 4), dest + x * 2, width - x, params);
+	}
+
+	// 8 pixels per loop. F16C for half float.
+	template <int In, bool bAlpha>
+	NDI_TARGET("avx2,f16c")
+	static void convert_rgba_p216_avx2(const unsigned char *source, unsigned char *dest, unsigned int width, const ConvertParams &params)
+	{
+		const DeepCoefficients &c = params.deep;
+		unsigned short *Y = (unsigned short *)dest;
+		unsigned short *UV = (unsigned short *)(dest + params.destPlane);
+		unsigned short *A = (unsigned short *)(dest + params.destPlane * 2);
+		const __m256 kr = _mm256_set1_ps(c.kr);
+		const __m256 kg = _mm256_set1_ps(c.kg);
+		const __m256 kb = _mm256_set1_ps(c.kb);
+		const __m256 ygain = _mm256_set1_ps(c.ygain);
+		const __m256 yoffset = _mm256_set1_ps(c.yoffset);
+		const __m256 cgain = _mm256_setr_ps(c.cbgain, c.crgain, c.cbgain, c.crgain, c.cbgain, c.crgain, c.cbgain, c.crgain);
+		const __m256 coffset = _mm256_set1_ps(32768.0f);
+		const __m256 zero = _mm256_setzero_ps();
+		const __m256 maximum = _mm256_set1_ps(65535.0f);
+		const __m256 half = _mm256_set1_ps(0.5f);
+		const __m256 scale = _mm256_set1_ps(In == DEEP_RGBA16 ? 1.0f / 65535.0f : 1.0f / 255.0f);
+		unsigned int x = 0;
+		for (; x + 7 < width; x += 8) {
+			// Pixel vectors 0|4, 1|5, 2|6, 3|7 for the transpose to components
+			__m256 r, g, b, a;
+			if (In == DEEP_RGBA || In == DEEP_BGRA) {
+				__m128i s0 = _mm_loadu_si128((const __m128i *)(source + x * 4));
+				__m128i s1 = _mm_loadu_si128((const __m128i *)(source + x * 4 + 16));
+				__m128i lo = _mm_unpacklo_epi32(s0, s1); // 0 4 1 5
+				__m128i hi = _mm_unpackhi_epi32(s0, s1); // 2 6 3 7
+				r = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(lo));
+				g = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_srli_si128(lo, 8)));
+				b = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(hi));
+				a = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_srli_si128(hi, 8)));
+			}
+			else {
+				const __m128i *s = (const __m128i *)(source + x * 8);
+				__m128i s0 = _mm_loadu_si128(s);     // 0 1
+				__m128i s1 = _mm_loadu_si128(s + 1); // 2 3
+				__m128i s2 = _mm_loadu_si128(s + 2); // 4 5
+				__m128i s3 = _mm_loadu_si128(s + 3); // 6 7
+				__m128i p04 = _mm_unpacklo_epi64(s0, s2);
+				__m128i p15 = _mm_unpackhi_epi64(s0, s2);
+				__m128i p26 = _mm_unpacklo_epi64(s1, s3);
+				__m128i p37 = _mm_unpackhi_epi64(s1, s3);
+				if (In == DEEP_RGBA16F) {
+					r = _mm256_cvtph_ps(p04);
+					g = _mm256_cvtph_ps(p15);
+					b = _mm256_cvtph_ps(p26);
+					a = _mm256_cvtph_ps(p37);
+				}
+				else {
+					r = _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(p04));
+					g = _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(p15));
+					b = _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(p26));
+					a = _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(p37));
+				}
+			}
+			if (In != DEEP_RGBA16F) {
+				r = _mm256_mul_ps(r, scale);
+				g = _mm256_mul_ps(g, scale);
+				b = _mm256_mul_ps(b, scale);
+				a = _mm256_mul_ps(a, scale);
+			}
+			transpose_ps(r, g, b, a); // components of pixels 0-3 | 4-7
+			if (In == DEEP_BGRA) {
+				__m256 t = r; r = b; b = t;
+			}
+			__m256 yn = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(kr, r), _mm256_mul_ps(kg, g)), _mm256_mul_ps(kb, b));
+			__m256 y16 = _mm256_min_ps(_mm256_max_ps(_mm256_add_ps(_mm256_mul_ps(yn, ygain), yoffset), zero), maximum);
+			__m256i yi = _mm256_cvttps_epi32(_mm256_add_ps(y16, half));
+			// Pack within lanes then gather the low halves
+			yi = _mm256_permute4x64_epi64(_mm256_packus_epi32(yi, yi), _MM_SHUFFLE(3, 1, 2, 0));
+			_mm_storeu_si128((__m128i *)(Y + x), _mm256_castsi256_si128(yi));
+			__m256 sums = _mm256_hadd_ps(_mm256_sub_ps(b, yn), _mm256_sub_ps(r, yn));
+			sums = _mm256_shuffle_ps(sums, sums, _MM_SHUFFLE(3, 1, 2, 0));
+			__m256 c16 = _mm256_min_ps(_mm256_max_ps(_mm256_add_ps(_mm256_mul_ps(sums, cgain), coffset), zero), maximum);
+			__m256i ci = _mm256_cvttps_epi32(_mm256_add_ps(c16, half));
+			ci = _mm256_permute4x64_epi64(_mm256_packus_epi32(ci, ci), _MM_SHUFFLE(3, 1, 2, 0));
+			_mm_storeu_si128((__m128i *)(UV + x), _mm256_castsi256_si128(ci));
+			if (bAlpha) {
+				__m256 a16 = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(a, maximum), zero), maximum);
+				__m256i ai = _mm256_cvttps_epi32(_mm256_add_ps(a16, half));
+				ai = _mm256_permute4x64_epi64(_mm256_packus_epi32(ai, ai), _MM_SHUFFLE(3, 1, 2, 0));
+				_mm_storeu_si128((__m128i *)(A + x), _mm256_castsi256_si128(ai));
+			}
+		}
+		convert_rgba_p216_c<In, bAlpha>(source + x * (In == DEEP_RGBA || In == DEEP_BGRA ? 4 : 8), dest + x * 2, width - x, params);
+	}
+
+	// 16 bit to 10 bit, the inverse of to_16bit
+	static inline uint32_t to_10bit(unsigned short v)
+	{
+		return (uint32_t)v >> 6;
+	}
+
+	// 10 bit to 16 bit with the high bits repeated so that 1023 is 65535
+	static inline unsigned short to_16bit(uint32_t v)
+	{
+		return (unsigned short)((v << 6) | (v >> 4));
+	}
+
+	// P216 or PA16 to v210 - alpha is not used
+	static void convert_p216_v210_c(const unsigned char *source, unsigned char *dest, unsigned int width, const ConvertParams &params)
+	{
+		const unsigned short *Y = (const unsigned short *)source;
+		const unsigned short *UV = (const unsigned short *)(source + params.sourcePlane);
+		uint32_t *dst = (uint32_t *)dest;
+		for (unsigned int x = 0; x < width; x += 6) {
+			// Components of a partial last group are zero
+			uint32_t y[6] = { 0, 0, 0, 0, 0, 0 };
+			uint32_t c[6] = { 0, 0, 0, 0, 0, 0 };
+			for (unsigned int i = 0; i < 6 && x + i < width; i += 2) {
+				y[i] = to_10bit(Y[x + i]);
+				if (x + i + 1 < width)
+					y[i + 1] = to_10bit(Y[x + i + 1]);
+				c[i] = to_10bit(UV[x + i]);
+				c[i + 1] = to_10bit(UV[x + i + 1]);
+			}
+			dst[0] = c[0] | (y[0] << 10) | (c[1] << 20);
+			dst[1] = y[1] | (c[2] << 10) | (y[2] << 20);
+			dst[2] = c[3] | (y[3] << 10) | (c[4] << 20);
+			dst[3] = y[4] | (c[5] << 10) | (y[5] << 20);
+			dst += 4;
+		}
+	}
+
+	// v210 to P216, or PA16 with opaque alpha
+	template <bool bAlpha>
+	static void convert_v210_p216_c(const unsigned char *source, unsigned char *dest, unsigned int width, const ConvertParams &params)
+	{
+		const uint32_t *src = (const uint32_t *)source;
+		unsigned short *Y = (unsigned short *)dest;
+		unsigned short *UV = (unsigned short *)(dest + params.destPlane);
+		unsigned short *A = (unsigned short *)(dest + params.destPlane * 2);
+		for (unsigned int x = 0; x < width; x += 6) {
+			uint32_t y[6], c[6];
+			c[0] = src[0] & 0x3ff; y[0] = (src[0] >> 10) & 0x3ff; c[1] = (src[0] >> 20) & 0x3ff;
+			y[1] = src[1] & 0x3ff; c[2] = (src[1] >> 10) & 0x3ff; y[2] = (src[1] >> 20) & 0x3ff;
+			c[3] = src[2] & 0x3ff; y[3] = (src[2] >> 10) & 0x3ff; c[4] = (src[2] >> 20) & 0x3ff;
+			y[4] = src[3] & 0x3ff; c[5] = (src[3] >> 10) & 0x3ff; y[5] = (src[3] >> 20) & 0x3ff;
+			// Chroma of a pair is written with its first pixel
+			for (unsigned int i = 0; i < 6 && x + i < width; i++) {
+				Y[x + i] = to_16bit(y[i]);
+				if ((i & 1) == 0) {
+					UV[x + i] = to_16bit(c[i]);
+					UV[x + i + 1] = to_16bit(c[i + 1]);
+				}
+			}
+			src += 4;
+		}
+		if (bAlpha) {
+			for (unsigned int x = 0; x < width; x++)
+				A[x] = 0xffff;
+		}
+	}
+
+	// 6 pixels per loop, reading and writing 8 of each plane
+	NDI_TARGET("sse4.1")
+	static void convert_p216_v210_sse41(const unsigned char *source, unsigned char *dest, unsigned int width, const ConvertParams &params)
+	{
+		const unsigned short *Y = (const unsigned short *)source;
+		const unsigned short *UV = (const unsigned short *)(source + params.sourcePlane);
+		// Each 10 bit slot of the four words from the Y and CbCr lines
+		const __m128i y0 = _mm_setr_epi8(-1, -1, -1, -1, 2, 3, -1, -1, -1, -1, -1, -1, 8, 9, -1, -1);
+		const __m128i c0 = _mm_setr_epi8(0, 1, -1, -1, -1, -1, -1, -1, 6, 7, -1, -1, -1, -1, -1, -1);
+		const __m128i y1 = _mm_setr_epi8(0, 1, -1, -1, -1, -1, -1, -1, 6, 7, -1, -1, -1, -1, -1, -1);
+		const __m128i c1 = _mm_setr_epi8(-1, -1, -1, -1, 4, 5, -1, -1, -1, -1, -1, -1, 10, 11, -1, -1);
+		const __m128i y2 = _mm_setr_epi8(-1, -1, -1, -1, 4, 5, -1, -1, -1, -1, -1, -1, 10, 11, -1, -1);
+		const __m128i c2 = _mm_setr_epi8(2, 3, -1, -1, -1, -1, -1, -1, 8, 9, -1, -1, -1, -1, -1, -1);
+		unsigned int x = 0;
+		for (; x + 8 <= width; x += 6) {
+			__m128i yv = _mm_srli_epi16(_mm_loadu_si128((const __m128i *)(Y + x)), 6);
+			__m128i cv = _mm_srli_epi16(_mm_loadu_si128((const __m128i *)(UV + x)), 6);
+			__m128i s0 = _mm_or_si128(_mm_shuffle_epi8(yv, y0), _mm_shuffle_epi8(cv, c0));
+			__m128i s1 = _mm_or_si128(_mm_shuffle_epi8(yv, y1), _mm_shuffle_epi8(cv, c1));
+			__m128i s2 = _mm_or_si128(_mm_shuffle_epi8(yv, y2), _mm_shuffle_epi8(cv, c2));
+			__m128i words = _mm_or_si128(s0, _mm_or_si128(_mm_slli_epi32(s1, 10), _mm_slli_epi32(s2, 20)));
+			_mm_storeu_si128((__m128i *)(dest + (x / 6) * 16), words);
+		}
+		convert_p216_v210_c(source + x * 2, dest + (x / 6) * 16, width - x, params);
+	}
+
+	template <bool bAlpha>
+	NDI_TARGET("sse4.1")
+	static void convert_v210_p216_sse41(const unsigned char *source, unsigned char *dest, unsigned int width, const ConvertParams &params)
+	{
+		unsigned short *Y = (unsigned short *)dest;
+		unsigned short *UV = (unsigned short *)(dest + params.destPlane);
+		const __m128i mask = _mm_set1_epi32(0x3ff);
+		// Y and CbCr gathered from the three slots
+		const __m128i y0 = _mm_setr_epi8(-1, -1, 4, 5, -1, -1, -1, -1, 12, 13, -1, -1, -1, -1, -1, -1);
+		const __m128i y1 = _mm_setr_epi8(0, 1, -1, -1, -1, -1, 8, 9, -1, -1, -1, -1, -1, -1, -1, -1);
+		const __m128i y2 = _mm_setr_epi8(-1, -1, -1, -1, 4, 5, -1, -1, -1, -1, 12, 13, -1, -1, -1, -1);
+		const __m128i c0 = _mm_setr_epi8(0, 1, -1, -1, -1, -1, 8, 9, -1, -1, -1, -1, -1, -1, -1, -1);
+		const __m128i c1 = _mm_setr_epi8(-1, -1, -1, -1, 4, 5, -1, -1, -1, -1, 12, 13, -1, -1, -1, -1);
+		const __m128i c2 = _mm_setr_epi8(-1, -1, 0, 1, -1, -1, -1, -1, 8, 9, -1, -1, -1, -1, -1, -1);
+		unsigned int x = 0;
+		for (; x + 8 <= width; x += 6) {
+			__m128i words = _mm_loadu_si128((const __m128i *)(source + (x / 6) * 16));
+			__m128i s0 = _mm_and_si128(words, mask);
+			__m128i s1 = _mm_and_si128(_mm_srli_epi32(words, 10), mask);
+			__m128i s2 = _mm_and_si128(_mm_srli_epi32(words, 20), mask);
+			s0 = _mm_or_si128(_mm_slli_epi32(s0, 6), _mm_srli_epi32(s0, 4));
+			s1 = _mm_or_si128(_mm_slli_epi32(s1, 6), _mm_srli_epi32(s1, 4));
+			s2 = _mm_or_si128(_mm_slli_epi32(s2, 6), _mm_srli_epi32(s2, 4));
+			__m128i yv = _mm_or_si128(_mm_shuffle_epi8(s0, y0), _mm_or_si128(_mm_shuffle_epi8(s1, y1), _mm_shuffle_epi8(s2, y2)));
+			__m128i cv = _mm_or_si128(_mm_shuffle_epi8(s0, c0), _mm_or_si128(_mm_shuffle_epi8(s1, c1), _mm_shuffle_epi8(s2, c2)));
+			// The last two of each are written again by the next group
+			_mm_storeu_si128((__m128i *)(Y + x), yv);
+			_mm_storeu_si128((__m128i *)(UV + x), cv);
+		}
+		convert_v210_p216_c<false>(source + (x / 6) * 16, dest + x * 2, width - x, params);
+		if (bAlpha) {
+			unsigned short *A = (unsigned short *)(dest + params.destPlane * 2);
+			for (unsigned int i = 0; i < width; i++)
+				A[i] = 0xffff;
+		}
+	}
+
+	// Fastest line function for the CPU
+	template <bool bSwap, bool bAlpha>
+	static convert_line_func SelectRgbaLine()
+	{
+		if (UseAVX2()) return convert_rgba_rgba_avx2<bSwap, bAlpha>;
+		if (UseSSE2()) return convert_rgba_rgba_sse2<bSwap, bAlpha>;
+		return convert_rgba_rgba_c<bSwap, bAlpha>;
+	}
+
+	template <bool bSwap>
+	static convert_line_func SelectUyvyLine()
+	{
+		if (UseAVX2())  return convert_uyvy_rgba_avx2<bSwap>;
+		if (UseSSE41()) return convert_uyvy_rgba_sse41<bSwap>;
+		return convert_uyvy_rgba_c<bSwap>;
+	}
+
+	template <bool bSwap>
+	static convert_line_func SelectUyvaLine()
+	{
+		if (UseAVX2())  return convert_uyva_rgba_avx2<bSwap>;
+		if (UseSSE41()) return convert_uyva_rgba_sse41<bSwap>;
+		return convert_uyva_rgba_c<bSwap>;
+	}
+
+	template <int Out, bool bAlpha>
+	static convert_line_func SelectP216RgbaLine()
+	{
+		if (UseAVX2() && HasF16C()) return convert_p216_rgba_avx2<Out, bAlpha>;
+		if (UseSSE41() && Out != DEEP_RGBA16F) return convert_p216_rgba_sse41<Out, bAlpha>;
+		return convert_p216_rgba_c<Out, bAlpha>;
+	}
+
+	template <int In, bool bAlpha>
+	static convert_line_func SelectRgbaP216Line()
+	{
+		if (UseAVX2() && HasF16C()) return convert_rgba_p216_avx2<In, bAlpha>;
+		if (UseSSE41() && In != DEEP_RGBA16F) return convert_rgba_p216_sse41<In, bAlpha>;
+		return convert_rgba_p216_c<In, bAlpha>;
+	}
+
+	static inline bool IsRgbaFormat(PixelFormat format)
+	{
+		return format == FORMAT_RGBA || format == FORMAT_BGRA
+			|| format == FORMAT_RGBA16 || format == FORMAT_RGBA16F;
+	}
+
+	static inline bool IsP216Format(PixelFormat format)
+	{
+		return format == FORMAT_P216 || format == FORMAT_PA16;
+	}
+
+	// P216 or PA16 to and from v210 and RGBA formats
+	template <bool bAlpha>
+	static convert_line_func SelectDeepLine(PixelFormat rgbaFormat, bool bToRgba)
+	{
+		switch (rgbaFormat) {
+		case FORMAT_RGBA:
+			return bToRgba ? SelectP216RgbaLine<DEEP_RGBA, bAlpha>() : SelectRgbaP216Line<DEEP_RGBA, bAlpha>();
+		case FORMAT_BGRA:
+			return bToRgba ? SelectP216RgbaLine<DEEP_BGRA, bAlpha>() : SelectRgbaP216Line<DEEP_BGRA, bAlpha>();
+		case FORMAT_RGBA16:
+			return bToRgba ? SelectP216RgbaLine<DEEP_RGBA16, bAlpha>() : SelectRgbaP216Line<DEEP_RGBA16, bAlpha>();
+		case FORMAT_RGBA16F:
+			return bToRgba ? SelectP216RgbaLine<DEEP_RGBA16F, bAlpha>() : SelectRgbaP216Line<DEEP_RGBA16F, bAlpha>();
+		case FORMAT_V210:
+			if (bToRgba)
+				return UseSSE41() ? convert_p216_v210_sse41 : convert_p216_v210_c;
+			return UseSSE41() ? convert_v210_p216_sse41<bAlpha> : convert_v210_p216_c<bAlpha>;
+		default:
+			return NULL;
+		}
+	}
+
+	static convert_line_func SelectConvertLine(PixelFormat sourceFormat, PixelFormat destFormat, bool bAlphaFill)
+	{
+		// 16 bit formats
+		if (IsP216Format(sourceFormat))
+			return sourceFormat == FORMAT_PA16 ? SelectDeepLine<true>(destFormat, true) : SelectDeepLine<false>(destFormat, true);
+		if (IsP216Format(destFormat))
+			return destFormat == FORMAT_PA16 ? SelectDeepLine<true>(sourceFormat, false) : SelectDeepLine<false>(sourceFormat, false);
+		if (destFormat == FORMAT_UYVA) {
+			if (sourceFormat != FORMAT_RGBA && sourceFormat != FORMAT_BGRA)
+				return NULL;
+			return UseSSE41() ? convert_rgba_uyva_sse41 : convert_rgba_uyva_c;
+		}
+		if (sourceFormat == FORMAT_UYVA) {
+			if (destFormat == FORMAT_RGBA) return SelectUyvaLine<false>();
+			if (destFormat == FORMAT_BGRA) return SelectUyvaLine<true>();
+			return NULL;
+		}
+		if (sourceFormat > FORMAT_UYVY || destFormat > FORMAT_UYVY)
+			return NULL;
+
+		bool bSwap = (sourceFormat == FORMAT_BGRA) != (destFormat == FORMAT_BGRA);
+
+		if (sourceFormat == FORMAT_UYVY)
+			return bSwap ? SelectUyvyLine<true>() : SelectUyvyLine<false>();
+
+		if (destFormat == FORMAT_UYVY)
+			return UseSSE41() ? convert_rgba_uyvy_sse41 : convert_rgba_uyvy_c;
+
+		if (bSwap)
+			return bAlphaFill ? SelectRgbaLine<true, true>() : SelectRgbaLine<true, false>();
+		return SelectRgbaLine<false, true>();
+	}
+
+	// Bytes per line of packed pixels
+	unsigned int GetLineBytes(PixelFormat format, unsigned int width)
+	{
+		switch (format) {
+		case FORMAT_UYVY:
+		case FORMAT_UYVA: // UYVY plane line
+		case FORMAT_P216: // Y plane line
+		case FORMAT_PA16:
+			return ((width + 1) / 2) * 4; // pixel pairs
+		case FORMAT_V210:
+			return ((width + 47) / 48) * 128;
+		case FORMAT_RGBA16:
+		case FORMAT_RGBA16F:
+			return width * 8;
+		case FORMAT_NV12: // Y plane line
+		case FORMAT_I420:
+			return ((width + 1) / 2) * 2; // even so that I420 chroma is half
+		default:
+			return width * 4;
+		}
+	}
+
+	unsigned int GetPlanes(PixelFormat format)
+	{
+		if (format == FORMAT_P216) return 2;
+		if (format == FORMAT_PA16) return 3;
+		if (format == FORMAT_UYVA) return 2;
+		if (format == FORMAT_NV12) return 2;
+		if (format == FORMAT_I420) return 3;
+		return 1;
+	}
+
+	size_t GetImageBytes(PixelFormat format, unsigned int width, unsigned int height)
+	{
+		if (format == FORMAT_UYVA)
+			return (size_t)(GetLineBytes(format, width) + width)*height;
+		if (format == FORMAT_NV12 || format == FORMAT_I420)
+			return (size_t)GetLineBytes(format, width)*(height + (height + 1) / 2);
+		return (size_t)GetLineBytes(format, width)*height*GetPlanes(format);
+	}
+
+	// Bytes from a line to its line in the UYVA alpha plane
+	static inline size_t AlphaPlaneOffset(unsigned int line, unsigned int width, unsigned int height, unsigned int stride)
+	{
+		return (size_t)(height - line)*stride + (size_t)line*width;
+	}
+
+	// Scratch memory of the calling thread
+	// Grown as needed and kept for the next conversion on the thread
+	static unsigned char *GetScratch(size_t size)
+	{
+		static thread_local std::vector<unsigned char> scratch;
+		if (scratch.size() < size)
+			scratch.resize(size);
+		return scratch.data();
+	}
+
+	// UYVY, UYVA, RGBA or BGRA to NV12 or I420 by pairs of lines
+	// RGBA and BGRA lines are converted to UYVY first in a small buffer
+	// that stays in the cache. The UYVA alpha plane is not used.
+	static void ConvertImage420(const unsigned char *source, unsigned int sourceStride, PixelFormat sourceFormat,
+		unsigned char *dest, unsigned int destStride, PixelFormat destFormat,
+		unsigned int width, unsigned int height, bool bInvert)
+	{
+		convert_line_func toUyvy = NULL;
+		if (sourceFormat == FORMAT_RGBA || sourceFormat == FORMAT_BGRA)
+			toUyvy = SelectConvertLine(sourceFormat, FORMAT_UYVY, false);
+		else if (sourceFormat != FORMAT_UYVY && sourceFormat != FORMAT_UYVA)
+			return;
+
+		bool bNV12 = (destFormat == FORMAT_NV12);
+		convert_420_func convert = bNV12 ? Select420Line<true>() : Select420Line<false>();
+
+		ConvertParams params;
+		params.rgbyuv = GetRGBYUVcoefficients(sourceFormat == FORMAT_BGRA);
+
+		// An odd last line is a pair with itself
+		unsigned int pairs = (height + 1) / 2;
+		unsigned int chromaStride = bNV12 ? destStride : destStride / 2;
+		size_t lumaSize = (size_t)height*destStride;
+		size_t chromaSize = (size_t)pairs*chromaStride;
+		unsigned int uyvyBytes = GetLineBytes(FORMAT_UYVY, width);
+
+		auto convertPairs = [=](unsigned int p0, unsigned int p1) {
+			// A pair of UYVY lines for each band thread
+			unsigned char *lines = toUyvy ? GetScratch((size_t)uyvyBytes * 2) : NULL;
+			for (unsigned int p = p0; p < p1; p++) {
+				unsigned int y0 = p * 2;
+				unsigned int y1 = (y0 + 1 < height) ? y0 + 1 : y0;
+				const unsigned char *src0 = source + (size_t)(bInvert ? height - 1 - y0 : y0)*sourceStride;
+				const unsigned char *src1 = source + (size_t)(bInvert ? height - 1 - y1 : y1)*sourceStride;
+				if (toUyvy) {
+					toUyvy(src0, lines, width, params);
+					toUyvy(src1, lines + uyvyBytes, width, params);
+					src0 = lines;
+					src1 = lines + uyvyBytes;
+				}
+				unsigned char *U = dest + lumaSize + (size_t)p*chromaStride;
+				convert(src0, src1, dest + (size_t)y0*destStride, dest + (size_t)y1*destStride,
+					U, U + chromaSize, width);
+			}
+		};
+
+		if (!UseThreads(width, height))
+			convertPairs(0, pairs);
+		else
+			GetThreadPool().Run(pairs, convertPairs);
+	}
+
+	void ConvertImage(const unsigned char *source, unsigned int sourceStride, PixelFormat sourceFormat,
+		unsigned char *dest, unsigned int destStride, PixelFormat destFormat,
+		unsigned int width, unsigned int height,
+		bool bInvert, bool bAlphaFill, ColorMatrix matrix, bool bFullRange)
+	{
+		if (source == NULL || dest == NULL || width == 0 || height == 0)
+			return;
+
+		if (sourceStride == 0)
+			sourceStride = GetLineBytes(sourceFormat, width);
+		if (destStride == 0)
+			destStride = GetLineBytes(destFormat, width);
+
+		// Alpha fill is for 8 bit RGBA and BGRA only.
+		// UYVY has no alpha and is always converted to opaque RGBA.
+		if (sourceFormat > FORMAT_BGRA || destFormat > FORMAT_BGRA)
+			bAlphaFill = false;
+
+		// 4:2:0 formats are written from pairs of lines
+		if (destFormat == FORMAT_NV12 || destFormat == FORMAT_I420) {
+			ConvertImage420(source, sourceStride, sourceFormat, dest, destStride, destFormat, width, height, bInvert);
+			return;
+		}
+		if (sourceFormat == FORMAT_NV12 || sourceFormat == FORMAT_I420)
+			return;
+
+		// The same format is a copy of each plane
+		if (sourceFormat == destFormat && !bAlphaFill) {
+			unsigned int planes = GetPlanes(sourceFormat);
+			if (sourceFormat == FORMAT_UYVA) {
+				CopyLines(source + (size_t)height*sourceStride, width,
+					dest + (size_t)height*destStride, width, width, height, bInvert);
+				planes = 1;
+			}
+			for (unsigned int p = 0; p < planes; p++) {
+				CopyLines(source + (size_t)p*height*sourceStride, sourceStride,
+					dest + (size_t)p*height*destStride, destStride,
+					GetLineBytes(sourceFormat, width), height, bInvert);
+			}
+			return;
+		}
+
+		convert_line_func convert = SelectConvertLine(sourceFormat, destFormat, bAlphaFill);
+		if (!convert)
+			return;
+
+		ConvertParams params;
+		params.yuv = GetYUVcoefficients(matrix, bFullRange);
+		params.rgbyuv = GetRGBYUVcoefficients(sourceFormat == FORMAT_BGRA);
+		params.deep = GetDeepCoefficients(matrix, bFullRange);
+		params.sourcePlane = (size_t)height*sourceStride;
+		params.destPlane = (size_t)height*destStride;
+
+		auto convertLines = [=](unsigned int y0, unsigned int y1) {
+			ConvertParams lineParams = params;
+			for (unsigned int y = y0; y < y1; y++) {
+				unsigned int line = bInvert ? height - 1 - y : y;
+				// The UYVA alpha plane has its own line stride
+				if (destFormat == FORMAT_UYVA)
+					lineParams.destPlane = AlphaPlaneOffset(y, width, height, destStride);
+				if (sourceFormat == FORMAT_UYVA)
+					lineParams.sourcePlane = AlphaPlaneOffset(line, width, height, sourceStride);
+				convert(source + (size_t)line*sourceStride, dest + (size_t)y*destStride, width, lineParams);
+			}
+		};
+
+		if (!UseThreads(width, height))
+			convertLines(0, height);
+		else
+			GetThreadPool().Run(height, convertLines);
+	}
 
+} // end namespace ofxNDIutils
@@ -26,6 +26,23 @@
 
 	16.10.16 - Create file
 	11.06.18 - - Add changes for OSX (https://github.com/ThomasLengeling/ofxNDI)
+	17.10.26 - Add CPU feature detection
+			 - Add rgba_bgra with AVX2 and AVX-512 variants selected on first use
+			 - YUV422_to_RGBA : SSE4.1 and AVX2 fixed point versions
+			   BT.601, BT.709, BT.2020 colour matrix and full/limited range
+			 - Add RGBA_to_YUV422 and BGRA_to_YUV422
+			 - Add SetThreads, GetThreads, GetThreadFallbacks
+			 - Windows headers for Windows only, x86intrin for other platforms
+			 - Add CopyLines, destination stride for CopyImage
+			 - Add SetStreamThreshold, GetStreamThreshold, HasERMSB, GetCacheSize
+			 - Add ConvertImage - single pass conversion with flip, swap and alpha fill
+			 - Add FlipImage - flip in place without a second buffer
+			 - ConvertImage : P216, PA16, v210, RGBA16 and RGBA16F formats
+			 - Add GetLineBytes, GetPlanes, GetImageBytes, HasF16C
+			 - ConvertImage : RGBA and BGRA to UYVA
+			 - ConvertImage : UYVY, UYVA, RGBA and BGRA to NV12 and I420
+			 - ConvertImage : UYVA to RGBA and BGRA
+			 - Add SetInstructionSet, GetInstructionSet
 
 
 */
@@ -34,28 +51,206 @@
 #define __ofxNDI_
 
 #include <emmintrin.h> // for SSE2
+#include <immintrin.h> // for AVX2 and AVX-512
 #include <iostream> // for cout
-
-// TODO : test includes for OSX
-#if defined(__APPLE__)
-#include <x86intrin.h> // for _movsd
 #include <stdlib.h>
-#include <cstdint>
-#include <string.h>
-#else
+#include <stdint.h>
+#include <string.h> // for memcpy
+
+#if defined(_WIN32)
 #include <windows.h>
-#include <intrin.h> // for _movsd
+#include <intrin.h> // for __movsd
+#else
+#include <x86intrin.h> // OSX and Linux
 #endif
 
 namespace ofxNDIutils {
 
+	// Threads used for conversion of large images
+	// Images are split into bands of rows processed in parallel.
+	// Functions return when the whole image is complete.
+	// - nThreads | total including the calling thread
+	//   0 - one for each core
+	//   1 - single threaded (default)
+	// - bAffinity | pin each worker thread to a core
+	void SetThreads(unsigned int nThreads, bool bAffinity = false);
+	unsigned int GetThreads();
+
+	// Conversions run on the calling thread only although they could
+	// have been split, because they were called from inside a band or
+	// while SetThreads was replacing the threads. Conversions from
+	// several threads at once share the threads.
+	unsigned long long GetThreadFallbacks();
+
+	// Copy an RGBA or BGRA image
+	// - stride | source line stride in bytes
+	// - bSwapRB | convert between RGBA and BGRA
+	// - bInvert | flip the image
+	// - destStride | destination line stride in bytes
+	//   0 - width*4 (packed)
 	void CopyImage(const unsigned char *source, unsigned char *dest, 
 				   unsigned int width, unsigned int height, unsigned int stride,
-				   bool bSwapRB = false, bool bInvert = false);
+				   bool bSwapRB = false, bool bInvert = false, unsigned int destStride = 0);
+
+	// Copy lines of any format with separate source and destination strides
+	// - lineBytes | bytes copied from each line
+	// - bInvert | copy the source lines bottom up
+	void CopyLines(const unsigned char *source, unsigned int sourceStride,
+				   unsigned char *dest, unsigned int destStride,
+				   unsigned int lineBytes, unsigned int height, bool bInvert = false);
+
+	// Flip an image in place by exchanging lines top and bottom
+	// - image | image data
+	// - stride | line stride in bytes
+	// - lineBytes | bytes exchanged for each line
+	// - height | number of lines
+	// - bSwapRB | also convert between RGBA and BGRA (lineBytes is width*4)
+	void FlipImage(unsigned char *image, unsigned int stride, unsigned int lineBytes,
+				   unsigned int height, bool bSwapRB = false);
+
+	// Copy with SSE2 non-temporal stores, any size and alignment
+	// Faster than memcpy only for copies larger than the caches
 	void memcpy_sse2(void* dst, const void* src, size_t Size);
+
+	// Image copies larger than this number of bytes use non-temporal stores.
+	// Smaller copies use rep movsb if the CPU has ERMSB, or memcpy.
+	// 0 - the size of the largest processor cache (default)
+	void SetStreamThreshold(size_t bytes);
+	size_t GetStreamThreshold();
+
+	// RGBA <> BGRA conversion using the fastest instruction set available.
+	// The function used is selected once, on first use, from CPUID.
+	void rgba_bgra(const void *source, void *dest, unsigned int width, unsigned int height, bool bInvert = false);
+
+	// Individual RGBA <> BGRA conversion paths.
+	// All produce identical output. Do not call a path
+	// that is not supported by the CPU (see below).
+	void rgba_bgra_c(const void *source, void *dest, unsigned int width, unsigned int height, bool bInvert = false);
 	void rgba_bgra_sse2(const void *source, void *dest, unsigned int width, unsigned int height, bool bInvert = false);
+	void rgba_bgra_avx2(const void *source, void *dest, unsigned int width, unsigned int height, bool bInvert = false);
+	void rgba_bgra_avx512(const void *source, void *dest, unsigned int width, unsigned int height, bool bInvert = false);
+
+	// CPU instruction set support
+	// (checks both the processor and that the OS saves the registers)
+	bool HasSSE2();
+	bool HasSSE41();
+	bool HasAVX2();
+	bool HasAVX512(); // AVX-512 F and BW
+	bool HasF16C(); // Half float conversion
+	bool HasERMSB(); // Enhanced rep movsb
+
+	// Size of the largest processor data cache in bytes, 0 if not known
+	size_t GetCacheSize();
+
+	// Instruction sets in order
+	enum InstructionSet {
+		INSTRUCTIONS_C,
+		INSTRUCTIONS_SSE2,
+		INSTRUCTIONS_SSE41,
+		INSTRUCTIONS_AVX2,
+		INSTRUCTIONS_AVX512
+	};
+
+	// Highest instruction set used by ConvertImage, FlipImage, CopyImage
+	// with padded lines, YUV422_to_RGBA and RGBA_to_YUV422
+	// Sets the processor does not support are never used. Lower the limit
+	// to compare a SIMD path with the C version (examples/example-verify).
+	// rgba_bgra selects its path once and is not limited.
+	// Default INSTRUCTIONS_AVX512 - all supported
+	void SetInstructionSet(InstructionSet maximum);
+	InstructionSet GetInstructionSet();
+
 	void FlipBuffer(const unsigned char *src, unsigned char *dst, unsigned int width, unsigned int height);
-	void YUV422_to_RGBA(const unsigned char * source, unsigned char * dest, unsigned int width, unsigned int height, unsigned int stride);
+
+	// YUV colour matrix
+	// NDI uses BT.601 for SD, BT.709 for HD and BT.2020 for UHD
+	enum ColorMatrix {
+		BT601,
+		BT709,
+		BT2020
+	};
+
+	// Colour matrix used by NDI for the image size
+	ColorMatrix GetColorMatrix(unsigned int width, unsigned int height);
+
+	// Pixel formats for ConvertImage
+	enum PixelFormat {
+		FORMAT_RGBA,
+		FORMAT_BGRA,
+		FORMAT_UYVY,
+		FORMAT_P216,    // 16 bit Y plane then interleaved 16 bit CbCr plane
+		FORMAT_PA16,    // P216 then a 16 bit alpha plane
+		FORMAT_V210,    // 10 bit 4:2:2, 6 pixels in 16 bytes
+		FORMAT_RGBA16,  // 16 bit unsigned per component
+		FORMAT_RGBA16F, // 16 bit half float per component
+		FORMAT_UYVA,    // UYVY then an 8 bit alpha plane of width bytes per line
+		FORMAT_NV12,    // 8 bit Y plane then interleaved CbCr plane of half height
+		FORMAT_I420     // 8 bit Y plane then Cb and Cr planes of half width and height
+	};
+
+	// Convert an image between pixel formats in a single pass
+	// Each pixel is read and written once whatever the options.
+	// - sourceStride, destStride | line strides in bytes, 0 - packed
+	//   The planes of P216 and PA16 use the same stride and follow each other.
+	//   The UYVA alpha plane follows the UYVY lines and is always packed.
+	//   The NV12 CbCr plane has the Y line stride, I420 Cb and Cr half of it.
+	// - bInvert | flip the image
+	// - bAlphaFill | set alpha to 255, e.g. for RGBX and BGRX sources.
+	//   UYVY sources always give opaque RGBA.
+	// - matrix, bFullRange | UYVY, P216 and PA16 colour matrix and range
+	//   RGBA to UYVY uses the same coefficients as the sender shader.
+	// 8 bit formats convert to each other.
+	// P216 and PA16 convert to and from v210 and any RGBA format.
+	// RGBA and BGRA convert to and from UYVA.
+	// UYVY, UYVA, RGBA and BGRA convert to NV12 and I420 for video encoders.
+	// Chroma is averaged over each pair of lines and the UYVA alpha is not used.
+	// Other combinations are not supported and nothing is done.
+	void ConvertImage(const unsigned char *source, unsigned int sourceStride, PixelFormat sourceFormat,
+					  unsigned char *dest, unsigned int destStride, PixelFormat destFormat,
+					  unsigned int width, unsigned int height,
+					  bool bInvert = false, bool bAlphaFill = false,
+					  ColorMatrix matrix = BT601, bool bFullRange = false);
+
+	// Bytes per line of a packed image
+	// v210 lines are padded to 128 byte blocks of 48 pixels
+	unsigned int GetLineBytes(PixelFormat format, unsigned int width);
+
+	// Number of planes of the format, each of GetLineBytes * height
+	// except for the UYVA alpha plane of width * height
+	// and the NV12 and I420 chroma planes of half height
+	unsigned int GetPlanes(PixelFormat format);
+
+	// Bytes of a packed image including all planes
+	size_t GetImageBytes(PixelFormat format, unsigned int width, unsigned int height);
+
+	// UYVY to RGBA using the fastest instruction set available
+	// - stride | line stride of the UYVY source in bytes
+	// - matrix | YUV colour matrix
+	// - bFullRange | Y 0-255 rather than 16-235
+	void YUV422_to_RGBA(const unsigned char * source, unsigned char * dest, unsigned int width, unsigned int height, unsigned int stride,
+		ColorMatrix matrix = BT601, bool bFullRange = false);
+
+	// Individual UYVY to RGBA conversion paths, all with identical output
+	void YUV422_to_RGBA_c(const unsigned char * source, unsigned char * dest, unsigned int width, unsigned int height, unsigned int stride,
+		ColorMatrix matrix = BT601, bool bFullRange = false);
+	void YUV422_to_RGBA_sse41(const unsigned char * source, unsigned char * dest, unsigned int width, unsigned int height, unsigned int stride,
+		ColorMatrix matrix = BT601, bool bFullRange = false);
+	void YUV422_to_RGBA_avx2(const unsigned char * source, unsigned char * dest, unsigned int width, unsigned int height, unsigned int stride,
+		ColorMatrix matrix = BT601, bool bFullRange = false);
+
+	// RGBA or BGRA to UYVY using the fastest instruction set available
+	// Same BT.709 coefficients as the sender shader (ofxNDIshaders)
+	// - stride | line stride of the UYVY destination in bytes
+	// - bInvert | flip the image
+	void RGBA_to_YUV422(const unsigned char * source, unsigned char * dest, unsigned int width, unsigned int height, unsigned int stride, bool bInvert = false);
+	void BGRA_to_YUV422(const unsigned char * source, unsigned char * dest, unsigned int width, unsigned int height, unsigned int stride, bool bInvert = false);
+
+	// Individual RGBA/BGRA to UYVY conversion paths, with identical output
+	// - bSwapRB | source is BGRA
+	void RGBA_to_YUV422_c(const unsigned char * source, unsigned char * dest, unsigned int width, unsigned int height, unsigned int stride,
+		bool bSwapRB = false, bool bInvert = false);
+	void RGBA_to_YUV422_sse41(const unsigned char * source, unsigned char * dest, unsigned int width, unsigned int height, unsigned int stride,
+		bool bSwapRB = false, bool bInvert = false);
 
 }
 